@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A tiny benchmark harness.  Each benchmark is a function that runs its body
+// `iterations` times; the runner grows the iteration count until a run takes
+// long enough to time reliably, then reports the time per iteration.
+namespace bench {
+
+typedef std::function<void(size_t iterations)> BenchFn;
+
+struct Benchmark {
+  std::string name;
+  BenchFn fn;
+};
+
+std::vector<Benchmark>& Registry();
+
+struct Registrar {
+  Registrar(const std::string& name, BenchFn fn) {
+    Registry().push_back(Benchmark { name, fn });
+  }
+};
+
+// Keeps the compiler from optimizing away a computed value.
+template<class T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs the registered benchmarks.  Arguments are an optional name filter,
+// --json to print results as JSON, and --<param>=<value> to set parameters
+// read through GetParam.
+int RunAll(int argc, char **argv);
+
+// A --<name>=<value> argument, or defaultValue if it wasn't given.
+size_t GetParam(const std::string& name, size_t defaultValue);
+
+}
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+
+// Registers a benchmark, fn is callable as fn(size_t iterations).
+#define BENCHMARK(name, fn) \
+  static bench::Registrar BENCH_CONCAT(s_benchRegistrar, __LINE__)(name, fn)
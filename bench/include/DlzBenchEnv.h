@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClientAddress.h"
+#include "DlzState.h"
+#include "FakeFleet.h"
+
+struct DlzBenchOptions {
+  DlzBenchOptions()
+    : zone("aws.bench"), cidr("10.0.0.0/8"), account("bench"),
+      instances(10000), asgs(100), asg_size(16), api_latency_us(0) { }
+
+  std::string zone;
+  std::string cidr;
+  std::string account;
+  size_t instances;
+  size_t asgs;
+  size_t asg_size;
+  uint64_t api_latency_us;
+  // Written to the temporary config file dlz_create reads.
+  std::string extra_config;
+};
+
+// An ec2dns driver created through dlz_create in this process, with a fake
+// fleet behind its EC2 and AutoScaling clients and no-op BIND callbacks.
+class DlzBenchEnv {
+public:
+    DlzBenchEnv(const DlzBenchOptions& options);
+
+    // Shared by the benchmarks, sized by the instances, asgs and asg_size
+    // bench params.
+    static DlzBenchEnv& Get();
+
+    dlz_state* GetState() { return this->m_state; }
+    const FakeFleet& GetFleet() const { return *this->m_fleet; }
+
+    // Looks name up in zone as if asked by client (an IPv4 address in host
+    // byte order).
+    isc_result_t Lookup(const char *zone, const char *name, uint32_t client = 0x0A000101);
+    isc_result_t Lookup(const char *zone, const char *name, const ClientAddress& client);
+
+    const char* GetZone() const { return this->m_options.zone.c_str(); }
+    const char* GetAsgZone() const { return this->m_asgZone.c_str(); }
+    const char* GetAccount() const { return this->m_options.account.c_str(); }
+
+private:
+    const DlzBenchOptions m_options;
+    const std::string m_asgZone;
+    std::shared_ptr<const FakeFleet> m_fleet;
+    dlz_state *m_state;
+};
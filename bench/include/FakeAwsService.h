@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "FakeFleet.h"
+
+struct FakeAwsFaults {
+  FakeAwsFaults() : latency_ms(0), latency_jitter_ms(0), error_rate(0), throttle_rate(0) { }
+
+  // Every request waits latency_ms plus up to latency_jitter_ms.
+  uint32_t latency_ms;
+  uint32_t latency_jitter_ms;
+  // Fractions of requests answered with a 500 InternalError, or throttled
+  // (RequestLimitExceeded/503 for EC2, Throttling/400 for AutoScaling).
+  double error_rate;
+  double throttle_rate;
+};
+
+struct FakeAwsResponse {
+  int status;
+  std::string body;
+};
+
+// Answers DescribeInstances and DescribeAutoScalingGroups in the EC2 and
+// AutoScaling query protocols (form or query string parameters in, XML
+// out) from a FakeFleet.  Both APIs are served from one endpoint since the
+// clients share endpoint_override, requests are told apart by Action.
+class FakeAwsService {
+public:
+    FakeAwsService(std::shared_ptr<const FakeFleet> fleet, const FakeAwsFaults& faults)
+      : m_fleet(fleet), m_faults(faults), m_requests(0), m_errors(0), m_throttled(0) { }
+
+    // params is an application/x-www-form-urlencoded string.
+    FakeAwsResponse Handle(const std::string& params);
+
+    static std::map<std::string, std::string> ParseParams(const std::string& params);
+
+    uint64_t GetRequests() const { return this->m_requests; }
+    uint64_t GetErrors() const { return this->m_errors; }
+    uint64_t GetThrottled() const { return this->m_throttled; }
+
+private:
+    FakeAwsResponse _DescribeInstances(const std::map<std::string, std::string>& params);
+    FakeAwsResponse _DescribeAutoScalingGroups(const std::map<std::string, std::string>& params);
+    FakeAwsResponse _Error(bool autoscaling, int status, const std::string& code, const std::string& message);
+
+    std::shared_ptr<const FakeFleet> m_fleet;
+    const FakeAwsFaults m_faults;
+    std::atomic<uint64_t> m_requests, m_errors, m_throttled;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "aws/autoscaling/AutoScalingClient.h"
+#include "aws/autoscaling/model/DescribeAutoScalingGroupsRequest.h"
+#include "aws/ec2/EC2Client.h"
+#include "aws/ec2/model/DescribeInstancesRequest.h"
+
+// A deterministic made up fleet: instance n has id i-<n as 8 hex digits>,
+// the n+256th address in the VPC and one of three AZs, and every n below
+// numAsgs * asgSize belongs to group "asg-<n % numAsgs>".  Instances past
+// numInstances don't show up in a full listing, but can still be described
+// by id or address, which is what lookups that miss the cache do.
+class FakeFleet {
+public:
+    FakeFleet(size_t numInstances, size_t numAsgs, size_t asgSize, uint32_t vpcBase = 0x0A000000)
+      : m_numInstances(numInstances), m_numAsgs(numAsgs), m_asgSize(asgSize), m_vpcBase(vpcBase) { }
+
+    size_t GetNumInstances() const { return this->m_numInstances; }
+    size_t GetNumAsgs() const { return this->m_numAsgs; }
+
+    static std::string GetInstanceId(size_t n);
+    std::string GetIp(size_t n) const;
+    static std::string GetAvailabilityZone(size_t n);
+    // The name the default instance_regex resolves to instance n.
+    static std::string GetHostname(size_t n, const std::string& accountName);
+    static std::string GetAsgName(size_t g);
+
+    bool TryParseInstanceId(const std::string& instanceId, size_t *n) const;
+    bool TryParseIp(const std::string& ip, size_t *n) const;
+
+    Aws::EC2::Model::Instance GetInstance(size_t n) const;
+    Aws::AutoScaling::Model::AutoScalingGroup GetAutoScalingGroup(size_t g) const;
+
+    Aws::EC2::Model::DescribeInstancesOutcome DescribeInstances(
+        const Aws::EC2::Model::DescribeInstancesRequest& request) const;
+    Aws::AutoScaling::Model::DescribeAutoScalingGroupsOutcome DescribeAutoScalingGroups(
+        const Aws::AutoScaling::Model::DescribeAutoScalingGroupsRequest& request) const;
+
+private:
+    const size_t m_numInstances;
+    const size_t m_numAsgs;
+    const size_t m_asgSize;
+    const uint32_t m_vpcBase;
+};
+
+class FakeEC2Client : public Aws::EC2::EC2Client {
+public:
+    FakeEC2Client(std::shared_ptr<const FakeFleet> fleet)
+      : m_fleet(fleet), m_calls(0), m_latencyUs(0) { }
+
+    Aws::EC2::Model::DescribeInstancesOutcome DescribeInstances(
+        const Aws::EC2::Model::DescribeInstancesRequest& request) const override {
+      this->m_calls++;
+      if (this->m_latencyUs > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(this->m_latencyUs));
+      }
+      return this->m_fleet->DescribeInstances(request);
+    }
+
+    // Every call sleeps this long before answering, like a real round trip.
+    void SetLatencyUs(uint64_t latencyUs) { this->m_latencyUs = latencyUs; }
+
+    uint64_t GetCalls() const { return this->m_calls; }
+
+private:
+    std::shared_ptr<const FakeFleet> m_fleet;
+    mutable std::atomic<uint64_t> m_calls;
+    uint64_t m_latencyUs;
+};
+
+class FakeAutoScalingClient : public Aws::AutoScaling::AutoScalingClient {
+public:
+    FakeAutoScalingClient(std::shared_ptr<const FakeFleet> fleet)
+      : m_fleet(fleet) { }
+
+    Aws::AutoScaling::Model::DescribeAutoScalingGroupsOutcome DescribeAutoScalingGroups(
+        const Aws::AutoScaling::Model::DescribeAutoScalingGroupsRequest& request) const override {
+      return this->m_fleet->DescribeAutoScalingGroups(request);
+    }
+
+private:
+    std::shared_ptr<const FakeFleet> m_fleet;
+};
@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#include "Bench.h"
+
+namespace bench {
+
+std::vector<Benchmark>& Registry() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+static std::map<std::string, std::string>& _Params() {
+  static std::map<std::string, std::string> params;
+  return params;
+}
+
+size_t GetParam(const std::string& name, size_t defaultValue) {
+  auto &params = _Params();
+  auto found = params.find(name);
+  if (found == params.end()) {
+    params[name] = std::to_string(defaultValue);
+    return defaultValue;
+  }
+  return strtoull(found->second.c_str(), nullptr, 10);
+}
+
+static double _TimeRun(const Benchmark &b, size_t iterations) {
+  auto start = std::chrono::steady_clock::now();
+  b.fn(iterations);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+struct Result {
+  std::string name;
+  size_t iterations;
+  double nsPerOp;
+};
+
+static void _PrintJson(const std::vector<Result> &results) {
+  printf("{\n  \"params\": {");
+  bool first = true;
+  for (const auto &p : _Params()) {
+    printf("%s\n    \"%s\": \"%s\"", first ? "" : ",", p.first.c_str(), p.second.c_str());
+    first = false;
+  }
+  printf("\n  },\n  \"benchmarks\": [");
+  first = true;
+  for (const auto &r : results) {
+    printf("%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.1f}",
+        first ? "" : ",", r.name.c_str(), r.iterations, r.nsPerOp);
+    first = false;
+  }
+  printf("\n  ]\n}\n");
+}
+
+int RunAll(int argc, char **argv) {
+  const char *filter = nullptr;
+  bool json = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    }
+    else if (strncmp(argv[i], "--", 2) == 0 && strchr(argv[i], '=') != nullptr) {
+      auto eq = strchr(argv[i], '=');
+      _Params()[std::string(argv[i] + 2, eq)] = eq + 1;
+    }
+    else {
+      filter = argv[i];
+    }
+  }
+  const double minRunNs = GetParam("min_run_ms", 200) * 1000.0 * 1000.0;
+
+  std::vector<Result> results;
+  if (!json) {
+    printf("%-48s %14s %14s\n", "benchmark", "iterations", "ns/op");
+  }
+  for (const auto &b : Registry()) {
+    if (filter != nullptr && strstr(b.name.c_str(), filter) == nullptr) {
+      continue;
+    }
+    // Untimed, so benchmarks can set up lazily on their first call.
+    b.fn(1);
+    size_t iterations = 1;
+    double ns = _TimeRun(b, iterations);
+    while (ns < minRunNs && iterations < (1ul << 30)) {
+      double scale = ns > 0 ? (minRunNs * 1.2) / ns : 100;
+      iterations = (size_t)(iterations * std::min(std::max(scale, 2.0), 100.0));
+      ns = _TimeRun(b, iterations);
+    }
+    results.push_back(Result { b.name, iterations, ns / iterations });
+    if (!json) {
+      printf("%-48s %14zu %14.1f\n", b.name.c_str(), iterations, ns / iterations);
+      fflush(stdout);
+    }
+  }
+  if (json) {
+    _PrintJson(results);
+  }
+  return 0;
+}
+
+}
+
+int main(int argc, char **argv) {
+  return bench::RunAll(argc, argv);
+}
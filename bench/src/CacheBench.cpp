@@ -0,0 +1,39 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "Cache.h"
+
+struct CacheFixture {
+  CacheFixture(size_t size, bool hit)
+    : cache("bench", std::make_shared<StatsReceiver>(), 3600) {
+    for (size_t a = 0; a < size; a++) {
+      auto key = "i-" + std::to_string(a);
+      this->cache.Insert(key, "10.0." + std::to_string(a / 256) + "." + std::to_string(a % 256));
+      this->keys.push_back(hit ? key : "i-missing-" + std::to_string(a));
+    }
+  }
+
+  Cache<std::string> cache;
+  std::vector<std::string> keys;
+};
+
+static bench::BenchFn _TryGet(size_t size, bool hit) {
+  auto fixture = std::make_shared<std::unique_ptr<CacheFixture>>();
+  return [fixture, size, hit](size_t iterations) {
+    if (!*fixture) {
+      fixture->reset(new CacheFixture(size, hit));
+    }
+    auto &cache = (*fixture)->cache;
+    auto &keys = (*fixture)->keys;
+    char value[64];
+    for (size_t i = 0; i < iterations; i++) {
+      bench::DoNotOptimize(cache.TryGet(keys[i % keys.size()], value, sizeof(value)));
+    }
+  };
+}
+
+BENCHMARK("cache/try_get/hit/n=1024", _TryGet(1024, true));
+BENCHMARK("cache/try_get/hit/n=65536", _TryGet(65536, true));
+BENCHMARK("cache/try_get/miss/n=65536", _TryGet(65536, false));
@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "DlzBenchEnv.h"
+
+// Names looked up round robin, so benchmarks touch the whole cache.
+static const size_t s_numNames = 4096;
+
+DlzBenchEnv& DlzBenchEnv::Get() {
+  static DlzBenchEnv env([] {
+    DlzBenchOptions options;
+    options.instances = bench::GetParam("instances", options.instances);
+    options.asgs = bench::GetParam("asgs", options.asgs);
+    options.asg_size = bench::GetParam("asg_size", options.asg_size);
+    return options;
+  }());
+  return env;
+}
+
+static void _Expect(isc_result_t result, isc_result_t expected, const char *name) {
+  if (result != expected) {
+    fprintf(stderr, "Lookup of %s returned %d, expected %d\n", name, result, expected);
+    exit(1);
+  }
+}
+
+static std::vector<std::string> _ForwardNames() {
+  auto &env = DlzBenchEnv::Get();
+  std::vector<std::string> names;
+  for (size_t n = 0; n < s_numNames; n++) {
+    names.push_back(FakeFleet::GetHostname(n * 7919 % env.GetFleet().GetNumInstances(), env.GetAccount()));
+  }
+  return names;
+}
+
+static void _ForwardHit(size_t iterations) {
+  auto &env = DlzBenchEnv::Get();
+  static const auto names = _ForwardNames();
+  for (size_t i = 0; i < iterations; i++) {
+    auto &name = names[i % names.size()];
+    _Expect(env.Lookup(env.GetZone(), name.c_str()), ISC_R_SUCCESS, name.c_str());
+  }
+}
+
+static std::vector<std::pair<std::string, std::string>> _ReverseNames() {
+  auto &env = DlzBenchEnv::Get();
+  std::vector<std::pair<std::string, std::string>> names;
+  for (size_t n = 0; n < s_numNames; n++) {
+    auto ip = env.GetFleet().GetIp(n * 7919 % env.GetFleet().GetNumInstances());
+    auto lastDot = ip.rfind('.');
+    auto octets = ip.substr(0, lastDot);
+    // "10.0.1" -> "1.0.10.in-addr.arpa"
+    auto first = octets.find('.'), second = octets.rfind('.');
+    auto zone = octets.substr(second + 1) + "." + octets.substr(first + 1, second - first - 1) + "."
+        + octets.substr(0, first) + ".in-addr.arpa";
+    names.push_back(std::make_pair(zone, ip.substr(lastDot + 1)));
+  }
+  return names;
+}
+
+static void _ReverseHit(size_t iterations) {
+  auto &env = DlzBenchEnv::Get();
+  static const auto names = _ReverseNames();
+  for (size_t i = 0; i < iterations; i++) {
+    auto &name = names[i % names.size()];
+    _Expect(env.Lookup(name.first.c_str(), name.second.c_str()), ISC_R_SUCCESS, name.second.c_str());
+  }
+}
+
+static void _IpSynthesized(size_t iterations) {
+  auto &env = DlzBenchEnv::Get();
+  for (size_t i = 0; i < iterations; i++) {
+    _Expect(env.Lookup(env.GetZone(), "ip-10-0-1-5"), ISC_R_SUCCESS, "ip-10-0-1-5");
+  }
+}
+
+static void _AsgHit(size_t iterations) {
+  auto &env = DlzBenchEnv::Get();
+  std::vector<std::string> names;
+  for (size_t g = 0; g < env.GetFleet().GetNumAsgs(); g++) {
+    names.push_back(FakeFleet::GetAsgName(g));
+  }
+  for (size_t i = 0; i < iterations; i++) {
+    auto &name = names[i % names.size()];
+    _Expect(env.Lookup(env.GetAsgZone(), name.c_str(), 0x0A000100 + (i & 0xFF)), ISC_R_SUCCESS, name.c_str());
+  }
+}
+
+static void _Apex(size_t iterations) {
+  auto &env = DlzBenchEnv::Get();
+  for (size_t i = 0; i < iterations; i++) {
+    _Expect(env.Lookup(env.GetZone(), "@"), ISC_R_SUCCESS, "@");
+  }
+}
+
+static void _RegexMiss(size_t iterations) {
+  auto &env = DlzBenchEnv::Get();
+  for (size_t i = 0; i < iterations; i++) {
+    _Expect(env.Lookup(env.GetZone(), "not-an-instance"), ISC_R_NOTFOUND, "not-an-instance");
+  }
+}
+
+// Every lookup is for an instance that wasn't in the refresh, so goes to the
+// (fake) API and is then cached.
+static void _CacheMiss(size_t iterations) {
+  auto &env = DlzBenchEnv::Get();
+  static size_t next = 0;
+  for (size_t i = 0; i < iterations; i++) {
+    auto name = FakeFleet::GetHostname(env.GetFleet().GetNumInstances() + next++, env.GetAccount());
+    _Expect(env.Lookup(env.GetZone(), name.c_str()), ISC_R_SUCCESS, name.c_str());
+  }
+}
+
+BENCHMARK("dlz/lookup/forward_hit", _ForwardHit);
+BENCHMARK("dlz/lookup/reverse_hit", _ReverseHit);
+BENCHMARK("dlz/lookup/ip_synthesized", _IpSynthesized);
+BENCHMARK("dlz/lookup/asg_hit", _AsgHit);
+BENCHMARK("dlz/lookup/apex", _Apex);
+BENCHMARK("dlz/lookup/regex_miss", _RegexMiss);
+BENCHMARK("dlz/lookup/cache_miss", _CacheMiss);
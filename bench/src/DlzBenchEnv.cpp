@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include <unistd.h>
+
+#include "Bench.h"
+#include "DlzBenchEnv.h"
+
+static void _log(int, const char*, ...) { }
+
+static isc_result_t _putrr(dns_sdlzlookup_t *, const char *, dns_ttl_t, const char *data) {
+  bench::DoNotOptimize(data);
+  return ISC_R_SUCCESS;
+}
+
+static isc_result_t _putnamedrr(dns_sdlzallnodes_t *, const char *, const char *, dns_ttl_t, const char *) {
+  return ISC_R_SUCCESS;
+}
+
+static thread_local isc_sockaddr_t t_client;
+
+static isc_result_t _sourceip(dns_clientinfo_t *, isc_sockaddr_t **addrp) {
+  *addrp = &t_client;
+  return ISC_R_SUCCESS;
+}
+
+DlzBenchEnv::DlzBenchEnv(const DlzBenchOptions& options)
+  : m_options(options), m_asgZone("asg." + options.zone) {
+  this->m_fleet = std::make_shared<FakeFleet>(options.instances, options.asgs, options.asg_size);
+
+  auto configPath = "/tmp/ec2dns-bench-" + std::to_string(getpid()) + ".conf";
+  {
+    std::ofstream config(configPath);
+    config << "{\"stats_port\": 0, \"stats_address\": \"127.0.0.1\", \"log_level\": 0"
+           << (options.extra_config.empty() ? "" : ", ") << options.extra_config << "}";
+  }
+  auto fleet = this->m_fleet;
+  auto apiLatencyUs = options.api_latency_us;
+  dlz_hooks().config_path = configPath;
+  dlz_hooks().client_factory = [fleet, apiLatencyUs](
+      const Ec2DnsConfig&, std::shared_ptr<EC2Client> *ec2, std::shared_ptr<AutoScalingClient> *asg) {
+    auto ec2Client = std::make_shared<FakeEC2Client>(fleet);
+    ec2Client->SetLatencyUs(apiLatencyUs);
+    *ec2 = ec2Client;
+    *asg = std::make_shared<FakeAutoScalingClient>(fleet);
+  };
+
+  const char *argv[] = {"ec2dns", this->GetZone(), options.cidr.c_str(), this->GetAccount()};
+  void *dbdata = nullptr;
+  auto result = dlz_create(
+      "ec2dns", 4, const_cast<char**>(argv), &dbdata,
+      "log", &_log, "putrr", &_putrr, "putnamedrr", &_putnamedrr, (const char*)nullptr);
+  unlink(configPath.c_str());
+  if (result != ISC_R_SUCCESS) {
+    fprintf(stderr, "dlz_create failed: %d\n", result);
+    exit(1);
+  }
+  this->m_state = static_cast<dlz_state*>(dbdata);
+
+  // The first refresh runs on the refresh thread.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(5);
+  while (this->m_state->client->GetSnapshotSerial() == 0) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      fprintf(stderr, "Timed out waiting for the first refresh\n");
+      exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+isc_result_t DlzBenchEnv::Lookup(const char *zone, const char *name, uint32_t client) {
+  struct in_addr addr;
+  addr.s_addr = htonl(client);
+  return this->Lookup(zone, name, ClientAddress::FromV4(addr));
+}
+
+isc_result_t DlzBenchEnv::Lookup(const char *zone, const char *name, const ClientAddress& client) {
+  dns_clientinfomethods_t methods;
+  methods.version = DNS_CLIENTINFOMETHODS_VERSION;
+  methods.age = DNS_CLIENTINFOMETHODS_AGE;
+  methods.sourceip = &_sourceip;
+  dns_clientinfo_t clientInfo;
+  memset(&t_client, 0, sizeof(t_client));
+  t_client.type.sa.sa_family = client.GetFamily();
+  if (client.GetFamily() == AF_INET) {
+    memcpy(&t_client.type.sin.sin_addr, client.GetBytes(), client.GetLength());
+  }
+  else if (client.GetFamily() == AF_INET6) {
+    memcpy(&t_client.type.sin6.sin6_addr, client.GetBytes(), client.GetLength());
+  }
+  return dlz_lookup(zone, name, this->m_state, nullptr, &methods, &clientInfo);
+}
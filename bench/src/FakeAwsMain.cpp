@@ -0,0 +1,82 @@
+// Serves DescribeInstances and DescribeAutoScalingGroups for a generated
+// fleet, point ec2dns at it with
+//
+//   {"endpoint_override": "127.0.0.1:8124", "use_ssl": false}
+//
+//   ec2dns-fake-aws --instances=500000 --latency_ms=50 --throttle_rate=0.01
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "FakeAwsService.h"
+#include "server_http.hpp"
+
+typedef SimpleWeb::Server<SimpleWeb::HTTP> HttpServer;
+
+static const char* _StatusLine(int status) {
+  switch (status) {
+    case 200: return "200 OK";
+    case 400: return "400 Bad Request";
+    case 503: return "503 Service Unavailable";
+    default: return "500 Internal Server Error";
+  }
+}
+
+int main(int argc, char **argv) {
+  std::map<std::string, std::string> params;
+  for (int i = 1; i < argc; i++) {
+    auto eq = strchr(argv[i], '=');
+    if (strncmp(argv[i], "--", 2) != 0 || eq == nullptr) {
+      fprintf(stderr, "usage: %s [--param=value ...]\n", argv[0]);
+      return 1;
+    }
+    params[std::string(argv[i] + 2, eq)] = eq + 1;
+  }
+  auto param = [&params](const std::string& name, const char *defaultValue) {
+    auto found = params.find(name);
+    return found == params.end() ? std::string(defaultValue) : found->second;
+  };
+
+  auto fleet = std::make_shared<FakeFleet>(
+      strtoull(param("instances", "10000").c_str(), nullptr, 10),
+      strtoull(param("asgs", "100").c_str(), nullptr, 10),
+      strtoull(param("asg_size", "16").c_str(), nullptr, 10));
+  FakeAwsFaults faults;
+  faults.latency_ms = (uint32_t)strtoul(param("latency_ms", "0").c_str(), nullptr, 10);
+  faults.latency_jitter_ms = (uint32_t)strtoul(param("latency_jitter_ms", "0").c_str(), nullptr, 10);
+  faults.error_rate = strtod(param("error_rate", "0").c_str(), nullptr);
+  faults.throttle_rate = strtod(param("throttle_rate", "0").c_str(), nullptr);
+  FakeAwsService service(fleet, faults);
+
+  auto port = (unsigned short)strtoul(param("port", "8124").c_str(), nullptr, 10);
+  HttpServer server(port, strtoul(param("threads", "4").c_str(), nullptr, 10));
+  server.config.address = param("address", "127.0.0.1");
+
+  // The SDK POSTs form encoded parameters to /, GETs with a query string
+  // are handy from curl.
+  auto handle = [&service](HttpServer::Response& response, std::shared_ptr<HttpServer::Request> request) {
+    auto query = request->path.find('?');
+    auto paramStr = query == std::string::npos ? "" : request->path.substr(query + 1);
+    if (request->method == "POST") {
+      auto body = request->content.string();
+      paramStr += paramStr.empty() || body.empty() ? body : "&" + body;
+    }
+    auto resp = service.Handle(paramStr);
+    response << "HTTP/1.1 " << _StatusLine(resp.status) << "\r\n"
+             << "Content-Type: text/xml;charset=UTF-8\r\n"
+             << "Content-Length: " << resp.body.size() << "\r\n\r\n"
+             << resp.body;
+  };
+  server.default_resource["GET"] = handle;
+  server.default_resource["POST"] = handle;
+
+  printf("Serving %zu instances in %zu groups on %s:%u\n",
+      fleet->GetNumInstances(), fleet->GetNumAsgs(), server.config.address.c_str(), port);
+  fflush(stdout);
+  server.start();
+  return 0;
+}
@@ -0,0 +1,242 @@
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "FakeAwsService.h"
+#include "KRandom.h"
+
+using namespace Aws::EC2::Model;
+using namespace Aws::AutoScaling::Model;
+
+#define EC2_XMLNS "http://ec2.amazonaws.com/doc/2016-11-15/"
+#define AUTOSCALING_XMLNS "http://autoscaling.amazonaws.com/doc/2011-01-01/"
+
+static int _HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static std::string _UrlDecode(const std::string& str) {
+  std::string ret;
+  ret.reserve(str.size());
+  for (size_t i = 0; i < str.size(); i++) {
+    if (str[i] == '+') {
+      ret += ' ';
+    }
+    else if (str[i] == '%' && i + 2 < str.size() && _HexValue(str[i + 1]) >= 0 && _HexValue(str[i + 2]) >= 0) {
+      ret += (char)(_HexValue(str[i + 1]) * 16 + _HexValue(str[i + 2]));
+      i += 2;
+    }
+    else {
+      ret += str[i];
+    }
+  }
+  return ret;
+}
+
+static std::string _XmlEscape(const std::string& str) {
+  std::string ret;
+  for (auto c : str) {
+    switch (c) {
+      case '&': ret += "&amp;"; break;
+      case '<': ret += "&lt;"; break;
+      case '>': ret += "&gt;"; break;
+      case '"': ret += "&quot;"; break;
+      default: ret += c;
+    }
+  }
+  return ret;
+}
+
+static std::string _RequestId() {
+  static std::atomic<uint64_t> next(0);
+  char id[40];
+  snprintf(id, sizeof(id), "00000000-0000-0000-0000-%012llx", (unsigned long long)next++);
+  return id;
+}
+
+// Values of the numbered list parameter prefix.1, prefix.2, ... in order.
+static std::vector<std::string> _GetList(const std::map<std::string, std::string>& params, const std::string& prefix) {
+  std::vector<std::string> values;
+  for (size_t i = 1; ; i++) {
+    auto found = params.find(prefix + "." + std::to_string(i));
+    if (found == params.end()) {
+      return values;
+    }
+    values.push_back(found->second);
+  }
+}
+
+static std::string _Get(const std::map<std::string, std::string>& params, const std::string& name) {
+  auto found = params.find(name);
+  return found == params.end() ? "" : found->second;
+}
+
+std::map<std::string, std::string> FakeAwsService::ParseParams(const std::string& params) {
+  std::map<std::string, std::string> ret;
+  size_t start = 0;
+  while (start < params.size()) {
+    auto end = params.find('&', start);
+    if (end == std::string::npos) {
+      end = params.size();
+    }
+    auto pair = params.substr(start, end - start);
+    auto eq = pair.find('=');
+    if (!pair.empty()) {
+      ret[_UrlDecode(pair.substr(0, eq))] = eq == std::string::npos ? "" : _UrlDecode(pair.substr(eq + 1));
+    }
+    start = end + 1;
+  }
+  return ret;
+}
+
+FakeAwsResponse FakeAwsService::Handle(const std::string& paramStr) {
+  this->m_requests++;
+  auto params = ParseParams(paramStr);
+  auto action = _Get(params, "Action");
+  bool autoscaling = action == "DescribeAutoScalingGroups";
+
+  auto rnd = tls_random::get();
+  if (this->m_faults.latency_ms > 0 || this->m_faults.latency_jitter_ms > 0) {
+    std::uniform_int_distribution<uint32_t> jitter(0, this->m_faults.latency_jitter_ms);
+    std::this_thread::sleep_for(std::chrono::milliseconds(this->m_faults.latency_ms + jitter(*rnd)));
+  }
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  auto roll = dist(*rnd);
+  if (roll < this->m_faults.throttle_rate) {
+    this->m_throttled++;
+    return autoscaling
+        ? this->_Error(true, 400, "Throttling", "Rate exceeded")
+        : this->_Error(false, 503, "RequestLimitExceeded", "Request limit exceeded.");
+  }
+  if (roll < this->m_faults.throttle_rate + this->m_faults.error_rate) {
+    this->m_errors++;
+    return this->_Error(autoscaling, 500, "InternalError", "An internal error has occurred");
+  }
+
+  if (action == "DescribeInstances") {
+    return this->_DescribeInstances(params);
+  }
+  if (autoscaling) {
+    return this->_DescribeAutoScalingGroups(params);
+  }
+  return this->_Error(false, 400, "InvalidAction", "The action " + action + " is not valid for this web service.");
+}
+
+FakeAwsResponse FakeAwsService::_DescribeInstances(const std::map<std::string, std::string>& params) {
+  DescribeInstancesRequest request;
+  for (const auto &id : _GetList(params, "InstanceId")) {
+    request.AddInstanceIds(id);
+  }
+  for (size_t f = 1; ; f++) {
+    auto prefix = "Filter." + std::to_string(f);
+    auto name = params.find(prefix + ".Name");
+    if (name == params.end()) {
+      break;
+    }
+    Filter filter;
+    filter.SetName(name->second);
+    for (const auto &value : _GetList(params, prefix + ".Value")) {
+      filter.AddValues(value);
+    }
+    request.AddFilters(filter);
+  }
+  request.SetMaxResults(atoi(_Get(params, "MaxResults").c_str()));
+  request.SetNextToken(_Get(params, "NextToken"));
+
+  auto response = this->m_fleet->DescribeInstances(request).GetResult();
+  std::ostringstream xml;
+  xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      << "<DescribeInstancesResponse xmlns=\"" EC2_XMLNS "\">"
+      << "<requestId>" << _RequestId() << "</requestId>"
+      << "<reservationSet>";
+  for (const auto &reservation : response.GetReservations()) {
+    xml << "<item><reservationId>r-00000000</reservationId>"
+        << "<ownerId>000000000000</ownerId><groupSet/><instancesSet>";
+    for (const auto &instance : reservation.GetInstances()) {
+      xml << "<item>"
+          << "<instanceId>" << _XmlEscape(instance.GetInstanceId()) << "</instanceId>"
+          << "<instanceState><code>16</code><name>running</name></instanceState>"
+          << "<privateIpAddress>" << _XmlEscape(instance.GetPrivateIpAddress()) << "</privateIpAddress>"
+          << "<placement><availabilityZone>" << _XmlEscape(instance.GetPlacement().GetAvailabilityZone())
+          << "</availabilityZone></placement>"
+          << "</item>";
+    }
+    xml << "</instancesSet></item>";
+  }
+  xml << "</reservationSet>";
+  if (!response.GetNextToken().empty()) {
+    xml << "<nextToken>" << _XmlEscape(response.GetNextToken()) << "</nextToken>";
+  }
+  xml << "</DescribeInstancesResponse>";
+  return FakeAwsResponse { 200, xml.str() };
+}
+
+FakeAwsResponse FakeAwsService::_DescribeAutoScalingGroups(const std::map<std::string, std::string>& params) {
+  DescribeAutoScalingGroupsRequest request;
+  for (const auto &name : _GetList(params, "AutoScalingGroupNames.member")) {
+    request.AddAutoScalingGroupNames(name);
+  }
+  request.SetMaxRecords(atoi(_Get(params, "MaxRecords").c_str()));
+  request.SetNextToken(_Get(params, "NextToken"));
+
+  auto result = this->m_fleet->DescribeAutoScalingGroups(request).GetResult();
+  std::ostringstream xml;
+  xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      << "<DescribeAutoScalingGroupsResponse xmlns=\"" AUTOSCALING_XMLNS "\">"
+      << "<DescribeAutoScalingGroupsResult><AutoScalingGroups>";
+  for (const auto &group : result.GetAutoScalingGroups()) {
+    auto name = _XmlEscape(group.GetAutoScalingGroupName());
+    xml << "<member><AutoScalingGroupName>" << name << "</AutoScalingGroupName><Instances>";
+    for (const auto &instance : group.GetInstances()) {
+      xml << "<member>"
+          << "<InstanceId>" << _XmlEscape(instance.GetInstanceId()) << "</InstanceId>"
+          << "<AvailabilityZone>" << _XmlEscape(instance.GetAvailabilityZone()) << "</AvailabilityZone>"
+          << "<HealthStatus>" << _XmlEscape(instance.GetHealthStatus()) << "</HealthStatus>"
+          << "<LifecycleState>"
+          << (instance.GetLifecycleState() == LifecycleState::InService ? "InService" : "Pending")
+          << "</LifecycleState>"
+          << "</member>";
+    }
+    xml << "</Instances><Tags>";
+    for (const auto &tag : group.GetTags()) {
+      xml << "<member>"
+          << "<ResourceId>" << name << "</ResourceId>"
+          << "<ResourceType>auto-scaling-group</ResourceType>"
+          << "<Key>" << _XmlEscape(tag.GetKey()) << "</Key>"
+          << "<Value>" << _XmlEscape(tag.GetValue()) << "</Value>"
+          << "<PropagateAtLaunch>true</PropagateAtLaunch>"
+          << "</member>";
+    }
+    xml << "</Tags></member>";
+  }
+  xml << "</AutoScalingGroups>";
+  if (!result.GetNextToken().empty()) {
+    xml << "<NextToken>" << _XmlEscape(result.GetNextToken()) << "</NextToken>";
+  }
+  xml << "</DescribeAutoScalingGroupsResult>"
+      << "<ResponseMetadata><RequestId>" << _RequestId() << "</RequestId></ResponseMetadata>"
+      << "</DescribeAutoScalingGroupsResponse>";
+  return FakeAwsResponse { 200, xml.str() };
+}
+
+FakeAwsResponse FakeAwsService::_Error(bool autoscaling, int status, const std::string& code, const std::string& message) {
+  std::ostringstream xml;
+  xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+  if (autoscaling) {
+    xml << "<ErrorResponse xmlns=\"" AUTOSCALING_XMLNS "\"><Error>"
+        << "<Type>" << (status >= 500 ? "Receiver" : "Sender") << "</Type>"
+        << "<Code>" << code << "</Code><Message>" << _XmlEscape(message) << "</Message>"
+        << "</Error><RequestId>" << _RequestId() << "</RequestId></ErrorResponse>";
+  }
+  else {
+    xml << "<Response><Errors><Error>"
+        << "<Code>" << code << "</Code><Message>" << _XmlEscape(message) << "</Message>"
+        << "</Error></Errors><RequestID>" << _RequestId() << "</RequestID></Response>";
+  }
+  return FakeAwsResponse { status, xml.str() };
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <arpa/inet.h>
+
+#include "FakeFleet.h"
+
+using namespace Aws::EC2::Model;
+using namespace Aws::AutoScaling::Model;
+
+std::string FakeFleet::GetInstanceId(size_t n) {
+  char id[32];
+  snprintf(id, sizeof(id), "i-%08zx", n);
+  return id;
+}
+
+std::string FakeFleet::GetIp(size_t n) const {
+  struct in_addr addr;
+  addr.s_addr = htonl(this->m_vpcBase + 256 + (uint32_t)n);
+  char ip[INET_ADDRSTRLEN];
+  return inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+}
+
+std::string FakeFleet::GetAvailabilityZone(size_t n) {
+  return std::string("us-east-1") + "abc"[n % 3];
+}
+
+std::string FakeFleet::GetHostname(size_t n, const std::string& accountName) {
+  char name[128];
+  snprintf(name, sizeof(name), "ue1%c-%s-%08zx", "abc"[n % 3], accountName.c_str(), n);
+  return name;
+}
+
+std::string FakeFleet::GetAsgName(size_t g) {
+  return "asg-" + std::to_string(g);
+}
+
+bool FakeFleet::TryParseInstanceId(const std::string& instanceId, size_t *n) const {
+  if (instanceId.size() < 3 || instanceId.compare(0, 2, "i-") != 0) {
+    return false;
+  }
+  char *end;
+  auto parsed = strtoull(instanceId.c_str() + 2, &end, 16);
+  if (*end != '\0') {
+    return false;
+  }
+  *n = (size_t)parsed;
+  return true;
+}
+
+bool FakeFleet::TryParseIp(const std::string& ip, size_t *n) const {
+  struct in_addr addr;
+  if (inet_pton(AF_INET, ip.c_str(), &addr) != 1) {
+    return false;
+  }
+  uint32_t value = ntohl(addr.s_addr);
+  if (value < this->m_vpcBase + 256) {
+    return false;
+  }
+  *n = value - this->m_vpcBase - 256;
+  return true;
+}
+
+Aws::EC2::Model::Instance FakeFleet::GetInstance(size_t n) const {
+  return Aws::EC2::Model::Instance()
+      .WithInstanceId(GetInstanceId(n))
+      .WithPrivateIpAddress(this->GetIp(n))
+      .WithPlacement(Placement().WithAvailabilityZone(GetAvailabilityZone(n)));
+}
+
+DescribeInstancesOutcome FakeFleet::DescribeInstances(const DescribeInstancesRequest& request) const {
+  Reservation reservation;
+  DescribeInstancesResponse response;
+  size_t n;
+  if (!request.GetInstanceIds().empty()) {
+    for (const auto &id : request.GetInstanceIds()) {
+      if (this->TryParseInstanceId(id, &n)) {
+        reservation.AddInstances(this->GetInstance(n));
+      }
+    }
+  }
+  else if (!request.GetFilters().empty()) {
+    for (const auto &filter : request.GetFilters()) {
+      if (filter.GetName() != "private-ip-address") {
+        continue;
+      }
+      for (const auto &ip : filter.GetValues()) {
+        if (this->TryParseIp(ip, &n)) {
+          reservation.AddInstances(this->GetInstance(n));
+        }
+      }
+    }
+  }
+  else {
+    size_t start = request.GetNextToken().empty() ? 0 : strtoull(request.GetNextToken().c_str(), nullptr, 10);
+    size_t pageSize = request.GetMaxResults() > 0 ? request.GetMaxResults() : 1000;
+    size_t end = std::min(start + pageSize, this->m_numInstances);
+    for (n = start; n < end; n++) {
+      reservation.AddInstances(this->GetInstance(n));
+    }
+    if (end < this->m_numInstances) {
+      response.SetNextToken(std::to_string(end));
+    }
+  }
+  return DescribeInstancesOutcome(response.AddReservations(reservation));
+}
+
+AutoScalingGroup FakeFleet::GetAutoScalingGroup(size_t g) const {
+  AutoScalingGroup group;
+  group.WithAutoScalingGroupName(GetAsgName(g))
+      .AddTags(TagDescription().WithKey("twitter:aws:dns-alias").WithValue(GetAsgName(g)));
+  for (size_t n = g; n < this->m_numInstances && n < this->m_numAsgs * this->m_asgSize; n += this->m_numAsgs) {
+    group.AddInstances(Aws::AutoScaling::Model::Instance()
+        .WithInstanceId(GetInstanceId(n))
+        .WithAvailabilityZone(GetAvailabilityZone(n))
+        .WithHealthStatus("Healthy")
+        .WithLifecycleState(LifecycleState::InService));
+  }
+  return group;
+}
+
+DescribeAutoScalingGroupsOutcome FakeFleet::DescribeAutoScalingGroups(
+    const DescribeAutoScalingGroupsRequest& request) const {
+  DescribeAutoScalingGroupsResult result;
+  if (!request.GetAutoScalingGroupNames().empty()) {
+    for (const auto &name : request.GetAutoScalingGroupNames()) {
+      char *end;
+      if (name.compare(0, 4, "asg-") != 0) {
+        continue;
+      }
+      size_t g = strtoull(name.c_str() + 4, &end, 10);
+      if (*end == '\0' && g < this->m_numAsgs) {
+        result.AddAutoScalingGroups(this->GetAutoScalingGroup(g));
+      }
+    }
+    return DescribeAutoScalingGroupsOutcome(result);
+  }
+
+  size_t start = request.GetNextToken().empty() ? 0 : strtoull(request.GetNextToken().c_str(), nullptr, 10);
+  size_t pageSize = request.GetMaxRecords() > 0 ? request.GetMaxRecords() : 50;
+  size_t end = std::min(start + pageSize, this->m_numAsgs);
+  for (size_t g = start; g < end; g++) {
+    result.AddAutoScalingGroups(this->GetAutoScalingGroup(g));
+  }
+  if (end < this->m_numAsgs) {
+    result.SetNextToken(std::to_string(end));
+  }
+  return DescribeAutoScalingGroupsOutcome(result);
+}
@@ -0,0 +1,36 @@
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "Histogram.h"
+
+static bench::BenchFn _Record(size_t numThreads) {
+  return [numThreads](size_t iterations) {
+    Histogram histogram("bench");
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; t++) {
+      threads.push_back(std::thread([&histogram, iterations]() {
+        for (size_t i = 0; i < iterations; i++) {
+          histogram.Record(i & 0xFFFF);
+        }
+      }));
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    bench::DoNotOptimize(histogram.GetSnapshot().GetCount());
+  };
+}
+
+BENCHMARK("histogram/record/threads=1", _Record(1));
+BENCHMARK("histogram/record/threads=4", _Record(4));
+
+BENCHMARK("histogram/snapshot", [](size_t iterations) {
+  Histogram histogram("bench");
+  for (size_t i = 0; i < 1000; i++) {
+    histogram.Record(i);
+  }
+  for (size_t i = 0; i < iterations; i++) {
+    bench::DoNotOptimize(histogram.GetSnapshot().GetPercentile(0.99));
+  }
+});
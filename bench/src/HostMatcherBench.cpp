@@ -0,0 +1,25 @@
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "Ec2DnsClient.h"
+#include "FakeFleet.h"
+#include "HostMatcher.h"
+
+static bench::BenchFn _Match(bool matching) {
+  return [matching](size_t iterations) {
+    HostMatcher matcher(Ec2DnsConfig("bench", "10.0.0.0/8", "aws.bench"));
+    std::vector<std::string> hosts;
+    for (size_t n = 0; n < 1024; n++) {
+      hosts.push_back(matching ? FakeFleet::GetHostname(n, "bench") : "web-" + std::to_string(n));
+    }
+    char instanceId[32];
+    boost::string_ref region;
+    for (size_t i = 0; i < iterations; i++) {
+      bench::DoNotOptimize(matcher.TryMatch(hosts[i % hosts.size()], instanceId, sizeof(instanceId), &region));
+    }
+  };
+}
+
+BENCHMARK("host_matcher/try_match/hit", _Match(true));
+BENCHMARK("host_matcher/try_match/miss", _Match(false));
@@ -0,0 +1,27 @@
+#include <memory>
+#include <string>
+
+#include "Bench.h"
+#include "KRandom.h"
+
+static bench::BenchFn _PickFrom(size_t numNodes, size_t k) {
+  auto nodes = std::make_shared<std::vector<std::string>>();
+  for (size_t a = 0; a < numNodes; a++) {
+    nodes->push_back("10.0." + std::to_string(a / 256) + "." + std::to_string(a % 256));
+  }
+  return [nodes, k](size_t iterations) {
+    for (size_t i = 0; i < iterations; i++) {
+      for (const auto& node : k_random<std::string>(*nodes, k)) {
+        bench::DoNotOptimize(node.c_str());
+      }
+    }
+  };
+}
+
+BENCHMARK("k_random/pick4/n=4", _PickFrom(4, 4));
+BENCHMARK("k_random/pick4/n=16", _PickFrom(16, 4));
+BENCHMARK("k_random/pick4/n=256", _PickFrom(256, 4));
+BENCHMARK("k_random/pick4/n=1024", _PickFrom(1024, 4));
+BENCHMARK("k_random/pick4/n=4096", _PickFrom(4096, 4));
+BENCHMARK("k_random/pick16/n=4096", _PickFrom(4096, 16));
+BENCHMARK("k_random/pick64/n=4096", _PickFrom(4096, 64));
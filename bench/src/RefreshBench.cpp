@@ -0,0 +1,45 @@
+#include <memory>
+
+#include "Bench.h"
+#include "Ec2DnsClient.h"
+#include "FakeFleet.h"
+
+static void _log(int, const char*, ...) { }
+
+// Exposes the refresh so it can run on the bench thread.
+class BenchDnsClient : public Ec2DnsClient {
+public:
+  using Ec2DnsClient::Ec2DnsClient;
+
+  void Refresh() {
+    this->_RefreshInstanceDataImpl();
+  }
+};
+
+// Shared across calls so caches are warm after the first (untimed) one, as
+// they are in steady state.
+static BenchDnsClient& _GetClient() {
+  static auto fleet = std::make_shared<FakeFleet>(
+      bench::GetParam("instances", 10000),
+      bench::GetParam("asgs", 100),
+      bench::GetParam("asg_size", 16));
+  static BenchDnsClient client(
+      &_log,
+      std::make_shared<FakeEC2Client>(fleet),
+      std::make_shared<FakeAutoScalingClient>(fleet),
+      Ec2DnsConfig("bench", "10.0.0.0/8", "aws.bench"),
+      std::make_shared<StatsReceiver>());
+  return client;
+}
+
+// One full refresh per iteration: paging through DescribeInstances and
+// DescribeAutoScalingGroups and rebuilding every cache and the snapshot.
+static void _RefreshFull(size_t iterations) {
+  auto &client = _GetClient();
+  for (size_t i = 0; i < iterations; i++) {
+    client.Refresh();
+  }
+  bench::DoNotOptimize(client.GetSnapshotSerial());
+}
+
+BENCHMARK("refresh/full", _RefreshFull);
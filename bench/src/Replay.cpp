@@ -0,0 +1,176 @@
+// Feeds a query log captured with query_log_path back through dlz_lookup,
+// against a fake fleet, and reports throughput and latency per lookup path.
+//
+//   ec2dns-replay --log=/var/log/ec2dns.qlog --zone=aws.example.com --account=tc --speed=10
+//
+// speed=1 keeps the recorded gaps between lookups, speed=10 replays ten
+// times faster and speed=0 as fast as possible.  Lookups are dealt round
+// robin to threads, each of which keeps to the schedule of its own share.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DlzBenchEnv.h"
+#include "Histogram.h"
+#include "QueryLog.h"
+
+using namespace std::chrono;
+
+#define NUM_PATHS ((int)QueryPath::Forward + 1)
+
+static thread_local QueryPath t_lastPath;
+
+struct PathResult {
+  PathResult() : latency(new Histogram("replay_ns")), found(0) { }
+
+  std::unique_ptr<Histogram> latency;
+  uint64_t found;
+};
+
+struct ThreadResult {
+  ThreadResult() : behind(0), maxLagUs(0) { }
+
+  PathResult paths[NUM_PATHS];
+  // Lookups that started more than 1ms after their scheduled time.
+  uint64_t behind;
+  uint64_t maxLagUs;
+};
+
+int main(int argc, char **argv) {
+  std::map<std::string, std::string> params;
+  for (int i = 1; i < argc; i++) {
+    auto eq = strchr(argv[i], '=');
+    if (strncmp(argv[i], "--", 2) != 0 || eq == nullptr) {
+      fprintf(stderr, "usage: %s --log=<capture> --zone=<zone> [--param=value ...]\n", argv[0]);
+      return 1;
+    }
+    params[std::string(argv[i] + 2, eq)] = eq + 1;
+  }
+  auto param = [&params](const std::string& name, const char *defaultValue) {
+    auto found = params.find(name);
+    return found == params.end() ? std::string(defaultValue) : found->second;
+  };
+
+  std::vector<QueryLogEntry> entries;
+  {
+    QueryLogReader reader;
+    if (!reader.Open(param("log", ""))) {
+      fprintf(stderr, "Unable to read capture \"%s\"\n", param("log", "").c_str());
+      return 1;
+    }
+    QueryLogEntry entry;
+    while (reader.Next(&entry)) {
+      entries.push_back(entry);
+    }
+  }
+  if (entries.empty()) {
+    fprintf(stderr, "Capture is empty\n");
+    return 1;
+  }
+
+  DlzBenchOptions options;
+  options.zone = param("zone", options.zone.c_str());
+  options.cidr = param("cidr", options.cidr.c_str());
+  options.account = param("account", options.account.c_str());
+  options.instances = strtoull(param("instances", "10000").c_str(), nullptr, 10);
+  options.asgs = strtoull(param("asgs", "100").c_str(), nullptr, 10);
+  options.asg_size = strtoull(param("asg_size", "16").c_str(), nullptr, 10);
+  options.api_latency_us = strtoull(param("api_latency_us", "0").c_str(), nullptr, 10);
+  dlz_hooks().lookup_observer = [](const QueryTrace& trace) { t_lastPath = trace.path; };
+  DlzBenchEnv env(options);
+
+  const double speed = strtod(param("speed", "1").c_str(), nullptr);
+  const size_t numThreads = std::max(strtoull(param("threads", "1").c_str(), nullptr, 10), 1ull);
+  const uint64_t firstUs = entries.front().timestamp_us;
+  printf("Replaying %zu lookups spanning %.1fs at speed %g on %zu threads\n",
+      entries.size(), (entries.back().timestamp_us - firstUs) / 1e6, speed, numThreads);
+  fflush(stdout);
+
+  std::vector<ThreadResult> results(numThreads);
+  std::vector<std::thread> threads;
+  auto start = steady_clock::now();
+  for (size_t t = 0; t < numThreads; t++) {
+    threads.emplace_back([&, t] {
+      auto &result = results[t];
+      for (size_t i = t; i < entries.size(); i += numThreads) {
+        const auto &entry = entries[i];
+        if (speed > 0) {
+          auto due = start + microseconds((int64_t)((entry.timestamp_us - firstUs) / speed));
+          auto now = steady_clock::now();
+          if (due > now) {
+            std::this_thread::sleep_until(due);
+          }
+          else {
+            uint64_t lagUs = duration_cast<microseconds>(now - due).count();
+            result.behind += lagUs > 1000 ? 1 : 0;
+            result.maxLagUs = std::max(result.maxLagUs, lagUs);
+          }
+        }
+        auto lookupStart = steady_clock::now();
+        auto found = env.Lookup(entry.zone.c_str(), entry.name.c_str(), entry.client);
+        auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - lookupStart).count();
+        auto &path = result.paths[(int)t_lastPath];
+        path.latency->Record(elapsed);
+        path.found += found == ISC_R_SUCCESS ? 1 : 0;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double elapsed = duration<double>(steady_clock::now() - start).count();
+
+  printf("\n%-12s %10s %12s %8s %10s %10s %10s %10s\n",
+      "path", "lookups", "lookups/s", "found%", "p50_us", "p99_us", "p99.9_us", "max_us");
+  HistogramSnapshot all;
+  uint64_t allFound = 0, behind = 0, maxLagUs = 0;
+  for (int p = 0; p < NUM_PATHS; p++) {
+    HistogramSnapshot latency;
+    uint64_t found = 0;
+    for (const auto &result : results) {
+      latency.Merge(result.paths[p].latency->GetSnapshot());
+      found += result.paths[p].found;
+    }
+    all.Merge(latency);
+    allFound += found;
+    if (latency.GetCount() == 0) {
+      continue;
+    }
+    printf("%-12s %10llu %12.0f %8.1f %10.2f %10.2f %10.2f %10.2f\n",
+        QueryTracer::GetPathName((QueryPath)p),
+        (unsigned long long)latency.GetCount(),
+        latency.GetCount() / elapsed,
+        100.0 * found / latency.GetCount(),
+        latency.GetPercentile(0.5) / 1000.0,
+        latency.GetPercentile(0.99) / 1000.0,
+        latency.GetPercentile(0.999) / 1000.0,
+        latency.GetMax() / 1000.0);
+  }
+  for (const auto &result : results) {
+    behind += result.behind;
+    maxLagUs = std::max(maxLagUs, result.maxLagUs);
+  }
+  printf("%-12s %10llu %12.0f %8.1f %10.2f %10.2f %10.2f %10.2f\n",
+      "all",
+      (unsigned long long)all.GetCount(),
+      all.GetCount() / elapsed,
+      100.0 * allFound / all.GetCount(),
+      all.GetPercentile(0.5) / 1000.0,
+      all.GetPercentile(0.99) / 1000.0,
+      all.GetPercentile(0.999) / 1000.0,
+      all.GetMax() / 1000.0);
+  if (speed > 0) {
+    printf("\n%llu lookups ran more than 1ms behind schedule, at most %.1fms\n",
+        (unsigned long long)behind, maxLagUs / 1000.0);
+  }
+  return 0;
+}
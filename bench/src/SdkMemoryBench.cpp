@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "SdkMemory.h"
+
+// Each op builds and tears down a small object graph, roughly what one
+// instance of a DescribeInstances response costs the SDK.
+#define GRAPH_BLOCKS 48
+#define ARENA_GRAPHS 1000
+
+static const size_t BLOCK_SIZES[] = {24, 40, 17, 96, 32, 200, 64, 320};
+
+template<class Alloc, class Free>
+static void _Graphs(size_t iterations, Alloc alloc, Free free) {
+  void *blocks[GRAPH_BLOCKS];
+  for (size_t i = 0; i < iterations; i++) {
+    for (size_t b = 0; b < GRAPH_BLOCKS; b++) {
+      blocks[b] = alloc(BLOCK_SIZES[(i + b) % (sizeof(BLOCK_SIZES) / sizeof(BLOCK_SIZES[0]))]);
+    }
+    bench::DoNotOptimize(blocks[i % GRAPH_BLOCKS]);
+    for (size_t b = 0; b < GRAPH_BLOCKS; b++) {
+      free(blocks[b]);
+    }
+  }
+}
+
+template<class Fn>
+static void _RunThreads(size_t numThreads, size_t iterations, Fn fn) {
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; t++) {
+    threads.push_back(std::thread([&fn, iterations]() { fn(iterations); }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+static bench::BenchFn _Malloc(size_t numThreads) {
+  return [numThreads](size_t iterations) {
+    _RunThreads(numThreads, iterations, [](size_t n) {
+      _Graphs(n, [](size_t size) { return malloc(size); }, [](void *p) { free(p); });
+    });
+  };
+}
+
+static bench::BenchFn _Pools(size_t numThreads, bool arena) {
+  return [numThreads, arena](size_t iterations) {
+    SdkMemorySystem memory;
+    _RunThreads(numThreads, iterations, [&memory, arena](size_t n) {
+      // An arena lives for a refresh's worth of graphs.
+      for (size_t done = 0; done < n; done += ARENA_GRAPHS) {
+        SdkMemorySystem::ArenaScope scope(arena ? &memory : nullptr);
+        _Graphs(
+            std::min(n - done, (size_t)ARENA_GRAPHS),
+            [&memory](size_t size) { return memory.AllocateMemory(size, 16); },
+            [&memory](void *p) { memory.FreeMemory(p); });
+      }
+    });
+  };
+}
+
+BENCHMARK("sdk_memory/malloc/threads=1", _Malloc(1));
+BENCHMARK("sdk_memory/malloc/threads=4", _Malloc(4));
+BENCHMARK("sdk_memory/pools/threads=1", _Pools(1, false));
+BENCHMARK("sdk_memory/pools/threads=4", _Pools(4, false));
+BENCHMARK("sdk_memory/arena/threads=1", _Pools(1, true));
+BENCHMARK("sdk_memory/arena/threads=4", _Pools(4, true));
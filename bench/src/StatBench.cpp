@@ -0,0 +1,57 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "Stats.h"
+
+// Runs fn(iterations) on numThreads threads at once, so ns/op stays flat when
+// the counter scales.
+template<class Fn>
+static void _RunThreads(size_t numThreads, size_t iterations, Fn fn) {
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; t++) {
+    threads.push_back(std::thread([&fn, iterations]() { fn(iterations); }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+static bench::BenchFn _Striped(size_t numThreads) {
+  return [numThreads](size_t iterations) {
+    Stat stat("bench");
+    _RunThreads(numThreads, iterations, [&stat](size_t n) {
+      for (size_t i = 0; i < n; i++) {
+        stat.Increment();
+      }
+    });
+    bench::DoNotOptimize(stat.GetValue());
+  };
+}
+
+// The single shared atomic every Stat used to be.
+static bench::BenchFn _Shared(size_t numThreads) {
+  return [numThreads](size_t iterations) {
+    std::atomic_uint_fast64_t value(0);
+    _RunThreads(numThreads, iterations, [&value](size_t n) {
+      for (size_t i = 0; i < n; i++) {
+        value += 1;
+      }
+    });
+    bench::DoNotOptimize(value.load());
+  };
+}
+
+BENCHMARK("stat/striped/threads=1", _Striped(1));
+BENCHMARK("stat/striped/threads=2", _Striped(2));
+BENCHMARK("stat/striped/threads=4", _Striped(4));
+BENCHMARK("stat/striped/threads=8", _Striped(8));
+BENCHMARK("stat/striped/threads=16", _Striped(16));
+BENCHMARK("stat/striped/threads=32", _Striped(32));
+BENCHMARK("stat/shared/threads=1", _Shared(1));
+BENCHMARK("stat/shared/threads=2", _Shared(2));
+BENCHMARK("stat/shared/threads=4", _Shared(4));
+BENCHMARK("stat/shared/threads=8", _Shared(8));
+BENCHMARK("stat/shared/threads=16", _Shared(16));
+BENCHMARK("stat/shared/threads=32", _Shared(32));
@@ -0,0 +1,233 @@
+// Runs lookup threads against an Ec2DnsClient while its refresh thread
+// re-lists a fake fleet on a short interval, then reports throughput,
+// latency percentiles and how long threads waited on each lock.
+//
+//   ec2dns-stress --threads=16 --seconds=10 --keys=zipf --hit_ratio=0.99
+//
+// Build with -DEC2DNS_SANITIZER=thread to run it under ThreadSanitizer.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Ec2DnsClient.h"
+#include "FakeFleet.h"
+
+using namespace std::chrono;
+
+static std::map<std::string, std::string> s_params;
+
+static std::string _GetParam(const std::string& name, const std::string& defaultValue) {
+  auto found = s_params.find(name);
+  if (found == s_params.end()) {
+    s_params[name] = defaultValue;
+    return defaultValue;
+  }
+  return found->second;
+}
+
+static double _GetParam(const std::string& name, double defaultValue) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%g", defaultValue);
+  return strtod(_GetParam(name, std::string(buf)).c_str(), nullptr);
+}
+
+static void _log(int, const char*, ...) { }
+
+// Picks indices in [0, n), either uniformly or with Zipf(s) popularity.  The
+// most popular ranks are scattered over the key space so they don't all sit
+// next to each other in the fleet.
+class KeyChooser {
+public:
+  KeyChooser(size_t n, bool zipf, double s) : m_n(n) {
+    if (!zipf) {
+      return;
+    }
+    this->m_cdf.reserve(n);
+    double sum = 0;
+    for (size_t rank = 1; rank <= n; rank++) {
+      sum += 1.0 / std::pow((double)rank, s);
+      this->m_cdf.push_back(sum);
+    }
+    for (auto &c : this->m_cdf) {
+      c /= sum;
+    }
+  }
+
+  size_t Next(std::default_random_engine &rnd) const {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    if (this->m_cdf.empty()) {
+      return (size_t)(dist(rnd) * this->m_n) % this->m_n;
+    }
+    auto rank = std::lower_bound(this->m_cdf.begin(), this->m_cdf.end(), dist(rnd)) - this->m_cdf.begin();
+    return ((size_t)rank * 2654435761u) % this->m_n;
+  }
+
+private:
+  const size_t m_n;
+  std::vector<double> m_cdf;
+};
+
+struct ThreadResult {
+  ThreadResult() : latency(new Histogram("lookup_ns")), hits(0), misses(0), throttled(0), failed(0) { }
+
+  std::unique_ptr<Histogram> latency;
+  uint64_t hits, misses, throttled, failed;
+};
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    auto eq = strchr(argv[i], '=');
+    if (strncmp(argv[i], "--", 2) != 0 || eq == nullptr) {
+      fprintf(stderr, "usage: %s [--param=value ...]\n", argv[0]);
+      return 1;
+    }
+    s_params[std::string(argv[i] + 2, eq)] = eq + 1;
+  }
+
+  const size_t numThreads = (size_t)_GetParam("threads", 8.0);
+  const double seconds = _GetParam("seconds", 10.0);
+  const size_t numInstances = (size_t)_GetParam("instances", 50000.0);
+  const bool zipf = _GetParam("keys", std::string("uniform")) == "zipf";
+  const double zipfS = _GetParam("zipf_s", 1.0);
+  // The rest of the lookups are for instances the refresh never lists, so
+  // each goes through the throttler to the API.
+  const double hitRatio = _GetParam("hit_ratio", 0.99);
+  const double reverseRatio = _GetParam("reverse_ratio", 0.2);
+  const int refreshInterval = (int)_GetParam("refresh_interval", 1.0);
+  const uint64_t apiLatencyUs = (uint64_t)_GetParam("api_latency_us", 0.0);
+
+  auto fleet = std::make_shared<FakeFleet>(
+      numInstances, (size_t)_GetParam("asgs", 100.0), (size_t)_GetParam("asg_size", 16.0));
+  auto ec2Client = std::make_shared<FakeEC2Client>(fleet);
+  ec2Client->SetLatencyUs(apiLatencyUs);
+  auto stats = std::make_shared<StatsReceiver>();
+  Ec2DnsConfig config("stress", "10.0.0.0/8", "aws.stress");
+  config.refresh_interval = refreshInterval;
+  Ec2DnsClient client(&_log, ec2Client, std::make_shared<FakeAutoScalingClient>(fleet), config, stats);
+
+  for (const auto &p : s_params) {
+    printf("%s=%s ", p.first.c_str(), p.second.c_str());
+  }
+  printf("\n");
+
+  std::vector<std::string> ids, ips;
+  ids.reserve(numInstances);
+  ips.reserve(numInstances);
+  for (size_t n = 0; n < numInstances; n++) {
+    ids.push_back(FakeFleet::GetInstanceId(n));
+    ips.push_back(fleet->GetIp(n));
+  }
+  KeyChooser chooser(numInstances, zipf, zipfS);
+
+  client.LaunchRefreshThread();
+  while (client.GetSnapshotSerial() == 0) {
+    std::this_thread::sleep_for(milliseconds(10));
+  }
+  auto refreshesBefore = client.GetSnapshotSerial();
+  auto apiCallsBefore = ec2Client->GetCalls();
+
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> nextUnlisted(numInstances);
+  std::vector<ThreadResult> results(numThreads);
+  std::vector<std::thread> threads;
+  auto start = steady_clock::now();
+  for (size_t t = 0; t < numThreads; t++) {
+    threads.emplace_back([&, t] {
+      auto &result = results[t];
+      std::default_random_engine rnd((unsigned)t + 1);
+      std::uniform_real_distribution<double> dist(0.0, 1.0);
+      auto clientAddr = ClientAddress::FromV4({htonl(0x0A000000 + 0x10000 + (uint32_t)t)});
+      char answer[DNS_NAME_BUFFER_SIZE];
+      std::string unlisted;
+      while (!stop.load(std::memory_order_relaxed)) {
+        bool reverse = dist(rnd) < reverseRatio;
+        boost::string_ref key;
+        if (dist(rnd) < hitRatio) {
+          auto n = chooser.Next(rnd);
+          key = reverse ? ips[n] : ids[n];
+        }
+        else {
+          auto n = nextUnlisted.fetch_add(1, std::memory_order_relaxed);
+          unlisted = reverse ? fleet->GetIp(n) : FakeFleet::GetInstanceId(n);
+          key = unlisted;
+        }
+
+        ResolveInfo info;
+        auto lookupStart = steady_clock::now();
+        bool found = reverse
+            ? client.TryResolveHostname(key, clientAddr, answer, sizeof(answer), &info)
+            : client.TryResolveIp(key, clientAddr, answer, sizeof(answer), &info);
+        result.latency->Record(duration_cast<nanoseconds>(steady_clock::now() - lookupStart).count());
+
+        if (info.outcome == LookupOutcome::Hit) {
+          result.hits++;
+        }
+        else if (info.outcome == LookupOutcome::Miss) {
+          result.misses++;
+        }
+        else {
+          result.throttled++;
+        }
+        if (!found) {
+          result.failed++;
+        }
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(duration<double>(seconds));
+  stop.store(true);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double elapsed = duration<double>(steady_clock::now() - start).count();
+  client.StopRefreshThread();
+
+  HistogramSnapshot latency;
+  uint64_t hits = 0, misses = 0, throttled = 0, failed = 0;
+  for (const auto &result : results) {
+    latency.Merge(result.latency->GetSnapshot());
+    hits += result.hits;
+    misses += result.misses;
+    throttled += result.throttled;
+    failed += result.failed;
+  }
+  auto total = latency.GetCount();
+
+  printf("lookups      %12llu  %.0f/s\n", (unsigned long long)total, total / elapsed);
+  printf("hits         %12llu\n", (unsigned long long)hits);
+  printf("misses       %12llu\n", (unsigned long long)misses);
+  printf("throttled    %12llu\n", (unsigned long long)throttled);
+  printf("failed       %12llu\n", (unsigned long long)failed);
+  printf("refreshes    %12u\n", client.GetSnapshotSerial() - refreshesBefore);
+  printf("api calls    %12llu\n", (unsigned long long)(ec2Client->GetCalls() - apiCallsBefore));
+  printf("\nlatency (us)  p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+      latency.GetPercentile(0.5) / 1000.0,
+      latency.GetPercentile(0.9) / 1000.0,
+      latency.GetPercentile(0.99) / 1000.0,
+      latency.GetPercentile(0.999) / 1000.0,
+      latency.GetMax() / 1000.0);
+
+  printf("\n%-12s %12s %14s %14s\n", "lock", "contended", "wait_ms", "mean_wait_us");
+  for (const auto &lock : client.GetLocks()) {
+    auto contended = lock.second->GetContended();
+    auto waitNs = lock.second->GetWaitNs();
+    printf("%-12s %12llu %14.2f %14.2f\n",
+        lock.first.c_str(),
+        (unsigned long long)contended,
+        waitNs / 1e6,
+        contended > 0 ? waitNs / 1e3 / contended : 0.0);
+  }
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "ClientAddress.h"
+#include "FakeFleet.h"
+#include "SharedSnapshot.h"
+#include "ZoneSnapshot.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+static std::vector<SnapshotInstance> _GetInstances(size_t count) {
+  FakeFleet fleet(count, 0, 0);
+  std::vector<SnapshotInstance> instances(count);
+  for (size_t n = 0; n < count; n++) {
+    ClientAddress addr;
+    ClientAddress::TryParse(fleet.GetIp(n), &addr);
+    instances[n].TrySetId(FakeFleet::GetInstanceId(n));
+    instances[n].ipv4 = addr.GetV4();
+    instances[n].zone = (uint8_t)(n % 3);
+    instances[n].flags = SNAPSHOT_INSTANCE_HAS_IPV4;
+  }
+  return instances;
+}
+
+static ZoneSnapshot _GetSnapshot(std::vector<SnapshotInstance> instances) {
+  return ZoneSnapshot(
+      1, std::move(instances), {"us-east-1a", "us-east-1b", "us-east-1c"},
+      HostnameFormat("ue1", "bench", "aws.bench."), ZoneSnapshot::AutoscalingGroups());
+}
+
+static void _Build(size_t iterations) {
+  auto instances = _GetInstances(100000);
+  for (size_t i = 0; i < iterations; i++) {
+    bench::DoNotOptimize(_GetSnapshot(instances).GetInstances().size());
+  }
+}
+
+static void _FormatHostname(size_t iterations) {
+  auto snapshot = _GetSnapshot(_GetInstances(1024));
+  const auto &instances = snapshot.GetInstances();
+  char hostname[SNAPSHOT_HOSTNAME_BUFFER_SIZE];
+  for (size_t i = 0; i < iterations; i++) {
+    bench::DoNotOptimize(snapshot.FormatHostname(instances[i % instances.size()], true, hostname, sizeof(hostname)));
+  }
+}
+
+static void _FormatIp(size_t iterations) {
+  auto instances = _GetInstances(1024);
+  char ip[SNAPSHOT_IP_BUFFER_SIZE];
+  for (size_t i = 0; i < iterations; i++) {
+    bench::DoNotOptimize(ZoneSnapshot::FormatIp(instances[i % instances.size()], ip, sizeof(ip)));
+  }
+}
+
+// Publishing and mapping a generation of 100k instances, as the resolvers
+// sharing a snapshot do every refresh.
+static void _SharedPublishLoad(size_t iterations) {
+  auto name = "ec2dns-bench-" + std::to_string(getpid());
+  auto lockPath = "/tmp/" + name + ".lock";
+  auto snapshot = _GetSnapshot(_GetInstances(100000));
+  SharedSnapshot leader(name, lockPath, std::make_shared<StatsReceiver>());
+  SharedSnapshot follower(name, lockPath, std::make_shared<StatsReceiver>());
+  leader.TryLead();
+  HostnameFormat format("ue1", "bench", "aws.bench.");
+  for (size_t i = 0; i < iterations; i++) {
+    SharedSnapshotGeneration loaded;
+    leader.Publish(snapshot, 0, 0);
+    follower.Load(format, &loaded);
+    bench::DoNotOptimize(loaded.snapshot->FindByIp(snapshot.GetInstances()[i % 100000].ipv4));
+  }
+  for (size_t generation = std::max(iterations, (size_t)1) - 1; generation <= iterations; generation++) {
+    shm_unlink(leader.GetGenerationPath(generation).c_str());
+  }
+  shm_unlink(("/" + name).c_str());
+  unlink(lockPath.c_str());
+}
+
+BENCHMARK("zone_snapshot/build_100k", _Build);
+BENCHMARK("zone_snapshot/format_hostname", _FormatHostname);
+BENCHMARK("zone_snapshot/format_ip", _FormatIp);
+BENCHMARK("zone_snapshot/shared_publish_load_100k", _SharedPublishLoad);
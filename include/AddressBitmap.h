@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Networks with more host bits than this aren't mapped, 2^20 addresses take
+// 128KB.
+#define ADDRESS_BITMAP_MAX_HOST_BITS 20
+
+// One bit per address in an IPv4 network (host byte order), set for the
+// addresses in use.
+class AddressBitmap {
+public:
+  AddressBitmap(uint32_t network, uint32_t mask)
+    : m_network(network & mask), m_mask(mask), m_bits(((size_t)~mask >> 6) + 1, 0) { }
+
+  bool Covers(uint32_t ip) const {
+    return (ip & this->m_mask) == this->m_network;
+  }
+
+  // ip must be covered.
+  void Add(uint32_t ip) {
+    uint32_t offset = ip - this->m_network;
+    this->m_bits[offset >> 6] |= (uint64_t)1 << (offset & 63);
+  }
+
+  bool Contains(uint32_t ip) const {
+    uint32_t offset = ip - this->m_network;
+    return this->Covers(ip) && (this->m_bits[offset >> 6] & ((uint64_t)1 << (offset & 63))) != 0;
+  }
+
+  uint32_t GetNetwork() const {
+    return this->m_network;
+  }
+
+  uint32_t GetMask() const {
+    return this->m_mask;
+  }
+
+private:
+  uint32_t m_network;
+  uint32_t m_mask;
+  std::vector<uint64_t> m_bits;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "Histogram.h"
+#include "Stats.h"
+
+// Who made an API call: the periodic refresh, or a lookup that missed the
+// cache.
+enum class ApiCaller {
+  Refresh,
+  Miss
+};
+
+// Telemetry for the calls to one API from one caller.  A call is one or
+// more pages, each page is one request.
+class ApiCallStats {
+public:
+    ApiCallStats(const ApiCallStats&) = delete;
+
+    ApiCallStats(const std::string& api, ApiCaller caller, const std::shared_ptr<StatsReceiver>& statsReceiver);
+
+    // A page of items results came back after latencyUs.
+    void RecordPage(uint64_t latencyUs, size_t items);
+    // A request failed with the AWSError's exception name (or type) code.
+    void RecordError(const std::string& code, bool retryable);
+    void RecordCall(bool success);
+
+    const std::string& GetApi() const {
+      return this->m_api;
+    }
+
+    static const char* GetCallerName(ApiCaller caller);
+
+private:
+    std::string _GetStatName(const std::string& suffix) const;
+    MetricId _GetMetricId(const std::string& metricName) const;
+
+    const std::string m_api;
+    const ApiCaller m_caller;
+    std::shared_ptr<StatsReceiver> m_statsReceiver;
+
+    std::shared_ptr<Histogram> m_latency;
+    std::shared_ptr<Stat> m_calls, m_failedCalls, m_pages, m_items, m_retryableErrors;
+
+    // Per error code, created on first use.
+    std::map<std::string, std::shared_ptr<Stat>> m_errors;
+    std::mutex m_errorsLock;
+};
+
+class ApiTelemetry {
+public:
+    ApiTelemetry(const ApiTelemetry&) = delete;
+
+    ApiTelemetry(const std::shared_ptr<StatsReceiver>& statsReceiver)
+      : m_statsReceiver(statsReceiver) { }
+
+    // The stats for api called by caller, created on first use.
+    std::shared_ptr<ApiCallStats> Get(const std::string& api, ApiCaller caller);
+
+private:
+    std::shared_ptr<StatsReceiver> m_statsReceiver;
+    std::map<std::pair<std::string, ApiCaller>, std::shared_ptr<ApiCallStats>> m_stats;
+    std::mutex m_lock;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Index into the client's table of availability zone names.
+typedef int16_t ZoneIndex;
+#define UNKNOWN_ZONE ((ZoneIndex)-1)
+
+struct AsgMember {
+  std::string ip;
+  ZoneIndex zone;
+};
+
+// The healthy members of an autoscaling group, grouped by availability zone.
+// Immutable once built, so lookups can share it without copying.
+class AsgMembers {
+public:
+  // ttl is what answers for the group go out with.
+  AsgMembers(std::vector<AsgMember> members, uint32_t ttl = 0);
+
+  uint32_t GetTtl() const {
+    return this->m_ttl;
+  }
+
+  size_t size() const {
+    return this->m_ips.size();
+  }
+
+  const std::string& GetIp(size_t i) const {
+    return this->m_ips[i];
+  }
+
+  ZoneIndex GetZone(size_t i) const {
+    return this->m_zones[i];
+  }
+
+  const std::vector<std::string>& GetIps() const {
+    return this->m_ips;
+  }
+
+  // Writes up to k random member indices to picks and returns how many were
+  // written.  Members in clientZone are preferred; at least spillover picks
+  // (when available) and any picks the client's zone can't fill come from
+  // other zones.
+  size_t Select(ZoneIndex clientZone, size_t k, size_t spillover, size_t *picks) const;
+
+private:
+  struct ZoneRange {
+    ZoneIndex zone;
+    size_t begin, end;
+  };
+
+  std::vector<std::string> m_ips;
+  std::vector<ZoneIndex> m_zones;
+  std::vector<ZoneRange> m_ranges;
+  uint32_t m_ttl;
+};
+
+typedef std::shared_ptr<const AsgMembers> AsgMembersPtr;
@@ -1,11 +1,39 @@
 #pragma once
 
+#include <atomic>
+#include <cstring>
 #include <memory>
-#include <unordered_map>
 #include <string>
 
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_ref.hpp>
+
 #include "CacheEntry.h"
 #include "Stats.h"
+#include "TimedMutex.h"
+
+// Hashes std::string and boost::string_ref keys identically, so caches can be
+// probed with a view into a caller's buffer without building a std::string.
+struct StringRefHash {
+  size_t operator()(const boost::string_ref& key) const {
+    return boost::hash_range(key.begin(), key.end());
+  }
+};
+
+struct StringRefEqual {
+  bool operator()(const boost::string_ref& lhs, const boost::string_ref& rhs) const {
+    return lhs == rhs;
+  }
+};
+
+// What Cache::TryGet found for a key whose value is copied into a buffer.
+enum class CacheLookup {
+  Hit,
+  Missing,
+  // Present, but the value doesn't fit in the buffer.
+  TooLong
+};
 
 template<class T>
 class Cache {
@@ -15,13 +43,13 @@ public:
       unsigned int defaultTimeoutSec
   ) :
     m_defaultTimeout(defaultTimeoutSec),
-    m_hits(statsReceiver->Create(cacheName + "_hits")),
-    m_misses(statsReceiver->Create(cacheName + "_misses"))
+    m_hits(statsReceiver->Create(cacheName + "_hits", MetricId("cache_hits", {{"cache", cacheName}}))),
+    m_misses(statsReceiver->Create(cacheName + "_misses", MetricId("cache_misses", {{"cache", cacheName}})))
   { }
 
-  bool TryGet(const std::string& key, T* value) {
-    std::lock_guard<std::mutex> lock(this->m_cacheLock);
-    auto found = this->m_cache.find(key);
+  bool TryGet(const boost::string_ref& key, T* value) {
+    std::lock_guard<TimedMutex> lock(this->m_cacheLock);
+    auto found = this->m_cache.find(key, StringRefHash(), StringRefEqual());
     if (found == this->m_cache.end()) {
       this->m_misses->Increment();
       return false;
@@ -33,24 +61,70 @@ public:
     }
   }
 
-  std::unique_lock<std::mutex>&& GetLock() {
-    return std::move(std::unique_lock<std::mutex>(this->m_cacheLock, std::try_to_lock));
+  // Copies a string value into value, which holds len bytes including the
+  // terminator.  A value that doesn't fit is neither copied nor counted as
+  // a miss.  stableSince, if given, receives when the key took on this
+  // value.
+  CacheLookup TryGet(
+      const boost::string_ref& key, char *value, size_t len,
+      std::chrono::time_point<std::chrono::steady_clock> *stableSince = nullptr) {
+    std::lock_guard<TimedMutex> lock(this->m_cacheLock);
+    auto found = this->m_cache.find(key, StringRefHash(), StringRefEqual());
+    if (found == this->m_cache.end()) {
+      this->m_misses->Increment();
+      return CacheLookup::Missing;
+    }
+    const auto& item = found->second.GetItem();
+    if (item.length() >= len) {
+      return CacheLookup::TooLong;
+    }
+    memcpy(value, item.c_str(), item.length() + 1);
+    if (stableSince != nullptr) {
+      *stableSince = found->second.GetStableSince();
+    }
+    this->m_hits->Increment();
+    return CacheLookup::Hit;
+  }
+
+  // For entries inserted without an expiry from now on.
+  void SetDefaultTimeout(unsigned int defaultTimeoutSec) {
+    this->m_defaultTimeout.store(defaultTimeoutSec, std::memory_order_relaxed);
+  }
+
+  const TimedMutex& GetMutex() const {
+    return this->m_cacheLock;
+  }
+
+  std::unique_lock<TimedMutex> GetLock() {
+    return std::unique_lock<TimedMutex>(this->m_cacheLock);
   }
 
   void Insert(const std::string& key, const T& value) {
-    auto expiresOn = std::chrono::steady_clock::now() + std::chrono::seconds(this->m_defaultTimeout);
+    auto expiresOn = std::chrono::steady_clock::now() + std::chrono::seconds(this->m_defaultTimeout.load(std::memory_order_relaxed));
     this->Insert(key, value, expiresOn);
   }
   void Insert(const std::string& key, const T& value, const std::chrono::time_point<std::chrono::steady_clock> expiresOn) {
-    std::lock_guard<std::mutex> lock(this->m_cacheLock);
+    std::lock_guard<TimedMutex> lock(this->m_cacheLock);
     this->InsertNoLock(key, value, expiresOn);
   }
-  void InsertNoLock(const std::string& key, const T& value, const std::chrono::time_point<std::chrono::steady_clock> expiresOn) {
-    this->m_cache[key] = CacheEntry<T>(value, expiresOn);
+  // Re-inserting the value a key already has keeps its stable time, which
+  // is returned.
+  std::chrono::time_point<std::chrono::steady_clock> InsertNoLock(
+      const std::string& key, const T& value, const std::chrono::time_point<std::chrono::steady_clock> expiresOn) {
+    auto found = this->m_cache.find(key);
+    auto stableSince = found != this->m_cache.end() && found->second.GetItem() == value
+        ? found->second.GetStableSince()
+        : std::chrono::steady_clock::now();
+    this->m_cache[key] = CacheEntry<T>(value, expiresOn, stableSince);
+    return stableSince;
   }
 
   void Trim() {
-    std::lock_guard<std::mutex>(this->m_cacheLock);
+    std::lock_guard<TimedMutex> lock(this->m_cacheLock);
+    this->TrimNoLock();
+  }
+
+  void TrimNoLock() {
     std::vector<Aws::String> toDelete;
     time_point<steady_clock> now = steady_clock::now();
     // Delete expired entries
@@ -65,8 +139,8 @@ public:
   }
 
 private:
-  unsigned int m_defaultTimeout;
-  std::unordered_map<std::string, CacheEntry<T>> m_cache;
-  std::mutex m_cacheLock;
+  std::atomic<unsigned int> m_defaultTimeout;
+  boost::unordered_map<std::string, CacheEntry<T>, StringRefHash, StringRefEqual> m_cache;
+  TimedMutex m_cacheLock;
   std::shared_ptr<Stat> m_hits, m_misses;
 };
\ No newline at end of file
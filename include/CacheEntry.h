@@ -10,20 +10,29 @@ public:
     CacheEntry() { }
 
     CacheEntry(const T &item, const time_point<steady_clock> expiresOn):
-        m_item(item), m_expiresOn(expiresOn) { }
+        m_item(item), m_expiresOn(expiresOn), m_stableSince(steady_clock::now()) { }
 
-    T GetItem() {
+    CacheEntry(const T &item, const time_point<steady_clock> expiresOn, const time_point<steady_clock> stableSince):
+        m_item(item), m_expiresOn(expiresOn), m_stableSince(stableSince) { }
+
+    const T& GetItem() const {
       return m_item;
     }
 
-    bool IsValid() {
+    // When the key was first seen with this item.
+    time_point<steady_clock> GetStableSince() const {
+      return m_stableSince;
+    }
+
+    bool IsValid() const {
       return IsValid(steady_clock::now());
     }
 
-    bool IsValid(const time_point<steady_clock> now) {
+    bool IsValid(const time_point<steady_clock> now) const {
       return now < m_expiresOn;
     }
 private:
     T m_item;
     time_point<steady_clock> m_expiresOn;
-};
\ No newline at end of file
+    time_point<steady_clock> m_stableSince;
+};
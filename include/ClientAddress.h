@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+// Maximum length of a formatted client address, including the terminator.
+#define CLIENT_ADDRESS_STRLEN INET6_ADDRSTRLEN
+
+// The source address of a DNS client, kept in network byte order so it can
+// be carried through the lookup path without formatting it.
+class ClientAddress {
+public:
+    ClientAddress() : m_family(AF_UNSPEC) {
+      memset(&this->m_addr, 0, sizeof(this->m_addr));
+    }
+
+    static ClientAddress FromV4(const struct in_addr &addr) {
+      ClientAddress ret;
+      ret.m_family = AF_INET;
+      ret.m_addr.v4 = addr;
+      return ret;
+    }
+
+    static ClientAddress FromV6(const struct in6_addr &addr) {
+      ClientAddress ret;
+      ret.m_family = AF_INET6;
+      ret.m_addr.v6 = addr;
+      return ret;
+    }
+
+    static bool TryParse(const char *str, ClientAddress *addr) {
+      ClientAddress ret;
+      if (inet_pton(AF_INET, str, &ret.m_addr.v4) == 1) {
+        ret.m_family = AF_INET;
+      }
+      else if (inet_pton(AF_INET6, str, &ret.m_addr.v6) == 1) {
+        ret.m_family = AF_INET6;
+      }
+      else {
+        return false;
+      }
+      *addr = ret;
+      return true;
+    }
+
+    static bool TryParse(const std::string &str, ClientAddress *addr) {
+      return TryParse(str.c_str(), addr);
+    }
+
+    bool IsValid() const {
+      return this->m_family != AF_UNSPEC;
+    }
+
+    int GetFamily() const {
+      return this->m_family;
+    }
+
+    // The IPv4 address in host byte order, only meaningful for AF_INET.
+    uint32_t GetV4() const {
+      return ntohl(this->m_addr.v4.s_addr);
+    }
+
+    // The address in network byte order, GetLength() bytes long.
+    const uint8_t* GetBytes() const {
+      return this->m_addr.bytes;
+    }
+
+    size_t GetLength() const {
+      return this->m_family == AF_INET ? sizeof(struct in_addr)
+          : this->m_family == AF_INET6 ? sizeof(struct in6_addr)
+          : 0;
+    }
+
+    // Formats the address into buf, which should hold CLIENT_ADDRESS_STRLEN
+    // bytes.  Returns buf, or "-" if the address is unknown.
+    const char* Format(char *buf, size_t len) const {
+      if (!this->IsValid() || inet_ntop(this->m_family, &this->m_addr, buf, len) == NULL) {
+        return "-";
+      }
+      return buf;
+    }
+
+    std::string ToString() const {
+      char buf[CLIENT_ADDRESS_STRLEN];
+      return std::string(this->Format(buf, sizeof(buf)));
+    }
+
+    bool operator==(const ClientAddress &rhs) const {
+      if (this->m_family != rhs.m_family) {
+        return false;
+      }
+      size_t len = this->m_family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+      return memcmp(&this->m_addr, &rhs.m_addr, len) == 0;
+    }
+
+    bool operator!=(const ClientAddress &rhs) const {
+      return !(*this == rhs);
+    }
+
+private:
+    union {
+        struct in_addr v4;
+        struct in6_addr v6;
+        uint8_t bytes[16];
+    } m_addr;
+    uint8_t m_family;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "AsgMembers.h"
+
+// Maps client IPv4 addresses (host byte order) to the availability zone
+// they're in.  Built from the instances seen in a refresh: an instance's own
+// address maps to its zone, and so does any address in the same subnet, as
+// long as every instance seen in that subnet is in the same zone.
+class ClientZoneMap {
+public:
+  ClientZoneMap(int subnetBits)
+    : m_subnetMask(subnetBits <= 0 ? 0 : subnetBits >= 32 ? 0xFFFFFFFFu : (0xFFFFFFFFu << (32 - subnetBits)))
+  { }
+
+  void Add(uint32_t ip, ZoneIndex zone) {
+    this->m_byIp[ip] = zone;
+    auto inserted = this->m_bySubnet.insert(std::make_pair(ip & this->m_subnetMask, zone));
+    if (!inserted.second && inserted.first->second != zone) {
+      inserted.first->second = UNKNOWN_ZONE;
+    }
+  }
+
+  ZoneIndex Lookup(uint32_t ip) const {
+    auto found = this->m_byIp.find(ip);
+    if (found != this->m_byIp.end()) {
+      return found->second;
+    }
+    found = this->m_bySubnet.find(ip & this->m_subnetMask);
+    if (found != this->m_bySubnet.end()) {
+      return found->second;
+    }
+    return UNKNOWN_ZONE;
+  }
+
+private:
+  uint32_t m_subnetMask;
+  std::unordered_map<uint32_t, ZoneIndex> m_byIp;
+  std::unordered_map<uint32_t, ZoneIndex> m_bySubnet;
+};
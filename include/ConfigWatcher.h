@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+
+// How long a burst of changes to the file has to settle before onChange.
+#define CONFIG_WATCHER_SETTLE_MS 200
+
+// Calls onChange from its own thread whenever a file is written, or replaced
+// by a rename as editors and config management do.  The file's directory is
+// watched with inotify, so the file needn't exist yet.
+class ConfigWatcher {
+public:
+  ConfigWatcher(const ConfigWatcher&) = delete;
+
+  ConfigWatcher(const std::string& path, std::function<void()> onChange);
+  ~ConfigWatcher();
+
+  // False if inotify or the directory couldn't be watched.
+  bool IsWatching() const {
+    return this->m_watchThread.joinable();
+  }
+
+private:
+  void _WatchLoop();
+  // Reads pending events, true if any were for the file.
+  bool _ReadEvents();
+
+  std::string m_name;
+  std::function<void()> m_onChange;
+  int m_inotifyFd;
+  // Written to stop the watch thread.
+  int m_stopFd;
+  std::thread m_watchThread;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "dlz_minimal.h"
+#include "ConfigWatcher.h"
+#include "Ec2DnsClient.h"
+#include "HeavyHitters.h"
+#include "HostMatcher.h"
+#include "QueryLog.h"
+#include "QueryTracer.h"
+#include "RefreshRegistry.h"
+#include "ReverseLookupHelper.h"
+#include "Stats.h"
+#include "TransferAcl.h"
+#include "ZoneClassifier.h"
+#include "ZoneFileWriter.h"
+#include "ZoneRecords.h"
+
+// Creates the EC2 and AutoScaling clients for dlz_create, for running the
+// driver in-process against fakes (benchmarks, tools).
+typedef std::function<void(
+    const Ec2DnsConfig& config,
+    std::shared_ptr<EC2Client> *ec2Client,
+    std::shared_ptr<AutoScalingClient> *asgClient)> AwsClientFactory;
+
+// Called after every lookup with its path, outcome, result and time taken.
+typedef std::function<void(const QueryTrace& trace)> LookupObserver;
+
+// Process wide overrides of how dlz_create builds its state.
+struct DlzHooks {
+    DlzHooks() : config_path("/etc/ec2dns.conf") { }
+
+    std::string config_path;
+    // Null uses the AWS SDK clients.
+    AwsClientFactory client_factory;
+    LookupObserver lookup_observer;
+};
+
+DlzHooks& dlz_hooks();
+
+// Per-zone state handed back to BIND from dlz_create as dbdata.
+struct dlz_state {
+    std::shared_ptr<Ec2DnsClient> client;
+    std::unique_ptr<HostMatcher> matcher;
+    std::shared_ptr<ReverseLookupHelper> rl_helper;
+    std::unique_ptr<ZoneClassifier> classifier;
+    std::unique_ptr<QueryTracer> tracer;
+    // Null unless query_log_path is set.
+    std::unique_ptr<QueryLogWriter> query_log;
+    LookupObserver lookup_observer;
+    // Most queried names and most active clients, null if disabled.
+    std::unique_ptr<HeavyHitters> top_names;
+    std::unique_ptr<HeavyHitters> top_clients;
+    // Shared by the zones serving stats on the same address and port, this
+    // zone's are mounted as stats_name.
+    std::shared_ptr<StatsServer> stats_server;
+    std::string stats_name;
+    std::shared_ptr<StatsReceiver> stats_receiver;
+    // Shared by the zones that see the same instances.
+    std::shared_ptr<RefreshEngine> engine;
+    std::string zone_name;
+    std::shared_ptr<ZoneRecords> records;
+    std::shared_ptr<ZoneFileWriter> zone_writer;
+    TransferAcl xfr_acl;
+    DlzCallbacks callbacks;
+    // The rest of dlz_create's args, which the config is built on.
+    std::string vpc_cidr;
+    std::string account_name;
+    std::mutex reload_lock;
+    // Null unless config_watch is set.  Last, so it stops before the state
+    // it reloads goes.
+    std::unique_ptr<ConfigWatcher> config_watcher;
+};
+
+// Reloads the config file into state's client, and the client refreshing
+// for it, rebuilding the AWS clients if their timeouts changed.  Returns
+// JSON naming the settings applied, and those that changed but won't apply
+// until named reloads the zone.
+std::string dlz_reload_config(dlz_state *state);
@@ -6,22 +6,39 @@
 #define AWSDNS_EC2DNSCLIENT_H
 
 #include "dlz_minimal.h"
+#include "AddressBitmap.h"
+#include "ApiTelemetry.h"
+#include "AsgMembers.h"
 #include "Cache.h"
+#include "ClientAddress.h"
+#include "ClientZoneMap.h"
+#include "HeavyHitters.h"
+#include "Histogram.h"
 #include "Stats.h"
+#include "TtlPolicy.h"
+#include "RefreshProfiler.h"
 #include "RequestThrottler.h"
+#include "SdkMemory.h"
+#include "SharedSnapshot.h"
+#include "ZoneSnapshot.h"
 #include "aws/core/utils/json/JsonSerializer.h"
 #include "aws/autoscaling/AutoScalingClient.h"
 #include "aws/autoscaling/model/DescribeAutoScalingGroupsRequest.h"
 #include "aws/ec2/EC2Client.h"
 #include "aws/ec2/model/DescribeInstancesRequest.h"
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <boost/regex.hpp>
+#include <boost/utility/string_ref.hpp>
 
 using namespace Aws::AutoScaling;
 using namespace Aws::EC2;
@@ -33,6 +50,77 @@ struct DlzCallbacks {
   dns_sdlz_putnamedrr_t *putnamedrr;
 };
 
+// How a lookup was answered: from memory, by calling the API, or not at all
+// because the client was throttled.
+enum class LookupOutcome {
+  Hit,
+  Miss,
+  Throttled,
+  // Missing from an authoritative snapshot, answered without the API.
+  Absent
+};
+
+struct ResolveInfo {
+  ResolveInfo() : ttl(0), outcome(LookupOutcome::Hit) { }
+
+  uint32_t ttl;
+  LookupOutcome outcome;
+};
+
+// Large enough for any presentation format domain name, plus the terminator.
+#define DNS_NAME_BUFFER_SIZE 256
+
+// The settings a running client takes up from ApplyConfig, besides the API
+// timeouts.
+#define EC2DNS_TUNABLES(X) \
+    X(refresh_interval) \
+    X(instance_timeout) \
+    X(num_asg_records) \
+    X(asg_prefer_same_az) \
+    X(asg_az_spillover) \
+    X(asg_az_subnet_bits) \
+    X(request_batch_size) \
+    X(host_ttl) \
+    X(asg_ttl) \
+    X(shared_snapshot_poll_ms) \
+    X(sdk_refresh_arena) \
+    X(authoritative_snapshot) \
+    X(authoritative_grace_sec) \
+    X(authoritative_max_intervals)
+
+// The settings that change which data a client serves, or that dlz_create
+// builds around, which only take effect once named reloads the zone.
+#define EC2DNS_FIXED_SETTINGS(X) \
+    X(aws_access_key) \
+    X(aws_secret_key) \
+    X(instance_regex) \
+    X(account_name) \
+    X(log_level) \
+    X(log_path) \
+    X(vpc_cidr) \
+    X(zone_name) \
+    X(asg_dns_tag) \
+    X(region_code) \
+    X(xfr_allow) \
+    X(xfr_nameservers) \
+    X(zone_file_dir) \
+    X(stats_port) \
+    X(stats_address) \
+    X(stats_threads) \
+    X(trace_sample_every) \
+    X(trace_buffer_size) \
+    X(trace_slowest) \
+    X(top_k_capacity) \
+    X(top_k_window_sec) \
+    X(refresh_history) \
+    X(query_log_path) \
+    X(query_log_sample_every) \
+    X(query_log_max_mb) \
+    X(sdk_memory_pools) \
+    X(shared_snapshot_name) \
+    X(shared_snapshot_lock_path) \
+    X(config_watch)
+
 #define DEFAULT_INSTANCE_REGEX "^(?<region>[a-z]{2}\\d)(?<zone>[a-z])-(?<account>\\w+)-(?<instanceId>\\w*)$"
 
 class Ec2DnsConfig {
@@ -49,7 +137,37 @@ public:
         zone_name(zoneName),
         num_asg_records(4),
         asg_dns_tag("twitter:aws:dns-alias"),
-        request_batch_size(200)
+        asg_prefer_same_az(true),
+        asg_az_spillover(0),
+        asg_az_subnet_bits(24),
+        request_batch_size(200),
+        region_code("ue1"),
+        xfr_allow(""),
+        xfr_nameservers(""),
+        zone_file_dir(""),
+        host_ttl(60, 600, 10),
+        asg_ttl(10, 120, 25),
+        stats_port(8123),
+        stats_address(""),
+        stats_threads(4),
+        trace_sample_every(0),
+        trace_buffer_size(1024),
+        trace_slowest(32),
+        top_k_capacity(0),
+        top_k_window_sec(60),
+        refresh_history(16),
+        query_log_path(""),
+        query_log_sample_every(1),
+        query_log_max_mb(1024),
+        sdk_memory_pools(true),
+        sdk_refresh_arena(true),
+        shared_snapshot_name(""),
+        shared_snapshot_lock_path(""),
+        shared_snapshot_poll_ms(1000),
+        config_watch(true),
+        authoritative_snapshot(false),
+        authoritative_grace_sec(60),
+        authoritative_max_intervals(2)
     { }
 
     Aws::String aws_access_key;
@@ -72,13 +190,98 @@ public:
     size_t num_asg_records;
     std::string asg_dns_tag;
 
+    // Prefer ASG members in the client's availability zone.  At least
+    // asg_az_spillover records still come from other zones, and clients are
+    // mapped to a zone by the /asg_az_subnet_bits subnet they're in.
+    bool asg_prefer_same_az;
+    size_t asg_az_spillover;
+    int asg_az_subnet_bits;
+
     int request_batch_size;
 
     std::string region_code;
 
+    // Comma separated clients allowed to AXFR our zones (see TransferAcl),
+    // and the NS records served at the apex of each zone.
+    std::string xfr_allow;
+    std::string xfr_nameservers;
+
+    // When set, each zone is also exported as a zone file in this directory.
+    std::string zone_file_dir;
+
+    // TTLs for instance A/PTR answers grow with how long the instance has had
+    // the same address, and are at least the time left until the next
+    // refresh.  ASG answers follow how often the group's membership changes.
+    TtlPolicy host_ttl;
+    TtlPolicy asg_ttl;
+
+    // Where the stats server (/stats, /metrics) listens, an empty address
+    // listens on all interfaces.
+    int stats_port;
+    std::string stats_address;
+    int stats_threads;
+
+    // One in every trace_sample_every lookups is traced (0 disables it) into
+    // a ring of trace_buffer_size, the trace_slowest slowest are always kept.
+    size_t trace_sample_every;
+    size_t trace_buffer_size;
+    size_t trace_slowest;
+
+    // Heavy hitters among queried names, cache miss keys and clients are
+    // tracked per top_k_window_sec window in top_k_capacity counters each.
+    // Off (0) by default, tracking locks on every lookup.
+    size_t top_k_capacity;
+    int top_k_window_sec;
+
+    // How many refresh cycle profiles /debug/refresh keeps.
+    size_t refresh_history;
+
+    // When set, one in every query_log_sample_every lookups is captured to
+    // this file for replay, until it reaches query_log_max_mb.
+    std::string query_log_path;
+    size_t query_log_sample_every;
+    size_t query_log_max_mb;
+
+    // The AWS SDK allocates through SdkMemorySystem (see /debug/memory),
+    // and each refresh's allocations through an arena released in one go.
+    bool sdk_memory_pools;
+    bool sdk_refresh_arena;
+
+    // When set, the resolvers on a host configured with the same name share
+    // one refresh (see SharedSnapshot).  Whichever holds the lock file,
+    // /run/ec2dns/<name>.lock unless shared_snapshot_lock_path is set,
+    // refreshes and publishes, the others answer from its latest snapshot
+    // and check for a new one every shared_snapshot_poll_ms.  They must all
+    // run as the same user.
+    std::string shared_snapshot_name;
+    std::string shared_snapshot_lock_path;
+    int shared_snapshot_poll_ms;
+
+    // Reload the config file whenever it changes.  It can also be reloaded
+    // with a POST to /admin/reload on the stats server.
+    bool config_watch;
+
+    // Answer instance IDs, and addresses in vpc_cidr, that the latest
+    // snapshot lacks as not found rather than asking the API, for as long as
+    // the snapshot is fresh: the last refresh succeeded and the snapshot is
+    // no older than authoritative_max_intervals refresh intervals.  Instance
+    // IDs carry no order, so once the snapshot is authoritative_grace_sec old
+    // an ID it lacks may be for an instance launched since, and goes to the
+    // API.  Addresses stay answered from the snapshot.
+    bool authoritative_snapshot;
+    int authoritative_grace_sec;
+    int authoritative_max_intervals;
+
     bool TryLoad(const std::string& file);
+
+    // The names of the settings that differ from other's, those that a
+    // running client can take up, API timeouts included, and those it can't.
+    std::vector<std::string> GetChangedTunables(const Ec2DnsConfig& other) const;
+    std::vector<std::string> GetChangedFixedSettings(const Ec2DnsConfig& other) const;
 };
 
+typedef std::shared_ptr<const Ec2DnsConfig> Ec2DnsConfigPtr;
+
 class Ec2DnsClient {
 public:
   Ec2DnsClient(
@@ -90,65 +293,292 @@ public:
   )
     : m_hostCache("host", statsReceiver, config.instance_timeout),
       m_asgCache("asg", statsReceiver, config.instance_timeout),
-      m_config(config), m_ec2Client(ec2Client), m_asgClient(asgClient),
-      m_log(logCb), m_throttler(new RequestThrottler()),
-      m_apiFailures(statsReceiver->Create("api_failure")),
+      m_config(std::make_shared<const Ec2DnsConfig>(config)),
+      m_hostnameFormat(config.region_code, config.account_name, config.zone_name),
+      m_ec2Client(ec2Client), m_asgClient(asgClient),
+      m_log(logCb), m_stopRefresh(false), m_rescheduleRefresh(false), m_throttler(new RequestThrottler()),
+      m_nextRefresh(0),
+      m_refreshFailed(false),
+      m_snapshotSerial(0),
+      m_sharedGeneration(0),
+      m_following(false),
+      m_apiFailures(statsReceiver->Create("api_failure", MetricId("api_results", {{"result", "failure"}}))),
       m_apiRequests(statsReceiver->Create("api_requests")),
-      m_apiSuccesses(statsReceiver->Create("api_success")),
-      m_lookupRequests(statsReceiver->Create("a_requests")),
-      m_reverseLookupRequests(statsReceiver->Create("ptr_requests")),
-      m_autoscalerRequests(statsReceiver->Create("autoscaler_requests"))
+      m_apiSuccesses(statsReceiver->Create("api_success", MetricId("api_results", {{"result", "success"}}))),
+      m_lookupRequests(statsReceiver->Create("a_requests", MetricId("requests", {{"zone_kind", "forward"}}))),
+      m_reverseLookupRequests(statsReceiver->Create("ptr_requests", MetricId("requests", {{"zone_kind", "reverse"}}))),
+      m_autoscalerRequests(statsReceiver->Create("autoscaler_requests", MetricId("requests", {{"zone_kind", "autoscaler"}}))),
+      m_throttledLookups(statsReceiver->Create("throttled_lookups")),
+      m_asgSameZone(statsReceiver->Create("asg_same_az", MetricId("asg_client_zone", {{"zone", "known"}}))),
+      m_asgUnknownZone(statsReceiver->Create("asg_unknown_az", MetricId("asg_client_zone", {{"zone", "unknown"}}))),
+      m_lookupLatency {
+          statsReceiver->CreateHistogram("lookup_hit_us", MetricId("lookup_duration", {{"outcome", "hit"}})),
+          statsReceiver->CreateHistogram("lookup_miss_us", MetricId("lookup_duration", {{"outcome", "miss"}})),
+          statsReceiver->CreateHistogram("lookup_throttled_us", MetricId("lookup_duration", {{"outcome", "throttled"}})),
+          statsReceiver->CreateHistogram("lookup_absent_us", MetricId("lookup_duration", {{"outcome", "absent"}}))
+      },
+      m_refreshLatency(statsReceiver->CreateHistogram(
+          "refresh_total_us", MetricId("refresh_duration", {{"phase", "total"}}))),
+      m_refreshDescribeLatency(statsReceiver->CreateHistogram(
+          "refresh_describe_instances_us", MetricId("refresh_duration", {{"phase", "describe_instances"}}))),
+      m_refreshAutoscalerLatency(statsReceiver->CreateHistogram(
+          "refresh_autoscaler_us", MetricId("refresh_duration", {{"phase", "autoscaler"}}))),
+      m_refreshZoneMapLatency(statsReceiver->CreateHistogram(
+          "refresh_zone_map_us", MetricId("refresh_duration", {{"phase", "zone_map"}}))),
+      m_refreshHostCacheTrimLatency(statsReceiver->CreateHistogram(
+          "refresh_host_cache_trim_us", MetricId("refresh_duration", {{"phase", "host_cache_trim"}}))),
+      m_refreshSnapshotLatency(statsReceiver->CreateHistogram(
+          "refresh_snapshot_us", MetricId("refresh_duration", {{"phase", "snapshot"}}))),
+      m_statsReceiver(statsReceiver),
+      m_apiTelemetry(statsReceiver),
+      m_refreshProfiler(config.refresh_history)
   {
+    if (config.top_k_capacity > 0) {
+      this->m_missKeys.reset(new HeavyHitters("miss_keys", config.top_k_capacity, config.top_k_window_sec));
+    }
+    if (!config.shared_snapshot_name.empty()) {
+      auto lockPath = config.shared_snapshot_lock_path.empty()
+          ? SHARED_SNAPSHOT_LOCK_DIR + config.shared_snapshot_name + ".lock"
+          : config.shared_snapshot_lock_path;
+      this->m_sharedSnapshot.reset(new SharedSnapshot(config.shared_snapshot_name, lockPath, statsReceiver));
+    }
+  }
+
+  ~Ec2DnsClient() {
+    this->StopRefreshThread();
+  }
+
+  typedef std::function<void(const ZoneSnapshotPtr&)> SnapshotListener;
+
+  // Called on the refresh thread with every new snapshot, must be set before
+  // LaunchRefreshThread.
+  void SetSnapshotListener(SnapshotListener listener) {
+    this->m_snapshotListener = listener;
+  }
+
+  const SnapshotListener& GetSnapshotListener() const {
+    return this->m_snapshotListener;
   }
 
   void LaunchRefreshThread() {
     this->m_refreshThread = std::thread(&Ec2DnsClient::_RefreshInstanceData, this);
   }
 
-  bool TryResolveIp(const std::string &instanceId, const std::string &clientAddr, std::string *ip);
-  bool TryResolveHostname(const std::string &ip, const std::string &clientAddr, std::string *hostname);
-  bool TryResolveAutoscaler(const std::string &name, const std::string &clientAddr, std::vector<std::string> *nodes);
+  // Waits for an in flight refresh to finish, the refresh thread exits
+  // instead of sleeping until the next one.
+  void StopRefreshThread();
+
+  // The locks lookups can wait on, by name.
+  std::vector<std::pair<std::string, const TimedMutex*>> GetLocks() const;
+
+  // ip and hostname are caller provided buffers of len bytes, answers served
+  // from the cache don't allocate.  info, if given, receives the TTL to
+  // answer with and how the lookup was served.
+  bool TryResolveIp(const boost::string_ref &instanceId, const ClientAddress &clientAddr, char *ip, size_t len, ResolveInfo *info = nullptr);
+  bool TryResolveHostname(const boost::string_ref &ip, const ClientAddress &clientAddr, char *hostname, size_t len, ResolveInfo *info = nullptr);
+  bool TryResolveAutoscaler(const boost::string_ref &name, const ClientAddress &clientAddr, AsgMembersPtr *nodes);
+
+  // Picks up to num_asg_records indices into members for an answer to
+  // clientAddr, writing them to picks (K_RANDOM_MAX_K entries).
+  size_t SelectAutoscalerMembers(const AsgMembers &members, const ClientAddress &clientAddr, size_t *picks);
+  ZoneIndex GetClientZone(const ClientAddress &clientAddr);
+
+  // Records the latency of a dlz_lookup that began at start.
+  void RecordLookup(LookupOutcome outcome, uint64_t elapsedUs) {
+    this->m_lookupLatency[(int)outcome]->Record(elapsedUs);
+  }
+
+  RefreshProfiler& GetRefreshProfiler() {
+    return this->m_refreshProfiler;
+  }
+
+  // The most missed cache keys, null if disabled.
+  HeavyHitters* GetMissKeys() {
+    return this->m_missKeys.get();
+  }
+
+  // The config as last applied, which stays valid while it's held even if
+  // another is applied meanwhile.
+  Ec2DnsConfigPtr GetConfig() const {
+    return std::atomic_load(&this->m_config);
+  }
+
+  // Takes up the tunables (see EC2DNS_TUNABLES) from config, keeping the
+  // caches, snapshot and refresh thread, and returns the names of those that
+  // changed.  The next refresh is rescheduled by the new interval.  New API
+  // timeouts only apply to clients passed to SetAwsClients.
+  std::vector<std::string> ApplyConfig(const Ec2DnsConfig& config);
+
+  void SetAwsClients(std::shared_ptr<EC2Client> ec2Client, std::shared_ptr<AutoScalingClient> asgClient);
+
+  // The data from the last successful refresh, null until there is one.
+  ZoneSnapshotPtr GetSnapshot();
+  // When GetSnapshot() was taken, by whichever client refreshed, in
+  // steady_clock ticks.  0 until there is one.
+  int64_t GetSnapshotTaken();
+  // The serial of GetSnapshot(), 0 until there is one.
+  uint32_t GetSnapshotSerial() const {
+    return this->m_snapshotSerial.load(std::memory_order_acquire);
+  }
+
+  // When the snapshot is next refreshed, in steady_clock ticks.
+  int64_t GetNextRefresh() const {
+    return this->m_nextRefresh.load(std::memory_order_relaxed);
+  }
+
+  // Answering from another process's shared snapshot, or another client's
+  // (see FollowSnapshot), rather than refreshing.
+  bool IsFollowing() const {
+    return this->m_following.load(std::memory_order_relaxed);
+  }
+
+  // Answers from snapshot, which another client in the process refreshed,
+  // named this client's way.  taken is when the other client took it, and
+  // nextRefresh when it refreshes next, in steady_clock ticks.  For a client
+  // whose refresh thread isn't running, calls must not overlap.
+  void FollowSnapshot(const ZoneSnapshotPtr& snapshot, int64_t taken, int64_t nextRefresh);
 
 protected:
-  void _RefreshAutoscalerDataImpl(const Aws::Vector<Aws::EC2::Model::Instance>& instances);
+  bool _RefreshAutoscalerDataImpl(
+      const Aws::Vector<Aws::EC2::Model::Instance>& instances,
+      ZoneSnapshot::AutoscalingGroups *groups);
+  // Instances keeping their address in the previous snapshot keep its
+  // stable time.
+  void _RefreshSnapshotImpl(
+      const Aws::Vector<Aws::EC2::Model::Instance>& instances,
+      ZoneSnapshot::AutoscalingGroups groups);
+  void _RefreshZoneMapImpl(const Aws::Vector<Aws::EC2::Model::Instance>& instances);
+  // Records dnsAlias's current members and returns the TTL to answer with.
+  uint32_t _UpdateAsgHistory(const std::string& dnsAlias, std::vector<std::string> ips, const time_point<steady_clock> now);
   void _RefreshInstanceData();
+  // Refreshes, or with a shared snapshot that another process publishes,
+  // follows it.
+  void _RefreshOrFollow();
+  // When to refresh or follow again after a run ending at lastRun.
+  time_point<steady_clock> _ScheduleNextRun(time_point<steady_clock> lastRun);
   void _RefreshInstanceDataImpl();
+  // Takes up the latest shared snapshot if it's new.
+  void _FollowSharedSnapshot();
+  // Answers from snapshot, which follows this client's naming, from now on.
+  void _AdoptSnapshot(const ZoneSnapshotPtr& snapshot, int64_t taken, int64_t nextRefresh);
+  // Rebuilds the ASG, zone map and host caches and the snapshot from a
+  // successful DescribeInstances.
+  void _RefreshCachesImpl(const Aws::Vector<Aws::EC2::Model::Instance>& instances);
 
 private:
+  typedef bool (Ec2DnsClient::*ValueFactory)(const std::string&, std::string*);
+  typedef CacheLookup (Ec2DnsClient::*SnapshotFinder)(
+      const ZoneSnapshot&, const boost::string_ref&, char*, size_t, time_point<steady_clock>*);
+  typedef std::vector<AddressBitmap> AddressBitmaps;
+
+  // What lookups read of the last refresh, published as one so that they
+  // never see a snapshot with another's bitmaps.
+  struct PublishedSnapshot {
+    ZoneSnapshotPtr snapshot;
+    // Built with snapshot while authoritative_snapshot is set, else null.
+    std::shared_ptr<const AddressBitmaps> bitmaps;
+    // steady_clock ticks at which snapshot was taken.
+    int64_t taken;
+
+    steady_clock::duration GetAge() const {
+      return steady_clock::now() - time_point<steady_clock>(steady_clock::duration(this->taken));
+    }
+  };
+  typedef bool (Ec2DnsClient::*AbsenceCheck)(
+      const Ec2DnsConfig&, const PublishedSnapshot&, const boost::string_ref&);
+
     template<class TRequest, class TResponse, class TError>
   bool _CallApi(
       std::string apiTag,
+      ApiCaller caller,
       TRequest& request,
       std::function<Aws::Utils::Outcome<TResponse, Aws::Client::AWSError<TError>>(const TRequest&)> requestFn,
       std::vector<TResponse> *responses) {
     std::string nextToken;
+    auto telemetry = this->m_apiTelemetry.Get(apiTag, caller);
+    auto callStart = steady_clock::now();
+    size_t pages = 0, items = 0;
     do {
       this->m_apiRequests->Increment();
+      auto start = steady_clock::now();
       auto ret = requestFn(request);
-      this->m_log(ISC_LOG_INFO, "ec2dns - API Request complete");
+      auto latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(steady_clock::now() - start).count();
       if (!ret.IsSuccess()) {
         this->m_apiFailures->Increment();
-        auto errorMessage = ret.GetError().GetMessage();
+        const auto &error = ret.GetError();
+        auto code = error.GetExceptionName();
+        if (code.empty()) {
+          code = "type_" + std::to_string((int)error.GetErrorType());
+        }
+        telemetry->RecordError(code, error.ShouldRetry());
+        telemetry->RecordCall(false);
         this->m_log(
             ISC_LOG_ERROR,
-            "ec2dns - API request %s failed with error: %s",
+            "ec2dns - API request %s (%s) failed on page %d with %s: %s",
             apiTag.c_str(),
-            errorMessage.c_str());
+            ApiCallStats::GetCallerName(caller),
+            (int)pages + 1,
+            code.c_str(),
+            error.GetMessage().c_str());
         return false;
       }
       this->m_apiSuccesses->Increment();
 
       auto result = ret.GetResult();
+      auto pageItems = _CountItems(result);
+      telemetry->RecordPage(latencyUs, pageItems);
+      pages++;
+      items += pageItems;
       responses->push_back(result);
       nextToken = result.GetNextToken();
       request.SetNextToken(nextToken);
     } while (!nextToken.empty());
+    telemetry->RecordCall(true);
+    this->m_log(
+        ISC_LOG_INFO,
+        "ec2dns - API request %s (%s) complete, %d items in %d pages, %dms",
+        apiTag.c_str(),
+        ApiCallStats::GetCallerName(caller),
+        (int)items,
+        (int)pages,
+        (int)std::chrono::duration_cast<std::chrono::milliseconds>(steady_clock::now() - callStart).count());
     return true;
   };
 
-  const std::string _GetHostname(const Aws::EC2::Model::Instance& instance);
+  static size_t _CountItems(const Aws::EC2::Model::DescribeInstancesResponse& response) {
+    size_t items = 0;
+    for (const auto &r : response.GetReservations()) {
+      items += r.GetInstances().size();
+    }
+    return items;
+  }
 
-  bool _CheckHostCache(const std::string& instanceId, std::string *ip);
+  static size_t _CountItems(const Aws::AutoScaling::Model::DescribeAutoScalingGroupsResult& result) {
+    return result.GetAutoScalingGroups().size();
+  }
+
+  const std::string _GetHostname(const Aws::EC2::Model::Instance& instance);
+  std::shared_ptr<EC2Client> _GetEc2Client();
+  std::shared_ptr<AutoScalingClient> _GetAsgClient();
+  ZoneIndex _GetZoneIndex(const std::string& availabilityZone);
+
+  CacheLookup _CheckHostCache(const boost::string_ref& key, char *value, size_t len, time_point<steady_clock> *stableSince);
+  // Instances are looked up in the snapshot first, the host cache only holds
+  // what the API filled on a miss.
+  CacheLookup _CheckSnapshot(
+      const boost::string_ref& key, SnapshotFinder finder, char *value, size_t len, time_point<steady_clock> *stableSince);
+  CacheLookup _FindIpInSnapshot(
+      const ZoneSnapshot& snapshot, const boost::string_ref& instanceId, char *ip, size_t len, time_point<steady_clock> *stableSince);
+  CacheLookup _FindHostnameInSnapshot(
+      const ZoneSnapshot& snapshot, const boost::string_ref& ip, char *hostname, size_t len, time_point<steady_clock> *stableSince);
+  // With authoritative_snapshot, whether a fresh snapshot shows there's
+  // nothing for key.
+  bool _IsAbsent(const boost::string_ref& key, AbsenceCheck check);
+  bool _IsIdAbsent(const Ec2DnsConfig& config, const PublishedSnapshot& published, const boost::string_ref& instanceId);
+  bool _IsIpAbsent(const Ec2DnsConfig& config, const PublishedSnapshot& published, const boost::string_ref& ip);
+  // The addresses in use in each network of vpc_cidr small enough to map.
+  std::shared_ptr<const AddressBitmaps> _BuildAddressBitmaps(const ZoneSnapshot& snapshot);
+  uint32_t _GetHostTtl(const time_point<steady_clock> stableSince, const time_point<steady_clock> now);
   template<class T>
   bool _CheckCache(
       const std::string &key, T* result,
@@ -161,25 +591,82 @@ private:
   void _InsertCache(const std::string& instanceId, const std::string& ip, const time_point<steady_clock> expiresOn);
   void _InsertCacheNoLock(const std::string& instanceId, const std::string& ip, const time_point<steady_clock> expiresOn);
 
-  bool _Resolve(const std::string &key, const std::string &clientAddr, const std::function<bool(const std::string&, std::string*)> valueFactory, std::string *value);
+  bool _Resolve(
+      const boost::string_ref &key, const ClientAddress &clientAddr, ValueFactory valueFactory,
+      SnapshotFinder snapshotFinder, AbsenceCheck absenceCheck, char *value, size_t len, ResolveInfo *info);
+  // taken is when the publisher took snapshot, in steady_clock ticks.
+  void _SetSnapshot(const ZoneSnapshotPtr& snapshot, int64_t taken);
   bool _QueryInstanceById(const std::string& instanceId, std::string *ip);
   bool _QueryInstanceByIp(const std::string& ip, std::string *hostname);
 
   bool _DescribeInstances(const std::string& instanceId, const std::string& ip, Aws::Vector<Aws::EC2::Model::Instance> *instances);
 
   Cache<std::string> m_hostCache;
-  Cache<std::vector<std::string>> m_asgCache;
+  Cache<AsgMembersPtr> m_asgCache;
 
-  Ec2DnsConfig m_config;
+  // Swapped with std::atomic_load and std::atomic_store.
+  Ec2DnsConfigPtr m_config;
+  std::mutex m_configLock;
+  HostnameFormat m_hostnameFormat;
   std::shared_ptr<EC2Client> m_ec2Client;
   std::shared_ptr<AutoScalingClient> m_asgClient;
+  std::mutex m_awsClientsLock;
   log_t *m_log;
   std::thread m_refreshThread;
+  bool m_stopRefresh;
+  bool m_rescheduleRefresh;
+  std::mutex m_stopRefreshLock;
+  std::condition_variable m_stopRefreshCond;
   std::unique_ptr<RequestThrottler> m_throttler;
 
+  // Only touched by the refresh thread.
+  std::unordered_map<std::string, ZoneIndex> m_zoneIndexes;
+  std::shared_ptr<const ClientZoneMap> m_zoneMap;
+  std::mutex m_zoneMapLock;
+
+  // How each ASG's membership has changed, only touched by the refresh thread.
+  struct AsgHistory {
+    std::vector<std::string> ips;
+    time_point<steady_clock> lastChanged;
+    // Smoothed seconds between membership changes, 0 until the first change.
+    double meanChangeInterval;
+  };
+  std::unordered_map<std::string, AsgHistory> m_asgHistory;
+
+  // steady_clock ticks at which the next refresh is due.
+  std::atomic<int64_t> m_nextRefresh;
+  // Whether this client's last refresh failed, since when the snapshot may
+  // be missing instances.
+  std::atomic<bool> m_refreshFailed;
+
+  // Null until the first snapshot.  Swapped with std::atomic_load and
+  // std::atomic_store.
+  std::shared_ptr<const PublishedSnapshot> m_published;
+  std::atomic<uint32_t> m_snapshotSerial;
+  SnapshotListener m_snapshotListener;
+
+  // Null unless shared_snapshot_name is set, only touched by the refresh
+  // thread, as is the generation last taken up from it.
+  std::unique_ptr<SharedSnapshot> m_sharedSnapshot;
+  uint64_t m_sharedGeneration;
+  std::atomic<bool> m_following;
+
   std::shared_ptr<Stat> m_cacheHits, m_cacheMisses,
       m_apiFailures, m_apiRequests, m_apiSuccesses,
-      m_lookupRequests, m_reverseLookupRequests, m_autoscalerRequests;
+      m_lookupRequests, m_reverseLookupRequests, m_autoscalerRequests,
+      m_throttledLookups, m_asgSameZone, m_asgUnknownZone;
+
+  // Indexed by LookupOutcome.
+  std::shared_ptr<Histogram> m_lookupLatency[4];
+  std::shared_ptr<Histogram> m_refreshLatency, m_refreshDescribeLatency,
+      m_refreshAutoscalerLatency, m_refreshZoneMapLatency,
+      m_refreshHostCacheTrimLatency, m_refreshSnapshotLatency;
+
+  std::shared_ptr<StatsReceiver> m_statsReceiver;
+  ApiTelemetry m_apiTelemetry;
+  RefreshProfiler m_refreshProfiler;
+
+  std::unique_ptr<HeavyHitters> m_missKeys;
 };
 
 
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "aws/core/utils/json/JsonSerializer.h"
+
+// Keys longer than this are truncated, they're only used for reporting.
+#define HEAVY_HITTER_KEY_SIZE 128
+
+struct HeavyHitter {
+  std::string key;
+  // count overestimates the key's true count by at most error.
+  uint64_t count;
+  uint64_t error;
+};
+
+struct HeavyHitterWindow {
+  // How many keys were offered in the window.
+  uint64_t total;
+  std::vector<HeavyHitter> top;
+};
+
+// Streaming top-K of the keys offered in a window of windowSec seconds, in
+// fixed memory using Space-Saving: capacity counters are kept, and a new
+// key evicts the smallest one, inheriting its count as the error.  Any key
+// seen more than total / capacity times in a window is guaranteed a slot.
+// Offering never allocates, and drops the key rather than wait on a lock.
+class HeavyHitters {
+public:
+    HeavyHitters(const HeavyHitters&) = delete;
+
+    HeavyHitters(const std::string& name, size_t capacity, int windowSec);
+
+    void Offer(const boost::string_ref& key) {
+      this->Offer(key, std::chrono::steady_clock::now());
+    }
+
+    void Offer(const boost::string_ref& key, const std::chrono::steady_clock::time_point now);
+
+    // The window in progress and the last complete one, heaviest first.
+    HeavyHitterWindow GetCurrent(const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+    HeavyHitterWindow GetPrevious(const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    const std::string& GetName() const {
+      return this->m_name;
+    }
+
+    uint64_t GetDropped() const {
+      return this->m_dropped;
+    }
+
+    Aws::Utils::Json::JsonValue ToJson();
+
+private:
+    struct Entry {
+      uint64_t count;
+      uint64_t error;
+      size_t len;
+      char key[HEAVY_HITTER_KEY_SIZE];
+    };
+
+    struct Table {
+      std::vector<Entry> entries;
+      // Kept apart from the entries so the scan for a key stays in cache.
+      std::vector<uint32_t> hashes;
+      size_t size;
+      uint64_t total;
+      int64_t start;
+    };
+
+    void _RotateNoLock(int64_t window);
+    HeavyHitterWindow _GetWindow(bool previous, const std::chrono::steady_clock::time_point now);
+
+    static uint32_t _Hash(const boost::string_ref& key);
+
+    const std::string m_name;
+    const size_t m_capacity;
+    const int m_windowSec;
+
+    std::mutex m_lock;
+    Table m_tables[2];
+    int m_current;
+    std::atomic<uint64_t> m_dropped;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MetricId.h"
+
+// Log-linear bucketing: values below 2^HISTOGRAM_SUB_BITS get a bucket each,
+// above that every power of two is split into 2^HISTOGRAM_SUB_BITS linear
+// buckets, so a bucket is never wider than ~3% of the values in it.
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_MAX_EXPONENT 40
+#define HISTOGRAM_NUM_BUCKETS ((HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BITS + 2) << HISTOGRAM_SUB_BITS)
+
+// A point in time copy of a Histogram, snapshots of several histograms (or of
+// one histogram over time) can be merged.
+class HistogramSnapshot {
+public:
+  HistogramSnapshot() : m_counts(HISTOGRAM_NUM_BUCKETS), m_count(0), m_sum(0), m_max(0) { }
+
+  uint64_t GetCount() const {
+    return this->m_count;
+  }
+
+  uint64_t GetSum() const {
+    return this->m_sum;
+  }
+
+  uint64_t GetMax() const {
+    return this->m_max;
+  }
+
+  // The (upper bound of the bucket holding the) value at quantile q in [0, 1].
+  uint64_t GetPercentile(double q) const;
+
+  // How many values recorded were at most value, to bucket precision.
+  uint64_t GetCountAtMost(uint64_t value) const;
+
+  void Merge(const HistogramSnapshot &other);
+
+private:
+  friend class Histogram;
+
+  std::vector<uint64_t> m_counts;
+  uint64_t m_count;
+  uint64_t m_sum;
+  uint64_t m_max;
+};
+
+// Records a distribution of values (usually latencies in microseconds)
+// without locking; Record is a couple of relaxed atomic adds.
+class Histogram {
+public:
+  Histogram(const Histogram&) = delete;
+
+  Histogram(const std::string& name)
+    : Histogram(name, MetricId(name)) { }
+
+  Histogram(const std::string& name, const MetricId& metric)
+    : m_name(name), m_metric(metric), m_sum(0), m_max(0) {
+    for (auto &c : this->m_counts) {
+      c.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void Record(uint64_t value) {
+    this->m_counts[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+    this->m_sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = this->m_max.load(std::memory_order_relaxed);
+    while (value > max && !this->m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) { }
+  }
+
+  // Records the microseconds elapsed since start.
+  void RecordSince(const std::chrono::steady_clock::time_point start) {
+    this->Record(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+
+  const std::string GetName() const {
+    return this->m_name;
+  }
+
+  const MetricId& GetMetric() const {
+    return this->m_metric;
+  }
+
+  HistogramSnapshot GetSnapshot() const;
+
+  static size_t GetBucket(uint64_t value);
+  // The largest value that lands in bucket.
+  static uint64_t GetBucketUpperBound(size_t bucket);
+
+private:
+  const std::string m_name;
+  const MetricId m_metric;
+  std::atomic<uint64_t> m_counts[HISTOGRAM_NUM_BUCKETS];
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_max;
+};
+
+// Records the time from construction to destruction into a histogram, which
+// can be swapped before the scope ends (ie once the outcome is known).
+class ScopedTimer {
+public:
+  ScopedTimer(Histogram *histogram)
+    : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) { }
+
+  ~ScopedTimer() {
+    if (this->m_histogram != nullptr) {
+      this->m_histogram->RecordSince(this->m_start);
+    }
+  }
+
+  void SetHistogram(Histogram *histogram) {
+    this->m_histogram = histogram;
+  }
+
+private:
+  Histogram *m_histogram;
+  std::chrono::steady_clock::time_point m_start;
+};
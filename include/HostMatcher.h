@@ -6,7 +6,10 @@
 #define EC2DNS_HOSTMATCHER_H
 
 #include "Ec2DnsClient.h"
+#include <cstring>
+
 #include <boost/regex.hpp>
+#include <boost/utility/string_ref.hpp>
 
 class HostMatcher {
 public:
@@ -14,16 +17,29 @@ public:
       : m_hostRegex(config.instance_regex)
     {  }
 
-    bool TryMatch(const std::string &host,
-        std::string *instanceId,
-        std::string *awsRegion) {
+    // Writes the instance id ("i-" followed by the instanceId group) into
+    // instanceId and points awsRegion into host.  Match state is kept per
+    // thread so a match doesn't allocate.
+    bool TryMatch(const boost::string_ref &host,
+        char *instanceId,
+        size_t instanceIdLen,
+        boost::string_ref *awsRegion) {
 
-      boost::smatch matches;
-      if (!boost::regex_match(host, matches, m_hostRegex)) {
+      static thread_local boost::cmatch matches;
+      if (!boost::regex_match(host.begin(), host.end(), matches, m_hostRegex)) {
+        return false;
+      }
+      const auto& id = matches["instanceId"];
+      const auto& region = matches["region"];
+      size_t idLen = id.second - id.first;
+      if (!id.matched || idLen == 0 || idLen + 3 > instanceIdLen) {
         return false;
       }
-      *instanceId = "i-" + static_cast<std::string>(matches["instanceId"]);
-      *awsRegion = static_cast<std::string>(matches["region"]);
+      instanceId[0] = 'i';
+      instanceId[1] = '-';
+      memcpy(instanceId + 2, id.first, idLen);
+      instanceId[idLen + 2] = '\0';
+      *awsRegion = boost::string_ref(region.first, region.second - region.first);
       return true;
     }
 
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+// How a stat is exported to /metrics: the metric family it belongs to and
+// the labels telling it apart from the family's other series, ie
+// {"cache_hits", {{"cache", "host"}}}.
+struct MetricId {
+  MetricId() { }
+
+  MetricId(const std::string& name, const MetricLabels& labels = MetricLabels())
+    : name(name), labels(labels) { }
+
+  std::string name;
+  MetricLabels labels;
+};
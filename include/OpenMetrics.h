@@ -0,0 +1,31 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Stats.h"
+
+#define OPENMETRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+#define OPENMETRICS_PREFIX "ec2dns_"
+
+// Renders a StatsReceiver in the OpenMetrics text format.  Stats sharing a
+// metric name are one family told apart by labels, counters are exported as
+// <family>_total and latency histograms (recorded in microseconds) as
+// <family>_seconds with cumulative buckets.  Output is handed to the sink a
+// family at a time so it can be streamed out without building the whole page.
+class OpenMetricsWriter {
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    static void Render(StatsReceiver &stats, const Sink &sink);
+
+    static std::string Render(StatsReceiver &stats) {
+      std::string out;
+      Render(stats, [&out](const std::string& chunk) { out += chunk; });
+      return out;
+    }
+
+    // Escapes \, " and newlines in a label value.
+    static std::string EscapeLabelValue(const std::string& value);
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ClientAddress.h"
+#include "Stats.h"
+
+// Capture files start with this, followed by records of
+//
+//   uint64_t timestamp_us   wall clock, host byte order
+//   uint8_t  flags          QUERY_LOG_SAME_ZONE
+//   uint8_t  addr_len       0, 4 or 16
+//   uint8_t  zone_len       0 if QUERY_LOG_SAME_ZONE
+//   uint8_t  name_len
+//   addr_len address bytes, network order
+//   zone_len zone bytes
+//   name_len name bytes
+#define QUERY_LOG_MAGIC "EC2DNSQ1"
+#define QUERY_LOG_MAGIC_SIZE 8
+#define QUERY_LOG_HEADER_SIZE 12
+// The zone is the same as the previous record's.
+#define QUERY_LOG_SAME_ZONE 0x01
+#define QUERY_LOG_MAX_RECORD_SIZE (QUERY_LOG_HEADER_SIZE + 16 + 255 + 255)
+
+// Appends sampled lookups to a capture file.  Records are copied into one
+// of two fixed buffers under a short lock and written out by a background
+// thread, a lookup never waits on the disk and never allocates.  Records
+// that arrive while both buffers are full, or once the file has reached
+// maxBytes, are dropped.
+class QueryLogWriter {
+public:
+    QueryLogWriter(const QueryLogWriter&) = delete;
+
+    QueryLogWriter(
+        const std::string& path,
+        size_t sampleEvery,
+        uint64_t maxBytes,
+        std::shared_ptr<StatsReceiver> statsReceiver,
+        size_t bufferBytes = 1 << 20);
+    ~QueryLogWriter();
+
+    bool IsOpen() const {
+      return this->m_file != nullptr;
+    }
+
+    bool ShouldSample() {
+      if (this->m_sampleEvery == 0) {
+        return false;
+      }
+      static thread_local size_t counter = 0;
+      return ++counter % this->m_sampleEvery == 0;
+    }
+
+    void Append(uint64_t timestampUs, const char *zone, const char *name, const ClientAddress& client);
+
+    // Writes out everything appended so far.
+    void Flush();
+
+private:
+    struct Buffer {
+      std::unique_ptr<char[]> data;
+      size_t used;
+    };
+
+    void _WriteLoop();
+    void _Write(Buffer *buffer);
+
+    FILE *m_file;
+    const size_t m_sampleEvery;
+    const uint64_t m_maxBytes;
+    const size_t m_bufferBytes;
+
+    std::mutex m_lock;
+    std::condition_variable m_cond;
+    Buffer m_current, m_spare;
+    // m_spare holds records waiting to be written.
+    bool m_pending;
+    bool m_stop;
+    bool m_full;
+    uint64_t m_bytes;
+    char m_lastZone[256];
+    std::thread m_writeThread;
+
+    std::shared_ptr<Stat> m_records, m_dropped;
+};
+
+struct QueryLogEntry {
+  uint64_t timestamp_us;
+  ClientAddress client;
+  std::string zone;
+  std::string name;
+};
+
+class QueryLogReader {
+public:
+    QueryLogReader(const QueryLogReader&) = delete;
+
+    QueryLogReader() : m_file(nullptr) { }
+    ~QueryLogReader();
+
+    // Fails if path can't be read or isn't a capture.
+    bool Open(const std::string& path);
+
+    // False at the end of the capture, or at a truncated last record.
+    bool Next(QueryLogEntry *entry);
+
+private:
+    FILE *m_file;
+    std::string m_lastZone;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ClientAddress.h"
+#include "Ec2DnsClient.h"
+
+#define QUERY_TRACE_NAME_SIZE 128
+
+// Where a dlz_lookup was answered from.
+enum class QueryPath : uint8_t {
+  Apex,
+  Wildcard,
+  Reverse,
+  Synthesized,
+  Autoscaler,
+  RegexMiss,
+  Forward
+};
+
+// Points in do_lookup a sampled trace records the elapsed time at.
+enum class QueryPhase : uint8_t {
+  Classified,
+  Resolved,
+  Answered,
+  Count
+};
+
+// A fixed size record of one query, so recording one never allocates.
+struct QueryTrace {
+  QueryTrace()
+    : sampled(false), path(QueryPath::Apex), outcome(LookupOutcome::Hit),
+      result(0), ttl(0), timestamp_us(0), total_us(0) {
+    zone[0] = name[0] = '\0';
+    for (auto &p : phase_us) {
+      p = 0;
+    }
+  }
+
+  // Fills in the trace of a lookup that began at start, copying (and
+  // truncating) zone and name.
+  void Begin(const char *zone, const char *name, bool sampled);
+
+  void Mark(QueryPhase phase) {
+    if (this->sampled) {
+      this->phase_us[(int)phase] = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - this->start).count();
+    }
+  }
+
+  bool sampled;
+  QueryPath path;
+  LookupOutcome outcome;
+  int32_t result;
+  uint32_t ttl;
+  uint64_t timestamp_us;
+  uint32_t total_us;
+  uint32_t phase_us[(int)QueryPhase::Count];
+  std::chrono::steady_clock::time_point start;
+  ClientAddress client;
+  char zone[QUERY_TRACE_NAME_SIZE];
+  char name[QUERY_TRACE_NAME_SIZE];
+};
+
+// Keeps a sample of recent query traces in a fixed ring, plus the slowest
+// queries seen whether sampled or not.  Writers never block: a trace that
+// lands on a slot being read (or written by a lapping writer) is dropped.
+class QueryTracer {
+public:
+    QueryTracer(const QueryTracer&) = delete;
+
+    // One in every sampleEvery lookups is traced, 0 disables sampling.
+    QueryTracer(size_t sampleEvery, size_t capacity, size_t numSlowest);
+
+    bool ShouldSample() {
+      if (this->m_sampleEvery == 0) {
+        return false;
+      }
+      static thread_local size_t counter = 0;
+      return ++counter % this->m_sampleEvery == 0;
+    }
+
+    // Only traces slower than the current slowest N need to be offered.
+    bool IsSlow(uint32_t totalUs) const {
+      return (int64_t)totalUs > this->m_slowThreshold.load(std::memory_order_relaxed);
+    }
+
+    void Record(const QueryTrace& trace);
+    void OfferSlow(const QueryTrace& trace);
+
+    // Recent traces newest first, and the slowest traces slowest first.
+    std::vector<QueryTrace> GetRecent();
+    std::vector<QueryTrace> GetSlowest();
+
+    uint64_t GetDropped() const {
+      return this->m_dropped.load(std::memory_order_relaxed);
+    }
+
+    std::string RenderJson();
+
+    static const char* GetPathName(QueryPath path);
+
+private:
+    struct Slot {
+      Slot() : seq(0) { lock.clear(); }
+
+      std::atomic_flag lock;
+      uint64_t seq;
+      QueryTrace trace;
+    };
+
+    const size_t m_sampleEvery;
+    const size_t m_numSlowest;
+    std::vector<Slot> m_slots;
+    std::atomic<uint64_t> m_next;
+    std::atomic<uint64_t> m_dropped;
+
+    std::mutex m_slowLock;
+    // Min-heap on total_us, so the fastest of the slowest is on top.  Until
+    // it fills up every trace is slow.
+    std::vector<QueryTrace> m_slowest;
+    std::atomic<int64_t> m_slowThreshold;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Histogram.h"
+
+struct RefreshPhaseProfile {
+  std::string name;
+  // Phases started inside another phase have a greater depth.
+  int depth;
+  uint64_t duration_us;
+  // Change in heap bytes in use over the phase.  This is process wide, so
+  // includes whatever lookups allocated meanwhile.
+  int64_t heap_delta_bytes;
+};
+
+struct RefreshProfile {
+  int64_t timestamp;
+  uint64_t duration_us;
+  bool success;
+  size_t instances;
+  uint64_t rss_before_bytes;
+  uint64_t rss_after_bytes;
+  uint64_t peak_rss_bytes;
+  int64_t heap_delta_bytes;
+  std::vector<RefreshPhaseProfile> phases;
+};
+
+// Profiles refresh cycles phase by phase, keeping the last historySize.
+// Cycles and phases are only begun and ended on the refresh thread.
+class RefreshProfiler {
+public:
+    RefreshProfiler(const RefreshProfiler&) = delete;
+
+    RefreshProfiler(size_t historySize)
+      : m_historySize(historySize), m_inCycle(false), m_depth(0) { }
+
+    void BeginCycle();
+    void EndCycle(bool success, size_t instances);
+
+    // Times the scope it lives in as a phase of the current cycle (if any),
+    // and records the duration into histogram if given.
+    class Phase {
+    public:
+        Phase(const Phase&) = delete;
+
+        Phase(RefreshProfiler *profiler, const char *name, Histogram *histogram = nullptr);
+        ~Phase();
+
+    private:
+        RefreshProfiler *m_profiler;
+        Histogram *m_histogram;
+        size_t m_index;
+        std::chrono::steady_clock::time_point m_start;
+        int64_t m_heapBefore;
+    };
+
+    // Oldest first.
+    std::vector<RefreshProfile> GetHistory();
+    std::string RenderJson();
+
+    static uint64_t GetRssBytes();
+    static uint64_t GetPeakRssBytes();
+    static int64_t GetHeapInUseBytes();
+
+private:
+    const size_t m_historySize;
+
+    // Only touched by the refresh thread.
+    RefreshProfile m_current;
+    bool m_inCycle;
+    int m_depth;
+    std::chrono::steady_clock::time_point m_cycleStart;
+    int64_t m_cycleHeapBefore;
+
+    std::deque<RefreshProfile> m_history;
+    std::mutex m_historyLock;
+};
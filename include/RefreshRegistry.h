@@ -0,0 +1,98 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Ec2DnsClient.h"
+#include "aws/core/Aws.h"
+
+// One refresh shared by every zone in the process that sees the same
+// instances.  The client of the first zone to join refreshes, and every
+// snapshot it takes is handed on to the other zones' clients, which name the
+// instances their own way and only call the API for misses.  Outlives the
+// zone that started it while other zones remain.
+class RefreshEngine {
+public:
+  RefreshEngine(const RefreshEngine&) = delete;
+
+  // Launches owner's refresh thread, which must not be running yet.
+  RefreshEngine(uint32_t id, std::shared_ptr<Ec2DnsClient> owner);
+  ~RefreshEngine();
+
+  uint32_t GetId() const {
+    return this->m_id;
+  }
+
+  // The client that refreshes.
+  const std::shared_ptr<Ec2DnsClient>& GetOwner() const {
+    return this->m_owner;
+  }
+
+  // client takes up the current snapshot now, and each one after until
+  // it leaves.  Its refresh thread must not be running.
+  void Join(Ec2DnsClient *client);
+  // Stops handing snapshots to client, and for the owner, stops calling the
+  // snapshot listener it had when it joined.
+  void Leave(Ec2DnsClient *client);
+
+  size_t GetNumZones();
+
+  Aws::Utils::Json::JsonValue ToJson();
+
+private:
+  void _OnSnapshot(const ZoneSnapshotPtr& snapshot);
+
+  const uint32_t m_id;
+  std::shared_ptr<Ec2DnsClient> m_owner;
+  std::mutex m_zonesLock;
+  Ec2DnsClient::SnapshotListener m_ownerListener;
+  bool m_ownerJoined;
+  std::vector<Ec2DnsClient*> m_followers;
+};
+
+// Hands out the process's refresh engines, keyed by GetKey.
+class RefreshRegistry {
+public:
+  RefreshRegistry() : m_nextId(1) { }
+
+  static RefreshRegistry& Get();
+
+  // The settings that decide which instances a refresh sees.
+  static std::string GetKey(const Ec2DnsConfig& config);
+
+  // Joins client to the engine for its config, making it the owner of a new
+  // one if there's none.  The engine lasts as long as anything holds it.
+  std::shared_ptr<RefreshEngine> Join(const std::shared_ptr<Ec2DnsClient>& client);
+
+  std::vector<std::shared_ptr<RefreshEngine>> GetEngines();
+
+private:
+  std::mutex m_lock;
+  std::map<std::string, std::weak_ptr<RefreshEngine>> m_engines;
+  uint32_t m_nextId;
+};
+
+// Keeps the AWS SDK and its logging set up while any zone in the process
+// uses them.  The first zone's options and log file are the ones they run
+// with, until the last zone releases them.
+class SdkLifetime {
+public:
+  SdkLifetime() : m_users(0) { }
+
+  static SdkLifetime& Get();
+
+  // Sets the SDK up for the first user.
+  void Acquire(const Aws::SDKOptions& options, const std::string& logPath);
+  // Shuts the SDK down after the last user.
+  void Release();
+
+  size_t GetNumUsers();
+
+private:
+  std::mutex m_lock;
+  size_t m_users;
+  Aws::SDKOptions m_options;
+};
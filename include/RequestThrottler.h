@@ -7,13 +7,20 @@
 #include <unordered_set>
 
 #include "CacheEntry.h"
+#include "ClientAddress.h"
+#include "TimedMutex.h"
 
 class RequestThrottler {
 public:
-    bool IsRequestThrottled(const std::string& clientAddr, const std::string& key);
-    void OnMiss(const std::string &key, const std::string &clientAddr);
+    bool IsRequestThrottled(const ClientAddress& clientAddr, const std::string& key);
+    void OnMiss(const std::string &key);
     void Trim();
+
+    const TimedMutex& GetMutex() const {
+      return this->m_cacheLock;
+    }
 private:
-    std::mutex m_cacheLock;
-    std::unordered_map<std::string, CacheEntry<std::string>> m_cache;
+    TimedMutex m_cacheLock;
+    // Keyed by lookup key, holding the address the key names if it's an IP.
+    std::unordered_map<std::string, CacheEntry<ClientAddress>> m_cache;
 };
\ No newline at end of file
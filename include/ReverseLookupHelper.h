@@ -1,20 +1,47 @@
 #pragma once
 
 #include <string>
-#include <unordered_set>
+#include <vector>
 
 #include "Ec2DnsClient.h"
 
+// An IPv4 network in host byte order.
+struct Ipv4Cidr {
+  uint32_t network;
+  uint32_t mask;
+
+  bool Contains(uint32_t ip) const {
+    return (ip & this->mask) == this->network;
+  }
+
+  bool Overlaps(uint32_t network, uint32_t mask) const {
+    uint32_t common = this->mask & mask;
+    return (this->network & common) == (network & common);
+  }
+
+  static bool TryParse(const std::string& cidr, Ipv4Cidr *result);
+};
+
 class ReverseLookupHelper {
 public:
   ReverseLookupHelper(std::shared_ptr<Ec2DnsClient> dnsClient)
     : m_dnsClient(dnsClient) { }
 
+  // Accepts one or more comma separated CIDRs, e.g. "10.0.0.0/16,10.1.0.0/26".
   bool InitializeReverseLookupZones(const std::string& vpcCidr);
-  bool IsReverseLookupZone(const std::string& zone);
-  bool DoReverseLookup(const std::string& zone, const std::string& name, const std::string &clientAddr, std::string *hostname);
+  bool IsReverseLookupZone(const std::string& zone) const;
+  bool IsReverseLookupZone(const char *zone, size_t len) const;
+  bool IsInVpc(uint32_t ip) const;
+  const std::vector<std::string> GetReverseLookupZones() const;
+  bool DoReverseLookup(
+      const char *zone, const char *name, const ClientAddress &clientAddr,
+      char *hostname, size_t len, ResolveInfo *info = nullptr);
+
+  // Parses the (reversed) octets preceding ".in-addr.arpa" in name into a
+  // host order address.  numOctets receives how many octets were present.
+  static bool TryParseReverseName(const char *name, size_t len, uint32_t *addr, size_t *numOctets);
 
 private:
   std::shared_ptr<Ec2DnsClient> m_dnsClient;
-  std::unordered_set<std::string> m_rlZones;
-};
\ No newline at end of file
+  std::vector<Ipv4Cidr> m_cidrs;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "aws/core/utils/memory/MemorySystemInterface.h"
+
+// Blocks are rounded up to a power of two from 32 to 4096 bytes, header
+// included, and recycled through per-thread free lists.  Larger blocks come
+// straight from malloc.
+#define SDK_MEMORY_NUM_CLASSES 8
+#define SDK_MEMORY_MIN_CLASS_SHIFT 5
+// Each thread keeps at most this many bytes of free blocks per class.
+#define SDK_MEMORY_MAX_CACHED_BYTES (256 << 10)
+// Arenas grow in chunks of this size and serve blocks up to a quarter of it.
+// Up to SDK_MEMORY_SPARE_CHUNKS released chunks are kept for the next arena.
+#define SDK_MEMORY_ARENA_CHUNK_SIZE (256 << 10)
+#define SDK_MEMORY_SPARE_CHUNKS 8
+// Threads count into their own counters, and add them to the system's once
+// they've allocated or freed this many bytes, and when they exit.
+#define SDK_MEMORY_FLUSH_BYTES (64 << 10)
+
+// Other threads' counts may trail by up to SDK_MEMORY_FLUSH_BYTES each, and
+// peak_bytes is sampled as counts are flushed.
+struct SdkMemoryStats {
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+  uint64_t live_bytes;
+  uint64_t peak_bytes;
+  // Allocations served from a thread's free list rather than malloc.
+  uint64_t pool_hits;
+  uint64_t arena_allocations;
+  // Held in arena chunks, spares included.
+  uint64_t arena_chunk_bytes;
+};
+
+// The memory system ec2dns installs into the AWS SDK, so the object graphs
+// a refresh builds and tears down stay out of the host process's heap
+// locks.  Small blocks are recycled through thread local free lists.  While
+// an ArenaScope is alive on a thread, that thread's small blocks are bumped
+// out of the scope's chunks instead.  Each chunk is released once the scope
+// has moved past it and every block in it has been freed.
+class SdkMemorySystem : public Aws::Utils::Memory::MemorySystemInterface {
+public:
+    SdkMemorySystem(const SdkMemorySystem&) = delete;
+
+    SdkMemorySystem();
+    ~SdkMemorySystem();
+
+    void Begin() override { }
+    void End() override { }
+    void* AllocateMemory(std::size_t blockSize, std::size_t alignment, const char *allocationTag = nullptr) override;
+    void FreeMemory(void* memoryPtr) override;
+
+    SdkMemoryStats GetStats();
+    std::string RenderJson();
+
+    // The SDK's memory system, if it's one of these.
+    static SdkMemorySystem* GetInstalled();
+
+    struct Arena;
+    struct Chunk;
+    struct ThreadCounts;
+    struct ThreadState;
+
+    // Hands a thread's counts to their system as it exits.
+    static void ThreadExit(ThreadCounts *counts);
+
+    class ArenaScope {
+    public:
+        ArenaScope(const ArenaScope&) = delete;
+
+        // A null system makes this a no-op.
+        ArenaScope(SdkMemorySystem *system);
+        ~ArenaScope();
+
+    private:
+        Arena *m_arena;
+        Arena *m_previous;
+    };
+
+private:
+    void* _AllocateFromArena(Arena *arena, size_t size);
+    void _CloseChunk(Chunk *chunk);
+    void _ReleaseChunk(Chunk *chunk);
+    ThreadCounts& _GetThreadCounts(ThreadState *state);
+    void _Flush(ThreadCounts *counts);
+    static void _FlushIfAlive(ThreadCounts *counts);
+
+    const uint64_t m_id;
+
+    std::atomic<uint64_t> m_allocations;
+    std::atomic<uint64_t> m_allocatedBytes;
+    std::atomic<uint64_t> m_freedBytes;
+    std::atomic<uint64_t> m_poolHits;
+    std::atomic<uint64_t> m_arenaAllocations;
+    std::atomic<uint64_t> m_peakBytes;
+    std::atomic<uint64_t> m_arenaChunkBytes;
+
+    std::mutex m_spareChunksLock;
+    void *m_spareChunks[SDK_MEMORY_SPARE_CHUNKS];
+    size_t m_numSpareChunks;
+};
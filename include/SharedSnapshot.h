@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Stats.h"
+#include "ZoneSnapshot.h"
+
+// Changes whenever the layout of a published generation does, so processes
+// running different builds ignore each other's generations.
+#define SHARED_SNAPSHOT_MAGIC "ec2dns02"
+#define SHARED_SNAPSHOT_MAGIC_SIZE 8
+// Where lock files go by default, a directory only the service's user can
+// write to, like systemd's RuntimeDirectory=ec2dns.
+#define SHARED_SNAPSHOT_LOCK_DIR "/run/ec2dns/"
+
+struct SharedSnapshotGeneration {
+  SharedSnapshotGeneration() : generation(0), taken(0), next_refresh(0) { }
+
+  ZoneSnapshotPtr snapshot;
+  uint64_t generation;
+  // When the publisher took the snapshot and when its next refresh is due,
+  // in steady_clock ticks, which every process on the host shares.
+  int64_t taken;
+  int64_t next_refresh;
+};
+
+// Lets the resolvers on a host share one refresh.  Whichever process holds
+// the lock file publishes each snapshot as a new generation: a POSIX shared
+// memory object named <name>.<generation>, written once and never changed,
+// with everything in it addressed by offset so it maps anywhere.  A small
+// control object, <name>, holds the latest generation, which the others
+// poll and map read only.  A mapped generation stays valid after it's been
+// superseded and unlinked, until the last snapshot using it is released.
+// Everything is created readable by this user only, and objects or lock
+// files some other user created are refused.
+//
+// Belongs to the refresh thread.
+class SharedSnapshot {
+public:
+  SharedSnapshot(const SharedSnapshot&) = delete;
+
+  SharedSnapshot(const std::string& name, const std::string& lockPath, std::shared_ptr<StatsReceiver> statsReceiver);
+  ~SharedSnapshot();
+
+  // Takes the lock file unless another process holds it.  Once taken, this
+  // publishes until it's destroyed, and another process takes over when
+  // this one exits.
+  bool TryLead();
+
+  bool IsLeader() const {
+    return this->m_leader;
+  }
+
+  // Publishes snapshot as the next generation, leader only.
+  bool Publish(const ZoneSnapshot& snapshot, int64_t taken, int64_t nextRefresh);
+
+  // The latest generation published, 0 before the first.
+  uint64_t GetGeneration();
+
+  // Maps the latest generation, its snapshot names instances with format.
+  bool Load(const HostnameFormat& format, SharedSnapshotGeneration *loaded);
+
+  // Where the shared memory object for generation lives.
+  std::string GetGenerationPath(uint64_t generation) const;
+
+  struct Control;
+
+private:
+  bool _MapControl(bool writable);
+  void _UnmapControl();
+
+  std::string m_path;
+  std::string m_lockPath;
+  int m_lockFd;
+  bool m_leader;
+  Control *m_control;
+  bool m_controlWritable;
+
+  std::shared_ptr<Stat> m_publishes, m_loads, m_failures, m_bytes;
+};
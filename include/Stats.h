@@ -1,71 +1,157 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 
+#include "Histogram.h"
+#include "MetricId.h"
+#include "TimedMutex.h"
 #include "server_http.hpp"
 #include "aws/core/utils/json/JsonSerializer.h"
 
 using namespace std::placeholders;
 
+// Counters are striped over this many slots, each thread increments its own.
+#define STAT_NUM_SLOTS 32
+// Slots are spaced this far apart so no two ever share a cache line, even
+// without over-aligned allocation.
+#define STAT_SLOT_SIZE 128
+
 class Stat {
 public:
     Stat(const Stat&) = delete;
 
     Stat(const std::string& name)
-        : m_name(name) {
+        : Stat(name, MetricId(name)) { }
+
+    Stat(const std::string& name, const MetricId& metric)
+        : m_name(name), m_metric(metric) {
+      for (auto &slot : this->m_slots) {
+        slot.value.store(0, std::memory_order_relaxed);
+      }
     }
 
     inline void Increment(const uint64_t amount=1) {
-      m_value += amount;
+      this->m_slots[GetThreadSlot()].value.fetch_add(amount, std::memory_order_relaxed);
     }
 
     const std::string GetName() {
       return this->m_name;
     }
 
+    const MetricId& GetMetric() const {
+      return this->m_metric;
+    }
+
+    // Sums the slots, only called when stats are rendered.
     const uint64_t GetValue() {
-      return this->m_value;
+      uint64_t value = 0;
+      for (const auto &slot : this->m_slots) {
+        value += slot.value.load(std::memory_order_relaxed);
+      }
+      return value;
     }
+
+    // Threads are handed slots round robin the first time they count.
+    static size_t GetThreadSlot() {
+      static std::atomic<size_t> nextSlot(0);
+      static thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % STAT_NUM_SLOTS;
+      return slot;
+    }
+
 private:
+    struct Slot {
+      std::atomic<uint64_t> value;
+      char padding[STAT_SLOT_SIZE - sizeof(std::atomic<uint64_t>)];
+    };
+
     const std::string m_name;
-    std::atomic_uint_fast64_t m_value;
+    const MetricId m_metric;
+    Slot m_slots[STAT_NUM_SLOTS];
 };
 
 class StatsReceiver {
 public:
   const std::vector<std::shared_ptr<Stat>> GetAllStats();
+  // Stats are named for /stats, metric (when given) says how the stat is
+  // exported to /metrics, by default it's exported under its name.
   std::shared_ptr<Stat> Create(const std::string& name);
+  std::shared_ptr<Stat> Create(const std::string& name, const MetricId& metric);
+
+  const std::vector<std::shared_ptr<Histogram>> GetAllHistograms();
+  std::shared_ptr<Histogram> CreateHistogram(const std::string& name);
+  std::shared_ptr<Histogram> CreateHistogram(const std::string& name, const MetricId& metric);
+
+  const TimedMutex& GetMutex() const {
+    return this->m_statsLock;
+  }
 
 private:
   std::vector<std::shared_ptr<Stat>> m_stats;
-  std::mutex m_statsLock;
+  std::vector<std::shared_ptr<Histogram>> m_histograms;
+  TimedMutex m_statsLock;
 };
 
+// Serves the stats of every DLZ instance mounted on it, each under
+// /instances/<name>/, with /instances listing them.  The instance mounted
+// longest is served at the root as well.
 class StatsServer {
 public:
     StatsServer(const StatsServer&) = delete;
 
     typedef SimpleWeb::Server<SimpleWeb::HTTP> HttpServer;
 
-    StatsServer(unsigned short port, const std::shared_ptr<StatsReceiver> statsReceiver)
-      : m_stats(statsReceiver) {
-      m_server = std::unique_ptr<HttpServer>(new HttpServer(port, 4));
-      m_server->resource["^/stats$"]["GET"] = std::bind(&StatsServer::_RenderStats, this, _1, _2);
-    }
+    StatsServer(unsigned short port, const std::string& address, size_t numThreads);
 
-    ~StatsServer() {
-      this->Stop();
-    }
+    ~StatsServer();
+
+    // The running server on port and address, started if there's none.  It
+    // stops when the last instance using it lets go.
+    static std::shared_ptr<StatsServer> Acquire(unsigned short port, const std::string& address, size_t numThreads);
 
     void Start();
     void Stop();
 
+    // Serves stats under name, or if it's taken, a name made from it, which
+    // is returned.  describe adds to its entry in /instances.
+    std::string Mount(
+        const std::string& name,
+        std::shared_ptr<StatsReceiver> stats,
+        std::function<Aws::Utils::Json::JsonValue()> describe);
+    // Waits for requests to the mount to finish.
+    void Unmount(const std::string& name);
+
+    // Serves the JSON returned by render at path (ie "/debug/traces") under
+    // the mount.
+    void AddJsonResource(const std::string& name, const std::string& path, std::function<std::string()> render);
+    // As AddJsonResource, but run for a POST to path.
+    void AddJsonAction(const std::string& name, const std::string& path, std::function<std::string()> run);
+
 private:
+    struct Instance {
+      std::string name;
+      std::shared_ptr<StatsReceiver> stats;
+      std::function<Aws::Utils::Json::JsonValue()> describe;
+      std::map<std::string, std::function<std::string()>> resources;
+      std::map<std::string, std::function<std::string()>> actions;
+    };
+
     void _StartSync();
-    void _RenderStats(HttpServer::Response& response, std::shared_ptr<HttpServer::Request> request);
+    // Answers for path under the mount named name, the oldest if empty.
+    void _Serve(const std::string& name, const std::string& path, bool post, HttpServer::Response& response);
+    void _RenderInstances(HttpServer::Response& response);
+    static void _RenderStats(StatsReceiver& stats, HttpServer::Response& response);
+    static void _RenderMetrics(StatsReceiver& stats, HttpServer::Response& response);
+    Instance* _FindInstance(const std::string& name);
 
     std::thread m_serverThread;
     std::unique_ptr<HttpServer> m_server;
-    std::shared_ptr<StatsReceiver> m_stats;
+    std::mutex m_stopLock;
+    bool m_stopped;
+    std::mutex m_instancesLock;
+    // In the order mounted.
+    std::vector<Instance> m_instances;
 };
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// A std::mutex that keeps track of how long threads waited for it.  An
+// uncontended lock is a single try_lock, the clock is only read when a
+// thread actually has to wait.
+class TimedMutex {
+public:
+    TimedMutex(const TimedMutex&) = delete;
+
+    TimedMutex() : m_contended(0), m_waitNs(0) { }
+
+    void lock() {
+      if (this->m_mutex.try_lock()) {
+        return;
+      }
+      auto start = std::chrono::steady_clock::now();
+      this->m_mutex.lock();
+      auto waited = std::chrono::steady_clock::now() - start;
+      this->m_contended.fetch_add(1, std::memory_order_relaxed);
+      this->m_waitNs.fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(), std::memory_order_relaxed);
+    }
+
+    bool try_lock() {
+      return this->m_mutex.try_lock();
+    }
+
+    void unlock() {
+      this->m_mutex.unlock();
+    }
+
+    // How many lock() calls had to wait, and for how long in total.
+    uint64_t GetContended() const {
+      return this->m_contended.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetWaitNs() const {
+      return this->m_waitNs.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::atomic<uint64_t> m_contended;
+    std::atomic<uint64_t> m_waitNs;
+};
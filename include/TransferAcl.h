@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ClientAddress.h"
+#include "ReverseLookupHelper.h"
+
+// The clients allowed to transfer our zones.  Empty denies everyone.
+class TransferAcl {
+public:
+  // Accepts comma separated IPv4 CIDRs and IPv4/IPv6 addresses, e.g.
+  // "10.0.0.0/16,192.168.1.5,fd00::53".
+  bool TryParse(const std::string& acl);
+
+  bool IsAllowed(const ClientAddress &client) const;
+  bool IsAllowed(const char *client) const;
+
+private:
+  std::vector<Ipv4Cidr> m_networks;
+  std::vector<ClientAddress> m_addresses;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Turns how long a record has gone unchanged into the TTL we answer with.
+// Records that have been stable for longer get longer TTLs, within bounds.
+struct TtlPolicy {
+  TtlPolicy(uint32_t minTtl, uint32_t maxTtl, uint32_t stablePercent)
+    : min_ttl(minTtl), max_ttl(maxTtl), stable_percent(stablePercent) { }
+
+  uint32_t min_ttl;
+  uint32_t max_ttl;
+  // The TTL is this percentage of the time the record has been stable.
+  uint32_t stable_percent;
+
+  // floorSec raises the TTL before clamping, ie to the time left until the
+  // data could next change.
+  bool operator==(const TtlPolicy& other) const {
+    return this->min_ttl == other.min_ttl
+        && this->max_ttl == other.max_ttl
+        && this->stable_percent == other.stable_percent;
+  }
+
+  bool operator!=(const TtlPolicy& other) const {
+    return !(*this == other);
+  }
+
+  uint32_t GetTtl(uint64_t stableSec, uint64_t floorSec = 0) const {
+    uint64_t ttl = std::max(stableSec * this->stable_percent / 100, floorSec);
+    ttl = std::max(ttl, (uint64_t)this->min_ttl);
+    return (uint32_t)std::min(ttl, (uint64_t)std::max(this->max_ttl, this->min_ttl));
+  }
+};
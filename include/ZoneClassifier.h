@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "ReverseLookupHelper.h"
+
+enum class ZoneKind {
+  Unknown,
+  Forward,
+  Autoscaler,
+  Reverse
+};
+
+// Decides which of our zones (if any) a name belongs to in a single pass over
+// the name, without allocating.
+class ZoneClassifier {
+public:
+  ZoneClassifier(const std::string& zoneName, std::shared_ptr<ReverseLookupHelper> rlHelper);
+
+  ZoneKind Classify(const char *zone) const;
+  ZoneKind Classify(const char *zone, size_t len) const;
+
+  const std::string& GetZoneName() const {
+    return this->m_zoneName;
+  }
+
+  const std::string& GetAutoscalerZoneName() const {
+    return this->m_autoscalerZoneName;
+  }
+
+private:
+  std::string m_zoneName;
+  std::string m_autoscalerZoneName;
+  std::shared_ptr<ReverseLookupHelper> m_rlHelper;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Stats.h"
+#include "ZoneRecords.h"
+#include "ZoneSnapshot.h"
+
+// Exports snapshots as RFC 1035 zone files, one per zone, for resolvers that
+// can't load the plugin.  Each file is written to a temporary file and
+// renamed into place, so readers never see a partial zone.
+class ZoneFileWriter {
+public:
+  ZoneFileWriter(
+      const std::string& directory,
+      const std::string& zoneName,
+      const std::vector<std::string>& reverseZones,
+      std::shared_ptr<ZoneRecords> records,
+      std::shared_ptr<StatsReceiver> statsReceiver);
+
+  // Writes the zones whose records changed since the last successful write,
+  // with the TTLs they have now.
+  void Write(const ZoneSnapshot &snapshot, const RecordTtls &ttls);
+
+  const std::string GetPath(const std::string &zone) const;
+
+private:
+  struct ExportedZone {
+    std::string name;
+    ZoneKind kind;
+    bool written;
+    // ZoneRecords::Digest of the records last written.
+    uint64_t digest;
+  };
+
+  bool _WriteZone(const ExportedZone &zone, const ZoneSnapshot &snapshot, const RecordTtls &ttls, size_t *bytes);
+
+  std::string m_directory;
+  std::vector<ExportedZone> m_zones;
+  std::shared_ptr<ZoneRecords> m_records;
+  std::shared_ptr<Stat> m_writes, m_skipped, m_failures, m_bytes, m_writeMs;
+};
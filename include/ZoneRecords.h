@@ -0,0 +1,80 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ReverseLookupHelper.h"
+#include "TtlPolicy.h"
+#include "ZoneClassifier.h"
+#include "ZoneSnapshot.h"
+
+// Room for the SOA rdata, two names plus the numeric fields.
+#define SOA_BUFFER_SIZE (2 * DNS_NAME_BUFFER_SIZE + 64)
+
+// The TTLs of a snapshot's records at one moment, from the host TTL policy.
+// ASG records carry their own.
+struct RecordTtls {
+  // Times are whole seconds of steady_clock, as in ZoneSnapshot.
+  RecordTtls(const TtlPolicy& hostTtl, int64_t nowSec, int64_t nextRefreshSec)
+    : host_ttl(hostTtl), now_sec(nowSec), until_refresh(std::max(nextRefreshSec - nowSec, (int64_t)0)) { }
+
+  TtlPolicy host_ttl;
+  int64_t now_sec;
+  int64_t until_refresh;
+
+  // The SOA changes with every refresh, so the apex isn't stable at all.
+  uint32_t GetApexTtl() const {
+    return this->host_ttl.GetTtl(0, (uint64_t)this->until_refresh);
+  }
+
+  // stableSinceSec is 0 where it isn't known.
+  uint32_t GetHostTtl(uint32_t stableSinceSec) const {
+    int64_t stable = stableSinceSec == 0 ? 0 : std::max(this->now_sec - (int64_t)stableSinceSec, (int64_t)0);
+    return this->host_ttl.GetTtl((uint64_t)stable, (uint64_t)this->until_refresh);
+  }
+};
+
+// Renders the records of our zones from a snapshot, shared by zone transfers
+// and zone file exports.
+class ZoneRecords {
+public:
+  // Receives the owner name (relative to the zone, "@" for the apex), TTL,
+  // type and rdata of a record, returning false to stop.
+  typedef std::function<bool(const char *name, uint32_t ttl, const char *type, const char *data)> Emitter;
+
+  ZoneRecords(
+      const std::string& zoneName,
+      const std::vector<std::string>& nameservers,
+      std::shared_ptr<ReverseLookupHelper> rlHelper);
+
+  const std::vector<std::string>& GetNameservers() const {
+    return this->m_nameservers;
+  }
+
+  // Formats the apex SOA rdata for serial into buf, returning buf.
+  const char* FormatSoa(uint32_t serial, char *buf, size_t len) const;
+
+  // Whether zone, of kind zoneKind, is one whose records we can list.
+  bool IsListable(ZoneKind zoneKind, const char *zone) const;
+
+  // Emits every record of zone (of kind zoneKind) in snapshot, apex first.
+  // Returns false, having emitted nothing, if zone isn't listable, and false
+  // if emit stopped early.
+  bool ForEach(
+      const ZoneSnapshot &snapshot, ZoneKind zoneKind, const char *zone, const RecordTtls &ttls,
+      const Emitter &emit) const;
+
+  // A digest of zone's records in snapshot, not counting the serial or
+  // TTLs, so that what changed between snapshots can be told without
+  // keeping them.
+  uint64_t Digest(const ZoneSnapshot &snapshot, ZoneKind zoneKind, const char *zone) const;
+
+private:
+  bool _TryGetReverseNetwork(const char *zone, uint32_t *network) const;
+
+  std::string m_zoneName;
+  std::vector<std::string> m_nameservers;
+  std::shared_ptr<ReverseLookupHelper> m_rlHelper;
+};
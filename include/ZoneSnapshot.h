@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "AsgMembers.h"
+
+// The instance had a private IPv4 address.
+#define SNAPSHOT_INSTANCE_HAS_IPV4 0x01
+
+// Big enough for any hostname, dotted address or instance ID rendered from a
+// snapshot, including the terminator.
+#define SNAPSHOT_HOSTNAME_BUFFER_SIZE 256
+#define SNAPSHOT_IP_BUFFER_SIZE 16
+#define SNAPSHOT_ID_BUFFER_SIZE 20
+
+// EC2 instance IDs are "i-" followed by 8 or 17 hex digits.
+#define SNAPSHOT_MAX_ID_DIGITS 17
+
+// A fixed size record per instance, names are rendered from it on demand.
+struct SnapshotInstance {
+  // The hex digits of the instance ID after "i-": the last 16 in id, a 17th
+  // in idHigh, and how many there were so leading zeros survive.
+  uint64_t id;
+  // The private IPv4 address in host byte order, 0 without one.
+  uint32_t ipv4;
+  uint8_t idHigh;
+  uint8_t idDigits;
+  // Index into the snapshot's availability zones.
+  uint8_t zone;
+  // SNAPSHOT_INSTANCE_*
+  uint8_t flags;
+
+  // Sets id, idHigh and idDigits.  Fails unless instanceId is "i-" followed
+  // by 1 to SNAPSHOT_MAX_ID_DIGITS hex digits.
+  bool TrySetId(const boost::string_ref& instanceId);
+
+  // Writes the hex digits of the ID, without "i-" or a terminator, and
+  // returns how many there were.
+  size_t FormatIdDigits(char *buf) const;
+};
+
+// Spells instance hostnames <region code><AZ letter>-<account>-<ID digits>,
+// in zone.
+class HostnameFormat {
+public:
+  HostnameFormat(const std::string& regionCode, const std::string& account, const std::string& zone);
+
+  // Writes the hostname into buf, which holds len bytes, fully qualified with
+  // the trailing dot or as just the first label.  Returns buf, or nullptr if
+  // it didn't fit.
+  const char* Format(
+      char zoneLetter, const char *idDigits, size_t idLen, bool qualified, char *buf, size_t len) const;
+
+private:
+  std::string m_regionCode;
+  std::string m_account;
+  std::string m_zone;
+};
+
+// A snapshot's instances, which may live in memory it doesn't own.
+class SnapshotInstances {
+public:
+  SnapshotInstances(const SnapshotInstance *instances, size_t size)
+    : m_instances(instances), m_size(size) { }
+
+  const SnapshotInstance* begin() const {
+    return this->m_instances;
+  }
+
+  const SnapshotInstance* end() const {
+    return this->m_instances + this->m_size;
+  }
+
+  size_t size() const {
+    return this->m_size;
+  }
+
+  bool empty() const {
+    return this->m_size == 0;
+  }
+
+  const SnapshotInstance& operator[](size_t i) const {
+    return this->m_instances[i];
+  }
+
+private:
+  const SnapshotInstance *m_instances;
+  size_t m_size;
+};
+
+// Everything a single refresh learned about the account, immutable once
+// built.  Zone transfers are served from a snapshot so they see one
+// consistent generation of the data.
+class ZoneSnapshot {
+public:
+  typedef const SnapshotInstance* InstanceIterator;
+  typedef std::map<std::string, AsgMembersPtr> AutoscalingGroups;
+
+  // SnapshotInstance::zone indexes zones.  stableSince, if given, holds
+  // when each instance took on its address, in whole seconds of
+  // steady_clock.
+  ZoneSnapshot(
+      uint32_t serial,
+      std::vector<SnapshotInstance> instances,
+      std::vector<std::string> zones,
+      HostnameFormat format,
+      AutoscalingGroups groups,
+      std::vector<uint32_t> stableSince = std::vector<uint32_t>());
+
+  // Serves numInstances instances already sorted by GetInstances(), the
+  // order of GetIdIndex() and GetStableSince() from memory kept alive by
+  // storage.
+  ZoneSnapshot(
+      uint32_t serial,
+      std::shared_ptr<const void> storage,
+      const SnapshotInstance *instances,
+      const uint32_t *idIndex,
+      const uint32_t *stableSince,
+      size_t numInstances,
+      std::vector<std::string> zones,
+      HostnameFormat format,
+      AutoscalingGroups groups);
+
+  uint32_t GetSerial() const {
+    return this->m_serial;
+  }
+
+  // Sorted by IPv4 address, then ID.
+  SnapshotInstances GetInstances() const {
+    return SnapshotInstances(this->m_instances, this->m_numInstances);
+  }
+
+  // Indices into GetInstances() in order of instance ID.
+  const uint32_t* GetIdIndex() const {
+    return this->m_idIndex;
+  }
+
+  // Parallel to GetInstances(), 0 where it wasn't known.
+  const uint32_t* GetStableSince() const {
+    return this->m_stableSince;
+  }
+
+  const std::vector<std::string>& GetZones() const {
+    return this->m_zones;
+  }
+
+  // Keyed (and so ordered) by DNS alias.
+  const AutoscalingGroups& GetAutoscalingGroups() const {
+    return this->m_groups;
+  }
+
+  // The same data named with format instead, sharing this one's memory.
+  std::shared_ptr<const ZoneSnapshot> WithFormat(const HostnameFormat& format) const;
+
+  // The instances whose address is in network/mask (host byte order).
+  std::pair<InstanceIterator, InstanceIterator> GetInstancesInNetwork(uint32_t network, uint32_t mask) const;
+
+  // The instance with id's ID, or the first with address ip (host byte
+  // order), null if there isn't one.
+  const SnapshotInstance* FindById(const SnapshotInstance& id) const;
+  const SnapshotInstance* FindByIp(uint32_t ip) const;
+
+  // These write into buf, which holds len bytes, and return buf, or nullptr
+  // if it didn't fit.
+  const char* FormatHostname(const SnapshotInstance& instance, bool qualified, char *buf, size_t len) const;
+  static const char* FormatInstanceId(const SnapshotInstance& instance, char *buf, size_t len);
+  static const char* FormatIp(const SnapshotInstance& instance, char *buf, size_t len);
+
+  // Returns a serial greater than previous, following the wall clock when it
+  // is ahead so serials keep increasing across restarts.
+  static uint32_t NextSerial(uint32_t previous);
+
+private:
+  uint32_t m_serial;
+  std::shared_ptr<const void> m_storage;
+  const SnapshotInstance *m_instances;
+  const uint32_t *m_idIndex;
+  const uint32_t *m_stableSince;
+  size_t m_numInstances;
+  std::vector<std::string> m_zones;
+  HostnameFormat m_format;
+  AutoscalingGroups m_groups;
+};
+
+typedef std::shared_ptr<const ZoneSnapshot> ZoneSnapshotPtr;
@@ -0,0 +1,73 @@
+#include "ApiTelemetry.h"
+
+ApiCallStats::ApiCallStats(
+    const std::string& api,
+    ApiCaller caller,
+    const std::shared_ptr<StatsReceiver>& statsReceiver)
+  : m_api(api),
+    m_caller(caller),
+    m_statsReceiver(statsReceiver) {
+  this->m_latency = statsReceiver->CreateHistogram(this->_GetStatName("us"), this->_GetMetricId("api_duration"));
+  this->m_calls = statsReceiver->Create(this->_GetStatName("calls"), this->_GetMetricId("api_calls"));
+  this->m_failedCalls = statsReceiver->Create(this->_GetStatName("failed_calls"), this->_GetMetricId("api_failed_calls"));
+  this->m_pages = statsReceiver->Create(this->_GetStatName("pages"), this->_GetMetricId("api_pages"));
+  this->m_items = statsReceiver->Create(this->_GetStatName("items"), this->_GetMetricId("api_items"));
+  this->m_retryableErrors = statsReceiver->Create(
+      this->_GetStatName("retryable_errors"), this->_GetMetricId("api_retryable_errors"));
+}
+
+const char* ApiCallStats::GetCallerName(ApiCaller caller) {
+  switch (caller) {
+    case ApiCaller::Refresh: return "refresh";
+    case ApiCaller::Miss: return "miss";
+  }
+  return "unknown";
+}
+
+std::string ApiCallStats::_GetStatName(const std::string& suffix) const {
+  return "api_" + this->m_api + "_" + GetCallerName(this->m_caller) + "_" + suffix;
+}
+
+MetricId ApiCallStats::_GetMetricId(const std::string& metricName) const {
+  return MetricId(metricName, {{"api", this->m_api}, {"caller", GetCallerName(this->m_caller)}});
+}
+
+void ApiCallStats::RecordPage(uint64_t latencyUs, size_t items) {
+  this->m_latency->Record(latencyUs);
+  this->m_pages->Increment();
+  this->m_items->Increment(items);
+}
+
+void ApiCallStats::RecordError(const std::string& code, bool retryable) {
+  if (retryable) {
+    this->m_retryableErrors->Increment();
+  }
+  std::shared_ptr<Stat> errors;
+  {
+    std::lock_guard<std::mutex> lock(this->m_errorsLock);
+    auto &stat = this->m_errors[code];
+    if (!stat) {
+      auto metric = this->_GetMetricId("api_errors");
+      metric.labels.push_back(std::make_pair("error", code));
+      stat = this->m_statsReceiver->Create(this->_GetStatName("error_" + code), metric);
+    }
+    errors = stat;
+  }
+  errors->Increment();
+}
+
+void ApiCallStats::RecordCall(bool success) {
+  this->m_calls->Increment();
+  if (!success) {
+    this->m_failedCalls->Increment();
+  }
+}
+
+std::shared_ptr<ApiCallStats> ApiTelemetry::Get(const std::string& api, ApiCaller caller) {
+  std::lock_guard<std::mutex> lock(this->m_lock);
+  auto &stats = this->m_stats[std::make_pair(api, caller)];
+  if (!stats) {
+    stats = std::make_shared<ApiCallStats>(api, caller, this->m_statsReceiver);
+  }
+  return stats;
+}
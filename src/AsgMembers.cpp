@@ -0,0 +1,59 @@
+#include <algorithm>
+
+#include "AsgMembers.h"
+#include "KRandom.h"
+
+AsgMembers::AsgMembers(std::vector<AsgMember> members, uint32_t ttl)
+  : m_ttl(ttl) {
+  std::stable_sort(members.begin(), members.end(), [](const AsgMember &a, const AsgMember &b) {
+    return a.zone < b.zone;
+  });
+  for (size_t i = 0; i < members.size(); i++) {
+    if (this->m_ranges.empty() || this->m_ranges.back().zone != members[i].zone) {
+      this->m_ranges.push_back(ZoneRange { members[i].zone, i, i });
+    }
+    this->m_ranges.back().end = i + 1;
+    this->m_ips.push_back(std::move(members[i].ip));
+    this->m_zones.push_back(members[i].zone);
+  }
+}
+
+size_t AsgMembers::Select(ZoneIndex clientZone, size_t k, size_t spillover, size_t *picks) const {
+  const size_t n = this->m_ips.size();
+  k = std::min(std::min(k, n), (size_t)K_RANDOM_MAX_K);
+
+  const ZoneRange *local = nullptr;
+  if (clientZone != UNKNOWN_ZONE) {
+    for (const auto &r : this->m_ranges) {
+      if (r.zone == clientZone) {
+        local = &r;
+        break;
+      }
+    }
+  }
+  if (local == nullptr) {
+    k_random_sample(n, k, picks);
+    return k;
+  }
+
+  const size_t numLocal = local->end - local->begin;
+  const size_t numOther = n - numLocal;
+  size_t fromOther = std::min(std::min(spillover, k), numOther);
+  if (k > numLocal) {
+    fromOther = std::max(fromOther, k - numLocal);
+  }
+  size_t fromLocal = k - fromOther;
+
+  k_random_sample(numLocal, fromLocal, picks);
+  for (size_t i = 0; i < fromLocal; i++) {
+    picks[i] += local->begin;
+  }
+  // Sample the other zones as one range with the local members cut out.
+  k_random_sample(numOther, fromOther, picks + fromLocal);
+  for (size_t i = fromLocal; i < k; i++) {
+    if (picks[i] >= local->begin) {
+      picks[i] += numLocal;
+    }
+  }
+  return k;
+}
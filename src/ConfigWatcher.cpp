@@ -0,0 +1,83 @@
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "ConfigWatcher.h"
+
+ConfigWatcher::ConfigWatcher(const std::string& path, std::function<void()> onChange)
+  : m_onChange(onChange),
+    m_inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+    m_stopFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  auto slash = path.rfind('/');
+  auto dir = slash == std::string::npos ? std::string(".") : slash == 0 ? std::string("/") : path.substr(0, slash);
+  this->m_name = slash == std::string::npos ? path : path.substr(slash + 1);
+  if (this->m_inotifyFd < 0 || this->m_stopFd < 0) {
+    return;
+  }
+  if (inotify_add_watch(this->m_inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    return;
+  }
+  this->m_watchThread = std::thread(&ConfigWatcher::_WatchLoop, this);
+}
+
+ConfigWatcher::~ConfigWatcher() {
+  if (this->m_watchThread.joinable()) {
+    uint64_t one = 1;
+    while (write(this->m_stopFd, &one, sizeof(one)) < 0 && errno == EINTR) { }
+    this->m_watchThread.join();
+  }
+  if (this->m_inotifyFd >= 0) {
+    close(this->m_inotifyFd);
+  }
+  if (this->m_stopFd >= 0) {
+    close(this->m_stopFd);
+  }
+}
+
+bool ConfigWatcher::_ReadEvents() {
+  bool changed = false;
+  alignas(struct inotify_event) char buf[4096];
+  ssize_t len;
+  while ((len = read(this->m_inotifyFd, buf, sizeof(buf))) > 0) {
+    for (ssize_t at = 0; at < len;) {
+      auto event = (const struct inotify_event*)(buf + at);
+      if (event->len > 0 && strcmp(event->name, this->m_name.c_str()) == 0) {
+        changed = true;
+      }
+      at += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  return changed;
+}
+
+void ConfigWatcher::_WatchLoop() {
+  struct pollfd fds[2] = {
+      {this->m_inotifyFd, POLLIN, 0},
+      {this->m_stopFd, POLLIN, 0}
+  };
+  bool pending = false;
+  while (true) {
+    // Once the file has changed, wait for it to settle.
+    int ready = poll(fds, 2, pending ? CONFIG_WATCHER_SETTLE_MS : -1);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    if (fds[1].revents != 0) {
+      return;
+    }
+    if (fds[0].revents != 0) {
+      pending = this->_ReadEvents() || pending;
+      continue;
+    }
+    if (ready == 0 && pending) {
+      pending = false;
+      this->m_onChange();
+    }
+  }
+}
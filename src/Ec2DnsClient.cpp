@@ -1,7 +1,11 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
 #include <fstream>
 #include <boost/regex.hpp>
 
 #include "Ec2DnsClient.h"
+#include "ReverseLookupHelper.h"
 #include "dlz_minimal.h"
 #include "aws/core/Region.h"
 #include "aws/core/utils/json/JsonSerializer.h"
@@ -11,6 +15,8 @@ using namespace std::placeholders;
 bool Ec2DnsConfig::TryLoad(const std::string& file) {
 #define TryLoadString(key) if (root.ValueExists(#key)) { this->key = root.GetString(#key); }
 #define TryLoadInteger(key) if (root.ValueExists(#key)) { this->key = root.GetInteger(#key); }
+#define TryLoadBool(key) if (root.ValueExists(#key)) { this->key = root.GetBool(#key); }
+#define TryLoadNamedInteger(name, key) if (root.ValueExists(name)) { this->key = root.GetInteger(name); }
 
   std::ifstream f(file);
   if (f.fail()) {
@@ -27,9 +33,14 @@ bool Ec2DnsConfig::TryLoad(const std::string& file) {
   TryLoadString(aws_access_key)
   TryLoadString(aws_secret_key)
   TryLoadInteger(log_level)
+  TryLoadInteger(refresh_interval)
+  TryLoadInteger(instance_timeout)
   TryLoadString(log_path)
   TryLoadInteger(num_asg_records)
   TryLoadString(asg_dns_tag)
+  TryLoadBool(asg_prefer_same_az)
+  TryLoadInteger(asg_az_spillover)
+  TryLoadInteger(asg_az_subnet_bits)
 
   if (root.ValueExists("requestTimeoutMs")) {
     this->client_config.requestTimeoutMs = root.GetInteger("requestTimeoutMs");
@@ -76,17 +87,119 @@ bool Ec2DnsConfig::TryLoad(const std::string& file) {
   TryLoadString(instance_regex)
   TryLoadString(account_name)
   TryLoadInteger(request_batch_size)
+  TryLoadString(xfr_allow)
+  TryLoadString(xfr_nameservers)
+  TryLoadString(zone_file_dir)
+  TryLoadNamedInteger("host_ttl_min", host_ttl.min_ttl)
+  TryLoadNamedInteger("host_ttl_max", host_ttl.max_ttl)
+  TryLoadNamedInteger("host_ttl_stable_percent", host_ttl.stable_percent)
+  TryLoadNamedInteger("asg_ttl_min", asg_ttl.min_ttl)
+  TryLoadNamedInteger("asg_ttl_max", asg_ttl.max_ttl)
+  TryLoadNamedInteger("asg_ttl_stable_percent", asg_ttl.stable_percent)
+  TryLoadInteger(stats_port)
+  TryLoadString(stats_address)
+  TryLoadInteger(stats_threads)
+  TryLoadInteger(trace_sample_every)
+  TryLoadInteger(trace_buffer_size)
+  TryLoadInteger(trace_slowest)
+  TryLoadInteger(top_k_capacity)
+  TryLoadInteger(top_k_window_sec)
+  TryLoadInteger(refresh_history)
+  TryLoadString(query_log_path)
+  TryLoadInteger(query_log_sample_every)
+  TryLoadInteger(query_log_max_mb)
+  TryLoadBool(sdk_memory_pools)
+  TryLoadBool(sdk_refresh_arena)
+  TryLoadString(shared_snapshot_name)
+  TryLoadString(shared_snapshot_lock_path)
+  TryLoadInteger(shared_snapshot_poll_ms)
+  TryLoadBool(config_watch)
+  TryLoadBool(authoritative_snapshot)
+  TryLoadInteger(authoritative_grace_sec)
+  TryLoadInteger(authoritative_max_intervals)
   return true;
 }
 
+#define CHECK_CHANGED(key) if (this->key != other.key) { changed.push_back(#key); }
+
+std::vector<std::string> Ec2DnsConfig::GetChangedTunables(const Ec2DnsConfig& other) const {
+  std::vector<std::string> changed;
+  EC2DNS_TUNABLES(CHECK_CHANGED)
+  if (this->client_config.requestTimeoutMs != other.client_config.requestTimeoutMs) {
+    changed.push_back("requestTimeoutMs");
+  }
+  if (this->client_config.connectTimeoutMs != other.client_config.connectTimeoutMs) {
+    changed.push_back("connectTimeoutMs");
+  }
+  return changed;
+}
+
+std::vector<std::string> Ec2DnsConfig::GetChangedFixedSettings(const Ec2DnsConfig& other) const {
+  std::vector<std::string> changed;
+  EC2DNS_FIXED_SETTINGS(CHECK_CHANGED)
+  if (this->client_config.region != other.client_config.region) {
+    changed.push_back("region");
+  }
+  if (this->client_config.endpointOverride != other.client_config.endpointOverride) {
+    changed.push_back("endpoint_override");
+  }
+  if (this->client_config.scheme != other.client_config.scheme) {
+    changed.push_back("use_ssl");
+  }
+  return changed;
+}
+
+std::vector<std::string> Ec2DnsClient::ApplyConfig(const Ec2DnsConfig& config) {
+  std::vector<std::string> changed;
+  {
+    std::lock_guard<std::mutex> lock(this->m_configLock);
+    auto current = this->GetConfig();
+    changed = current->GetChangedTunables(config);
+    if (changed.empty()) {
+      return changed;
+    }
+    auto applied = std::make_shared<Ec2DnsConfig>(*current);
+#define APPLY_TUNABLE(key) applied->key = config.key;
+    EC2DNS_TUNABLES(APPLY_TUNABLE)
+    applied->client_config.requestTimeoutMs = config.client_config.requestTimeoutMs;
+    applied->client_config.connectTimeoutMs = config.client_config.connectTimeoutMs;
+    std::atomic_store(&this->m_config, Ec2DnsConfigPtr(applied));
+  }
+  this->m_hostCache.SetDefaultTimeout(config.instance_timeout);
+  this->m_asgCache.SetDefaultTimeout(config.instance_timeout);
+  {
+    std::lock_guard<std::mutex> lock(this->m_stopRefreshLock);
+    this->m_rescheduleRefresh = true;
+  }
+  this->m_stopRefreshCond.notify_all();
+  return changed;
+}
+
+void Ec2DnsClient::SetAwsClients(std::shared_ptr<EC2Client> ec2Client, std::shared_ptr<AutoScalingClient> asgClient) {
+  std::lock_guard<std::mutex> lock(this->m_awsClientsLock);
+  this->m_ec2Client = ec2Client;
+  this->m_asgClient = asgClient;
+}
+
+std::shared_ptr<EC2Client> Ec2DnsClient::_GetEc2Client() {
+  std::lock_guard<std::mutex> lock(this->m_awsClientsLock);
+  return this->m_ec2Client;
+}
+
+std::shared_ptr<AutoScalingClient> Ec2DnsClient::_GetAsgClient() {
+  std::lock_guard<std::mutex> lock(this->m_awsClientsLock);
+  return this->m_asgClient;
+}
+
 bool Ec2DnsClient::_DescribeInstances(
     const std::string &instanceId,
     const std::string &ip,
     Aws::Vector<Aws::EC2::Model::Instance> *instances) {
 
   Aws::EC2::Model::DescribeInstancesRequest req;
-  req.SetMaxResults(this->m_config.request_batch_size);
-  if (instanceId.empty() && ip.empty()) {
+  req.SetMaxResults(this->GetConfig()->request_batch_size);
+  auto caller = instanceId.empty() && ip.empty() ? ApiCaller::Refresh : ApiCaller::Miss;
+  if (caller == ApiCaller::Refresh) {
     this->m_log(ISC_LOG_INFO, "ec2dns - Getting all instances");
   }
   else if (ip.empty()) {
@@ -103,7 +216,7 @@ bool Ec2DnsClient::_DescribeInstances(
       Aws::EC2::Model::DescribeInstancesRequest,
       Aws::EC2::Model::DescribeInstancesResponse,
       Aws::EC2::EC2Errors
-  >("DescribeInstances", req, std::bind(&EC2Client::DescribeInstances, this->m_ec2Client, _1), &responses);
+  >("DescribeInstances", caller, req, std::bind(&EC2Client::DescribeInstances, this->_GetEc2Client(), _1), &responses);
 
   if (!success) {
     return false;
@@ -143,14 +256,16 @@ bool Ec2DnsClient::_QueryInstanceById(const std::string &instanceId, std::string
 }
 
 const std::string Ec2DnsClient::_GetHostname(const Aws::EC2::Model::Instance& instance) {
-  const auto& regionCode = this->m_config.region_code;
   const auto& az = instance.GetPlacement().GetAvailabilityZone();
-  const auto& account = this->m_config.account_name;
-  auto instanceId = instance.GetInstanceId().substr(2);
-  std::ostringstream oss;
-  oss << regionCode << az[az.length() - 1] << "-" << account << "-" << instanceId
-      << "." << this->m_config.zone_name << ".";
-  return oss.str();
+  const auto& instanceId = instance.GetInstanceId();
+  bool hasDigits = instanceId.size() > 2;
+  char hostname[SNAPSHOT_HOSTNAME_BUFFER_SIZE];
+  auto formatted = this->m_hostnameFormat.Format(
+      az.empty() ? '?' : az.back(),
+      hasDigits ? instanceId.c_str() + 2 : "",
+      hasDigits ? instanceId.size() - 2 : 0,
+      true, hostname, sizeof(hostname));
+  return formatted == nullptr ? std::string() : std::string(formatted);
 }
 
 bool Ec2DnsClient::_QueryInstanceByIp(const std::string &ip, std::string *hostname) {
@@ -172,127 +287,664 @@ bool Ec2DnsClient::_QueryInstanceByIp(const std::string &ip, std::string *hostna
   return false;
 }
 
-bool Ec2DnsClient::_CheckHostCache(const std::string &instanceId, std::string *ip) {
-  return this->m_hostCache.TryGet(instanceId, ip);
+CacheLookup Ec2DnsClient::_CheckHostCache(
+    const boost::string_ref &key, char *value, size_t len, time_point<steady_clock> *stableSince) {
+  return this->m_hostCache.TryGet(key, value, len, stableSince);
+}
+
+CacheLookup Ec2DnsClient::_CheckSnapshot(
+    const boost::string_ref &key,
+    SnapshotFinder finder,
+    char *value,
+    size_t len,
+    time_point<steady_clock> *stableSince) {
+  auto published = std::atomic_load(&this->m_published);
+  return published
+      ? (this->*finder)(*published->snapshot, key, value, len, stableSince)
+      : CacheLookup::Missing;
+}
+
+static bool _TryParseIp(const boost::string_ref &ip, uint32_t *addr) {
+  char terminated[INET_ADDRSTRLEN];
+  struct in_addr parsed;
+  if (ip.size() >= sizeof(terminated)) {
+    return false;
+  }
+  memcpy(terminated, ip.data(), ip.size());
+  terminated[ip.size()] = '\0';
+  if (inet_pton(AF_INET, terminated, &parsed) != 1) {
+    return false;
+  }
+  *addr = ntohl(parsed.s_addr);
+  return true;
+}
+
+static time_point<steady_clock> _GetStableSince(const ZoneSnapshot &snapshot, const SnapshotInstance *instance) {
+  auto stableSince = snapshot.GetStableSince()[instance - snapshot.GetInstances().begin()];
+  return time_point<steady_clock>(seconds(stableSince));
+}
+
+CacheLookup Ec2DnsClient::_FindIpInSnapshot(
+    const ZoneSnapshot &snapshot,
+    const boost::string_ref &instanceId,
+    char *ip,
+    size_t len,
+    time_point<steady_clock> *stableSince) {
+  SnapshotInstance key;
+  if (!key.TrySetId(instanceId)) {
+    return CacheLookup::Missing;
+  }
+  auto instance = snapshot.FindById(key);
+  if (instance == nullptr || !(instance->flags & SNAPSHOT_INSTANCE_HAS_IPV4)) {
+    return CacheLookup::Missing;
+  }
+  if (ZoneSnapshot::FormatIp(*instance, ip, len) == nullptr) {
+    return CacheLookup::TooLong;
+  }
+  *stableSince = _GetStableSince(snapshot, instance);
+  return CacheLookup::Hit;
+}
+
+CacheLookup Ec2DnsClient::_FindHostnameInSnapshot(
+    const ZoneSnapshot &snapshot,
+    const boost::string_ref &ip,
+    char *hostname,
+    size_t len,
+    time_point<steady_clock> *stableSince) {
+  uint32_t addr;
+  if (!_TryParseIp(ip, &addr)) {
+    return CacheLookup::Missing;
+  }
+  auto instance = snapshot.FindByIp(addr);
+  if (instance == nullptr || !(instance->flags & SNAPSHOT_INSTANCE_HAS_IPV4)) {
+    return CacheLookup::Missing;
+  }
+  if (snapshot.FormatHostname(*instance, true, hostname, len) == nullptr) {
+    return CacheLookup::TooLong;
+  }
+  *stableSince = _GetStableSince(snapshot, instance);
+  return CacheLookup::Hit;
+}
+
+bool Ec2DnsClient::_IsAbsent(const boost::string_ref &key, AbsenceCheck check) {
+  auto config = this->GetConfig();
+  if (!config->authoritative_snapshot) {
+    return false;
+  }
+  auto published = std::atomic_load(&this->m_published);
+  if (!published || this->m_refreshFailed.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  // A snapshot more than a few refreshes old means they're failing, wherever
+  // they run.
+  auto maxAge = seconds((int64_t)config->refresh_interval * config->authoritative_max_intervals);
+  if (published->GetAge() >= maxAge) {
+    return false;
+  }
+  return (this->*check)(*config, *published, key);
+}
+
+bool Ec2DnsClient::_IsIdAbsent(
+    const Ec2DnsConfig &config, const PublishedSnapshot &published, const boost::string_ref &instanceId) {
+  SnapshotInstance key;
+  if (!key.TrySetId(instanceId) || published.snapshot->FindById(key) != nullptr) {
+    return false;
+  }
+  // Past the grace period it could be an instance launched since.
+  return published.GetAge() < seconds(config.authoritative_grace_sec);
+}
+
+bool Ec2DnsClient::_IsIpAbsent(
+    const Ec2DnsConfig &config, const PublishedSnapshot &published, const boost::string_ref &ip) {
+  uint32_t addr;
+  if (!published.bitmaps || !_TryParseIp(ip, &addr)) {
+    return false;
+  }
+  for (const auto &bitmap : *published.bitmaps) {
+    if (bitmap.Covers(addr)) {
+      return !bitmap.Contains(addr);
+    }
+  }
+  return false;
+}
+
+std::shared_ptr<const Ec2DnsClient::AddressBitmaps> Ec2DnsClient::_BuildAddressBitmaps(const ZoneSnapshot &snapshot) {
+  auto bitmaps = std::make_shared<AddressBitmaps>();
+  std::string cidrs = this->GetConfig()->vpc_cidr;
+  size_t start = 0;
+  while (start <= cidrs.size()) {
+    size_t end = cidrs.find(',', start);
+    if (end == std::string::npos) {
+      end = cidrs.size();
+    }
+    Ipv4Cidr cidr;
+    if (Ipv4Cidr::TryParse(cidrs.substr(start, end - start), &cidr)
+        && (~cidr.mask >> ADDRESS_BITMAP_MAX_HOST_BITS) == 0) {
+      AddressBitmap bitmap(cidr.network, cidr.mask);
+      auto range = snapshot.GetInstancesInNetwork(cidr.network, cidr.mask);
+      for (auto i = range.first; i != range.second; i++) {
+        if (i->flags & SNAPSHOT_INSTANCE_HAS_IPV4) {
+          bitmap.Add(i->ipv4);
+        }
+      }
+      bitmaps->push_back(std::move(bitmap));
+    }
+    start = end + 1;
+  }
+  return bitmaps;
+}
+
+uint32_t Ec2DnsClient::_GetHostTtl(const time_point<steady_clock> stableSince, const time_point<steady_clock> now) {
+  auto nextRefresh = time_point<steady_clock>(steady_clock::duration(this->m_nextRefresh.load(std::memory_order_relaxed)));
+  int64_t untilRefresh = duration_cast<seconds>(nextRefresh - now).count();
+  int64_t stable = duration_cast<seconds>(now - stableSince).count();
+  return this->GetConfig()->host_ttl.GetTtl(
+      (uint64_t)std::max(stable, (int64_t)0),
+      (uint64_t)std::max(untilRefresh, (int64_t)0));
 }
 
 bool Ec2DnsClient::_Resolve(
-    const std::string &key,
-    const std::string &clientAddr,
-    const std::function<bool(const std::string&, std::string*)> valueFactory,
-    std::string *value) {
+    const boost::string_ref &key,
+    const ClientAddress &clientAddr,
+    ValueFactory valueFactory,
+    SnapshotFinder snapshotFinder,
+    AbsenceCheck absenceCheck,
+    char *value,
+    size_t len,
+    ResolveInfo *info) {
   if (key.empty()) {
     return false;
   }
-  if (this->_CheckHostCache(key, value)) {
+  time_point<steady_clock> stableSince;
+  auto cached = this->_CheckSnapshot(key, snapshotFinder, value, len, &stableSince);
+  if (cached == CacheLookup::Missing) {
+    cached = this->_CheckHostCache(key, value, len, &stableSince);
+  }
+  if (cached == CacheLookup::Hit) {
+    if (info != nullptr) {
+      info->ttl = this->_GetHostTtl(stableSince, steady_clock::now());
+      info->outcome = LookupOutcome::Hit;
+    }
     return true;
   }
-  if (this->m_throttler->IsRequestThrottled(clientAddr, key)) {
+  if (cached == CacheLookup::TooLong) {
+    // The API would only hand back the same value.
+    return false;
+  }
+
+  // Cache miss, everything from here on is allowed to allocate.
+  if (this->m_missKeys) {
+    this->m_missKeys->Offer(key);
+  }
+  if (this->_IsAbsent(key, absenceCheck)) {
+    if (info != nullptr) {
+      info->outcome = LookupOutcome::Absent;
+    }
+    return false;
+  }
+  std::string keyStr(key.begin(), key.end());
+  if (this->m_throttler->IsRequestThrottled(clientAddr, keyStr)) {
+    // Counted rather than logged, throttling kicks in during miss storms.
+    this->m_throttledLookups->Increment();
+    if (info != nullptr) {
+      info->outcome = LookupOutcome::Throttled;
+    }
     return false;
   }
-  this->m_throttler->OnMiss(key, clientAddr);
-  if (valueFactory(key, value)) {
-    this->m_hostCache.Insert(key, *value);
+  this->m_throttler->OnMiss(keyStr);
+  if (info != nullptr) {
+    info->outcome = LookupOutcome::Miss;
+  }
+  std::string result;
+  if ((this->*valueFactory)(keyStr, &result)) {
+    this->m_hostCache.Insert(keyStr, result);
+    if (result.length() >= len) {
+      return false;
+    }
+    if (info != nullptr) {
+      auto now = steady_clock::now();
+      info->ttl = this->_GetHostTtl(now, now);
+    }
+    memcpy(value, result.c_str(), result.length() + 1);
     return true;
   }
   return false;
 }
 
-bool Ec2DnsClient::TryResolveIp(const std::string &instanceId, const std::string& clientAddr, std::string *ip) {
+bool Ec2DnsClient::TryResolveIp(
+    const boost::string_ref &instanceId, const ClientAddress &clientAddr, char *ip, size_t len, ResolveInfo *info) {
   this->m_lookupRequests->Increment();
   return this->_Resolve(
       instanceId,
       clientAddr,
-      std::bind(&Ec2DnsClient::_QueryInstanceById, this, _1, _2),
-      ip);
+      &Ec2DnsClient::_QueryInstanceById,
+      &Ec2DnsClient::_FindIpInSnapshot,
+      &Ec2DnsClient::_IsIdAbsent,
+      ip,
+      len,
+      info);
 }
 
-bool Ec2DnsClient::TryResolveHostname(const std::string &ip, const std::string &clientAddr, std::string *hostname) {
+bool Ec2DnsClient::TryResolveHostname(
+    const boost::string_ref &ip, const ClientAddress &clientAddr, char *hostname, size_t len, ResolveInfo *info) {
   this->m_reverseLookupRequests->Increment();
   return this->_Resolve(
       ip,
       clientAddr,
-      std::bind(&Ec2DnsClient::_QueryInstanceByIp, this, _1, _2),
-      hostname);
+      &Ec2DnsClient::_QueryInstanceByIp,
+      &Ec2DnsClient::_FindHostnameInSnapshot,
+      &Ec2DnsClient::_IsIpAbsent,
+      hostname,
+      len,
+      info);
 }
 
-bool Ec2DnsClient::TryResolveAutoscaler(const std::string &name, const std::string &clientAddr, std::vector<std::string> *nodes) {
+bool Ec2DnsClient::TryResolveAutoscaler(const boost::string_ref &name, const ClientAddress &clientAddr, AsgMembersPtr *nodes) {
   this->m_autoscalerRequests->Increment();
   return this->m_asgCache.TryGet(name, nodes);
 }
 
+ZoneIndex Ec2DnsClient::GetClientZone(const ClientAddress &clientAddr) {
+  if (clientAddr.GetFamily() != AF_INET) {
+    return UNKNOWN_ZONE;
+  }
+  std::shared_ptr<const ClientZoneMap> zoneMap;
+  {
+    std::lock_guard<std::mutex> lock(this->m_zoneMapLock);
+    zoneMap = this->m_zoneMap;
+  }
+  return zoneMap ? zoneMap->Lookup(clientAddr.GetV4()) : UNKNOWN_ZONE;
+}
+
+size_t Ec2DnsClient::SelectAutoscalerMembers(const AsgMembers &members, const ClientAddress &clientAddr, size_t *picks) {
+  auto config = this->GetConfig();
+  ZoneIndex clientZone = UNKNOWN_ZONE;
+  if (config->asg_prefer_same_az) {
+    clientZone = this->GetClientZone(clientAddr);
+    if (clientZone == UNKNOWN_ZONE) {
+      this->m_asgUnknownZone->Increment();
+    }
+    else {
+      this->m_asgSameZone->Increment();
+    }
+  }
+  return members.Select(clientZone, config->num_asg_records, config->asg_az_spillover, picks);
+}
+
+ZoneIndex Ec2DnsClient::_GetZoneIndex(const std::string &availabilityZone) {
+  auto found = this->m_zoneIndexes.find(availabilityZone);
+  if (found != this->m_zoneIndexes.end()) {
+    return found->second;
+  }
+  ZoneIndex index = (ZoneIndex)this->m_zoneIndexes.size();
+  this->m_zoneIndexes[availabilityZone] = index;
+  return index;
+}
+
 void Ec2DnsClient::_RefreshInstanceData() {
   while (true) {
+    this->_RefreshOrFollow();
+    auto lastRun = steady_clock::now();
+    auto nextRun = this->_ScheduleNextRun(lastRun);
+    std::unique_lock<std::mutex> lock(this->m_stopRefreshLock);
+    while (this->m_stopRefreshCond.wait_until(
+        lock, nextRun, [this] { return this->m_stopRefresh || this->m_rescheduleRefresh; })) {
+      if (this->m_stopRefresh) {
+        return;
+      }
+      this->m_rescheduleRefresh = false;
+      nextRun = this->_ScheduleNextRun(lastRun);
+    }
+  }
+}
+
+void Ec2DnsClient::_RefreshOrFollow() {
+  if (this->m_sharedSnapshot && !this->m_sharedSnapshot->TryLead()) {
+    this->m_following.store(true, std::memory_order_relaxed);
+    this->_FollowSharedSnapshot();
+  }
+  else {
+    this->m_following.store(false, std::memory_order_relaxed);
     this->_RefreshInstanceDataImpl();
-    this->m_throttler->Trim();
-    std::this_thread::sleep_for(
-        std::chrono::seconds(this->m_config.refresh_interval));
   }
+  this->m_throttler->Trim();
+}
+
+time_point<steady_clock> Ec2DnsClient::_ScheduleNextRun(time_point<steady_clock> lastRun) {
+  auto config = this->GetConfig();
+  if (this->IsFollowing()) {
+    return lastRun + std::chrono::milliseconds(config->shared_snapshot_poll_ms);
+  }
+  auto nextRefresh = lastRun + std::chrono::seconds(config->refresh_interval);
+  this->m_nextRefresh.store(nextRefresh.time_since_epoch().count(), std::memory_order_relaxed);
+  return nextRefresh;
+}
+
+void Ec2DnsClient::_FollowSharedSnapshot() {
+  auto generation = this->m_sharedSnapshot->GetGeneration();
+  if (generation == 0 || generation == this->m_sharedGeneration) {
+    return;
+  }
+  SharedSnapshotGeneration loaded;
+  if (!this->m_sharedSnapshot->Load(this->m_hostnameFormat, &loaded)) {
+    this->m_log(ISC_LOG_WARNING, "ec2dns - Unable to load shared snapshot generation %llu",
+        (unsigned long long)generation);
+    return;
+  }
+  this->m_sharedGeneration = loaded.generation;
+  this->_AdoptSnapshot(loaded.snapshot, loaded.taken, loaded.next_refresh);
+  this->m_log(ISC_LOG_INFO, "ec2dns - Loaded shared snapshot generation %llu with %d instances",
+      (unsigned long long)loaded.generation, (int)loaded.snapshot->GetInstances().size());
+}
+
+void Ec2DnsClient::FollowSnapshot(const ZoneSnapshotPtr& snapshot, int64_t taken, int64_t nextRefresh) {
+  this->m_following.store(true, std::memory_order_relaxed);
+  this->_AdoptSnapshot(snapshot->WithFormat(this->m_hostnameFormat), taken, nextRefresh);
+}
+
+void Ec2DnsClient::_AdoptSnapshot(const ZoneSnapshotPtr& adopted, int64_t taken, int64_t nextRefresh) {
+  const auto &snapshot = *adopted;
+
+  // Zone indexes follow the publisher's, which its groups are in terms of.
+  const auto &zones = snapshot.GetZones();
+  this->m_zoneIndexes.clear();
+  for (size_t z = 0; z < zones.size(); z++) {
+    this->m_zoneIndexes[zones[z]] = (ZoneIndex)z;
+  }
+  auto zoneMap = std::make_shared<ClientZoneMap>(this->GetConfig()->asg_az_subnet_bits);
+  for (const auto &i : snapshot.GetInstances()) {
+    if ((i.flags & SNAPSHOT_INSTANCE_HAS_IPV4) && i.zone < zones.size()) {
+      zoneMap->Add(i.ipv4, (ZoneIndex)i.zone);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->m_zoneMapLock);
+    this->m_zoneMap = zoneMap;
+  }
+
+  auto expiresOn = steady_clock::now() + std::chrono::seconds(10 * 60);
+  for (const auto &group : snapshot.GetAutoscalingGroups()) {
+    this->m_asgCache.Insert(group.first, group.second, expiresOn);
+  }
+  this->m_asgCache.Trim();
+
+  this->m_nextRefresh.store(nextRefresh, std::memory_order_relaxed);
+  this->_SetSnapshot(adopted, taken);
+}
+
+void Ec2DnsClient::StopRefreshThread() {
+  {
+    std::lock_guard<std::mutex> lock(this->m_stopRefreshLock);
+    this->m_stopRefresh = true;
+  }
+  this->m_stopRefreshCond.notify_all();
+  if (this->m_refreshThread.joinable()) {
+    this->m_refreshThread.join();
+  }
+}
+
+std::vector<std::pair<std::string, const TimedMutex*>> Ec2DnsClient::GetLocks() const {
+  return {
+      {"host_cache", &this->m_hostCache.GetMutex()},
+      {"asg_cache", &this->m_asgCache.GetMutex()},
+      {"throttler", &this->m_throttler->GetMutex()},
+      {"stats", &this->m_statsReceiver->GetMutex()}
+  };
 }
 
 void Ec2DnsClient::_RefreshInstanceDataImpl() {
+  SdkMemorySystem::ArenaScope arena(this->GetConfig()->sdk_refresh_arena ? SdkMemorySystem::GetInstalled() : nullptr);
+  auto profiler = &this->m_refreshProfiler;
+  profiler->BeginCycle();
   Aws::Vector<Aws::EC2::Model::Instance> instances;
-  bool success = this->_DescribeInstances("", "", &instances);
+  bool success;
+  {
+    RefreshProfiler::Phase total(profiler, "total", this->m_refreshLatency.get());
+    {
+      RefreshProfiler::Phase phase(profiler, "describe_instances", this->m_refreshDescribeLatency.get());
+      success = this->_DescribeInstances("", "", &instances);
+    }
+    if (success) {
+      this->_RefreshCachesImpl(instances);
+    }
+  }
+  profiler->EndCycle(success, instances.size());
   if (not success) {
+    this->m_refreshFailed.store(true, std::memory_order_relaxed);
     this->m_log(ISC_LOG_ERROR, "ec2dns - Unable to refresh cache.");
     return;
   }
-  this->_RefreshAutoscalerDataImpl(instances);
+  this->m_log(ISC_LOG_INFO, "ec2dns - Refreshed cache with %d instances", instances.size());
+}
 
+void Ec2DnsClient::_RefreshCachesImpl(const Aws::Vector<Aws::EC2::Model::Instance>& instances) {
+  auto profiler = &this->m_refreshProfiler;
+  ZoneSnapshot::AutoscalingGroups groups;
+  {
+    RefreshProfiler::Phase phase(profiler, "autoscaler", this->m_refreshAutoscalerLatency.get());
+    if (!this->_RefreshAutoscalerDataImpl(instances, &groups)) {
+      // Keep transferring the groups we saw last rather than dropping them.
+      auto previous = this->GetSnapshot();
+      if (previous) {
+        groups = previous->GetAutoscalingGroups();
+      }
+    }
+  }
   {
-    auto&& lock = this->m_hostCache.GetLock();
-    this->m_hostCache.Trim();
+    RefreshProfiler::Phase phase(profiler, "zone_map", this->m_refreshZoneMapLatency.get());
+    this->_RefreshZoneMapImpl(instances);
+  }
 
-    auto expiresOn = std::chrono::steady_clock::now() + std::chrono::seconds(this->m_config.instance_timeout);
-    for (const auto& it : instances) {
-      this->m_hostCache.InsertNoLock(it.GetInstanceId(), it.GetPrivateIpAddress(), expiresOn);
-      this->m_hostCache.InsertNoLock(it.GetPrivateIpAddress(), this->_GetHostname(it), expiresOn);
+  {
+    // Instances are answered from the snapshot, the host cache only holds
+    // what the API filled on a miss.
+    RefreshProfiler::Phase phase(profiler, "host_cache_trim", this->m_refreshHostCacheTrimLatency.get());
+    std::unique_lock<TimedMutex> lock;
+    {
+      RefreshProfiler::Phase wait(profiler, "host_cache_lock_wait");
+      lock = this->m_hostCache.GetLock();
     }
-    UNUSED(lock);
+    this->m_hostCache.TrimNoLock();
+  }
+  {
+    RefreshProfiler::Phase phase(profiler, "snapshot", this->m_refreshSnapshotLatency.get());
+    this->_RefreshSnapshotImpl(instances, std::move(groups));
   }
-  this->m_log(ISC_LOG_INFO, "ec2dns - Refreshed cache with %d instances", instances.size());
 }
 
-void Ec2DnsClient::_RefreshAutoscalerDataImpl(const Aws::Vector<Aws::EC2::Model::Instance>& instances) {
+bool Ec2DnsClient::_RefreshAutoscalerDataImpl(
+    const Aws::Vector<Aws::EC2::Model::Instance>& instances,
+    ZoneSnapshot::AutoscalingGroups *groups) {
+  auto profiler = &this->m_refreshProfiler;
   auto req = Aws::AutoScaling::Model::DescribeAutoScalingGroupsRequest();
   std::vector<Aws::AutoScaling::Model::DescribeAutoScalingGroupsResult> results;
-  bool success = this->_CallApi<
-      Aws::AutoScaling::Model::DescribeAutoScalingGroupsRequest,
-      Aws::AutoScaling::Model::DescribeAutoScalingGroupsResult,
-      Aws::AutoScaling::AutoScalingErrors
-  >("DescribeAutoScalingGroups", req,
-    std::bind(&AutoScalingClient::DescribeAutoScalingGroups, this->m_asgClient, _1), &results);
+  bool success;
+  {
+    RefreshProfiler::Phase phase(profiler, "autoscaler_describe_groups");
+    success = this->_CallApi<
+        Aws::AutoScaling::Model::DescribeAutoScalingGroupsRequest,
+        Aws::AutoScaling::Model::DescribeAutoScalingGroupsResult,
+        Aws::AutoScaling::AutoScalingErrors
+    >("DescribeAutoScalingGroups", ApiCaller::Refresh, req,
+      std::bind(&AutoScalingClient::DescribeAutoScalingGroups, this->_GetAsgClient(), _1), &results);
+  }
 
   if (!success) {
-    return;
+    return false;
   }
 
-  std::unordered_map<std::string, std::string> instanceToIpLookup;
-  for (const auto &i : instances) {
-    instanceToIpLookup[i.GetInstanceId()] = i.GetPrivateIpAddress();
+  std::unordered_map<std::string, AsgMember> instanceToIpLookup;
+  {
+    RefreshProfiler::Phase phase(profiler, "autoscaler_index_instances");
+    for (const auto &i : instances) {
+      instanceToIpLookup[i.GetInstanceId()] = AsgMember {
+          i.GetPrivateIpAddress(),
+          this->_GetZoneIndex(i.GetPlacement().GetAvailabilityZone())
+      };
+    }
   }
 
-  auto expiresOn = std::chrono::steady_clock::now() + std::chrono::seconds(10 * 60);
+  RefreshProfiler::Phase phase(profiler, "autoscaler_groups");
+
+  auto now = std::chrono::steady_clock::now();
+  auto expiresOn = now + std::chrono::seconds(10 * 60);
   for (const auto &resp : results) {
     for (const auto &asg : resp.GetAutoScalingGroups()) {
       for (const auto &tag : asg.GetTags()) {
-        if (tag.GetKey() == this->m_config.asg_dns_tag) {
+        if (tag.GetKey() == this->GetConfig()->asg_dns_tag) {
           const auto& dnsAlias = tag.GetValue();
           const auto& asgInstances = asg.GetInstances();
-          std::vector<std::string> instanceIps;
+          std::vector<AsgMember> members;
+          std::vector<std::string> ips;
           for (const auto &i : asgInstances) {
             if (i.GetLifecycleState() == Aws::AutoScaling::Model::LifecycleState::InService
                 && i.GetHealthStatus() == "Healthy") {
               auto instanceInfo = instanceToIpLookup.find(i.GetInstanceId());
               if (instanceInfo != instanceToIpLookup.end()) {
-                instanceIps.push_back(instanceInfo->second);
+                members.push_back(instanceInfo->second);
+                ips.push_back(instanceInfo->second.ip);
               }
             }
           }
-          this->m_asgCache.Insert(dnsAlias, instanceIps, expiresOn);
+          auto ttl = this->_UpdateAsgHistory(dnsAlias, std::move(ips), now);
+          auto asgMembers = std::make_shared<const AsgMembers>(members, ttl);
+          this->m_asgCache.Insert(dnsAlias, asgMembers, expiresOn);
+          (*groups)[dnsAlias] = asgMembers;
         }
       }
     }
   }
   this->m_asgCache.Trim();
-}
\ No newline at end of file
+
+  for (auto it = this->m_asgHistory.begin(); it != this->m_asgHistory.end();) {
+    if (groups->find(it->first) == groups->end()) {
+      it = this->m_asgHistory.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  return true;
+}
+
+uint32_t Ec2DnsClient::_UpdateAsgHistory(
+    const std::string &dnsAlias,
+    std::vector<std::string> ips,
+    const time_point<steady_clock> now) {
+  std::sort(ips.begin(), ips.end());
+  auto found = this->m_asgHistory.find(dnsAlias);
+  if (found == this->m_asgHistory.end()) {
+    this->m_asgHistory[dnsAlias] = AsgHistory { std::move(ips), now, 0 };
+    return this->GetConfig()->asg_ttl.GetTtl(0);
+  }
+
+  auto &history = found->second;
+  if (history.ips != ips) {
+    double interval = duration_cast<duration<double>>(now - history.lastChanged).count();
+    history.meanChangeInterval = history.meanChangeInterval == 0
+        ? interval
+        : (history.meanChangeInterval + interval) / 2;
+    history.ips = std::move(ips);
+    history.lastChanged = now;
+  }
+  // A group that has stopped changing earns longer TTLs as time goes on.
+  double sinceChange = duration_cast<duration<double>>(now - history.lastChanged).count();
+  double stable = history.meanChangeInterval == 0
+      ? sinceChange
+      : std::max(history.meanChangeInterval, sinceChange);
+  return this->GetConfig()->asg_ttl.GetTtl((uint64_t)stable);
+}
+
+void Ec2DnsClient::_RefreshZoneMapImpl(const Aws::Vector<Aws::EC2::Model::Instance>& instances) {
+  auto zoneMap = std::make_shared<ClientZoneMap>(this->GetConfig()->asg_az_subnet_bits);
+  for (const auto &i : instances) {
+    ClientAddress addr;
+    const auto &az = i.GetPlacement().GetAvailabilityZone();
+    if (!az.empty()
+        && ClientAddress::TryParse(i.GetPrivateIpAddress(), &addr)
+        && addr.GetFamily() == AF_INET) {
+      zoneMap->Add(addr.GetV4(), this->_GetZoneIndex(az));
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(this->m_zoneMapLock);
+  this->m_zoneMap = zoneMap;
+}
+
+ZoneSnapshotPtr Ec2DnsClient::GetSnapshot() {
+  auto published = std::atomic_load(&this->m_published);
+  return published ? published->snapshot : ZoneSnapshotPtr();
+}
+
+int64_t Ec2DnsClient::GetSnapshotTaken() {
+  auto published = std::atomic_load(&this->m_published);
+  return published ? published->taken : 0;
+}
+
+void Ec2DnsClient::_RefreshSnapshotImpl(
+    const Aws::Vector<Aws::EC2::Model::Instance>& instances,
+    ZoneSnapshot::AutoscalingGroups groups) {
+  auto previous = this->GetSnapshot();
+  auto now = (uint32_t)duration_cast<seconds>(steady_clock::now().time_since_epoch()).count();
+  std::vector<SnapshotInstance> snapshotInstances;
+  std::vector<uint32_t> snapshotStableSince;
+  snapshotInstances.reserve(instances.size());
+  snapshotStableSince.reserve(instances.size());
+  for (const auto &i : instances) {
+    SnapshotInstance instance;
+    if (!instance.TrySetId(i.GetInstanceId())) {
+      this->m_log(ISC_LOG_WARNING, "ec2dns - Leaving unexpected instance id %s out of the snapshot",
+          i.GetInstanceId().c_str());
+      continue;
+    }
+    ClientAddress addr;
+    bool isV4 = ClientAddress::TryParse(i.GetPrivateIpAddress(), &addr) && addr.GetFamily() == AF_INET;
+    ZoneIndex zone = this->_GetZoneIndex(i.GetPlacement().GetAvailabilityZone());
+    instance.ipv4 = isV4 ? addr.GetV4() : 0;
+    instance.zone = zone >= 0 && zone <= UINT8_MAX ? (uint8_t)zone : UINT8_MAX;
+    instance.flags = isV4 ? SNAPSHOT_INSTANCE_HAS_IPV4 : 0;
+    snapshotInstances.push_back(instance);
+    // An instance keeping its address keeps its stable time.
+    auto last = previous ? previous->FindById(instance) : nullptr;
+    snapshotStableSince.push_back(last != nullptr && last->ipv4 == instance.ipv4 && last->flags == instance.flags
+        ? previous->GetStableSince()[last - previous->GetInstances().begin()]
+        : now);
+  }
+  std::vector<std::string> zones(this->m_zoneIndexes.size());
+  for (const auto &z : this->m_zoneIndexes) {
+    zones[z.second] = z.first;
+  }
+
+  uint32_t serial = ZoneSnapshot::NextSerial(this->GetSnapshotSerial());
+  auto snapshot = std::make_shared<const ZoneSnapshot>(
+      serial, std::move(snapshotInstances), std::move(zones), this->m_hostnameFormat, std::move(groups),
+      std::move(snapshotStableSince));
+
+  // Set ahead of _ScheduleNextRun, for whoever takes up the snapshot.
+  auto taken = steady_clock::now();
+  auto nextRefresh = taken + std::chrono::seconds(this->GetConfig()->refresh_interval);
+  this->m_nextRefresh.store(nextRefresh.time_since_epoch().count(), std::memory_order_relaxed);
+  if (this->m_sharedSnapshot && this->m_sharedSnapshot->IsLeader()) {
+    if (!this->m_sharedSnapshot->Publish(
+        *snapshot, taken.time_since_epoch().count(), nextRefresh.time_since_epoch().count())) {
+      this->m_log(ISC_LOG_WARNING, "ec2dns - Unable to publish shared snapshot %s: %s",
+          this->GetConfig()->shared_snapshot_name.c_str(), strerror(errno));
+    }
+  }
+  this->_SetSnapshot(snapshot, taken.time_since_epoch().count());
+}
+
+void Ec2DnsClient::_SetSnapshot(const ZoneSnapshotPtr& snapshot, int64_t taken) {
+  auto published = std::make_shared<PublishedSnapshot>();
+  published->snapshot = snapshot;
+  if (this->GetConfig()->authoritative_snapshot) {
+    published->bitmaps = this->_BuildAddressBitmaps(*snapshot);
+  }
+  published->taken = taken;
+  std::atomic_store(&this->m_published, std::shared_ptr<const PublishedSnapshot>(published));
+  this->m_refreshFailed.store(false, std::memory_order_relaxed);
+  this->m_snapshotSerial.store(snapshot->GetSerial(), std::memory_order_release);
+  if (this->m_snapshotListener) {
+    this->m_snapshotListener(snapshot);
+  }
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstring>
+
+#include "HeavyHitters.h"
+
+HeavyHitters::HeavyHitters(const std::string& name, size_t capacity, int windowSec)
+  : m_name(name),
+    m_capacity(std::max(capacity, (size_t)1)),
+    m_windowSec(std::max(windowSec, 1)),
+    m_current(0),
+    m_dropped(0) {
+  for (auto &table : this->m_tables) {
+    table.entries.resize(this->m_capacity);
+    table.hashes.resize(this->m_capacity);
+    table.size = 0;
+    table.total = 0;
+    table.start = -1;
+  }
+}
+
+uint32_t HeavyHitters::_Hash(const boost::string_ref& key) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (auto c : key) {
+    hash = (hash ^ (uint8_t)c) * 16777619u;
+  }
+  return hash;
+}
+
+void HeavyHitters::_RotateNoLock(int64_t window) {
+  auto &current = this->m_tables[this->m_current];
+  if (current.start == window) {
+    return;
+  }
+  if (current.start >= 0) {
+    this->m_current ^= 1;
+  }
+  auto &next = this->m_tables[this->m_current];
+  next.size = 0;
+  next.total = 0;
+  next.start = window;
+  if (window - this->m_tables[this->m_current ^ 1].start > 1) {
+    // Nothing was offered in the window before this one.
+    auto &previous = this->m_tables[this->m_current ^ 1];
+    previous.size = 0;
+    previous.total = 0;
+    previous.start = window - 1;
+  }
+}
+
+void HeavyHitters::Offer(const boost::string_ref& key, const std::chrono::steady_clock::time_point now) {
+  auto truncated = key.substr(0, HEAVY_HITTER_KEY_SIZE);
+  auto hash = _Hash(truncated);
+  std::unique_lock<std::mutex> lock(this->m_lock, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    this->m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  auto seconds = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+  this->_RotateNoLock(seconds / this->m_windowSec);
+
+  auto &table = this->m_tables[this->m_current];
+  table.total++;
+  for (size_t i = 0; i < table.size; i++) {
+    if (table.hashes[i] == hash) {
+      auto &entry = table.entries[i];
+      if (entry.len == truncated.size() && memcmp(entry.key, truncated.data(), entry.len) == 0) {
+        entry.count++;
+        return;
+      }
+    }
+  }
+
+  size_t slot = table.size;
+  uint64_t floor = 0;
+  if (table.size < this->m_capacity) {
+    table.size++;
+  }
+  else {
+    slot = 0;
+    for (size_t i = 1; i < table.size; i++) {
+      if (table.entries[i].count < table.entries[slot].count) {
+        slot = i;
+      }
+    }
+    floor = table.entries[slot].count;
+  }
+  auto &entry = table.entries[slot];
+  table.hashes[slot] = hash;
+  entry.count = floor + 1;
+  entry.error = floor;
+  entry.len = truncated.size();
+  memcpy(entry.key, truncated.data(), entry.len);
+}
+
+HeavyHitterWindow HeavyHitters::_GetWindow(bool previous, const std::chrono::steady_clock::time_point now) {
+  HeavyHitterWindow window;
+  {
+    std::lock_guard<std::mutex> lock(this->m_lock);
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    this->_RotateNoLock(seconds / this->m_windowSec);
+    auto &table = this->m_tables[previous ? this->m_current ^ 1 : this->m_current];
+    window.total = table.total;
+    for (size_t i = 0; i < table.size; i++) {
+      auto &entry = table.entries[i];
+      window.top.push_back(HeavyHitter{std::string(entry.key, entry.len), entry.count, entry.error});
+    }
+  }
+  std::sort(window.top.begin(), window.top.end(), [](const HeavyHitter& a, const HeavyHitter& b) {
+    return a.count > b.count;
+  });
+  return window;
+}
+
+HeavyHitterWindow HeavyHitters::GetCurrent(const std::chrono::steady_clock::time_point now) {
+  return this->_GetWindow(false, now);
+}
+
+HeavyHitterWindow HeavyHitters::GetPrevious(const std::chrono::steady_clock::time_point now) {
+  return this->_GetWindow(true, now);
+}
+
+static Aws::Utils::Json::JsonValue window_to_json(const HeavyHitterWindow& window) {
+  std::vector<Aws::Utils::Json::JsonValue> top;
+  for (auto &h : window.top) {
+    top.push_back(Aws::Utils::Json::JsonValue()
+        .WithString("key", h.key)
+        .WithInt64("count", h.count)
+        .WithInt64("error", h.error));
+  }
+  return Aws::Utils::Json::JsonValue()
+      .WithInt64("total", window.total)
+      .WithArray("top", top);
+}
+
+Aws::Utils::Json::JsonValue HeavyHitters::ToJson() {
+  auto now = std::chrono::steady_clock::now();
+  return Aws::Utils::Json::JsonValue()
+      .WithInteger("window_sec", this->m_windowSec)
+      .WithInt64("dropped", this->GetDropped())
+      .WithObject("current", window_to_json(this->GetCurrent(now)))
+      .WithObject("previous", window_to_json(this->GetPrevious(now)));
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Histogram.h"
+
+#define SUB_BUCKETS (1u << HISTOGRAM_SUB_BITS)
+
+size_t Histogram::GetBucket(uint64_t value) {
+  if (value < SUB_BUCKETS) {
+    return (size_t)value;
+  }
+  int exponent = 63 - __builtin_clzll(value);
+  if (exponent > HISTOGRAM_MAX_EXPONENT) {
+    return HISTOGRAM_NUM_BUCKETS - 1;
+  }
+  int shift = exponent - HISTOGRAM_SUB_BITS;
+  return ((size_t)(shift + 1) << HISTOGRAM_SUB_BITS) + (size_t)((value >> shift) - SUB_BUCKETS);
+}
+
+uint64_t Histogram::GetBucketUpperBound(size_t bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  int shift = (int)(bucket >> HISTOGRAM_SUB_BITS) - 1;
+  uint64_t lower = (uint64_t)(SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) << shift;
+  return lower + ((uint64_t)1 << shift) - 1;
+}
+
+HistogramSnapshot Histogram::GetSnapshot() const {
+  HistogramSnapshot snapshot;
+  for (size_t i = 0; i < HISTOGRAM_NUM_BUCKETS; i++) {
+    snapshot.m_counts[i] = this->m_counts[i].load(std::memory_order_relaxed);
+    snapshot.m_count += snapshot.m_counts[i];
+  }
+  snapshot.m_sum = this->m_sum.load(std::memory_order_relaxed);
+  snapshot.m_max = this->m_max.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+uint64_t HistogramSnapshot::GetPercentile(double q) const {
+  if (this->m_count == 0) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)std::ceil(std::min(std::max(q, 0.0), 1.0) * this->m_count);
+  rank = std::max(rank, (uint64_t)1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < this->m_counts.size(); i++) {
+    seen += this->m_counts[i];
+    if (seen >= rank) {
+      return std::min(Histogram::GetBucketUpperBound(i), this->m_max);
+    }
+  }
+  return this->m_max;
+}
+
+uint64_t HistogramSnapshot::GetCountAtMost(uint64_t value) const {
+  uint64_t count = 0;
+  for (size_t i = 0; i < this->m_counts.size() && Histogram::GetBucketUpperBound(i) <= value; i++) {
+    count += this->m_counts[i];
+  }
+  return count;
+}
+
+void HistogramSnapshot::Merge(const HistogramSnapshot &other) {
+  for (size_t i = 0; i < this->m_counts.size(); i++) {
+    this->m_counts[i] += other.m_counts[i];
+  }
+  this->m_count += other.m_count;
+  this->m_sum += other.m_sum;
+  this->m_max = std::max(this->m_max, other.m_max);
+}
@@ -1,3 +0,0 @@
-#include "KRandom.h"
-
-boost::thread_specific_ptr<std::default_random_engine> tls_random::m_ptr;
\ No newline at end of file
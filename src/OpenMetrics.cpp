@@ -0,0 +1,111 @@
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include "OpenMetrics.h"
+
+// Bucket bounds exported for latency histograms, in microseconds.
+static const uint64_t s_bucketBoundsUs[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000, 60000000
+};
+
+// Keeps the families in the order their first stat was created.
+template<typename T>
+static std::vector<std::pair<std::string, std::vector<std::shared_ptr<T>>>> group_by_family(
+    const std::vector<std::shared_ptr<T>>& stats) {
+  std::vector<std::pair<std::string, std::vector<std::shared_ptr<T>>>> families;
+  std::map<std::string, size_t> index;
+  for (auto &s : stats) {
+    auto &name = s->GetMetric().name;
+    auto it = index.find(name);
+    if (it == index.end()) {
+      it = index.insert(std::make_pair(name, families.size())).first;
+      families.push_back(std::make_pair(name, std::vector<std::shared_ptr<T>>()));
+    }
+    families[it->second].second.push_back(s);
+  }
+  return families;
+}
+
+static void write_labels(std::ostream& out, const MetricLabels& labels, const char *le = nullptr) {
+  if (labels.empty() && le == nullptr) {
+    return;
+  }
+  out << "{";
+  bool first = true;
+  for (auto &l : labels) {
+    out << (first ? "" : ",") << l.first << "=\"" << OpenMetricsWriter::EscapeLabelValue(l.second) << "\"";
+    first = false;
+  }
+  if (le != nullptr) {
+    out << (first ? "" : ",") << "le=\"" << le << "\"";
+  }
+  out << "}";
+}
+
+static std::string format_seconds(uint64_t us) {
+  std::ostringstream out;
+  out.precision(9);
+  out << (double)us / 1000000.0;
+  auto ret = out.str();
+  if (ret.find_first_of(".e") == std::string::npos) {
+    ret += ".0";
+  }
+  return ret;
+}
+
+std::string OpenMetricsWriter::EscapeLabelValue(const std::string& value) {
+  std::string ret;
+  ret.reserve(value.size());
+  for (auto c : value) {
+    switch (c) {
+      case '\\': ret += "\\\\"; break;
+      case '"': ret += "\\\""; break;
+      case '\n': ret += "\\n"; break;
+      default: ret += c;
+    }
+  }
+  return ret;
+}
+
+void OpenMetricsWriter::Render(StatsReceiver &stats, const Sink &sink) {
+  for (auto &family : group_by_family(stats.GetAllStats())) {
+    std::ostringstream out;
+    auto name = OPENMETRICS_PREFIX + family.first;
+    out << "# TYPE " << name << " counter\n";
+    for (auto &s : family.second) {
+      out << name << "_total";
+      write_labels(out, s->GetMetric().labels);
+      out << " " << s->GetValue() << "\n";
+    }
+    sink(out.str());
+  }
+
+  for (auto &family : group_by_family(stats.GetAllHistograms())) {
+    std::ostringstream out;
+    auto name = OPENMETRICS_PREFIX + family.first + "_seconds";
+    out << "# TYPE " << name << " histogram\n";
+    out << "# UNIT " << name << " seconds\n";
+    for (auto &h : family.second) {
+      auto &labels = h->GetMetric().labels;
+      auto snapshot = h->GetSnapshot();
+      for (auto bound : s_bucketBoundsUs) {
+        out << name << "_bucket";
+        write_labels(out, labels, format_seconds(bound).c_str());
+        out << " " << snapshot.GetCountAtMost(bound) << "\n";
+      }
+      out << name << "_bucket";
+      write_labels(out, labels, "+Inf");
+      out << " " << snapshot.GetCount() << "\n";
+      out << name << "_count";
+      write_labels(out, labels);
+      out << " " << snapshot.GetCount() << "\n";
+      out << name << "_sum";
+      write_labels(out, labels);
+      out << " " << format_seconds(snapshot.GetSum()) << "\n";
+    }
+    sink(out.str());
+  }
+  sink("# EOF\n");
+}
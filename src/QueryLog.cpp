@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "QueryLog.h"
+
+QueryLogWriter::QueryLogWriter(
+    const std::string& path,
+    size_t sampleEvery,
+    uint64_t maxBytes,
+    std::shared_ptr<StatsReceiver> statsReceiver,
+    size_t bufferBytes)
+  : m_file(fopen(path.c_str(), "wb")),
+    m_sampleEvery(sampleEvery),
+    m_maxBytes(maxBytes),
+    m_bufferBytes(std::max(bufferBytes, (size_t)QUERY_LOG_MAX_RECORD_SIZE)),
+    m_pending(false),
+    m_stop(false),
+    m_full(false),
+    m_bytes(QUERY_LOG_MAGIC_SIZE),
+    m_records(statsReceiver->Create("query_log_records")),
+    m_dropped(statsReceiver->Create("query_log_dropped")) {
+  this->m_current.data.reset(new char[this->m_bufferBytes]);
+  this->m_current.used = 0;
+  this->m_spare.data.reset(new char[this->m_bufferBytes]);
+  this->m_spare.used = 0;
+  this->m_lastZone[0] = '\0';
+  if (this->m_file == nullptr) {
+    return;
+  }
+  fwrite(QUERY_LOG_MAGIC, 1, QUERY_LOG_MAGIC_SIZE, this->m_file);
+  this->m_writeThread = std::thread(&QueryLogWriter::_WriteLoop, this);
+}
+
+QueryLogWriter::~QueryLogWriter() {
+  {
+    std::lock_guard<std::mutex> lock(this->m_lock);
+    this->m_stop = true;
+  }
+  this->m_cond.notify_all();
+  if (this->m_writeThread.joinable()) {
+    this->m_writeThread.join();
+  }
+  if (this->m_file != nullptr) {
+    fclose(this->m_file);
+  }
+}
+
+void QueryLogWriter::Append(uint64_t timestampUs, const char *zone, const char *name, const ClientAddress& client) {
+  if (this->m_file == nullptr) {
+    return;
+  }
+  size_t zoneLen = std::min(strlen(zone), (size_t)255);
+  size_t nameLen = std::min(strlen(name), (size_t)255);
+  size_t addrLen = client.GetLength();
+
+  std::lock_guard<std::mutex> lock(this->m_lock);
+  bool sameZone = strncmp(this->m_lastZone, zone, zoneLen) == 0 && this->m_lastZone[zoneLen] == '\0';
+  size_t size = QUERY_LOG_HEADER_SIZE + addrLen + (sameZone ? 0 : zoneLen) + nameLen;
+  if (!this->m_full && this->m_bytes + size > this->m_maxBytes) {
+    this->m_full = true;
+  }
+  if (this->m_full) {
+    this->m_dropped->Increment();
+    return;
+  }
+  if (this->m_current.used + size > this->m_bufferBytes) {
+    if (this->m_pending) {
+      this->m_dropped->Increment();
+      return;
+    }
+    std::swap(this->m_current, this->m_spare);
+    this->m_pending = true;
+    this->m_cond.notify_one();
+  }
+
+  auto out = this->m_current.data.get() + this->m_current.used;
+  memcpy(out, &timestampUs, sizeof(timestampUs));
+  out[8] = sameZone ? QUERY_LOG_SAME_ZONE : 0;
+  out[9] = (char)addrLen;
+  out[10] = (char)(sameZone ? 0 : zoneLen);
+  out[11] = (char)nameLen;
+  out += QUERY_LOG_HEADER_SIZE;
+  memcpy(out, client.GetBytes(), addrLen);
+  out += addrLen;
+  if (!sameZone) {
+    memcpy(out, zone, zoneLen);
+    out += zoneLen;
+    memcpy(this->m_lastZone, zone, zoneLen);
+    this->m_lastZone[zoneLen] = '\0';
+  }
+  memcpy(out, name, nameLen);
+  this->m_current.used += size;
+  this->m_bytes += size;
+  this->m_records->Increment();
+}
+
+void QueryLogWriter::Flush() {
+  if (this->m_file == nullptr) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(this->m_lock);
+  while (this->m_pending) {
+    this->m_cond.wait(lock);
+  }
+  if (this->m_current.used > 0) {
+    std::swap(this->m_current, this->m_spare);
+    this->_Write(&this->m_spare);
+  }
+  fflush(this->m_file);
+}
+
+void QueryLogWriter::_Write(Buffer *buffer) {
+  fwrite(buffer->data.get(), 1, buffer->used, this->m_file);
+  buffer->used = 0;
+}
+
+void QueryLogWriter::_WriteLoop() {
+  std::unique_lock<std::mutex> lock(this->m_lock);
+  while (true) {
+    this->m_cond.wait_for(lock, std::chrono::seconds(1), [this] { return this->m_pending || this->m_stop; });
+    if (!this->m_pending && this->m_current.used > 0) {
+      std::swap(this->m_current, this->m_spare);
+      this->m_pending = true;
+    }
+    if (this->m_pending) {
+      // Appends carry on into m_current while the spare is written.
+      lock.unlock();
+      this->_Write(&this->m_spare);
+      fflush(this->m_file);
+      lock.lock();
+      this->m_pending = false;
+      this->m_cond.notify_all();
+    }
+    if (this->m_stop && this->m_current.used == 0) {
+      return;
+    }
+  }
+}
+
+QueryLogReader::~QueryLogReader() {
+  if (this->m_file != nullptr) {
+    fclose(this->m_file);
+  }
+}
+
+bool QueryLogReader::Open(const std::string& path) {
+  this->m_file = fopen(path.c_str(), "rb");
+  if (this->m_file == nullptr) {
+    return false;
+  }
+  char magic[QUERY_LOG_MAGIC_SIZE];
+  return fread(magic, 1, sizeof(magic), this->m_file) == sizeof(magic)
+      && memcmp(magic, QUERY_LOG_MAGIC, sizeof(magic)) == 0;
+}
+
+bool QueryLogReader::Next(QueryLogEntry *entry) {
+  unsigned char header[QUERY_LOG_HEADER_SIZE];
+  if (this->m_file == nullptr || fread(header, 1, sizeof(header), this->m_file) != sizeof(header)) {
+    return false;
+  }
+  memcpy(&entry->timestamp_us, header, sizeof(entry->timestamp_us));
+  size_t addrLen = header[9], zoneLen = header[10], nameLen = header[11];
+  char data[16 + 255 + 255];
+  if (addrLen > 16 || fread(data, 1, addrLen + zoneLen + nameLen, this->m_file) != addrLen + zoneLen + nameLen) {
+    return false;
+  }
+
+  entry->client = ClientAddress();
+  if (addrLen == sizeof(struct in_addr)) {
+    struct in_addr addr;
+    memcpy(&addr, data, addrLen);
+    entry->client = ClientAddress::FromV4(addr);
+  }
+  else if (addrLen == sizeof(struct in6_addr)) {
+    struct in6_addr addr;
+    memcpy(&addr, data, addrLen);
+    entry->client = ClientAddress::FromV6(addr);
+  }
+  if (!(header[8] & QUERY_LOG_SAME_ZONE)) {
+    this->m_lastZone.assign(data + addrLen, zoneLen);
+  }
+  entry->zone = this->m_lastZone;
+  entry->name.assign(data + addrLen + zoneLen, nameLen);
+  return true;
+}
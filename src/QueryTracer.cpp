@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstring>
+
+#include "aws/core/utils/json/JsonSerializer.h"
+
+#include "QueryTracer.h"
+
+static bool slower_than(const QueryTrace& a, const QueryTrace& b) {
+  return a.total_us > b.total_us;
+}
+
+void QueryTrace::Begin(const char *zone, const char *name, bool sampled) {
+  this->sampled = sampled;
+  auto sinceStart = std::chrono::steady_clock::now() - this->start;
+  this->timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch() - sinceStart).count();
+  strncpy(this->zone, zone, sizeof(this->zone) - 1);
+  this->zone[sizeof(this->zone) - 1] = '\0';
+  strncpy(this->name, name, sizeof(this->name) - 1);
+  this->name[sizeof(this->name) - 1] = '\0';
+}
+
+QueryTracer::QueryTracer(size_t sampleEvery, size_t capacity, size_t numSlowest)
+  : m_sampleEvery(sampleEvery),
+    m_numSlowest(numSlowest),
+    m_slots(std::max(capacity, (size_t)1)),
+    m_next(0),
+    m_dropped(0),
+    m_slowThreshold(numSlowest == 0 ? (int64_t)UINT32_MAX : -1) {
+  this->m_slowest.reserve(numSlowest);
+}
+
+void QueryTracer::Record(const QueryTrace& trace) {
+  auto seq = this->m_next.fetch_add(1, std::memory_order_relaxed) + 1;
+  auto &slot = this->m_slots[seq % this->m_slots.size()];
+  if (slot.lock.test_and_set(std::memory_order_acquire)) {
+    this->m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (slot.seq > seq) {
+    // Lapped by a newer trace while we waited.
+    slot.lock.clear(std::memory_order_release);
+    this->m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  slot.seq = seq;
+  slot.trace = trace;
+  slot.lock.clear(std::memory_order_release);
+}
+
+void QueryTracer::OfferSlow(const QueryTrace& trace) {
+  std::lock_guard<std::mutex> lock(this->m_slowLock);
+  if (!this->IsSlow(trace.total_us)) {
+    return;
+  }
+  if (this->m_slowest.size() == this->m_numSlowest) {
+    std::pop_heap(this->m_slowest.begin(), this->m_slowest.end(), slower_than);
+    this->m_slowest.pop_back();
+  }
+  this->m_slowest.push_back(trace);
+  std::push_heap(this->m_slowest.begin(), this->m_slowest.end(), slower_than);
+  if (this->m_slowest.size() == this->m_numSlowest) {
+    this->m_slowThreshold.store(this->m_slowest.front().total_us, std::memory_order_relaxed);
+  }
+}
+
+std::vector<QueryTrace> QueryTracer::GetRecent() {
+  std::vector<std::pair<uint64_t, QueryTrace>> traces;
+  for (auto &slot : this->m_slots) {
+    while (slot.lock.test_and_set(std::memory_order_acquire)) {
+      // Writers only hold a slot for the copy.
+    }
+    if (slot.seq != 0) {
+      traces.push_back(std::make_pair(slot.seq, slot.trace));
+    }
+    slot.lock.clear(std::memory_order_release);
+  }
+  std::sort(traces.begin(), traces.end(),
+      [](const std::pair<uint64_t, QueryTrace>& a, const std::pair<uint64_t, QueryTrace>& b) {
+        return a.first > b.first;
+      });
+  std::vector<QueryTrace> ret;
+  ret.reserve(traces.size());
+  for (auto &t : traces) {
+    ret.push_back(t.second);
+  }
+  return ret;
+}
+
+std::vector<QueryTrace> QueryTracer::GetSlowest() {
+  std::vector<QueryTrace> ret;
+  {
+    std::lock_guard<std::mutex> lock(this->m_slowLock);
+    ret = this->m_slowest;
+  }
+  std::sort(ret.begin(), ret.end(), slower_than);
+  return ret;
+}
+
+const char* QueryTracer::GetPathName(QueryPath path) {
+  switch (path) {
+    case QueryPath::Apex: return "apex";
+    case QueryPath::Wildcard: return "wildcard";
+    case QueryPath::Reverse: return "reverse";
+    case QueryPath::Synthesized: return "synthesized";
+    case QueryPath::Autoscaler: return "autoscaler";
+    case QueryPath::RegexMiss: return "regex_miss";
+    case QueryPath::Forward: return "forward";
+  }
+  return "unknown";
+}
+
+static const char* get_outcome_name(LookupOutcome outcome) {
+  switch (outcome) {
+    case LookupOutcome::Hit: return "hit";
+    case LookupOutcome::Miss: return "miss";
+    case LookupOutcome::Throttled: return "throttled";
+    case LookupOutcome::Absent: return "absent";
+  }
+  return "unknown";
+}
+
+static std::vector<Aws::Utils::Json::JsonValue> to_json(const std::vector<QueryTrace>& traces) {
+  std::vector<Aws::Utils::Json::JsonValue> ret;
+  for (auto &t : traces) {
+    Aws::Utils::Json::JsonValue trace;
+    trace.WithInt64("timestamp_us", t.timestamp_us)
+        .WithString("zone", t.zone)
+        .WithString("name", t.name)
+        .WithString("client", t.client.ToString())
+        .WithString("path", QueryTracer::GetPathName(t.path))
+        .WithString("outcome", get_outcome_name(t.outcome))
+        .WithInteger("result", t.result)
+        .WithInt64("ttl", t.ttl)
+        .WithInt64("total_us", t.total_us)
+        .WithBool("sampled", t.sampled);
+    if (t.sampled) {
+      trace.WithInt64("classified_us", t.phase_us[(int)QueryPhase::Classified])
+          .WithInt64("resolved_us", t.phase_us[(int)QueryPhase::Resolved])
+          .WithInt64("answered_us", t.phase_us[(int)QueryPhase::Answered]);
+    }
+    ret.push_back(trace);
+  }
+  return ret;
+}
+
+std::string QueryTracer::RenderJson() {
+  Aws::Utils::Json::JsonValue root;
+  root.WithInt64("sample_every", this->m_sampleEvery)
+      .WithInt64("dropped", this->GetDropped())
+      .WithArray("recent", to_json(this->GetRecent()))
+      .WithArray("slowest", to_json(this->GetSlowest()));
+  return root.WriteReadable();
+}
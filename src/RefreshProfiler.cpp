@@ -0,0 +1,131 @@
+#include <cstdio>
+#include <ctime>
+
+#include <malloc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "aws/core/utils/json/JsonSerializer.h"
+
+#include "RefreshProfiler.h"
+
+using namespace std::chrono;
+
+uint64_t RefreshProfiler::GetRssBytes() {
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == nullptr) {
+    return 0;
+  }
+  unsigned long size = 0, resident = 0;
+  int read = fscanf(f, "%lu %lu", &size, &resident);
+  fclose(f);
+  return read == 2 ? (uint64_t)resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+uint64_t RefreshProfiler::GetPeakRssBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  // ru_maxrss is in kilobytes on Linux.
+  return (uint64_t)usage.ru_maxrss * 1024;
+}
+
+int64_t RefreshProfiler::GetHeapInUseBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  auto info = mallinfo2();
+  return (int64_t)(info.uordblks + info.hblkhd);
+#elif defined(__GLIBC__)
+  auto info = mallinfo();
+  return (int64_t)(unsigned)info.uordblks + (int64_t)(unsigned)info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+void RefreshProfiler::BeginCycle() {
+  this->m_current = RefreshProfile();
+  this->m_current.timestamp = (int64_t)time(nullptr);
+  this->m_current.rss_before_bytes = GetRssBytes();
+  this->m_inCycle = true;
+  this->m_depth = 0;
+  this->m_cycleStart = steady_clock::now();
+  this->m_cycleHeapBefore = GetHeapInUseBytes();
+}
+
+void RefreshProfiler::EndCycle(bool success, size_t instances) {
+  if (!this->m_inCycle) {
+    return;
+  }
+  this->m_inCycle = false;
+  auto &current = this->m_current;
+  current.duration_us = duration_cast<microseconds>(steady_clock::now() - this->m_cycleStart).count();
+  current.success = success;
+  current.instances = instances;
+  current.heap_delta_bytes = GetHeapInUseBytes() - this->m_cycleHeapBefore;
+  current.rss_after_bytes = GetRssBytes();
+  current.peak_rss_bytes = GetPeakRssBytes();
+
+  std::lock_guard<std::mutex> lock(this->m_historyLock);
+  this->m_history.push_back(std::move(current));
+  while (this->m_history.size() > this->m_historySize) {
+    this->m_history.pop_front();
+  }
+}
+
+RefreshProfiler::Phase::Phase(RefreshProfiler *profiler, const char *name, Histogram *histogram)
+  : m_profiler(profiler != nullptr && profiler->m_inCycle ? profiler : nullptr),
+    m_histogram(histogram),
+    m_index(0),
+    m_start(steady_clock::now()),
+    m_heapBefore(0) {
+  if (this->m_profiler != nullptr) {
+    auto &phases = this->m_profiler->m_current.phases;
+    this->m_index = phases.size();
+    phases.push_back(RefreshPhaseProfile{name, this->m_profiler->m_depth++, 0, 0});
+    this->m_heapBefore = GetHeapInUseBytes();
+  }
+}
+
+RefreshProfiler::Phase::~Phase() {
+  auto durationUs = duration_cast<microseconds>(steady_clock::now() - this->m_start).count();
+  if (this->m_histogram != nullptr) {
+    this->m_histogram->Record(durationUs);
+  }
+  if (this->m_profiler != nullptr) {
+    auto &phase = this->m_profiler->m_current.phases[this->m_index];
+    phase.duration_us = durationUs;
+    phase.heap_delta_bytes = GetHeapInUseBytes() - this->m_heapBefore;
+    this->m_profiler->m_depth--;
+  }
+}
+
+std::vector<RefreshProfile> RefreshProfiler::GetHistory() {
+  std::lock_guard<std::mutex> lock(this->m_historyLock);
+  return std::vector<RefreshProfile>(this->m_history.begin(), this->m_history.end());
+}
+
+std::string RefreshProfiler::RenderJson() {
+  std::vector<Aws::Utils::Json::JsonValue> cycles;
+  for (const auto &cycle : this->GetHistory()) {
+    std::vector<Aws::Utils::Json::JsonValue> phases;
+    for (const auto &phase : cycle.phases) {
+      phases.push_back(Aws::Utils::Json::JsonValue()
+          .WithString("name", phase.name)
+          .WithInteger("depth", phase.depth)
+          .WithInt64("duration_us", phase.duration_us)
+          .WithInt64("heap_delta_bytes", phase.heap_delta_bytes));
+    }
+    cycles.push_back(Aws::Utils::Json::JsonValue()
+        .WithInt64("timestamp", cycle.timestamp)
+        .WithInt64("duration_us", cycle.duration_us)
+        .WithBool("success", cycle.success)
+        .WithInt64("instances", cycle.instances)
+        .WithInt64("rss_before_bytes", cycle.rss_before_bytes)
+        .WithInt64("rss_after_bytes", cycle.rss_after_bytes)
+        .WithInt64("peak_rss_bytes", cycle.peak_rss_bytes)
+        .WithInt64("heap_delta_bytes", cycle.heap_delta_bytes)
+        .WithArray("phases", phases));
+  }
+  return Aws::Utils::Json::JsonValue().WithArray("cycles", cycles).WriteReadable();
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+
+#include "RefreshRegistry.h"
+#include "aws/core/utils/logging/AWSLogging.h"
+#include "aws/core/utils/logging/DefaultLogSystem.h"
+
+RefreshEngine::RefreshEngine(uint32_t id, std::shared_ptr<Ec2DnsClient> owner)
+  : m_id(id),
+    m_owner(owner),
+    m_ownerListener(owner->GetSnapshotListener()),
+    m_ownerJoined(true) {
+  owner->SetSnapshotListener([this](const ZoneSnapshotPtr& snapshot) { this->_OnSnapshot(snapshot); });
+  owner->LaunchRefreshThread();
+}
+
+RefreshEngine::~RefreshEngine() {
+  // Its listener points here, and it may outlive this in its zone's state.
+  this->m_owner->StopRefreshThread();
+}
+
+void RefreshEngine::Join(Ec2DnsClient *client) {
+  std::lock_guard<std::mutex> lock(this->m_zonesLock);
+  this->m_followers.push_back(client);
+  auto snapshot = this->m_owner->GetSnapshot();
+  if (snapshot) {
+    client->FollowSnapshot(snapshot, this->m_owner->GetSnapshotTaken(), this->m_owner->GetNextRefresh());
+  }
+}
+
+void RefreshEngine::Leave(Ec2DnsClient *client) {
+  std::lock_guard<std::mutex> lock(this->m_zonesLock);
+  if (client == this->m_owner.get()) {
+    this->m_ownerListener = nullptr;
+    this->m_ownerJoined = false;
+    return;
+  }
+  this->m_followers.erase(
+      std::remove(this->m_followers.begin(), this->m_followers.end(), client), this->m_followers.end());
+}
+
+size_t RefreshEngine::GetNumZones() {
+  std::lock_guard<std::mutex> lock(this->m_zonesLock);
+  return this->m_followers.size() + (this->m_ownerJoined ? 1 : 0);
+}
+
+Aws::Utils::Json::JsonValue RefreshEngine::ToJson() {
+  auto config = this->m_owner->GetConfig();
+  return Aws::Utils::Json::JsonValue()
+      .WithInteger("id", this->m_id)
+      .WithString("region", config->client_config.region)
+      .WithString("endpoint", config->client_config.endpointOverride)
+      .WithInt64("zones", this->GetNumZones())
+      .WithInt64("serial", this->m_owner->GetSnapshotSerial());
+}
+
+void RefreshEngine::_OnSnapshot(const ZoneSnapshotPtr& snapshot) {
+  std::lock_guard<std::mutex> lock(this->m_zonesLock);
+  if (this->m_ownerListener) {
+    this->m_ownerListener(snapshot);
+  }
+  auto taken = this->m_owner->GetSnapshotTaken();
+  auto nextRefresh = this->m_owner->GetNextRefresh();
+  for (auto follower : this->m_followers) {
+    follower->FollowSnapshot(snapshot, taken, nextRefresh);
+  }
+}
+
+RefreshRegistry& RefreshRegistry::Get() {
+  static RefreshRegistry registry;
+  return registry;
+}
+
+std::string RefreshRegistry::GetKey(const Ec2DnsConfig& config) {
+  std::string key;
+  for (const auto &part : {
+      std::string(config.aws_access_key.c_str()),
+      std::string(config.aws_secret_key.c_str()),
+      std::string(config.client_config.region.c_str()),
+      std::string(config.client_config.endpointOverride.c_str()),
+      std::string(config.client_config.scheme == Aws::Http::Scheme::HTTPS ? "https" : "http"),
+      config.asg_dns_tag,
+      config.shared_snapshot_name,
+      config.shared_snapshot_lock_path}) {
+    key += part;
+    key += '\0';
+  }
+  return key;
+}
+
+std::shared_ptr<RefreshEngine> RefreshRegistry::Join(const std::shared_ptr<Ec2DnsClient>& client) {
+  auto key = GetKey(*client->GetConfig());
+  std::lock_guard<std::mutex> lock(this->m_lock);
+  auto engine = this->m_engines[key].lock();
+  if (engine) {
+    engine->Join(client.get());
+    return engine;
+  }
+  engine = std::make_shared<RefreshEngine>(this->m_nextId++, client);
+  this->m_engines[key] = engine;
+  return engine;
+}
+
+std::vector<std::shared_ptr<RefreshEngine>> RefreshRegistry::GetEngines() {
+  std::vector<std::shared_ptr<RefreshEngine>> engines;
+  std::lock_guard<std::mutex> lock(this->m_lock);
+  for (auto it = this->m_engines.begin(); it != this->m_engines.end();) {
+    auto engine = it->second.lock();
+    if (engine) {
+      engines.push_back(engine);
+      it++;
+    }
+    else {
+      it = this->m_engines.erase(it);
+    }
+  }
+  std::sort(engines.begin(), engines.end(),
+      [](const std::shared_ptr<RefreshEngine>& a, const std::shared_ptr<RefreshEngine>& b) {
+        return a->GetId() < b->GetId();
+      });
+  return engines;
+}
+
+SdkLifetime& SdkLifetime::Get() {
+  static SdkLifetime lifetime;
+  return lifetime;
+}
+
+void SdkLifetime::Acquire(const Aws::SDKOptions& options, const std::string& logPath) {
+  std::lock_guard<std::mutex> lock(this->m_lock);
+  if (this->m_users++ > 0) {
+    return;
+  }
+  this->m_options = options;
+  Aws::InitAPI(this->m_options);
+  Aws::Utils::Logging::InitializeAWSLogging(
+      Aws::MakeShared<Aws::Utils::Logging::DefaultLogSystem>(
+          "log", this->m_options.loggingOptions.logLevel, logPath));
+}
+
+void SdkLifetime::Release() {
+  std::lock_guard<std::mutex> lock(this->m_lock);
+  if (this->m_users == 0 || --this->m_users > 0) {
+    return;
+  }
+  Aws::Utils::Logging::ShutdownAWSLogging();
+  Aws::ShutdownAPI(this->m_options);
+}
+
+size_t SdkLifetime::GetNumUsers() {
+  std::lock_guard<std::mutex> lock(this->m_lock);
+  return this->m_users;
+}
@@ -4,7 +4,7 @@
 #include <vector>
 
 void RequestThrottler::Trim() {
-  std::lock_guard<std::mutex> lock(this->m_cacheLock);
+  std::lock_guard<TimedMutex> lock(this->m_cacheLock);
   std::vector<std::string> toDelete;
   time_point<steady_clock> now = steady_clock::now();
   // Delete expired entries
@@ -18,35 +18,32 @@ void RequestThrottler::Trim() {
   }
 }
 
-void RequestThrottler::OnMiss(const std::string &key, const std::string &clientAddr) {
-  std::lock_guard<std::mutex> lock(this->m_cacheLock);
+void RequestThrottler::OnMiss(const std::string &key) {
+  // Parsed once here so throttle checks compare addresses in binary.
+  ClientAddress keyAddr;
+  ClientAddress::TryParse(key, &keyAddr);
+  std::lock_guard<TimedMutex> lock(this->m_cacheLock);
   auto expiresOn = std::chrono::steady_clock::now() + std::chrono::seconds(240);
-  this->m_cache[key] = CacheEntry<std::string>(clientAddr, expiresOn);
+  this->m_cache[key] = CacheEntry<ClientAddress>(keyAddr, expiresOn);
 }
 
-bool RequestThrottler::IsRequestThrottled(const std::string &clientAddr, const std::string &key) {
-  // Never throttle a client requesting its own IP.
-  if (clientAddr == key) {
-    return false;
-  }
-
-  {
-    std::lock_guard<std::mutex> lock(this->m_cacheLock);
-    auto found = this->m_cache.find(key);
+bool RequestThrottler::IsRequestThrottled(const ClientAddress &clientAddr, const std::string &key) {
+  std::lock_guard<TimedMutex> lock(this->m_cacheLock);
+  auto found = this->m_cache.find(key);
 
-    // It was found in the cache
-    if (found != this->m_cache.end()) {
-      // But it's now expired
-      if (!found->second.IsValid()) {
-        this->m_cache.erase(found);
-        return false;
-      } else {
-        // Still valid, throttle.
-        return true;
-      }
-    } else {
-      // Not found in the cache
+  // It was found in the cache
+  if (found != this->m_cache.end()) {
+    // But it's now expired
+    if (!found->second.IsValid()) {
+      this->m_cache.erase(found);
       return false;
+    } else {
+      // Still valid, throttle, unless a client is requesting its own IP.
+      const auto &keyAddr = found->second.GetItem();
+      return !keyAddr.IsValid() || keyAddr != clientAddr;
     }
+  } else {
+    // Not found in the cache
+    return false;
   }
 }
\ No newline at end of file
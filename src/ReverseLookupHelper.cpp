@@ -1,68 +1,178 @@
 #include <arpa/inet.h>
+#include <cstring>
+#include <strings.h>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/trim.hpp>
 
 #include "ReverseLookupHelper.h"
 
-bool ReverseLookupHelper::InitializeReverseLookupZones(const std::string &vpcCidr) {
+#define REVERSE_SUFFIX ".in-addr.arpa"
+#define REVERSE_SUFFIX_LEN (sizeof(REVERSE_SUFFIX) - 1)
+
+bool Ipv4Cidr::TryParse(const std::string &cidr, Ipv4Cidr *result) {
   std::vector<std::string> split;
-  boost::algorithm::split(split, vpcCidr, boost::is_any_of("/"));
+  boost::algorithm::split(split, cidr, boost::is_any_of("/"));
   if (split.size() != 2) {
     return false;
   }
 
-  auto ip = split[0];
-  auto bitsStr = split[1];
-
   uint32_t ipBits;
-  inet_pton(AF_INET, ip.c_str(), &ipBits);
-  ipBits &= 0x00FFFFFF;
-
-  uint8_t bits = (uint8_t)atoi(bitsStr.c_str());
-  if (bits < 8 || bits > 24) {
-    // The mask is too large or small.
+  if (inet_pton(AF_INET, boost::algorithm::trim_copy(split[0]).c_str(), &ipBits) != 1) {
     return false;
   }
-  uint32_t maskRange = (1 << ((32 - bits) - 8));
-
-  //Generate all class C subnets that fall inside the CIDR.
-  for (int a = 0; a < maskRange; a++) {
-    char buff[100] = {0};
-    uint32_t flipped = htonl(ipBits);
-    inet_ntop(AF_INET, &flipped, buff, sizeof(buff));
-    std::string cidrStr(buff + 2);
-    this->m_rlZones.insert(cidrStr + ".in-addr.arpa");
-    ipBits += (1 << 16);
+
+  char *end;
+  auto bitsStr = boost::algorithm::trim_copy(split[1]);
+  long bits = strtol(bitsStr.c_str(), &end, 10);
+  if (bitsStr.empty() || *end != '\0' || bits < 0 || bits > 32) {
+    return false;
   }
 
+  result->mask = bits == 0 ? 0 : (0xFFFFFFFFu << (32 - bits));
+  result->network = ntohl(ipBits) & result->mask;
   return true;
 }
 
-bool ReverseLookupHelper::IsReverseLookupZone(const std::string& zone) {
-  return (this->m_rlZones.find(zone) != this->m_rlZones.end());
+bool ReverseLookupHelper::InitializeReverseLookupZones(const std::string &vpcCidr) {
+  std::vector<std::string> cidrs;
+  boost::algorithm::split(cidrs, vpcCidr, boost::is_any_of(","));
+
+  std::vector<Ipv4Cidr> parsed;
+  for (const auto &c : cidrs) {
+    Ipv4Cidr cidr;
+    if (!Ipv4Cidr::TryParse(c, &cidr)) {
+      return false;
+    }
+    parsed.push_back(cidr);
+  }
+  this->m_cidrs = parsed;
+  return true;
 }
 
-std::string _ReverseOctets(const std::string &ip) {
-  uint32_t inetAddr;
-  inet_pton(AF_INET, ip.c_str(), &inetAddr);
-  inetAddr = ntohl(inetAddr);
-  char buffer[100];
-  inet_ntop(AF_INET, &inetAddr, buffer, sizeof(buffer));
-  return std::string(buffer);
+// Parses dotted decimal labels written least significant first ("c.b.a"),
+// placing the last label at octet position firstOctet (0 = most significant).
+static bool _ParseReverseOctets(const char *name, size_t len, size_t firstOctet, uint32_t *addr, size_t *numOctets) {
+  uint32_t result = 0;
+  size_t octets = 0;
+  size_t i = len;
+  while (i > 0) {
+    size_t labelEnd = i;
+    uint32_t octet = 0;
+    while (i > 0 && name[i - 1] != '.') {
+      i--;
+    }
+    size_t labelLen = labelEnd - i;
+    if (labelLen == 0 || labelLen > 3 || firstOctet + octets == 4) {
+      return false;
+    }
+    for (size_t a = i; a < labelEnd; a++) {
+      if (name[a] < '0' || name[a] > '9') {
+        return false;
+      }
+      octet = octet * 10 + (name[a] - '0');
+    }
+    if (octet > 255) {
+      return false;
+    }
+    result |= octet << (24 - 8 * (firstOctet + octets));
+    octets++;
+    if (i > 0) {
+      // Skip the separating dot, a leading dot is an empty label.
+      i--;
+      if (i == 0) {
+        return false;
+      }
+    }
+  }
+
+  *addr = result;
+  *numOctets = octets;
+  return octets > 0;
+}
+
+bool ReverseLookupHelper::TryParseReverseName(const char *name, size_t len, uint32_t *addr, size_t *numOctets) {
+  if (len > 0 && name[len - 1] == '.') {
+    len--;
+  }
+  if (len < REVERSE_SUFFIX_LEN + 1
+      || strncasecmp(name + len - REVERSE_SUFFIX_LEN, REVERSE_SUFFIX, REVERSE_SUFFIX_LEN) != 0) {
+    return false;
+  }
+  return _ParseReverseOctets(name, len - REVERSE_SUFFIX_LEN, 0, addr, numOctets);
+}
+
+bool ReverseLookupHelper::IsReverseLookupZone(const std::string& zone) const {
+  return this->IsReverseLookupZone(zone.c_str(), zone.length());
 }
 
-bool ReverseLookupHelper::DoReverseLookup(const std::string& zone, const std::string& name, const std::string &clientAddr, std::string *hostname) {
-  std::string fullIp = name + "." + zone;
-  if (fullIp.length() < 14) {
+bool ReverseLookupHelper::IsReverseLookupZone(const char *zone, size_t len) const {
+  // Zones are always class C sized, ie "c.b.a.in-addr.arpa".
+  uint32_t prefix;
+  size_t numOctets;
+  if (!TryParseReverseName(zone, len, &prefix, &numOctets) || numOctets != 3) {
     return false;
   }
+  for (const auto &cidr : this->m_cidrs) {
+    if (cidr.Overlaps(prefix, 0xFFFFFF00u)) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  fullIp = fullIp.substr(0, fullIp.length() - 13); //13 = len(".in-addr.arpa")
-  fullIp = _ReverseOctets(fullIp);
+bool ReverseLookupHelper::IsInVpc(uint32_t ip) const {
+  for (const auto &cidr : this->m_cidrs) {
+    if (cidr.Contains(ip)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const std::vector<std::string> ReverseLookupHelper::GetReverseLookupZones() const {
+  std::vector<std::string> zones;
+  // CIDRs may overlap, so subnets are deduplicated by network address.
+  std::unordered_set<uint32_t> seen;
+  for (const auto &cidr : this->m_cidrs) {
+    // Enumerate every class C subnet that overlaps the CIDR.
+    uint32_t first = cidr.network & 0xFFFFFF00u;
+    uint32_t last = (cidr.network | ~cidr.mask) & 0xFFFFFF00u;
+    for (uint64_t net = first; net <= last; net += 256) {
+      if (!seen.insert((uint32_t)net).second) {
+        continue;
+      }
+      char buff[32];
+      snprintf(buff, sizeof(buff), "%u.%u.%u" REVERSE_SUFFIX,
+               (uint32_t)(net >> 8) & 0xFF, (uint32_t)(net >> 16) & 0xFF, (uint32_t)(net >> 24) & 0xFF);
+      zones.push_back(buff);
+    }
+  }
+  return zones;
+}
+
+bool ReverseLookupHelper::DoReverseLookup(
+    const char *zone, const char *name, const ClientAddress &clientAddr,
+    char *hostname, size_t len, ResolveInfo *info) {
+  uint32_t prefix, suffix;
+  size_t zoneOctets, nameOctets;
+  if (!TryParseReverseName(zone, strlen(zone), &prefix, &zoneOctets)
+      || !_ParseReverseOctets(name, strlen(name), zoneOctets, &suffix, &nameOctets)
+      || zoneOctets + nameOctets != 4) {
+    return false;
+  }
+  uint32_t ip = prefix | suffix;
+  if (!this->IsInVpc(ip)) {
+    return false;
+  }
+
+  char buffer[INET_ADDRSTRLEN];
+  uint32_t inetAddr = htonl(ip);
+  inet_ntop(AF_INET, &inetAddr, buffer, sizeof(buffer));
 
-  return this->m_dnsClient->TryResolveHostname(fullIp, clientAddr, hostname);
+  return this->m_dnsClient->TryResolveHostname(buffer, clientAddr, hostname, len, info);
 }
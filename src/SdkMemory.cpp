@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <unordered_map>
+
+#include "aws/core/utils/json/JsonSerializer.h"
+
+#include "SdkMemory.h"
+
+#define SDK_MEMORY_HEADER_SIZE 16
+#define SDK_MEMORY_LARGE SDK_MEMORY_NUM_CLASSES
+
+// Sits just before every block handed out.
+struct BlockHeader {
+  SdkMemorySystem::Chunk *chunk;
+  uint64_t size : 48;
+  // SDK_MEMORY_LARGE for blocks straight from malloc or an arena.
+  uint64_t sizeClass : 8;
+  // log2 of the distance from what malloc returned to the block.
+  uint64_t offsetShift : 8;
+};
+static_assert(sizeof(BlockHeader) == SDK_MEMORY_HEADER_SIZE, "blocks must stay 16 byte aligned");
+
+// Sits at the start of every arena chunk, so a block pins only its own chunk.
+struct SdkMemorySystem::Chunk {
+  SdkMemorySystem *system;
+  // Biased by CHUNK_OPEN while the arena bumps out of it, after that the
+  // blocks not yet freed.
+  std::atomic<int64_t> references;
+  // Only touched by the scope's thread.
+  int64_t allocations;
+};
+
+struct SdkMemorySystem::Arena {
+  SdkMemorySystem *system;
+  Chunk *chunk;
+  char *next;
+  char *end;
+};
+
+#define CHUNK_OPEN ((int64_t)1 << 62)
+#define CHUNK_HEADER_SIZE \
+  ((sizeof(SdkMemorySystem::Chunk) + SDK_MEMORY_HEADER_SIZE - 1) & ~(size_t)(SDK_MEMORY_HEADER_SIZE - 1))
+
+// Systems are matched by id as well, in case one is freed and another takes
+// its address.
+struct SdkMemorySystem::ThreadCounts {
+  SdkMemorySystem *system;
+  uint64_t systemId;
+  uint64_t allocations;
+  uint64_t allocatedBytes;
+  uint64_t freedBytes;
+  uint64_t poolHits;
+  uint64_t arenaAllocations;
+  uint64_t unflushedBytes;
+};
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+// Everything a thread keeps, trivial and in one place so reaching it costs a
+// single TLS access.
+struct SdkMemorySystem::ThreadState {
+  FreeBlock *heads[SDK_MEMORY_NUM_CLASSES];
+  size_t cached[SDK_MEMORY_NUM_CLASSES];
+  SdkMemorySystem::ThreadCounts counts;
+  SdkMemorySystem::Arena *arena;
+  bool reaped;
+  bool destroyed;
+};
+
+static thread_local SdkMemorySystem::ThreadState t_state;
+
+static std::mutex& _GetSystemsLock() {
+  static std::mutex lock;
+  return lock;
+}
+
+static std::unordered_map<SdkMemorySystem*, uint64_t>& _GetSystems() {
+  static std::unordered_map<SdkMemorySystem*, uint64_t> systems;
+  return systems;
+}
+
+// Hands the thread's counts to their system and frees its cached blocks when
+// it exits.
+struct ThreadReaper {
+  ~ThreadReaper() {
+    SdkMemorySystem::ThreadExit(&t_state.counts);
+    for (auto head : t_state.heads) {
+      while (head != nullptr) {
+        auto next = head->next;
+        free(head);
+        head = next;
+      }
+    }
+    // Blocks freed by later thread exit handlers go straight back to malloc.
+    t_state.destroyed = true;
+  }
+};
+
+static thread_local ThreadReaper t_reaper;
+
+static void _EnsureReaper() {
+  if (!t_state.reaped) {
+    t_state.reaped = true;
+    // Constructs the reaper, so its destructor runs at thread exit.
+    (void)&t_reaper;
+  }
+}
+
+// SDK_MEMORY_NUM_CLASSES or more for blocks too big for any class.
+static size_t _GetClass(size_t total) {
+  if (total <= ((size_t)1 << SDK_MEMORY_MIN_CLASS_SHIFT)) {
+    return 0;
+  }
+  return 64 - __builtin_clzll((unsigned long long)total - 1) - SDK_MEMORY_MIN_CLASS_SHIFT;
+}
+
+static size_t _GetClassSize(size_t cls) {
+  return (size_t)1 << (SDK_MEMORY_MIN_CLASS_SHIFT + cls);
+}
+
+static size_t _Log2(size_t value) {
+  size_t shift = 0;
+  while (((size_t)1 << shift) < value) {
+    shift++;
+  }
+  return shift;
+}
+
+static void* _InitBlock(void *at, SdkMemorySystem::Chunk *chunk, size_t size, size_t sizeClass, size_t offset) {
+  auto header = (BlockHeader*)at;
+  header->chunk = chunk;
+  header->size = size;
+  header->sizeClass = sizeClass;
+  header->offsetShift = _Log2(offset);
+  return header + 1;
+}
+
+static uint64_t _NextId() {
+  static std::atomic<uint64_t> nextId(1);
+  return nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+SdkMemorySystem::SdkMemorySystem()
+  : m_id(_NextId()),
+    m_allocations(0),
+    m_allocatedBytes(0),
+    m_freedBytes(0),
+    m_poolHits(0),
+    m_arenaAllocations(0),
+    m_peakBytes(0),
+    m_arenaChunkBytes(0),
+    m_numSpareChunks(0) {
+  std::lock_guard<std::mutex> lock(_GetSystemsLock());
+  _GetSystems()[this] = this->m_id;
+}
+
+SdkMemorySystem::~SdkMemorySystem() {
+  {
+    std::lock_guard<std::mutex> lock(_GetSystemsLock());
+    _GetSystems().erase(this);
+  }
+  for (size_t i = 0; i < this->m_numSpareChunks; i++) {
+    free(this->m_spareChunks[i]);
+  }
+}
+
+void* SdkMemorySystem::AllocateMemory(std::size_t blockSize, std::size_t alignment, const char *) {
+  auto &state = t_state;
+  auto &counts = this->_GetThreadCounts(&state);
+  counts.allocations++;
+  counts.allocatedBytes += blockSize;
+  counts.unflushedBytes += blockSize;
+  if (counts.unflushedBytes >= SDK_MEMORY_FLUSH_BYTES) {
+    this->_Flush(&counts);
+  }
+
+  size_t total = blockSize + SDK_MEMORY_HEADER_SIZE;
+  if (alignment <= SDK_MEMORY_HEADER_SIZE) {
+    auto arena = state.arena;
+    if (arena != nullptr && arena->system == this && total <= SDK_MEMORY_ARENA_CHUNK_SIZE / 4) {
+      void *at = this->_AllocateFromArena(arena, total);
+      if (at == nullptr) {
+        return nullptr;
+      }
+      counts.arenaAllocations++;
+      return _InitBlock(at, arena->chunk, blockSize, SDK_MEMORY_LARGE, SDK_MEMORY_HEADER_SIZE);
+    }
+    size_t cls = _GetClass(total);
+    if (cls < SDK_MEMORY_NUM_CLASSES) {
+      void *at;
+      if (state.heads[cls] != nullptr) {
+        at = state.heads[cls];
+        state.heads[cls] = state.heads[cls]->next;
+        state.cached[cls]--;
+        counts.poolHits++;
+      }
+      else if ((at = malloc(_GetClassSize(cls))) == nullptr) {
+        return nullptr;
+      }
+      return _InitBlock(at, nullptr, blockSize, cls, SDK_MEMORY_HEADER_SIZE);
+    }
+  }
+
+  size_t offset = std::max(alignment, (size_t)SDK_MEMORY_HEADER_SIZE);
+  void *raw;
+  if (posix_memalign(&raw, offset, offset + blockSize) != 0) {
+    return nullptr;
+  }
+  return _InitBlock((char*)raw + offset - SDK_MEMORY_HEADER_SIZE, nullptr, blockSize, SDK_MEMORY_LARGE, offset);
+}
+
+void SdkMemorySystem::FreeMemory(void* memoryPtr) {
+  if (memoryPtr == nullptr) {
+    return;
+  }
+  auto header = (BlockHeader*)memoryPtr - 1;
+  auto &state = t_state;
+  auto &counts = this->_GetThreadCounts(&state);
+  counts.freedBytes += header->size;
+  counts.unflushedBytes += header->size;
+  if (counts.unflushedBytes >= SDK_MEMORY_FLUSH_BYTES) {
+    this->_Flush(&counts);
+  }
+
+  if (header->chunk != nullptr) {
+    if (header->chunk->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      header->chunk->system->_ReleaseChunk(header->chunk);
+    }
+    return;
+  }
+  size_t cls = header->sizeClass;
+  if (cls < SDK_MEMORY_NUM_CLASSES) {
+    if (!state.destroyed && state.cached[cls] < SDK_MEMORY_MAX_CACHED_BYTES / _GetClassSize(cls)) {
+      auto block = (FreeBlock*)header;
+      block->next = state.heads[cls];
+      state.heads[cls] = block;
+      state.cached[cls]++;
+    }
+    else {
+      free(header);
+    }
+    return;
+  }
+  free((char*)memoryPtr - ((size_t)1 << header->offsetShift));
+}
+
+SdkMemorySystem::ThreadCounts& SdkMemorySystem::_GetThreadCounts(ThreadState *state) {
+  auto &counts = state->counts;
+  if (counts.system != this || counts.systemId != this->m_id) {
+    _FlushIfAlive(&counts);
+    counts.system = this;
+    counts.systemId = this->m_id;
+    _EnsureReaper();
+  }
+  return counts;
+}
+
+void SdkMemorySystem::_Flush(ThreadCounts *counts) {
+  this->m_allocations.fetch_add(counts->allocations, std::memory_order_relaxed);
+  this->m_allocatedBytes.fetch_add(counts->allocatedBytes, std::memory_order_relaxed);
+  this->m_freedBytes.fetch_add(counts->freedBytes, std::memory_order_relaxed);
+  this->m_poolHits.fetch_add(counts->poolHits, std::memory_order_relaxed);
+  this->m_arenaAllocations.fetch_add(counts->arenaAllocations, std::memory_order_relaxed);
+  counts->allocations = 0;
+  counts->allocatedBytes = 0;
+  counts->freedBytes = 0;
+  counts->poolHits = 0;
+  counts->arenaAllocations = 0;
+  counts->unflushedBytes = 0;
+
+  uint64_t live = this->m_allocatedBytes.load(std::memory_order_relaxed)
+      - this->m_freedBytes.load(std::memory_order_relaxed);
+  uint64_t peak = this->m_peakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !this->m_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) { }
+}
+
+void SdkMemorySystem::_FlushIfAlive(ThreadCounts *counts) {
+  if (counts->system == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(_GetSystemsLock());
+  auto found = _GetSystems().find(counts->system);
+  if (found != _GetSystems().end() && found->second == counts->systemId) {
+    counts->system->_Flush(counts);
+  }
+  counts->system = nullptr;
+}
+
+void SdkMemorySystem::ThreadExit(ThreadCounts *counts) {
+  _FlushIfAlive(counts);
+}
+
+void* SdkMemorySystem::_AllocateFromArena(Arena *arena, size_t size) {
+  size = (size + SDK_MEMORY_HEADER_SIZE - 1) & ~(size_t)(SDK_MEMORY_HEADER_SIZE - 1);
+  if (arena->next == nullptr || (size_t)(arena->end - arena->next) < size) {
+    if (arena->chunk != nullptr) {
+      this->_CloseChunk(arena->chunk);
+      arena->chunk = nullptr;
+      arena->next = nullptr;
+      arena->end = nullptr;
+    }
+    void *spare = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(this->m_spareChunksLock);
+      if (this->m_numSpareChunks > 0) {
+        spare = this->m_spareChunks[--this->m_numSpareChunks];
+      }
+    }
+    if (spare == nullptr) {
+      if ((spare = malloc(SDK_MEMORY_ARENA_CHUNK_SIZE)) == nullptr) {
+        return nullptr;
+      }
+      this->m_arenaChunkBytes.fetch_add(SDK_MEMORY_ARENA_CHUNK_SIZE, std::memory_order_relaxed);
+    }
+    auto chunk = new (spare) Chunk();
+    chunk->system = this;
+    chunk->references.store(CHUNK_OPEN, std::memory_order_relaxed);
+    chunk->allocations = 0;
+    arena->chunk = chunk;
+    arena->next = (char*)chunk + CHUNK_HEADER_SIZE;
+    arena->end = (char*)chunk + SDK_MEMORY_ARENA_CHUNK_SIZE;
+  }
+  void *at = arena->next;
+  arena->next += size;
+  arena->chunk->allocations++;
+  return at;
+}
+
+void SdkMemorySystem::_CloseChunk(Chunk *chunk) {
+  // Frees so far have counted down from CHUNK_OPEN, now count down from the
+  // blocks handed out instead.
+  int64_t adjust = chunk->allocations - CHUNK_OPEN;
+  if (chunk->references.fetch_add(adjust, std::memory_order_acq_rel) + adjust == 0) {
+    this->_ReleaseChunk(chunk);
+  }
+}
+
+void SdkMemorySystem::_ReleaseChunk(Chunk *chunk) {
+  std::lock_guard<std::mutex> lock(this->m_spareChunksLock);
+  if (this->m_numSpareChunks < SDK_MEMORY_SPARE_CHUNKS) {
+    this->m_spareChunks[this->m_numSpareChunks++] = chunk;
+  }
+  else {
+    free(chunk);
+    this->m_arenaChunkBytes.fetch_sub(SDK_MEMORY_ARENA_CHUNK_SIZE, std::memory_order_relaxed);
+  }
+}
+
+SdkMemoryStats SdkMemorySystem::GetStats() {
+  this->_Flush(&this->_GetThreadCounts(&t_state));
+  SdkMemoryStats stats;
+  stats.allocations = this->m_allocations.load(std::memory_order_relaxed);
+  stats.allocated_bytes = this->m_allocatedBytes.load(std::memory_order_relaxed);
+  stats.live_bytes = stats.allocated_bytes - this->m_freedBytes.load(std::memory_order_relaxed);
+  stats.peak_bytes = this->m_peakBytes.load(std::memory_order_relaxed);
+  stats.pool_hits = this->m_poolHits.load(std::memory_order_relaxed);
+  stats.arena_allocations = this->m_arenaAllocations.load(std::memory_order_relaxed);
+  stats.arena_chunk_bytes = this->m_arenaChunkBytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+std::string SdkMemorySystem::RenderJson() {
+  auto stats = this->GetStats();
+  return Aws::Utils::Json::JsonValue()
+      .WithInt64("allocations", stats.allocations)
+      .WithInt64("allocated_bytes", stats.allocated_bytes)
+      .WithInt64("live_bytes", stats.live_bytes)
+      .WithInt64("peak_bytes", stats.peak_bytes)
+      .WithInt64("pool_hits", stats.pool_hits)
+      .WithInt64("arena_allocations", stats.arena_allocations)
+      .WithInt64("arena_chunk_bytes", stats.arena_chunk_bytes)
+      .WriteReadable();
+}
+
+SdkMemorySystem* SdkMemorySystem::GetInstalled() {
+  return dynamic_cast<SdkMemorySystem*>(Aws::Utils::Memory::GetMemorySystem());
+}
+
+SdkMemorySystem::ArenaScope::ArenaScope(SdkMemorySystem *system)
+  : m_arena(nullptr),
+    m_previous(t_state.arena) {
+  if (system == nullptr) {
+    return;
+  }
+  this->m_arena = new Arena();
+  this->m_arena->system = system;
+  this->m_arena->chunk = nullptr;
+  this->m_arena->next = nullptr;
+  this->m_arena->end = nullptr;
+  t_state.arena = this->m_arena;
+}
+
+SdkMemorySystem::ArenaScope::~ArenaScope() {
+  if (this->m_arena == nullptr) {
+    return;
+  }
+  t_state.arena = this->m_previous;
+  auto arena = this->m_arena;
+  arena->system->_Flush(&arena->system->_GetThreadCounts(&t_state));
+  if (arena->chunk != nullptr) {
+    arena->system->_CloseChunk(arena->chunk);
+  }
+  delete arena;
+}
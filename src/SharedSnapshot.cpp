@@ -0,0 +1,373 @@
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SharedSnapshot.h"
+
+// Read through a read only mapping by the followers, so the generation must
+// be a plain load.
+struct SharedSnapshot::Control {
+  char magic[SHARED_SNAPSHOT_MAGIC_SIZE];
+  std::atomic<uint64_t> generation;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "followers can't take a lock in a read only mapping");
+
+// The start of a generation.  Instances, the ID index and stable times
+// follow at the given offsets, then the tables: the zone names and the
+// autoscaling groups, see _WriteTables.
+struct GenerationHeader {
+  char magic[SHARED_SNAPSHOT_MAGIC_SIZE];
+  uint64_t generation;
+  uint64_t size;
+  int64_t taken;
+  int64_t nextRefresh;
+  uint32_t serial;
+  uint32_t numInstances;
+  uint64_t instancesOffset;
+  uint64_t idIndexOffset;
+  uint64_t stableSinceOffset;
+  uint64_t tablesOffset;
+  uint64_t tablesSize;
+};
+
+static_assert(sizeof(GenerationHeader) % alignof(SnapshotInstance) == 0, "instances follow the header");
+
+// Only objects this user created are trusted, whoever else can write to
+// /dev/shm or the lock's directory.
+static bool _IsOwned(int fd, struct stat *st) {
+  return fstat(fd, st) == 0 && st->st_uid == geteuid();
+}
+
+// Unmaps a generation once the last snapshot reading from it is gone.
+struct GenerationMapping {
+  GenerationMapping(void *addr, size_t size) : addr(addr), size(size) { }
+  ~GenerationMapping() {
+    munmap(this->addr, this->size);
+  }
+
+  void *addr;
+  size_t size;
+};
+
+template<class T>
+static void _Append(std::string *out, T value) {
+  out->append((const char*)&value, sizeof(value));
+}
+
+static void _AppendString(std::string *out, const std::string& value) {
+  _Append(out, (uint16_t)value.size());
+  out->append(value, 0, UINT16_MAX);
+}
+
+// u32 zone count, then each zone name; u32 group count, then each group's
+// alias, u32 TTL, u32 member count and each member's address and i16 zone.
+// Strings are a u16 length then their bytes.
+static std::string _WriteTables(const ZoneSnapshot& snapshot) {
+  std::string tables;
+  _Append(&tables, (uint32_t)snapshot.GetZones().size());
+  for (const auto &zone : snapshot.GetZones()) {
+    _AppendString(&tables, zone);
+  }
+  _Append(&tables, (uint32_t)snapshot.GetAutoscalingGroups().size());
+  for (const auto &group : snapshot.GetAutoscalingGroups()) {
+    const auto &members = *group.second;
+    _AppendString(&tables, group.first);
+    _Append(&tables, members.GetTtl());
+    _Append(&tables, (uint32_t)members.size());
+    for (size_t i = 0; i < members.size(); i++) {
+      _AppendString(&tables, members.GetIp(i));
+      _Append(&tables, members.GetZone(i));
+    }
+  }
+  return tables;
+}
+
+class TableReader {
+public:
+  TableReader(const char *data, size_t size) : m_pos(data), m_end(data + size) { }
+
+  template<class T>
+  bool Read(T *value) {
+    if ((size_t)(this->m_end - this->m_pos) < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, this->m_pos, sizeof(T));
+    this->m_pos += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(std::string *value) {
+    uint16_t len;
+    if (!this->Read(&len) || (size_t)(this->m_end - this->m_pos) < len) {
+      return false;
+    }
+    value->assign(this->m_pos, len);
+    this->m_pos += len;
+    return true;
+  }
+
+private:
+  const char *m_pos;
+  const char *m_end;
+};
+
+static bool _ReadTables(
+    const char *data, size_t size, std::vector<std::string> *zones, ZoneSnapshot::AutoscalingGroups *groups) {
+  TableReader reader(data, size);
+  uint32_t numZones, numGroups;
+  if (!reader.Read(&numZones)) {
+    return false;
+  }
+  for (uint32_t z = 0; z < numZones; z++) {
+    std::string zone;
+    if (!reader.ReadString(&zone)) {
+      return false;
+    }
+    zones->push_back(std::move(zone));
+  }
+  if (!reader.Read(&numGroups)) {
+    return false;
+  }
+  for (uint32_t g = 0; g < numGroups; g++) {
+    std::string alias;
+    uint32_t ttl, numMembers;
+    if (!reader.ReadString(&alias) || !reader.Read(&ttl) || !reader.Read(&numMembers)) {
+      return false;
+    }
+    std::vector<AsgMember> members;
+    for (uint32_t m = 0; m < numMembers; m++) {
+      AsgMember member;
+      if (!reader.ReadString(&member.ip) || !reader.Read(&member.zone)) {
+        return false;
+      }
+      members.push_back(std::move(member));
+    }
+    (*groups)[alias] = std::make_shared<const AsgMembers>(std::move(members), ttl);
+  }
+  return true;
+}
+
+static bool _InBounds(uint64_t offset, uint64_t length, uint64_t size) {
+  return offset <= size && length <= size - offset;
+}
+
+SharedSnapshot::SharedSnapshot(
+    const std::string& name, const std::string& lockPath, std::shared_ptr<StatsReceiver> statsReceiver)
+  : m_path(name.empty() || name[0] != '/' ? "/" + name : name),
+    m_lockPath(lockPath),
+    m_lockFd(-1),
+    m_leader(false),
+    m_control(nullptr),
+    m_controlWritable(false),
+    m_publishes(statsReceiver->Create("shared_snapshot_publishes")),
+    m_loads(statsReceiver->Create("shared_snapshot_loads")),
+    m_failures(statsReceiver->Create("shared_snapshot_failures")),
+    m_bytes(statsReceiver->Create("shared_snapshot_bytes")) { }
+
+SharedSnapshot::~SharedSnapshot() {
+  this->_UnmapControl();
+  if (this->m_lockFd >= 0) {
+    close(this->m_lockFd);
+  }
+}
+
+std::string SharedSnapshot::GetGenerationPath(uint64_t generation) const {
+  return this->m_path + "." + std::to_string(generation);
+}
+
+bool SharedSnapshot::TryLead() {
+  if (this->m_leader) {
+    return true;
+  }
+  if (this->m_lockFd < 0) {
+    this->m_lockFd = open(this->m_lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+    if (this->m_lockFd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (!_IsOwned(this->m_lockFd, &st)) {
+      close(this->m_lockFd);
+      this->m_lockFd = -1;
+      return false;
+    }
+  }
+  if (flock(this->m_lockFd, LOCK_EX | LOCK_NB) != 0) {
+    return false;
+  }
+  this->m_leader = true;
+  this->_UnmapControl();
+  return true;
+}
+
+bool SharedSnapshot::_MapControl(bool writable) {
+  if (this->m_control != nullptr && (this->m_controlWritable || !writable)) {
+    return true;
+  }
+  this->_UnmapControl();
+  int fd = shm_open(this->m_path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  bool sized = _IsOwned(fd, &st)
+      && ((size_t)st.st_size >= sizeof(Control)
+          || (writable && ftruncate(fd, sizeof(Control)) == 0));
+  void *addr = sized
+      ? mmap(nullptr, sizeof(Control), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0)
+      : MAP_FAILED;
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  this->m_control = (Control*)addr;
+  this->m_controlWritable = writable;
+  if (writable && memcmp(this->m_control->magic, SHARED_SNAPSHOT_MAGIC, SHARED_SNAPSHOT_MAGIC_SIZE) != 0) {
+    // Left by another build, or new.
+    this->m_control->generation.store(0, std::memory_order_relaxed);
+    memcpy(this->m_control->magic, SHARED_SNAPSHOT_MAGIC, SHARED_SNAPSHOT_MAGIC_SIZE);
+  }
+  return true;
+}
+
+void SharedSnapshot::_UnmapControl() {
+  if (this->m_control != nullptr) {
+    munmap(this->m_control, sizeof(Control));
+    this->m_control = nullptr;
+  }
+}
+
+uint64_t SharedSnapshot::GetGeneration() {
+  if (!this->_MapControl(this->m_leader)
+      || memcmp(this->m_control->magic, SHARED_SNAPSHOT_MAGIC, SHARED_SNAPSHOT_MAGIC_SIZE) != 0) {
+    return 0;
+  }
+  return this->m_control->generation.load(std::memory_order_acquire);
+}
+
+bool SharedSnapshot::Publish(const ZoneSnapshot& snapshot, int64_t taken, int64_t nextRefresh) {
+  if (!this->m_leader || !this->_MapControl(true)) {
+    this->m_failures->Increment();
+    return false;
+  }
+  uint64_t generation = this->m_control->generation.load(std::memory_order_relaxed) + 1;
+  auto path = this->GetGenerationPath(generation);
+
+  auto instances = snapshot.GetInstances();
+  auto tables = _WriteTables(snapshot);
+  GenerationHeader header;
+  memcpy(header.magic, SHARED_SNAPSHOT_MAGIC, SHARED_SNAPSHOT_MAGIC_SIZE);
+  header.generation = generation;
+  header.taken = taken;
+  header.nextRefresh = nextRefresh;
+  header.serial = snapshot.GetSerial();
+  header.numInstances = (uint32_t)instances.size();
+  header.instancesOffset = sizeof(GenerationHeader);
+  header.idIndexOffset = header.instancesOffset + instances.size() * sizeof(SnapshotInstance);
+  header.stableSinceOffset = header.idIndexOffset + instances.size() * sizeof(uint32_t);
+  header.tablesOffset = header.stableSinceOffset + instances.size() * sizeof(uint32_t);
+  header.tablesSize = tables.size();
+  header.size = header.tablesOffset + tables.size();
+
+  // Left behind by a publisher that died part way through.
+  shm_unlink(path.c_str());
+  int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    this->m_failures->Increment();
+    return false;
+  }
+  void *addr = ftruncate(fd, header.size) == 0
+      ? mmap(nullptr, header.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+      : MAP_FAILED;
+  close(fd);
+  if (addr == MAP_FAILED) {
+    shm_unlink(path.c_str());
+    this->m_failures->Increment();
+    return false;
+  }
+  auto base = (char*)addr;
+  memcpy(base, &header, sizeof(header));
+  memcpy(base + header.instancesOffset, instances.begin(), instances.size() * sizeof(SnapshotInstance));
+  memcpy(base + header.idIndexOffset, snapshot.GetIdIndex(), instances.size() * sizeof(uint32_t));
+  memcpy(base + header.stableSinceOffset, snapshot.GetStableSince(), instances.size() * sizeof(uint32_t));
+  memcpy(base + header.tablesOffset, tables.data(), tables.size());
+  munmap(addr, header.size);
+
+  this->m_control->generation.store(generation, std::memory_order_release);
+  // Followers may still be opening the generation before this one.
+  if (generation > 2) {
+    shm_unlink(this->GetGenerationPath(generation - 2).c_str());
+  }
+  this->m_publishes->Increment();
+  this->m_bytes->Increment(header.size);
+  return true;
+}
+
+bool SharedSnapshot::Load(const HostnameFormat& format, SharedSnapshotGeneration *loaded) {
+  uint64_t generation = this->GetGeneration();
+  if (generation == 0) {
+    return false;
+  }
+  // Fails if it has already been superseded and unlinked, the next poll
+  // picks up its successor.
+  int fd = shm_open(this->GetGenerationPath(generation).c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    this->m_failures->Increment();
+    return false;
+  }
+  struct stat st;
+  void *addr = _IsOwned(fd, &st) && (size_t)st.st_size >= sizeof(GenerationHeader)
+      ? mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0)
+      : MAP_FAILED;
+  close(fd);
+  if (addr == MAP_FAILED) {
+    this->m_failures->Increment();
+    return false;
+  }
+  auto mapping = std::make_shared<GenerationMapping>(addr, st.st_size);
+  auto base = (const char*)addr;
+  GenerationHeader header;
+  memcpy(&header, base, sizeof(header));
+
+  uint64_t n = header.numInstances;
+  bool valid = memcmp(header.magic, SHARED_SNAPSHOT_MAGIC, SHARED_SNAPSHOT_MAGIC_SIZE) == 0
+      && header.generation == generation
+      && header.size <= mapping->size
+      && header.instancesOffset % alignof(SnapshotInstance) == 0
+      && header.idIndexOffset % alignof(uint32_t) == 0
+      && header.stableSinceOffset % alignof(uint32_t) == 0
+      && _InBounds(header.instancesOffset, n * sizeof(SnapshotInstance), header.size)
+      && _InBounds(header.idIndexOffset, n * sizeof(uint32_t), header.size)
+      && _InBounds(header.stableSinceOffset, n * sizeof(uint32_t), header.size)
+      && _InBounds(header.tablesOffset, header.tablesSize, header.size);
+  auto idIndex = (const uint32_t*)(base + header.idIndexOffset);
+  for (uint64_t i = 0; valid && i < n; i++) {
+    valid = idIndex[i] < n;
+  }
+  std::vector<std::string> zones;
+  ZoneSnapshot::AutoscalingGroups groups;
+  if (!valid || !_ReadTables(base + header.tablesOffset, header.tablesSize, &zones, &groups)) {
+    this->m_failures->Increment();
+    return false;
+  }
+
+  loaded->snapshot = std::make_shared<const ZoneSnapshot>(
+      header.serial,
+      mapping,
+      (const SnapshotInstance*)(base + header.instancesOffset),
+      idIndex,
+      (const uint32_t*)(base + header.stableSinceOffset),
+      n,
+      std::move(zones),
+      format,
+      std::move(groups));
+  loaded->generation = generation;
+  loaded->taken = header.taken;
+  loaded->next_refresh = header.nextRefresh;
+  this->m_loads->Increment();
+  return true;
+}
@@ -1,35 +1,220 @@
+#include <algorithm>
+#include <cstring>
+
+#include "OpenMetrics.h"
 #include "Stats.h"
 
 const std::vector<std::shared_ptr<Stat>> StatsReceiver::GetAllStats() {
-  std::lock_guard<std::mutex> lock(this->m_statsLock);
+  std::lock_guard<TimedMutex> lock(this->m_statsLock);
   return std::vector<std::shared_ptr<Stat>>(m_stats);
 }
 
 std::shared_ptr<Stat> StatsReceiver::Create(const std::string& name) {
-  auto ptr = std::make_shared<Stat>(name);
-  std::lock_guard<std::mutex> lock(this->m_statsLock);
+  return this->Create(name, MetricId(name));
+}
+
+std::shared_ptr<Stat> StatsReceiver::Create(const std::string& name, const MetricId& metric) {
+  auto ptr = std::make_shared<Stat>(name, metric);
+  std::lock_guard<TimedMutex> lock(this->m_statsLock);
   m_stats.push_back(ptr);
   return ptr;
 }
 
+const std::vector<std::shared_ptr<Histogram>> StatsReceiver::GetAllHistograms() {
+  std::lock_guard<TimedMutex> lock(this->m_statsLock);
+  return std::vector<std::shared_ptr<Histogram>>(m_histograms);
+}
+
+std::shared_ptr<Histogram> StatsReceiver::CreateHistogram(const std::string& name) {
+  return this->CreateHistogram(name, MetricId(name));
+}
+
+std::shared_ptr<Histogram> StatsReceiver::CreateHistogram(const std::string& name, const MetricId& metric) {
+  auto ptr = std::make_shared<Histogram>(name, metric);
+  std::lock_guard<TimedMutex> lock(this->m_statsLock);
+  m_histograms.push_back(ptr);
+  return ptr;
+}
+
+StatsServer::StatsServer(unsigned short port, const std::string& address, size_t numThreads)
+  : m_server(new HttpServer(port, numThreads)), m_stopped(false) {
+  this->m_server->config.address = address;
+  this->m_server->resource["^/instances$"]["GET"] = [this](HttpServer::Response& response, std::shared_ptr<HttpServer::Request>) {
+    this->_RenderInstances(response);
+  };
+  for (auto method : {"GET", "POST"}) {
+    bool post = strcmp(method, "POST") == 0;
+    this->m_server->resource["^/instances/([^/]+)(/.*)$"][method] =
+        [this, post](HttpServer::Response& response, std::shared_ptr<HttpServer::Request> request) {
+          this->_Serve(request->path_match[1].str(), request->path_match[2].str(), post, response);
+        };
+    this->m_server->default_resource[method] =
+        [this, post](HttpServer::Response& response, std::shared_ptr<HttpServer::Request> request) {
+          this->_Serve("", request->path, post, response);
+        };
+  }
+}
+
+StatsServer::~StatsServer() {
+  this->Stop();
+  if (this->m_serverThread.joinable()) {
+    this->m_serverThread.join();
+  }
+}
+
+std::shared_ptr<StatsServer> StatsServer::Acquire(unsigned short port, const std::string& address, size_t numThreads) {
+  static std::mutex lock;
+  static std::map<std::string, std::weak_ptr<StatsServer>> servers;
+  std::lock_guard<std::mutex> guard(lock);
+  auto &entry = servers[address + ":" + std::to_string(port)];
+  auto server = entry.lock();
+  if (!server) {
+    server = std::make_shared<StatsServer>(port, address, numThreads);
+    server->Start();
+    entry = server;
+  }
+  return server;
+}
+
 void StatsServer::Start() {
   m_serverThread = std::thread(std::bind(&StatsServer::_StartSync, this));
 }
 
 void StatsServer::Stop() {
+  std::lock_guard<std::mutex> lock(this->m_stopLock);
+  this->m_stopped = true;
   this->m_server->stop();
 }
 
+std::string StatsServer::Mount(
+    const std::string& name,
+    std::shared_ptr<StatsReceiver> stats,
+    std::function<Aws::Utils::Json::JsonValue()> describe) {
+  std::lock_guard<std::mutex> lock(this->m_instancesLock);
+  auto mounted = name;
+  for (int n = 2; this->_FindInstance(mounted) != nullptr; n++) {
+    mounted = name + "-" + std::to_string(n);
+  }
+  this->m_instances.push_back(StatsServer::Instance {mounted, stats, describe, {}, {}});
+  return mounted;
+}
+
+void StatsServer::Unmount(const std::string& name) {
+  std::lock_guard<std::mutex> lock(this->m_instancesLock);
+  this->m_instances.erase(
+      std::remove_if(this->m_instances.begin(), this->m_instances.end(), [&name](const StatsServer::Instance& m) {
+        return m.name == name;
+      }),
+      this->m_instances.end());
+}
+
+void StatsServer::AddJsonResource(const std::string& name, const std::string& path, std::function<std::string()> render) {
+  std::lock_guard<std::mutex> lock(this->m_instancesLock);
+  auto mount = this->_FindInstance(name);
+  if (mount != nullptr) {
+    mount->resources[path] = render;
+  }
+}
+
+void StatsServer::AddJsonAction(const std::string& name, const std::string& path, std::function<std::string()> run) {
+  std::lock_guard<std::mutex> lock(this->m_instancesLock);
+  auto mount = this->_FindInstance(name);
+  if (mount != nullptr) {
+    mount->actions[path] = run;
+  }
+}
+
+StatsServer::Instance* StatsServer::_FindInstance(const std::string& name) {
+  for (auto &m : this->m_instances) {
+    if (m.name == name) {
+      return &m;
+    }
+  }
+  return nullptr;
+}
+
 void StatsServer::_StartSync() {
-  this->m_server->start();
+  {
+    std::lock_guard<std::mutex> lock(this->m_stopLock);
+    if (this->m_stopped) {
+      return;
+    }
+  }
+  try {
+    this->m_server->start();
+  }
+  catch (const std::exception&) {
+    // Most likely the port's taken, the process serves on without stats.
+  }
 }
 
-void StatsServer::_RenderStats(HttpServer::Response& response, std::shared_ptr<HttpServer::Request> request) {
+void StatsServer::_Serve(const std::string& name, const std::string& path, bool post, HttpServer::Response& response) {
+  // Held throughout, so an instance can't go while its resources run.
+  std::unique_lock<std::mutex> lock(this->m_instancesLock);
+  auto mount = name.empty()
+      ? (this->m_instances.empty() ? nullptr : &this->m_instances.front())
+      : this->_FindInstance(name);
+  if (mount != nullptr && !post && path == "/stats") {
+    _RenderStats(*mount->stats, response);
+    return;
+  }
+  if (mount != nullptr && !post && path == "/metrics") {
+    // Flushing yields to other requests on this thread, which may lock.
+    auto stats = mount->stats;
+    lock.unlock();
+    _RenderMetrics(*stats, response);
+    return;
+  }
+  if (mount != nullptr) {
+    const auto &handlers = post ? mount->actions : mount->resources;
+    auto found = handlers.find(path);
+    if (found != handlers.end()) {
+      auto resp = found->second();
+      response << "HTTP/1.1 200 OK\r\nContent-Length: " << resp.size() << "\r\n\r\n" << resp;
+      return;
+    }
+  }
+  response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+}
+
+void StatsServer::_RenderInstances(HttpServer::Response& response) {
+  std::vector<Aws::Utils::Json::JsonValue> instances;
+  {
+    std::lock_guard<std::mutex> lock(this->m_instancesLock);
+    for (const auto &m : this->m_instances) {
+      auto instance = m.describe ? m.describe() : Aws::Utils::Json::JsonValue();
+      instances.push_back(instance.WithString("name", m.name));
+    }
+  }
+  auto resp = Aws::Utils::Json::JsonValue().WithArray("instances", instances).WriteReadable();
+  response << "HTTP/1.1 200 OK\r\nContent-Length: " << resp.size() << "\r\n\r\n" << resp;
+}
+
+void StatsServer::_RenderStats(StatsReceiver& stats, HttpServer::Response& response) {
   Aws::Utils::Json::JsonValue root;
-  auto stats = m_stats->GetAllStats();
-  for (auto &s : stats) {
+  for (auto &s : stats.GetAllStats()) {
     root.WithInt64(s->GetName(), s->GetValue());
   }
+  for (auto &h : stats.GetAllHistograms()) {
+    auto snapshot = h->GetSnapshot();
+    root.WithInt64(h->GetName() + "_count", snapshot.GetCount());
+    root.WithInt64(h->GetName() + "_p50", snapshot.GetPercentile(0.5));
+    root.WithInt64(h->GetName() + "_p90", snapshot.GetPercentile(0.9));
+    root.WithInt64(h->GetName() + "_p99", snapshot.GetPercentile(0.99));
+    root.WithInt64(h->GetName() + "_max", snapshot.GetMax());
+  }
   auto resp = root.WriteReadable();
   response << "HTTP/1.1 200 OK\r\nContent-Length: " << resp.size() <<"\r\n\r\n" << resp;
-}
\ No newline at end of file
+}
+
+void StatsServer::_RenderMetrics(StatsReceiver& stats, HttpServer::Response& response) {
+  // Sent chunked a family at a time, so a scrape never holds the whole page.
+  response << "HTTP/1.1 200 OK\r\n"
+           << "Content-Type: " OPENMETRICS_CONTENT_TYPE "\r\n"
+           << "Transfer-Encoding: chunked\r\n\r\n";
+  OpenMetricsWriter::Render(stats, [&response](const std::string& chunk) {
+    response << std::hex << chunk.size() << std::dec << "\r\n" << chunk << "\r\n";
+    response.flush();
+  });
+  response << "0\r\n\r\n";
+}
@@ -0,0 +1,60 @@
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include "TransferAcl.h"
+
+bool TransferAcl::TryParse(const std::string &acl) {
+  std::vector<std::string> entries;
+  boost::algorithm::split(entries, acl, boost::is_any_of(","));
+
+  std::vector<Ipv4Cidr> networks;
+  std::vector<ClientAddress> addresses;
+  for (const auto &e : entries) {
+    auto entry = boost::algorithm::trim_copy(e);
+    if (entry.empty()) {
+      continue;
+    }
+    Ipv4Cidr cidr;
+    ClientAddress addr;
+    if (entry.find('/') != std::string::npos) {
+      if (!Ipv4Cidr::TryParse(entry, &cidr)) {
+        return false;
+      }
+      networks.push_back(cidr);
+    }
+    else if (ClientAddress::TryParse(entry, &addr)) {
+      addresses.push_back(addr);
+    }
+    else {
+      return false;
+    }
+  }
+  this->m_networks = networks;
+  this->m_addresses = addresses;
+  return true;
+}
+
+bool TransferAcl::IsAllowed(const ClientAddress &client) const {
+  if (!client.IsValid()) {
+    return false;
+  }
+  for (const auto &a : this->m_addresses) {
+    if (a == client) {
+      return true;
+    }
+  }
+  if (client.GetFamily() == AF_INET) {
+    for (const auto &n : this->m_networks) {
+      if (n.Contains(client.GetV4())) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool TransferAcl::IsAllowed(const char *client) const {
+  ClientAddress addr;
+  return client != nullptr && ClientAddress::TryParse(client, &addr) && this->IsAllowed(addr);
+}
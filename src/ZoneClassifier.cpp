@@ -0,0 +1,44 @@
+#include <strings.h>
+
+#include <boost/algorithm/string/case_conv.hpp>
+
+#include "ZoneClassifier.h"
+
+#define AUTOSCALER_PREFIX "asg."
+#define AUTOSCALER_PREFIX_LEN (sizeof(AUTOSCALER_PREFIX) - 1)
+
+ZoneClassifier::ZoneClassifier(const std::string &zoneName, std::shared_ptr<ReverseLookupHelper> rlHelper)
+  : m_zoneName(boost::algorithm::to_lower_copy(zoneName)),
+    m_rlHelper(rlHelper) {
+  if (!this->m_zoneName.empty() && this->m_zoneName.back() == '.') {
+    this->m_zoneName.pop_back();
+  }
+  this->m_autoscalerZoneName = AUTOSCALER_PREFIX + this->m_zoneName;
+}
+
+ZoneKind ZoneClassifier::Classify(const char *zone) const {
+  return this->Classify(zone, strlen(zone));
+}
+
+ZoneKind ZoneClassifier::Classify(const char *zone, size_t len) const {
+  if (len > 0 && zone[len - 1] == '.') {
+    len--;
+  }
+  const size_t zoneLen = this->m_zoneName.length();
+
+  if (len == zoneLen) {
+    if (strncasecmp(zone, this->m_zoneName.c_str(), len) == 0) {
+      return ZoneKind::Forward;
+    }
+  }
+  else if (len == zoneLen + AUTOSCALER_PREFIX_LEN) {
+    if (strncasecmp(zone, this->m_autoscalerZoneName.c_str(), len) == 0) {
+      return ZoneKind::Autoscaler;
+    }
+  }
+
+  if (this->m_rlHelper && this->m_rlHelper->IsReverseLookupZone(zone, len)) {
+    return ZoneKind::Reverse;
+  }
+  return ZoneKind::Unknown;
+}
@@ -0,0 +1,83 @@
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+
+#include "ZoneFileWriter.h"
+
+ZoneFileWriter::ZoneFileWriter(
+    const std::string &directory,
+    const std::string &zoneName,
+    const std::vector<std::string> &reverseZones,
+    std::shared_ptr<ZoneRecords> records,
+    std::shared_ptr<StatsReceiver> statsReceiver)
+  : m_directory(directory),
+    m_records(records),
+    m_writes(statsReceiver->Create("zone_export_writes")),
+    m_skipped(statsReceiver->Create("zone_export_skipped")),
+    m_failures(statsReceiver->Create("zone_export_failures")),
+    m_bytes(statsReceiver->Create("zone_export_bytes")),
+    m_writeMs(statsReceiver->Create("zone_export_write_ms")) {
+  auto name = zoneName;
+  if (!name.empty() && name.back() == '.') {
+    name.pop_back();
+  }
+  this->m_zones.push_back(ExportedZone {name, ZoneKind::Forward, false, 0});
+  this->m_zones.push_back(ExportedZone {"asg." + name, ZoneKind::Autoscaler, false, 0});
+  for (const auto &z : reverseZones) {
+    this->m_zones.push_back(ExportedZone {z, ZoneKind::Reverse, false, 0});
+  }
+}
+
+const std::string ZoneFileWriter::GetPath(const std::string &zone) const {
+  return this->m_directory + "/" + zone + ".zone";
+}
+
+void ZoneFileWriter::Write(const ZoneSnapshot &snapshot, const RecordTtls &ttls) {
+  for (auto &zone : this->m_zones) {
+    auto digest = this->m_records->Digest(snapshot, zone.kind, zone.name.c_str());
+    if (zone.written && zone.digest == digest) {
+      this->m_skipped->Increment();
+      continue;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    if (!this->_WriteZone(zone, snapshot, ttls, &bytes)) {
+      this->m_failures->Increment();
+      continue;
+    }
+    zone.written = true;
+    zone.digest = digest;
+    this->m_writes->Increment();
+    this->m_bytes->Increment(bytes);
+    this->m_writeMs->Increment(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+}
+
+bool ZoneFileWriter::_WriteZone(
+    const ExportedZone &zone, const ZoneSnapshot &snapshot, const RecordTtls &ttls, size_t *bytes) {
+  auto path = this->GetPath(zone.name);
+  auto tempPath = path + ".tmp";
+  FILE *f = fopen(tempPath.c_str(), "w");
+  if (f == nullptr) {
+    return false;
+  }
+
+  bool success = fprintf(f, "$ORIGIN %s.\n$TTL %u\n", zone.name.c_str(), ttls.GetApexTtl()) > 0;
+  success = success && this->m_records->ForEach(
+      snapshot, zone.kind, zone.name.c_str(), ttls,
+      [f](const char *name, uint32_t ttl, const char *type, const char *data) {
+        return fprintf(f, "%s\t%u\tIN\t%s\t%s\n", name, ttl, type, data) > 0;
+      });
+  success = success && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  long size = ftell(f);
+  success = (fclose(f) == 0) && success;
+
+  if (!success || rename(tempPath.c_str(), path.c_str()) != 0) {
+    unlink(tempPath.c_str());
+    return false;
+  }
+  *bytes = size > 0 ? (size_t)size : 0;
+  return true;
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstring>
+
+#include <boost/functional/hash.hpp>
+
+#include "ZoneRecords.h"
+
+#define REVERSE_ZONE_MASK 0xFFFFFF00u
+
+static void _HashInstance(uint64_t *digest, const SnapshotInstance &instance) {
+  boost::hash_combine(*digest, instance.id);
+  boost::hash_combine(*digest, instance.ipv4);
+  boost::hash_combine(*digest, instance.idHigh);
+  boost::hash_combine(*digest, instance.idDigits);
+  boost::hash_combine(*digest, instance.zone);
+  boost::hash_combine(*digest, instance.flags);
+}
+
+ZoneRecords::ZoneRecords(
+    const std::string &zoneName,
+    const std::vector<std::string> &nameservers,
+    std::shared_ptr<ReverseLookupHelper> rlHelper)
+  : m_zoneName(zoneName),
+    m_nameservers(nameservers),
+    m_rlHelper(rlHelper) {
+  if (!this->m_zoneName.empty() && this->m_zoneName.back() == '.') {
+    this->m_zoneName.pop_back();
+  }
+}
+
+const char* ZoneRecords::FormatSoa(uint32_t serial, char *buf, size_t len) const {
+  snprintf(buf, len, "%s. hostmaster.%s. %u 172800 900 1209600 180",
+           this->m_zoneName.c_str(), this->m_zoneName.c_str(), serial);
+  return buf;
+}
+
+bool ZoneRecords::_TryGetReverseNetwork(const char *zone, uint32_t *network) const {
+  size_t numOctets;
+  return ReverseLookupHelper::TryParseReverseName(zone, strlen(zone), network, &numOctets) && numOctets == 3;
+}
+
+bool ZoneRecords::IsListable(ZoneKind zoneKind, const char *zone) const {
+  uint32_t network;
+  return zoneKind == ZoneKind::Forward
+      || zoneKind == ZoneKind::Autoscaler
+      || (zoneKind == ZoneKind::Reverse && this->_TryGetReverseNetwork(zone, &network));
+}
+
+bool ZoneRecords::ForEach(
+    const ZoneSnapshot &snapshot, ZoneKind zoneKind, const char *zone, const RecordTtls &ttls,
+    const Emitter &emit) const {
+  if (!this->IsListable(zoneKind, zone)) {
+    return false;
+  }
+  auto apexTtl = ttls.GetApexTtl();
+  char soa[SOA_BUFFER_SIZE];
+  if (!emit("@", apexTtl, "SOA", this->FormatSoa(snapshot.GetSerial(), soa, sizeof(soa)))) {
+    return false;
+  }
+  for (const auto &ns : this->m_nameservers) {
+    if (!emit("@", apexTtl, "NS", ns.c_str())) {
+      return false;
+    }
+  }
+
+  auto stableSince = snapshot.GetStableSince();
+  auto instances = snapshot.GetInstances();
+  if (zoneKind == ZoneKind::Forward) {
+    char label[SNAPSHOT_HOSTNAME_BUFFER_SIZE];
+    char ip[SNAPSHOT_IP_BUFFER_SIZE];
+    for (const auto &i : instances) {
+      if (!(i.flags & SNAPSHOT_INSTANCE_HAS_IPV4)
+          || snapshot.FormatHostname(i, false, label, sizeof(label)) == nullptr) {
+        continue;
+      }
+      auto ttl = ttls.GetHostTtl(stableSince[&i - instances.begin()]);
+      if (!emit(label, ttl, "A", ZoneSnapshot::FormatIp(i, ip, sizeof(ip)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (zoneKind == ZoneKind::Autoscaler) {
+    for (const auto &group : snapshot.GetAutoscalingGroups()) {
+      for (const auto &ip : group.second->GetIps()) {
+        if (!emit(group.first.c_str(), group.second->GetTtl(), "A", ip.c_str())) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  uint32_t network;
+  this->_TryGetReverseNetwork(zone, &network);
+  auto range = snapshot.GetInstancesInNetwork(network, REVERSE_ZONE_MASK);
+  char hostname[SNAPSHOT_HOSTNAME_BUFFER_SIZE];
+  for (auto i = range.first; i != range.second; ++i) {
+    if (!this->m_rlHelper->IsInVpc(i->ipv4)
+        || snapshot.FormatHostname(*i, true, hostname, sizeof(hostname)) == nullptr) {
+      continue;
+    }
+    char label[4];
+    snprintf(label, sizeof(label), "%u", i->ipv4 & 0xFF);
+    if (!emit(label, ttls.GetHostTtl(stableSince[i - instances.begin()]), "PTR", hostname)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t ZoneRecords::Digest(const ZoneSnapshot &snapshot, ZoneKind zoneKind, const char *zone) const {
+  uint64_t digest = 0;
+  if (zoneKind == ZoneKind::Forward) {
+    for (const auto &z : snapshot.GetZones()) {
+      boost::hash_combine(digest, z);
+    }
+    for (const auto &i : snapshot.GetInstances()) {
+      _HashInstance(&digest, i);
+    }
+    return digest;
+  }
+  if (zoneKind == ZoneKind::Autoscaler) {
+    for (const auto &group : snapshot.GetAutoscalingGroups()) {
+      boost::hash_combine(digest, group.first);
+      for (const auto &ip : group.second->GetIps()) {
+        boost::hash_combine(digest, ip);
+      }
+    }
+    return digest;
+  }
+  uint32_t network;
+  if (!this->_TryGetReverseNetwork(zone, &network)) {
+    return digest;
+  }
+  for (const auto &z : snapshot.GetZones()) {
+    boost::hash_combine(digest, z);
+  }
+  auto range = snapshot.GetInstancesInNetwork(network, REVERSE_ZONE_MASK);
+  for (auto i = range.first; i != range.second; ++i) {
+    _HashInstance(&digest, *i);
+  }
+  return digest;
+}
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <numeric>
+
+#include "ZoneSnapshot.h"
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static int _HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool _IdLess(const SnapshotInstance &lhs, const SnapshotInstance &rhs) {
+  if (lhs.idDigits != rhs.idDigits) {
+    return lhs.idDigits < rhs.idDigits;
+  }
+  return lhs.idHigh != rhs.idHigh ? lhs.idHigh < rhs.idHigh : lhs.id < rhs.id;
+}
+
+bool SnapshotInstance::TrySetId(const boost::string_ref& instanceId) {
+  if (instanceId.size() < 3
+      || instanceId.size() > 2 + SNAPSHOT_MAX_ID_DIGITS
+      || !instanceId.starts_with("i-")) {
+    return false;
+  }
+  uint64_t id = 0;
+  uint8_t high = 0;
+  for (size_t i = 2; i < instanceId.size(); i++) {
+    int value = _HexValue(instanceId[i]);
+    if (value < 0) {
+      return false;
+    }
+    high = (uint8_t)(id >> 60);
+    id = (id << 4) | (uint64_t)value;
+  }
+  this->id = id;
+  this->idHigh = high;
+  this->idDigits = (uint8_t)(instanceId.size() - 2);
+  return true;
+}
+
+size_t SnapshotInstance::FormatIdDigits(char *buf) const {
+  for (size_t i = 0; i < this->idDigits; i++) {
+    size_t shift = this->idDigits - 1 - i;
+    buf[i] = HEX_DIGITS[shift == 16 ? this->idHigh : (this->id >> (4 * shift)) & 0xF];
+  }
+  return this->idDigits;
+}
+
+HostnameFormat::HostnameFormat(const std::string& regionCode, const std::string& account, const std::string& zone)
+  : m_regionCode(regionCode),
+    m_account(account),
+    m_zone(zone) {
+  if (!this->m_zone.empty() && this->m_zone.back() == '.') {
+    this->m_zone.pop_back();
+  }
+}
+
+const char* HostnameFormat::Format(
+    char zoneLetter, const char *idDigits, size_t idLen, bool qualified, char *buf, size_t len) const {
+  int written = qualified
+      ? snprintf(buf, len, "%s%c-%s-%.*s.%s.", this->m_regionCode.c_str(), zoneLetter,
+                 this->m_account.c_str(), (int)idLen, idDigits, this->m_zone.c_str())
+      : snprintf(buf, len, "%s%c-%s-%.*s", this->m_regionCode.c_str(), zoneLetter,
+                 this->m_account.c_str(), (int)idLen, idDigits);
+  return written >= 0 && (size_t)written < len ? buf : nullptr;
+}
+
+struct OwnedInstances {
+  std::vector<SnapshotInstance> instances;
+  std::vector<uint32_t> idIndex;
+  std::vector<uint32_t> stableSince;
+};
+
+static std::shared_ptr<OwnedInstances> _SortInstances(
+    std::vector<SnapshotInstance> instances, std::vector<uint32_t> stableSince) {
+  std::vector<uint32_t> order(instances.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&instances](uint32_t lhs, uint32_t rhs) {
+    const auto &l = instances[lhs], &r = instances[rhs];
+    return l.ipv4 != r.ipv4 ? l.ipv4 < r.ipv4 : _IdLess(l, r);
+  });
+
+  auto owned = std::make_shared<OwnedInstances>();
+  owned->instances.reserve(instances.size());
+  owned->stableSince.reserve(instances.size());
+  for (auto i : order) {
+    owned->instances.push_back(instances[i]);
+    owned->stableSince.push_back(i < stableSince.size() ? stableSince[i] : 0);
+  }
+  const auto &sorted = owned->instances;
+  owned->idIndex.resize(sorted.size());
+  std::iota(owned->idIndex.begin(), owned->idIndex.end(), 0);
+  std::sort(owned->idIndex.begin(), owned->idIndex.end(), [&sorted](uint32_t lhs, uint32_t rhs) {
+    return _IdLess(sorted[lhs], sorted[rhs]);
+  });
+  return owned;
+}
+
+ZoneSnapshot::ZoneSnapshot(
+    uint32_t serial,
+    std::vector<SnapshotInstance> instances,
+    std::vector<std::string> zones,
+    HostnameFormat format,
+    AutoscalingGroups groups,
+    std::vector<uint32_t> stableSince)
+  : m_serial(serial),
+    m_zones(std::move(zones)),
+    m_format(std::move(format)),
+    m_groups(std::move(groups)) {
+  auto owned = _SortInstances(std::move(instances), std::move(stableSince));
+  this->m_instances = owned->instances.data();
+  this->m_idIndex = owned->idIndex.data();
+  this->m_stableSince = owned->stableSince.data();
+  this->m_numInstances = owned->instances.size();
+  this->m_storage = std::move(owned);
+}
+
+ZoneSnapshot::ZoneSnapshot(
+    uint32_t serial,
+    std::shared_ptr<const void> storage,
+    const SnapshotInstance *instances,
+    const uint32_t *idIndex,
+    const uint32_t *stableSince,
+    size_t numInstances,
+    std::vector<std::string> zones,
+    HostnameFormat format,
+    AutoscalingGroups groups)
+  : m_serial(serial),
+    m_storage(std::move(storage)),
+    m_instances(instances),
+    m_idIndex(idIndex),
+    m_stableSince(stableSince),
+    m_numInstances(numInstances),
+    m_zones(std::move(zones)),
+    m_format(std::move(format)),
+    m_groups(std::move(groups)) { }
+
+std::shared_ptr<const ZoneSnapshot> ZoneSnapshot::WithFormat(const HostnameFormat& format) const {
+  return std::make_shared<const ZoneSnapshot>(
+      this->m_serial, this->m_storage, this->m_instances, this->m_idIndex, this->m_stableSince,
+      this->m_numInstances, this->m_zones, format, this->m_groups);
+}
+
+std::pair<ZoneSnapshot::InstanceIterator, ZoneSnapshot::InstanceIterator>
+ZoneSnapshot::GetInstancesInNetwork(uint32_t network, uint32_t mask) const {
+  uint32_t first = network & mask;
+  uint32_t last = first | ~mask;
+  auto instances = this->GetInstances();
+  auto begin = std::lower_bound(
+      instances.begin(),
+      instances.end(),
+      first,
+      [](const SnapshotInstance &i, uint32_t ip) { return i.ipv4 < ip; });
+  auto end = std::upper_bound(
+      begin,
+      instances.end(),
+      last,
+      [](uint32_t ip, const SnapshotInstance &i) { return ip < i.ipv4; });
+  return std::make_pair(begin, end);
+}
+
+const SnapshotInstance* ZoneSnapshot::FindById(const SnapshotInstance& id) const {
+  auto instances = this->m_instances;
+  auto end = this->m_idIndex + this->m_numInstances;
+  auto found = std::lower_bound(
+      this->m_idIndex, end, id,
+      [instances](uint32_t i, const SnapshotInstance &key) { return _IdLess(instances[i], key); });
+  if (found == end || _IdLess(id, instances[*found])) {
+    return nullptr;
+  }
+  return &instances[*found];
+}
+
+const SnapshotInstance* ZoneSnapshot::FindByIp(uint32_t ip) const {
+  auto range = this->GetInstancesInNetwork(ip, 0xFFFFFFFFu);
+  return range.first == range.second ? nullptr : range.first;
+}
+
+const char* ZoneSnapshot::FormatHostname(
+    const SnapshotInstance& instance, bool qualified, char *buf, size_t len) const {
+  char zoneLetter = '?';
+  if (instance.zone < this->m_zones.size() && !this->m_zones[instance.zone].empty()) {
+    zoneLetter = this->m_zones[instance.zone].back();
+  }
+  char digits[SNAPSHOT_MAX_ID_DIGITS];
+  size_t idLen = instance.FormatIdDigits(digits);
+  return this->m_format.Format(zoneLetter, digits, idLen, qualified, buf, len);
+}
+
+const char* ZoneSnapshot::FormatInstanceId(const SnapshotInstance& instance, char *buf, size_t len) {
+  if (len < (size_t)instance.idDigits + 3) {
+    return nullptr;
+  }
+  buf[0] = 'i';
+  buf[1] = '-';
+  buf[2 + instance.FormatIdDigits(buf + 2)] = '\0';
+  return buf;
+}
+
+const char* ZoneSnapshot::FormatIp(const SnapshotInstance& instance, char *buf, size_t len) {
+  uint32_t ip = instance.ipv4;
+  int written = snprintf(buf, len, "%u.%u.%u.%u", ip >> 24, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+  return written >= 0 && (size_t)written < len ? buf : nullptr;
+}
+
+uint32_t ZoneSnapshot::NextSerial(uint32_t previous) {
+  uint32_t now = (uint32_t)time(nullptr);
+  return std::max(previous + 1, now);
+}
@@ -1,4 +1,5 @@
 #include <stdarg.h>
+#include <algorithm>
 #include <math.h>
 #include <memory>
 #include <random>
@@ -10,17 +11,25 @@
 #include <boost/algorithm/string/join.hpp>
 
 #include "dlz_minimal.h"
+#include "ClientAddress.h"
+#include "DlzState.h"
 #include "Ec2DnsClient.h"
 #include "HostMatcher.h"
 #include "KRandom.h"
+#include "QueryLog.h"
+#include "QueryTracer.h"
 #include "ReverseLookupHelper.h"
+#include "SdkMemory.h"
 #include "Stats.h"
+#include "TransferAcl.h"
+#include "ZoneClassifier.h"
+#include "ZoneFileWriter.h"
+#include "ZoneRecords.h"
+#include "ZoneSnapshot.h"
 
 #include "aws/core/Aws.h"
 #include "aws/core/auth/AWSCredentialsProvider.h"
 #include "aws/core/utils/StringUtils.h"
-#include "aws/core/utils/logging/AWSLogging.h"
-#include "aws/core/utils/logging/DefaultLogSystem.h"
 
 #include <arpa/inet.h>
 #include <dlz_minimal.h>
@@ -28,45 +37,215 @@
 using namespace Aws::EC2;
 using namespace Aws::Utils;
 
-struct dlz_state {
-    std::shared_ptr<Ec2DnsClient> client;
-    std::unique_ptr<HostMatcher> matcher;
-    std::unique_ptr<ReverseLookupHelper> rl_helper;
-    std::unique_ptr<StatsServer> stats_server;
-    std::shared_ptr<StatsReceiver> stats_receiver;
-    std::string soa_data;
-    std::string zone_name;
-    std::string autoscaler_zone_name;
-    size_t num_asg_records;
-    DlzCallbacks callbacks;
-};
-
 isc_result_t get_src_address(dns_clientinfomethods_t *methods,
-    dns_clientinfo_t *clientinfo, std::string *srcAddress) {
+    dns_clientinfo_t *clientinfo, ClientAddress *srcAddress) {
   isc_result_t ret;
   if (methods != NULL && methods->version - methods->age >= DNS_CLIENTINFOMETHODS_VERSION) {
     isc_sockaddr_t *addr;
     if ((ret = methods->sourceip(clientinfo, &addr)) != ISC_R_SUCCESS) {
       return ret;
     }
-    char buf[100];
-    const char* retAddr;
     switch (addr->type.sa.sa_family) {
       case AF_INET:
-        retAddr = inet_ntop(AF_INET, &addr->type.sin.sin_addr, buf, sizeof(buf));
-        break;
+        *srcAddress = ClientAddress::FromV4(addr->type.sin.sin_addr);
+        return ISC_R_SUCCESS;
       case AF_INET6:
-        retAddr = inet_ntop(AF_INET6, &addr->type.sin6.sin6_addr, buf, sizeof(buf));
-        break;
+        *srcAddress = ClientAddress::FromV6(addr->type.sin6.sin6_addr);
+        return ISC_R_SUCCESS;
       default:
         return ISC_R_FAILURE;
     }
-    if (retAddr == NULL) {
-      return ISC_R_FAILURE;
+  }
+  return ISC_R_FAILURE;
+}
+
+// Turns the label after "ip-" (ie "10-1-2-3") into a dotted IPv4 address.
+static bool synthesize_ip(const char *label, char *ip, size_t len) {
+  size_t i = 0;
+  for (; label[i] != '\0'; i++) {
+    if (i + 1 >= len) {
+      return false;
+    }
+    ip[i] = label[i] == '-' ? '.' : label[i];
+  }
+  ip[i] = '\0';
+  struct in_addr addr;
+  return i > 0 && inet_pton(AF_INET, ip, &addr) == 1;
+}
+
+static RecordTtls get_record_ttls(const Ec2DnsClient &client) {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  auto nextRefresh = std::chrono::steady_clock::duration(client.GetNextRefresh());
+  return RecordTtls(
+      client.GetConfig()->host_ttl,
+      std::chrono::duration_cast<std::chrono::seconds>(now).count(),
+      std::chrono::duration_cast<std::chrono::seconds>(nextRefresh).count());
+}
+
+// Shared by every zone and never freed, SDK allocations may outlive them all.
+static SdkMemorySystem* get_sdk_memory() {
+  static SdkMemorySystem *memory = new SdkMemorySystem();
+  return memory;
+}
+
+DlzHooks& dlz_hooks() {
+  static DlzHooks hooks;
+  return hooks;
+}
+
+static void create_aws_clients(
+    const Ec2DnsConfig& config,
+    std::shared_ptr<EC2Client> *ec2Client,
+    std::shared_ptr<AutoScalingClient> *asgClient) {
+  if (dlz_hooks().client_factory) {
+    dlz_hooks().client_factory(config, ec2Client, asgClient);
+  }
+  else if (!config.aws_access_key.empty() && !config.aws_secret_key.empty()) {
+    Aws::Auth::AWSCredentials creds(
+        config.aws_access_key,
+        config.aws_secret_key);
+    *ec2Client = std::make_shared<EC2Client>(creds, config.client_config);
+    *asgClient = std::make_shared<AutoScalingClient>(creds, config.client_config);
+  }
+  else {
+    *ec2Client = std::make_shared<EC2Client>(config.client_config);
+    *asgClient = std::make_shared<AutoScalingClient>(config.client_config);
+  }
+}
+
+std::string dlz_reload_config(dlz_state *state) {
+  std::lock_guard<std::mutex> lock(state->reload_lock);
+  const auto &path = dlz_hooks().config_path;
+  Ec2DnsConfig config(state->account_name, state->vpc_cidr, state->zone_name);
+  if (!config.TryLoad(path)) {
+    state->callbacks.log(ISC_LOG_WARNING, "ec2dns - Unable to reload %s, keeping the current config", path.c_str());
+    return Aws::Utils::Json::JsonValue().WithString("error", "Unable to load " + path).WriteReadable();
+  }
+
+  auto current = state->client->GetConfig();
+  bool timeoutsChanged =
+      current->client_config.requestTimeoutMs != config.client_config.requestTimeoutMs ||
+      current->client_config.connectTimeoutMs != config.client_config.connectTimeoutMs;
+  auto needsRestart = current->GetChangedFixedSettings(config);
+  std::vector<Ec2DnsClient*> clients = {state->client.get()};
+  if (state->engine && state->engine->GetOwner() != state->client) {
+    clients.push_back(state->engine->GetOwner().get());
+  }
+  std::vector<std::string> applied;
+  for (auto client : clients) {
+    auto changed = client->ApplyConfig(config);
+    if (client == state->client.get()) {
+      applied = changed;
+    }
+    if (timeoutsChanged) {
+      std::shared_ptr<EC2Client> ec2Client;
+      std::shared_ptr<AutoScalingClient> asgClient;
+      create_aws_clients(*client->GetConfig(), &ec2Client, &asgClient);
+      client->SetAwsClients(ec2Client, asgClient);
+    }
+  }
+
+  auto appliedList = boost::algorithm::join(applied, ", ");
+  auto needsRestartList = boost::algorithm::join(needsRestart, ", ");
+  if (!applied.empty()) {
+    state->callbacks.log(ISC_LOG_INFO, "ec2dns - Reloaded %s: %s", path.c_str(), appliedList.c_str());
+  }
+  if (!needsRestart.empty()) {
+    state->callbacks.log(ISC_LOG_WARNING, "ec2dns - Changes to %s in %s need named to reload the zone",
+        needsRestartList.c_str(), path.c_str());
+  }
+  return Aws::Utils::Json::JsonValue()
+      .WithString("applied", appliedList)
+      .WithString("needs_restart", needsRestartList)
+      .WriteReadable();
+}
+
+// Answers a dlz_lookup, info and trace receive how it was answered.
+static isc_result_t do_lookup(
+    const char *zone, const char *name, dlz_state *state,
+    dns_sdlzlookup_t *lookup, dns_clientinfomethods_t *methods,
+    dns_clientinfo_t *clientinfo, ResolveInfo *info, QueryTrace *trace) {
+
+  if (strcmp(name, "@") == 0) {
+    trace->path = QueryPath::Apex;
+    info->ttl = get_record_ttls(*state->client).GetApexTtl();
+    char soa[SOA_BUFFER_SIZE];
+    state->records->FormatSoa(state->client->GetSnapshotSerial(), soa, sizeof(soa));
+    state->callbacks.putrr(lookup, "SOA", info->ttl, soa);
+    for (const auto &ns : state->records->GetNameservers()) {
+      state->callbacks.putrr(lookup, "NS", info->ttl, ns.c_str());
     }
-    *srcAddress = buf;
     return ISC_R_SUCCESS;
   }
+  if (strcmp(name, "*") == 0) {
+    trace->path = QueryPath::Wildcard;
+    return ISC_R_NOTFOUND;
+  }
+  auto zoneKind = state->classifier->Classify(zone);
+  trace->Mark(QueryPhase::Classified);
+  if (zoneKind == ZoneKind::Reverse) {
+    char hostName[DNS_NAME_BUFFER_SIZE];
+    trace->path = QueryPath::Reverse;
+    get_src_address(methods, clientinfo, &trace->client);
+    auto found = state->rl_helper->DoReverseLookup(zone, name, trace->client, hostName, sizeof(hostName), info);
+    trace->Mark(QueryPhase::Resolved);
+    if (found) {
+      state->callbacks.putrr(lookup, "PTR", info->ttl, hostName);
+      return ISC_R_SUCCESS;
+    }
+    else {
+      return ISC_R_NOTFOUND;
+    }
+  }
+
+  if (strncmp(name, "ip-", 3) == 0 && name[3] != '\0') {
+    char ip[INET_ADDRSTRLEN];
+    trace->path = QueryPath::Synthesized;
+    if (!synthesize_ip(name + 3, ip, sizeof(ip))) {
+      return ISC_R_NOTFOUND;
+    }
+    // Synthesized addresses never change.
+    state->callbacks.putrr(lookup, "A", state->client->GetConfig()->host_ttl.max_ttl, ip);
+    return ISC_R_SUCCESS;
+  }
+
+  if (zoneKind == ZoneKind::Autoscaler) {
+    AsgMembersPtr nodes;
+    trace->path = QueryPath::Autoscaler;
+    get_src_address(methods, clientinfo, &trace->client);
+    auto found = state->client->TryResolveAutoscaler(name, trace->client, &nodes);
+    trace->Mark(QueryPhase::Resolved);
+    if (found) {
+      size_t picks[K_RANDOM_MAX_K];
+      size_t numPicks = state->client->SelectAutoscalerMembers(*nodes, trace->client, picks);
+      for (size_t i = 0; i < numPicks; i++) {
+        state->callbacks.putrr(lookup, "A", nodes->GetTtl(), nodes->GetIp(picks[i]).c_str());
+      }
+      return ISC_R_SUCCESS;
+    }
+    else {
+      return ISC_R_NOTFOUND;
+    }
+  }
+
+  char instanceId[DNS_NAME_BUFFER_SIZE];
+  boost::string_ref awsZone;
+  bool matched = state->matcher->TryMatch(name, instanceId, sizeof(instanceId), &awsZone);
+  if (!matched || awsZone.empty()) {
+    trace->path = QueryPath::RegexMiss;
+    return ISC_R_NOTFOUND;
+  }
+
+  char ip[DNS_NAME_BUFFER_SIZE];
+  trace->path = QueryPath::Forward;
+  get_src_address(methods, clientinfo, &trace->client);
+  auto success = state->client->TryResolveIp(instanceId, trace->client, ip, sizeof(ip), info);
+  trace->Mark(QueryPhase::Resolved);
+  if (success) {
+    return state->callbacks.putrr(lookup, "A", info->ttl, ip);
+  } else if (info->outcome == LookupOutcome::Absent) {
+    return ISC_R_NOTFOUND;
+  }
   return ISC_R_FAILURE;
 }
 
@@ -112,82 +291,144 @@ isc_result_t dlz_create(
   cbs.log(ISC_LOG_WARNING, "Creating EC2 client");
 
   Ec2DnsConfig dnsConfig(argv[3], argv[2], argv[1]);
-  dnsConfig.TryLoad("/etc/ec2dns.conf");
+  dnsConfig.TryLoad(dlz_hooks().config_path);
 
   Aws::SDKOptions options;
   options.loggingOptions.logLevel = (Logging::LogLevel)dnsConfig.log_level;
   options.cryptoOptions.initAndCleanupOpenSSL = false;
-  Aws::InitAPI(options);
-
-  Logging::InitializeAWSLogging(
-      Aws::MakeShared<Logging::DefaultLogSystem>(
-          "log", (Logging::LogLevel)dnsConfig.log_level, dnsConfig.log_path));
+  if (dnsConfig.sdk_memory_pools) {
+    options.memoryManagementOptions.memoryManager = get_sdk_memory();
+  }
+  SdkLifetime::Get().Acquire(options, dnsConfig.log_path);
 
   std::shared_ptr<EC2Client> ec2Client;
   std::shared_ptr<AutoScalingClient> asgClient;
-  if (!dnsConfig.aws_access_key.empty() && !dnsConfig.aws_secret_key.empty()) {
-    Aws::Auth::AWSCredentials creds(
-        dnsConfig.aws_access_key,
-        dnsConfig.aws_secret_key);
-    ec2Client = std::make_shared<EC2Client>(creds, dnsConfig.client_config);
-    asgClient = std::make_shared<AutoScalingClient>(creds, dnsConfig.client_config);
-  }
-  else {
-    ec2Client = std::make_shared<EC2Client>(dnsConfig.client_config);
-    asgClient = std::make_shared<AutoScalingClient>(dnsConfig.client_config);
-  }
+  create_aws_clients(dnsConfig, &ec2Client, &asgClient);
 
-  auto state = new dlz_state();
+  // Owned here until it's handed to named, so failing frees it.
+  std::unique_ptr<dlz_state> ownedState(new dlz_state());
+  auto state = ownedState.get();
   state->stats_receiver = std::make_shared<StatsReceiver>();
-  state->num_asg_records = dnsConfig.num_asg_records;
   state->client = std::make_shared<Ec2DnsClient>(
           cbs.log,
-          ec2Client,
-          asgClient,
+          std::move(ec2Client),
+          std::move(asgClient),
           dnsConfig,
           state->stats_receiver);
   state->zone_name = argv[1];
-  state->autoscaler_zone_name = "asg." + state->zone_name;
+  state->vpc_cidr = argv[2];
+  state->account_name = argv[3];
   state->callbacks = cbs;
   state->matcher = std::unique_ptr<HostMatcher>(new HostMatcher(dnsConfig));
-  state->rl_helper = std::unique_ptr<ReverseLookupHelper>(new ReverseLookupHelper(state->client));
+  state->rl_helper = std::make_shared<ReverseLookupHelper>(state->client);
   if (!state->rl_helper->InitializeReverseLookupZones(argv[2])) {
-    printf("ec2dns - Unable to load reverse lookup zones");
+    cbs.log(ISC_LOG_CRITICAL, "ec2dns - Unable to load reverse lookup zones");
+    ownedState.reset();
+    SdkLifetime::Get().Release();
     return ISC_R_FAILURE;
   }
+  state->classifier = std::unique_ptr<ZoneClassifier>(new ZoneClassifier(state->zone_name, state->rl_helper));
+  if (!state->xfr_acl.TryParse(dnsConfig.xfr_allow)) {
+    cbs.log(ISC_LOG_CRITICAL, "Unable to parse xfr_allow \"%s\"", dnsConfig.xfr_allow.c_str());
+    ownedState.reset();
+    SdkLifetime::Get().Release();
+    return ISC_R_FAILURE;
+  }
+  std::vector<std::string> nameservers;
+  boost::algorithm::split(nameservers, dnsConfig.xfr_nameservers, boost::is_any_of(", "), boost::token_compress_on);
+  nameservers.erase(std::remove(nameservers.begin(), nameservers.end(), ""), nameservers.end());
+  state->records = std::make_shared<ZoneRecords>(state->zone_name, nameservers, state->rl_helper);
 
-  state->client->LaunchRefreshThread();
+  if (!dnsConfig.zone_file_dir.empty()) {
+    auto zoneWriter = std::make_shared<ZoneFileWriter>(
+        dnsConfig.zone_file_dir,
+        state->zone_name,
+        state->rl_helper->GetReverseLookupZones(),
+        state->records,
+        state->stats_receiver);
+    state->zone_writer = zoneWriter;
+    auto client = state->client.get();
+    state->client->SetSnapshotListener([zoneWriter, client](const ZoneSnapshotPtr &snapshot) {
+      zoneWriter->Write(*snapshot, get_record_ttls(*client));
+    });
+  }
 
-  Aws::OStringStream soaData;
-  soaData << state->zone_name
-          << " hostmaster." << state->zone_name
-          << " 123 172800 900 1209600 180";
-  state->soa_data = soaData.str();
-  state->stats_server = std::unique_ptr<StatsServer>(new StatsServer(8123, state->stats_receiver));
-  state->stats_server->Start();
-  *dbdata = state;
+  state->engine = RefreshRegistry::Get().Join(state->client);
+  if (state->engine->GetOwner() != state->client) {
+    cbs.log(ISC_LOG_INFO, "ec2dns - Sharing refresh %u for %s", state->engine->GetId(), state->zone_name.c_str());
+  }
+
+  state->stats_server = StatsServer::Acquire(dnsConfig.stats_port, dnsConfig.stats_address, dnsConfig.stats_threads);
+  state->stats_name = state->stats_server->Mount(state->zone_name, state->stats_receiver, [state]() {
+    return Aws::Utils::Json::JsonValue()
+        .WithString("zone", state->zone_name)
+        .WithInt64("serial", state->client->GetSnapshotSerial())
+        .WithBool("refreshes", state->engine->GetOwner() == state->client)
+        .WithObject("refresh", state->engine->ToJson());
+  });
+  auto statsName = state->stats_name;
+  state->tracer = std::unique_ptr<QueryTracer>(new QueryTracer(
+      dnsConfig.trace_sample_every, dnsConfig.trace_buffer_size, dnsConfig.trace_slowest));
+  auto tracer = state->tracer.get();
+  state->stats_server->AddJsonResource(statsName, "/debug/traces", [tracer]() { return tracer->RenderJson(); });
+  if (!dnsConfig.query_log_path.empty()) {
+    state->query_log.reset(new QueryLogWriter(
+        dnsConfig.query_log_path,
+        dnsConfig.query_log_sample_every,
+        (uint64_t)dnsConfig.query_log_max_mb << 20,
+        state->stats_receiver));
+    if (!state->query_log->IsOpen()) {
+      cbs.log(ISC_LOG_WARNING, "ec2dns - Unable to open query log %s", dnsConfig.query_log_path.c_str());
+    }
+  }
+  state->lookup_observer = dlz_hooks().lookup_observer;
+  auto sdkMemory = SdkMemorySystem::GetInstalled();
+  if (sdkMemory != nullptr) {
+    state->stats_server->AddJsonResource(statsName, "/debug/memory", [sdkMemory]() { return sdkMemory->RenderJson(); });
+  }
+  // Profiled by whichever client refreshes.
+  auto refreshProfiler = &state->engine->GetOwner()->GetRefreshProfiler();
+  state->stats_server->AddJsonResource(statsName, "/debug/refresh", [refreshProfiler]() { return refreshProfiler->RenderJson(); });
+  if (dnsConfig.top_k_capacity > 0) {
+    state->top_names.reset(new HeavyHitters("query_names", dnsConfig.top_k_capacity, dnsConfig.top_k_window_sec));
+    state->top_clients.reset(new HeavyHitters("clients", dnsConfig.top_k_capacity, dnsConfig.top_k_window_sec));
+    std::vector<HeavyHitters*> trackers = {
+        state->top_names.get(), state->client->GetMissKeys(), state->top_clients.get()};
+    state->stats_server->AddJsonResource(statsName, "/debug/top", [trackers]() {
+      Aws::Utils::Json::JsonValue root;
+      for (auto t : trackers) {
+        root.WithObject(t->GetName(), t->ToJson());
+      }
+      return root.WriteReadable();
+    });
+  }
+  state->stats_server->AddJsonAction(statsName, "/admin/reload", [state]() { return dlz_reload_config(state); });
+  if (dnsConfig.config_watch) {
+    state->config_watcher.reset(new ConfigWatcher(dlz_hooks().config_path, [state]() { dlz_reload_config(state); }));
+    if (!state->config_watcher->IsWatching()) {
+      cbs.log(ISC_LOG_WARNING, "ec2dns - Unable to watch %s for changes", dlz_hooks().config_path.c_str());
+    }
+  }
+  *dbdata = ownedState.release();
 
   cbs.log(ISC_LOG_WARNING, "EC2 client created");
   return ISC_R_SUCCESS;
 }
 
 void dlz_destroy(void *dbdata) {
-  delete static_cast<dlz_state *>(dbdata);
-  Logging::ShutdownAWSLogging();
+  auto state = static_cast<dlz_state *>(dbdata);
+  // Cut the state off from everything shared with other zones first.
+  state->config_watcher.reset();
+  state->stats_server->Unmount(state->stats_name);
+  state->engine->Leave(state->client.get());
+  delete state;
+  SdkLifetime::Get().Release();
 }
 
 isc_result_t dlz_findzonedb(void *dbdata, const char *name) {
   auto state = static_cast<dlz_state *>(dbdata);
-  // Are we doing a plain old instance lookup?
-  if (StringUtils::CaselessCompare(state->zone_name.c_str(), name)) {
-    return ISC_R_SUCCESS;
-  }
-  // Are we doing an autoscaler lookup?
-  if (StringUtils::CaselessCompare(state->autoscaler_zone_name.c_str(), name)) {
-    return ISC_R_SUCCESS;
-  }
-  // Are we doing a reverse lookup?
-  if (state->rl_helper->IsReverseLookupZone(name)) {
+  // Is this a forward, autoscaler or reverse lookup zone?
+  if (state->classifier->Classify(name) != ZoneKind::Unknown) {
     return ISC_R_SUCCESS;
   }
   // Nothing we can do
@@ -199,65 +440,99 @@ isc_result_t dlz_lookup(
     dns_sdlzlookup_t *lookup, dns_clientinfomethods_t *methods,
     dns_clientinfo_t *clientinfo) {
   auto state = static_cast<dlz_state *>(dbdata);
-
-  if (strcmp(name, "@") == 0) {
-    state->callbacks.putrr(lookup, "SOA", 120, state->soa_data.c_str());
-    return ISC_R_SUCCESS;
+  auto tracer = state->tracer.get();
+  ResolveInfo info;
+  QueryTrace trace;
+  trace.start = std::chrono::steady_clock::now();
+  bool sampled = tracer != nullptr && tracer->ShouldSample();
+  if (sampled) {
+    trace.Begin(zone, name, true);
   }
-  if (strcmp(name, "*") == 0) {
-    return ISC_R_NOTFOUND;
+  auto result = do_lookup(zone, name, state, lookup, methods, clientinfo, &info, &trace);
+  trace.Mark(QueryPhase::Answered);
+  uint64_t elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - trace.start).count();
+  state->client->RecordLookup(info.outcome, elapsedUs);
+
+  if (state->top_names) {
+    char key[HEAVY_HITTER_KEY_SIZE];
+    snprintf(key, sizeof(key), "%s.%s", name, zone);
+    state->top_names->Offer(key);
   }
-  if (state->rl_helper->IsReverseLookupZone(zone)) {
-    std::string hostName, clientAddr;
-    get_src_address(methods, clientinfo, &clientAddr);
-    if (state->rl_helper->DoReverseLookup(zone, name, clientAddr, &hostName)) {
-      state->callbacks.putrr(lookup, "PTR", 120, hostName.c_str());
-      return ISC_R_SUCCESS;
+  if (state->top_clients) {
+    char addrBuf[CLIENT_ADDRESS_STRLEN];
+    if (!trace.client.IsValid()) {
+      get_src_address(methods, clientinfo, &trace.client);
     }
-    else {
-      return ISC_R_NOTFOUND;
+    state->top_clients->Offer(trace.client.Format(addrBuf, sizeof(addrBuf)));
+  }
+  if (state->query_log && state->query_log->ShouldSample()) {
+    if (!trace.client.IsValid()) {
+      get_src_address(methods, clientinfo, &trace.client);
     }
+    auto sinceStart = std::chrono::steady_clock::now() - trace.start;
+    state->query_log->Append(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch() - sinceStart).count(),
+        zone, name, trace.client);
   }
-
-  if (strlen(name) > 3 && strncmp(name, "ip-", 3) == 0) {
-    std::string sname(name);
-    std::replace(sname.begin(), sname.end(), '-', '.');
-    sname = sname.substr(3);
-    state->callbacks.putrr(lookup, "A", 120, sname.c_str());
-    return ISC_R_SUCCESS;
+  if (state->lookup_observer) {
+    trace.outcome = info.outcome;
+    trace.result = result;
+    trace.total_us = (uint32_t)elapsedUs;
+    state->lookup_observer(trace);
   }
 
-  if (StringUtils::CaselessCompare(state->autoscaler_zone_name.c_str(), zone)) {
-    std::string clientAddr;
-    std::vector<std::string> nodes;
-    get_src_address(methods, clientinfo, &clientAddr);
-    if (state->client->TryResolveAutoscaler(name, clientAddr, &nodes)) {
-      size_t maxNodes = std::min(nodes.size(), state->num_asg_records);
-      for (const auto&& node : k_random<std::string>(nodes, maxNodes)) {
-        state->callbacks.putrr(lookup, "A", 120, node.c_str());
-      }
-      return ISC_R_SUCCESS;
+  if (tracer != nullptr && (sampled || tracer->IsSlow((uint32_t)elapsedUs))) {
+    if (!sampled) {
+      trace.Begin(zone, name, false);
     }
-    else {
-      return ISC_R_NOTFOUND;
+    trace.outcome = info.outcome;
+    trace.ttl = info.ttl;
+    trace.result = result;
+    trace.total_us = (uint32_t)elapsedUs;
+    if (sampled) {
+      tracer->Record(trace);
+    }
+    if (tracer->IsSlow(trace.total_us)) {
+      tracer->OfferSlow(trace);
     }
   }
+  return result;
+}
 
-  std::string instanceId, awsZone;
-  bool matched = state->matcher->TryMatch(name, &instanceId, &awsZone);
-  if (!matched || instanceId.empty() || awsZone.empty()) {
+isc_result_t dlz_allowzonexfr(void *dbdata, const char *name, const char *client) {
+  auto state = static_cast<dlz_state *>(dbdata);
+  if (state->classifier->Classify(name) == ZoneKind::Unknown) {
     return ISC_R_NOTFOUND;
   }
+  if (!state->xfr_acl.IsAllowed(client)) {
+    state->callbacks.log(ISC_LOG_INFO, "ec2dns - Refused transfer of %s to %s", name, client);
+    return ISC_R_NOPERM;
+  }
+  return ISC_R_SUCCESS;
+}
 
-  std::string ip, clientAddr;
-  get_src_address(methods, clientinfo, &clientAddr);
-  auto success = state->client->TryResolveIp(instanceId, clientAddr, &ip);
-  if (success) {
-    return state->callbacks.putrr(lookup, "A", 120, ip.c_str());
-  } else {
+isc_result_t dlz_allnodes(const char *zone, void *dbdata, dns_sdlzallnodes_t *allnodes) {
+  auto state = static_cast<dlz_state *>(dbdata);
+  auto zoneKind = state->classifier->Classify(zone);
+  if (!state->records->IsListable(zoneKind, zone)) {
+    return ISC_R_NOTFOUND;
+  }
+  auto snapshot = state->client->GetSnapshot();
+  if (!snapshot) {
+    state->callbacks.log(ISC_LOG_WARNING, "ec2dns - Unable to transfer %s, no instance data loaded yet", zone);
     return ISC_R_FAILURE;
   }
-  return ISC_R_NOTFOUND;
+  isc_result_t result = ISC_R_SUCCESS;
+  bool listed = state->records->ForEach(
+      *snapshot, zoneKind, zone, get_record_ttls(*state->client),
+      [&](const char *name, uint32_t ttl, const char *type, const char *data) {
+        result = state->callbacks.putnamedrr(allnodes, name, type, ttl, data);
+        return result == ISC_R_SUCCESS;
+      });
+  return listed || result != ISC_R_SUCCESS ? result : ISC_R_NOTFOUND;
 }
 
-}
\ No newline at end of file
+
+}
@@ -30,6 +30,27 @@ public:
     ) : Ec2DnsClient(logCb, ec2Client, asgClient, config, statsReceiver) {}
 
     void RefreshAutoScalerData(const Aws::Vector<Aws::EC2::Model::Instance>& instances) {
-      this->_RefreshAutoscalerDataImpl(instances);
+      ZoneSnapshot::AutoscalingGroups groups;
+      this->_RefreshAutoscalerDataImpl(instances, &groups);
+    }
+
+    void RefreshZoneMap(const Aws::Vector<Aws::EC2::Model::Instance>& instances) {
+      this->_RefreshZoneMapImpl(instances);
+    }
+
+    void RefreshSnapshot(const Aws::Vector<Aws::EC2::Model::Instance>& instances) {
+      this->_RefreshSnapshotImpl(instances, ZoneSnapshot::AutoscalingGroups());
+    }
+
+    uint32_t UpdateAsgHistory(const std::string& dnsAlias, std::vector<std::string> ips, const time_point<steady_clock> now) {
+      return this->_UpdateAsgHistory(dnsAlias, ips, now);
+    }
+
+    void RefreshInstanceData() {
+      this->_RefreshInstanceDataImpl();
+    }
+
+    void RefreshOrFollow() {
+      this->_RefreshOrFollow();
     }
 };
\ No newline at end of file
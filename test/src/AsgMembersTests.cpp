@@ -0,0 +1,89 @@
+#include <set>
+
+#include "gtest/gtest.h"
+
+#include "AsgMembers.h"
+#include "ClientZoneMap.h"
+#include "KRandom.h"
+
+// Three members in zone 0, two in zone 1, one in zone 2.
+AsgMembers _Members() {
+  return AsgMembers({
+      {"10.0.1.1", 1}, {"10.0.0.1", 0}, {"10.0.2.1", 2},
+      {"10.0.0.2", 0}, {"10.0.1.2", 1}, {"10.0.0.3", 0}
+  });
+}
+
+std::vector<ZoneIndex> _SelectZones(ZoneIndex clientZone, size_t k, size_t spillover) {
+  auto members = _Members();
+  size_t picks[K_RANDOM_MAX_K];
+  size_t n = members.Select(clientZone, k, spillover, picks);
+
+  std::set<size_t> unique(picks, picks + n);
+  EXPECT_EQ(unique.size(), n);
+  std::vector<ZoneIndex> zones;
+  for (size_t i = 0; i < n; i++) {
+    zones.push_back(members.GetZone(picks[i]));
+  }
+  return zones;
+}
+
+TEST(TestAsgMembers, TestGroupsByZone) {
+  auto members = _Members();
+  ASSERT_EQ(members.size(), 6u);
+  ASSERT_EQ(members.GetIps(),
+            std::vector<std::string>({"10.0.0.1", "10.0.0.2", "10.0.0.3", "10.0.1.1", "10.0.1.2", "10.0.2.1"}));
+}
+
+TEST(TestAsgMembers, TestPrefersClientZone) {
+  tls_random::seed_thread(1);
+  for (int a = 0; a < 100; a++) {
+    ASSERT_EQ(_SelectZones(0, 3, 0), std::vector<ZoneIndex>({0, 0, 0}));
+    ASSERT_EQ(_SelectZones(1, 2, 0), std::vector<ZoneIndex>({1, 1}));
+  }
+}
+
+TEST(TestAsgMembers, TestFillsFromOtherZones) {
+  tls_random::seed_thread(1);
+  for (int a = 0; a < 100; a++) {
+    auto zones = _SelectZones(2, 4, 0);
+    ASSERT_EQ(zones.size(), 4u);
+    ASSERT_EQ(zones[0], 2);
+    for (size_t i = 1; i < zones.size(); i++) {
+      ASSERT_NE(zones[i], 2);
+    }
+  }
+}
+
+TEST(TestAsgMembers, TestSpillover) {
+  tls_random::seed_thread(1);
+  for (int a = 0; a < 100; a++) {
+    auto zones = _SelectZones(0, 3, 1);
+    ASSERT_EQ(zones.size(), 3u);
+    ASSERT_EQ(zones[0], 0);
+    ASSERT_EQ(zones[1], 0);
+    ASSERT_NE(zones[2], 0);
+  }
+}
+
+TEST(TestAsgMembers, TestUnknownZoneUsesEveryMember) {
+  tls_random::seed_thread(1);
+  ASSERT_EQ(_SelectZones(UNKNOWN_ZONE, 10, 0).size(), 6u);
+  ASSERT_EQ(_SelectZones(7, 4, 0).size(), 4u);
+}
+
+TEST(TestClientZoneMap, TestMapsSubnetsToZones) {
+  ClientZoneMap zoneMap(24);
+  zoneMap.Add(0x0A000001, 0);  // 10.0.0.1
+  zoneMap.Add(0x0A000002, 0);  // 10.0.0.2
+  zoneMap.Add(0x0A000101, 1);  // 10.0.1.1
+  zoneMap.Add(0x0A000201, 1);  // 10.0.2.1, in a subnet shared with zone 2
+  zoneMap.Add(0x0A000281, 2);  // 10.0.2.129
+
+  ASSERT_EQ(zoneMap.Lookup(0x0A000063), 0);
+  ASSERT_EQ(zoneMap.Lookup(0x0A000163), 1);
+  ASSERT_EQ(zoneMap.Lookup(0x0A000201), 1);
+  ASSERT_EQ(zoneMap.Lookup(0x0A000281), 2);
+  ASSERT_EQ(zoneMap.Lookup(0x0A000263), UNKNOWN_ZONE);
+  ASSERT_EQ(zoneMap.Lookup(0x0A000363), UNKNOWN_ZONE);
+}
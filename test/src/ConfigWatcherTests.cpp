@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ConfigWatcher.h"
+
+class TestConfigWatcher : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char dir[] = "/tmp/ec2dns-watch-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    this->dir = dir;
+    this->path = this->dir + "/ec2dns.conf";
+    this->changes = 0;
+  }
+
+  void TearDown() override {
+    unlink(this->path.c_str());
+    unlink((this->path + ".tmp").c_str());
+    unlink((this->dir + "/other.conf").c_str());
+    rmdir(this->dir.c_str());
+  }
+
+  void Write(const std::string& file, const std::string& contents) {
+    std::ofstream(file) << contents;
+  }
+
+  // Waits for the number of changes seen to reach count.
+  bool WaitForChanges(int count) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (this->changes.load() < count) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+  }
+
+  std::string dir;
+  std::string path;
+  std::atomic<int> changes;
+};
+
+TEST_F(TestConfigWatcher, TestSeesWritesAndRenames) {
+  ConfigWatcher watcher(this->path, [this]() { this->changes++; });
+  ASSERT_TRUE(watcher.IsWatching());
+
+  this->Write(this->path, "{}");
+  ASSERT_TRUE(this->WaitForChanges(1));
+
+  this->Write(this->path + ".tmp", "{\"refresh_interval\": 5}");
+  ASSERT_EQ(rename((this->path + ".tmp").c_str(), this->path.c_str()), 0);
+  ASSERT_TRUE(this->WaitForChanges(2));
+}
+
+TEST_F(TestConfigWatcher, TestIgnoresOtherFiles) {
+  ConfigWatcher watcher(this->path, [this]() { this->changes++; });
+  this->Write(this->dir + "/other.conf", "{}");
+  std::this_thread::sleep_for(std::chrono::milliseconds(CONFIG_WATCHER_SETTLE_MS * 2));
+  ASSERT_EQ(this->changes.load(), 0);
+}
+
+TEST_F(TestConfigWatcher, TestBurstsSettleIntoOneChange) {
+  ConfigWatcher watcher(this->path, [this]() { this->changes++; });
+  for (int i = 0; i < 5; i++) {
+    this->Write(this->path, "{}");
+  }
+  ASSERT_TRUE(this->WaitForChanges(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(CONFIG_WATCHER_SETTLE_MS * 2));
+  ASSERT_EQ(this->changes.load(), 1);
+}
+
+TEST_F(TestConfigWatcher, TestMissingDirectory) {
+  ConfigWatcher watcher(this->dir + "/missing/ec2dns.conf", [this]() { this->changes++; });
+  ASSERT_FALSE(watcher.IsWatching());
+}
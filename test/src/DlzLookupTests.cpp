@@ -0,0 +1,517 @@
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "DlzState.h"
+#include "mocks/mocks.h"
+
+using namespace testing;
+
+// Counts heap allocations made by the current thread while enabled.
+static thread_local bool t_countAllocations = false;
+static thread_local size_t t_allocations = 0;
+
+void* operator new(size_t size) {
+  if (t_countAllocations) {
+    t_allocations++;
+  }
+  void *ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+class AllocationCounter {
+public:
+  AllocationCounter() {
+    t_allocations = 0;
+    t_countAllocations = true;
+  }
+  ~AllocationCounter() {
+    t_countAllocations = false;
+  }
+  size_t Count() {
+    return t_allocations;
+  }
+};
+
+static size_t s_numRecords;
+static dns_ttl_t s_lastTtl;
+static char s_lastType[16];
+static char s_lastData[DNS_NAME_BUFFER_SIZE];
+
+isc_result_t _putrr(dns_sdlzlookup_t *, const char *type, dns_ttl_t ttl, const char *data) {
+  s_numRecords++;
+  s_lastTtl = ttl;
+  strncpy(s_lastType, type, sizeof(s_lastType) - 1);
+  strncpy(s_lastData, data, sizeof(s_lastData) - 1);
+  return ISC_R_SUCCESS;
+}
+
+static std::vector<std::string> s_nodes;
+static std::vector<dns_ttl_t> s_nodeTtls;
+
+isc_result_t _putnamedrr(dns_sdlzallnodes_t *, const char *name, const char *type, dns_ttl_t ttl, const char *data) {
+  s_nodes.push_back(std::string(name) + " " + type + " " + data);
+  s_nodeTtls.push_back(ttl);
+  return ISC_R_SUCCESS;
+}
+
+void _dlzlog(int, const char*, ...) { }
+
+static isc_sockaddr_t s_clientSockaddr;
+
+isc_result_t _sourceip(dns_clientinfo_t *, isc_sockaddr_t **addrp) {
+  *addrp = &s_clientSockaddr;
+  return ISC_R_SUCCESS;
+}
+
+class DlzLookupTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    auto ec2 = std::make_shared<MockEC2Client>();
+    auto asg = std::make_shared<MockAutoScalingClient>();
+    auto config = Ec2DnsConfig("tc", "10.1.0.0/16", "aws.test");
+    EXPECT_CALL(*ec2, DescribeInstances(_))
+        .WillOnce(Return(DescribeInstancesOutcome(
+            DescribeInstancesResponse().AddReservations(
+                Reservation()
+                    .AddInstances(Aws::EC2::Model::Instance()
+                        .WithPrivateIpAddress("10.1.2.3")
+                        .WithPlacement(Placement().WithAvailabilityZone("us-east-1a"))
+                        .WithInstanceId("i-0123456789abcdef0"))
+                    .AddInstances(Aws::EC2::Model::Instance()
+                        .WithPrivateIpAddress("10.1.2.4")
+                        .WithPlacement(Placement().WithAvailabilityZone("us-east-1c"))
+                        .WithInstanceId("i-1234567"))))));
+    EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+        .WillOnce(Return(DescribeAutoScalingGroupsOutcome(
+            DescribeAutoScalingGroupsResult().AddAutoScalingGroups(
+                AutoScalingGroup()
+                    .WithAutoScalingGroupName("web")
+                    .AddInstances(Aws::AutoScaling::Model::Instance()
+                        .WithInstanceId("i-0123456789abcdef0")
+                        .WithHealthStatus("Healthy")
+                        .WithLifecycleState(LifecycleState::InService))
+                    .AddTags(TagDescription()
+                        .WithKey("twitter:aws:dns-alias")
+                        .WithValue("web"))))));
+
+    m_stats = std::make_shared<StatsReceiver>();
+    auto client = std::make_shared<MockDnsClient>(&_dlzlog, ec2, asg, config, m_stats);
+    client->RefreshInstanceData();
+
+    m_state.client = client;
+    m_state.zone_name = "aws.test";
+    m_state.vpc_cidr = "10.1.0.0/16";
+    m_state.account_name = "tc";
+    m_state.xfr_acl.TryParse("10.1.9.0/24");
+    m_state.callbacks.log = &_dlzlog;
+    m_state.callbacks.putrr = &_putrr;
+    m_state.callbacks.putnamedrr = &_putnamedrr;
+    m_state.matcher = std::unique_ptr<HostMatcher>(new HostMatcher(config));
+    m_state.rl_helper = std::make_shared<ReverseLookupHelper>(client);
+    m_state.rl_helper->InitializeReverseLookupZones("10.1.0.0/16");
+    m_state.classifier = std::unique_ptr<ZoneClassifier>(new ZoneClassifier("aws.test", m_state.rl_helper));
+    m_state.records = std::make_shared<ZoneRecords>(
+        "aws.test", std::vector<std::string>({"ns1.aws.test."}), m_state.rl_helper);
+
+    s_clientSockaddr.type.sin.sin_family = AF_INET;
+    inet_pton(AF_INET, "10.1.9.9", &s_clientSockaddr.type.sin.sin_addr);
+    m_methods.version = DNS_CLIENTINFOMETHODS_VERSION;
+    m_methods.age = DNS_CLIENTINFOMETHODS_AGE;
+    m_methods.sourceip = &_sourceip;
+  }
+
+  isc_result_t Lookup(const char *zone, const char *name) {
+    s_numRecords = 0;
+    s_lastType[0] = s_lastData[0] = '\0';
+    return dlz_lookup(zone, name, &m_state, nullptr, &m_methods, &m_clientInfo);
+  }
+
+  std::vector<std::string> AllNodes(const char *zone, isc_result_t expected = ISC_R_SUCCESS) {
+    s_nodes.clear();
+    s_nodeTtls.clear();
+    EXPECT_EQ(dlz_allnodes(zone, &m_state, nullptr), expected);
+    return s_nodes;
+  }
+
+  // Looks the name up once to warm any lazily initialized state, then
+  // returns the number of allocations made by a second lookup.
+  size_t CountLookupAllocations(const char *zone, const char *name) {
+    EXPECT_EQ(this->Lookup(zone, name), (isc_result_t)ISC_R_SUCCESS);
+    AllocationCounter counter;
+    EXPECT_EQ(this->Lookup(zone, name), (isc_result_t)ISC_R_SUCCESS);
+    return counter.Count();
+  }
+
+  uint64_t GetLatencyCount(const std::string &name) {
+    for (const auto &h : m_stats->GetAllHistograms()) {
+      if (h->GetName() == name) {
+        return h->GetSnapshot().GetCount();
+      }
+    }
+    return 0;
+  }
+
+  std::shared_ptr<StatsReceiver> m_stats;
+  dlz_state m_state;
+  dns_clientinfomethods_t m_methods;
+  dns_clientinfo_t m_clientInfo;
+};
+
+TEST_F(DlzLookupTest, TestForwardLookup) {
+  ASSERT_EQ(this->Lookup("aws.test", "ue1a-tc-0123456789abcdef0"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_STREQ(s_lastType, "A");
+  ASSERT_STREQ(s_lastData, "10.1.2.3");
+}
+
+TEST_F(DlzLookupTest, TestReverseLookup) {
+  ASSERT_EQ(this->Lookup("2.1.10.in-addr.arpa", "4"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_STREQ(s_lastType, "PTR");
+  ASSERT_STREQ(s_lastData, "ue1c-tc-1234567.aws.test.");
+}
+
+TEST_F(DlzLookupTest, TestSyntheticIpLookup) {
+  ASSERT_EQ(this->Lookup("aws.test", "ip-10-1-7-8"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_STREQ(s_lastData, "10.1.7.8");
+  ASSERT_EQ(this->Lookup("aws.test", "ip-10-1-7"), (isc_result_t)ISC_R_NOTFOUND);
+  ASSERT_EQ(this->Lookup("aws.test", "ip-10-1-7-8-9-10-11-12-13-14"), (isc_result_t)ISC_R_NOTFOUND);
+}
+
+TEST_F(DlzLookupTest, TestAutoscalerLookup) {
+  ASSERT_EQ(this->Lookup("asg.aws.test", "web"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(s_numRecords, 1u);
+  ASSERT_STREQ(s_lastData, "10.1.2.3");
+  ASSERT_EQ(this->Lookup("asg.aws.test", "nope"), (isc_result_t)ISC_R_NOTFOUND);
+}
+
+TEST_F(DlzLookupTest, TestCacheHitsDontAllocate) {
+  {
+    AllocationCounter counter;
+    std::unique_ptr<std::string> str(new std::string(64, 'x'));
+    ASSERT_GT(counter.Count(), 0u);
+  }
+  ASSERT_EQ(this->CountLookupAllocations("aws.test", "ue1a-tc-0123456789abcdef0"), 0u);
+  ASSERT_EQ(this->CountLookupAllocations("aws.test", "ue1c-tc-1234567"), 0u);
+  ASSERT_EQ(this->CountLookupAllocations("2.1.10.in-addr.arpa", "4"), 0u);
+  ASSERT_EQ(this->CountLookupAllocations("aws.test", "ip-10-1-7-8"), 0u);
+  ASSERT_EQ(this->CountLookupAllocations("aws.test", "@"), 0u);
+  ASSERT_EQ(this->CountLookupAllocations("asg.aws.test", "web"), 0u);
+}
+
+TEST_F(DlzLookupTest, TestTracedCacheHitsDontAllocate) {
+  m_state.tracer = std::unique_ptr<QueryTracer>(new QueryTracer(1, 16, 4));
+  ASSERT_EQ(this->CountLookupAllocations("aws.test", "ue1a-tc-0123456789abcdef0"), 0u);
+  ASSERT_EQ(this->CountLookupAllocations("asg.aws.test", "web"), 0u);
+  ASSERT_EQ(m_state.tracer->GetRecent().size(), 4u);
+}
+
+TEST_F(DlzLookupTest, TestCapturedCacheHitsDontAllocate) {
+  auto path = "/tmp/ec2dns-dlz-test-" + std::to_string(getpid()) + ".qlog";
+  m_state.query_log.reset(new QueryLogWriter(path, 1, 1 << 20, m_stats));
+  ASSERT_EQ(this->CountLookupAllocations("aws.test", "ue1a-tc-0123456789abcdef0"), 0u);
+  m_state.query_log.reset();
+
+  QueryLogReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  QueryLogEntry entry;
+  size_t count = 0;
+  while (reader.Next(&entry)) {
+    ASSERT_EQ(entry.zone, "aws.test");
+    ASSERT_EQ(entry.name, "ue1a-tc-0123456789abcdef0");
+    ASSERT_EQ(entry.client.ToString(), "10.1.9.9");
+    count++;
+  }
+  ASSERT_GT(count, 0u);
+  unlink(path.c_str());
+}
+
+TEST_F(DlzLookupTest, TestTracesRecordPath) {
+  m_state.tracer = std::unique_ptr<QueryTracer>(new QueryTracer(1, 16, 4));
+  ASSERT_EQ(this->Lookup("aws.test", "ue1a-tc-0123456789abcdef0"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(this->Lookup("aws.test", "nothing-like-an-instance"), (isc_result_t)ISC_R_NOTFOUND);
+  ASSERT_EQ(this->Lookup("2.1.10.in-addr.arpa", "4"), (isc_result_t)ISC_R_SUCCESS);
+
+  auto traces = m_state.tracer->GetRecent();
+  ASSERT_EQ(traces.size(), 3u);
+  ASSERT_EQ(traces[0].path, QueryPath::Reverse);
+  ASSERT_STREQ(traces[0].zone, "2.1.10.in-addr.arpa");
+  ASSERT_STREQ(traces[0].name, "4");
+  ASSERT_EQ(traces[0].client.ToString(), "10.1.9.9");
+  ASSERT_EQ(traces[1].path, QueryPath::RegexMiss);
+  ASSERT_EQ(traces[1].result, ISC_R_NOTFOUND);
+  ASSERT_EQ(traces[2].path, QueryPath::Forward);
+  ASSERT_EQ(traces[2].outcome, LookupOutcome::Hit);
+  ASSERT_EQ(traces[2].result, ISC_R_SUCCESS);
+  ASSERT_TRUE(traces[2].sampled);
+  ASSERT_LE(traces[2].phase_us[(int)QueryPhase::Classified], traces[2].phase_us[(int)QueryPhase::Resolved]);
+  ASSERT_LE(traces[2].phase_us[(int)QueryPhase::Resolved], traces[2].total_us);
+  ASSERT_EQ(m_state.tracer->GetSlowest().size(), 3u);
+}
+
+TEST_F(DlzLookupTest, TestSlowestKeptWithoutSampling) {
+  m_state.tracer = std::unique_ptr<QueryTracer>(new QueryTracer(0, 16, 2));
+  ASSERT_EQ(this->Lookup("aws.test", "ue1a-tc-0123456789abcdef0"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(this->Lookup("aws.test", "ue1c-tc-1234567"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(this->Lookup("aws.test", "ue1c-tc-1234567"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_TRUE(m_state.tracer->GetRecent().empty());
+  auto slowest = m_state.tracer->GetSlowest();
+  ASSERT_EQ(slowest.size(), 2u);
+  ASSERT_FALSE(slowest[0].sampled);
+  ASSERT_GE(slowest[0].total_us, slowest[1].total_us);
+}
+
+TEST_F(DlzLookupTest, TestTopKeys) {
+  m_state.top_names.reset(new HeavyHitters("query_names", 8, 60));
+  m_state.top_clients.reset(new HeavyHitters("clients", 8, 60));
+  ASSERT_EQ(this->CountLookupAllocations("aws.test", "ue1a-tc-0123456789abcdef0"), 0u);
+  ASSERT_EQ(this->CountLookupAllocations("aws.test", "@"), 0u);
+  ASSERT_EQ(this->Lookup("2.1.10.in-addr.arpa", "4"), (isc_result_t)ISC_R_SUCCESS);
+
+  auto names = m_state.top_names->GetCurrent().top;
+  ASSERT_EQ(names.size(), 3u);
+  ASSERT_EQ(names[0].key, "ue1a-tc-0123456789abcdef0.aws.test");
+  ASSERT_EQ(names[0].count, 2u);
+  auto clients = m_state.top_clients->GetCurrent().top;
+  ASSERT_EQ(clients.size(), 1u);
+  ASSERT_EQ(clients[0].key, "10.1.9.9");
+  ASSERT_EQ(clients[0].count, 5u);
+}
+
+TEST_F(DlzLookupTest, TestRefreshIsProfiled) {
+  auto history = m_state.client->GetRefreshProfiler().GetHistory();
+  ASSERT_EQ(history.size(), 1u);
+  ASSERT_TRUE(history[0].success);
+  ASSERT_EQ(history[0].instances, 2u);
+  std::vector<std::string> phases;
+  for (const auto &phase : history[0].phases) {
+    phases.push_back(phase.name);
+  }
+  ASSERT_EQ(phases, std::vector<std::string>({
+      "total", "describe_instances", "autoscaler", "autoscaler_describe_groups",
+      "autoscaler_index_instances", "autoscaler_groups", "zone_map", "host_cache_trim",
+      "host_cache_lock_wait", "snapshot"}));
+  ASSERT_EQ(this->GetLatencyCount("refresh_total_us"), 1u);
+}
+
+TEST_F(DlzLookupTest, TestSoaFollowsSnapshotSerial) {
+  auto serial = m_state.client->GetSnapshotSerial();
+  ASSERT_GT(serial, 0u);
+  ASSERT_EQ(this->Lookup("aws.test", "@"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(s_numRecords, 2u);
+  ASSERT_STREQ(s_lastType, "NS");
+
+  auto client = std::static_pointer_cast<MockDnsClient>(m_state.client);
+  client->RefreshSnapshot(Aws::Vector<Aws::EC2::Model::Instance>());
+  ASSERT_GT(m_state.client->GetSnapshotSerial(), serial);
+}
+
+TEST_F(DlzLookupTest, TestAllowZoneTransfer) {
+  ASSERT_EQ(dlz_allowzonexfr(&m_state, "aws.test", "10.1.9.20"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(dlz_allowzonexfr(&m_state, "2.1.10.in-addr.arpa", "10.1.9.20"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(dlz_allowzonexfr(&m_state, "aws.test", "10.1.8.20"), (isc_result_t)ISC_R_NOPERM);
+  ASSERT_EQ(dlz_allowzonexfr(&m_state, "aws.test", "fd00::1"), (isc_result_t)ISC_R_NOPERM);
+  ASSERT_EQ(dlz_allowzonexfr(&m_state, "example.com", "10.1.9.20"), (isc_result_t)ISC_R_NOTFOUND);
+}
+
+TEST_F(DlzLookupTest, TestAllNodes) {
+  char soa[128];
+  snprintf(soa, sizeof(soa), "@ SOA aws.test. hostmaster.aws.test. %u 172800 900 1209600 180",
+           m_state.client->GetSnapshotSerial());
+
+  ASSERT_EQ(this->AllNodes("aws.test"), std::vector<std::string>({
+      soa,
+      "@ NS ns1.aws.test.",
+      "ue1a-tc-0123456789abcdef0 A 10.1.2.3",
+      "ue1c-tc-1234567 A 10.1.2.4"}));
+  ASSERT_EQ(this->AllNodes("2.1.10.in-addr.arpa"), std::vector<std::string>({
+      soa,
+      "@ NS ns1.aws.test.",
+      "3 PTR ue1a-tc-0123456789abcdef0.aws.test.",
+      "4 PTR ue1c-tc-1234567.aws.test."}));
+  ASSERT_EQ(this->AllNodes("3.1.10.in-addr.arpa").size(), 2u);
+  ASSERT_EQ(this->AllNodes("asg.aws.test"), std::vector<std::string>({
+      soa,
+      "@ NS ns1.aws.test.",
+      "web A 10.1.2.3"}));
+  // The apex lasts until the next refresh, the rest by the TTL policies.
+  ASSERT_EQ(s_nodeTtls, std::vector<dns_ttl_t>({60u, 60u, 10u}));
+}
+
+TEST_F(DlzLookupTest, TestAllNodesOfOtherZones) {
+  ASSERT_TRUE(this->AllNodes("example.com", ISC_R_NOTFOUND).empty());
+  ASSERT_TRUE(this->AllNodes("9.9.10.in-addr.arpa", ISC_R_NOTFOUND).empty());
+  ASSERT_TRUE(this->AllNodes("1.10.in-addr.arpa", ISC_R_NOTFOUND).empty());
+}
+
+TEST_F(DlzLookupTest, TestAnswerTtls) {
+  // Just seen instances get the minimum, synthesized names never change.
+  ASSERT_EQ(this->Lookup("aws.test", "ue1a-tc-0123456789abcdef0"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(s_lastTtl, 60u);
+  ASSERT_EQ(this->Lookup("2.1.10.in-addr.arpa", "4"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(s_lastTtl, 60u);
+  ASSERT_EQ(this->Lookup("aws.test", "ip-10-1-7-8"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(s_lastTtl, 600u);
+  ASSERT_EQ(this->Lookup("asg.aws.test", "web"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(s_lastTtl, 10u);
+
+  // The apex lasts until the next refresh, a minute away.
+  auto config = *m_state.client->GetConfig();
+  config.host_ttl.min_ttl = 5;
+  m_state.client->ApplyConfig(config);
+  ASSERT_EQ(this->Lookup("aws.test", "@"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_LE(s_lastTtl, 60u);
+  ASSERT_GE(s_lastTtl, 50u);
+}
+
+TEST_F(DlzLookupTest, TestAbsentInstanceIsNotFound) {
+  auto config = *m_state.client->GetConfig();
+  config.authoritative_snapshot = true;
+  m_state.client->ApplyConfig(config);
+  ASSERT_EQ(this->Lookup("aws.test", "ue1a-tc-7654321"), (isc_result_t)ISC_R_NOTFOUND);
+  ASSERT_EQ(s_numRecords, 0u);
+}
+
+TEST_F(DlzLookupTest, TestLookupLatencyByOutcome) {
+  ASSERT_EQ(this->Lookup("aws.test", "ue1a-tc-0123456789abcdef0"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(this->Lookup("aws.test", "ip-10-1-7-8"), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(this->GetLatencyCount("lookup_hit_us"), 2u);
+  ASSERT_EQ(this->GetLatencyCount("lookup_miss_us"), 0u);
+  ASSERT_EQ(this->GetLatencyCount("refresh_total_us"), 1u);
+  ASSERT_EQ(this->GetLatencyCount("api_DescribeInstances_refresh_us"), 1u);
+}
+
+TEST_F(DlzLookupTest, TestReloadConfig) {
+  char path[] = "/tmp/ec2dns-reload-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  auto hooks = dlz_hooks();
+  int clientsBuilt = 0;
+  dlz_hooks().config_path = path;
+  dlz_hooks().client_factory = [&clientsBuilt](
+      const Ec2DnsConfig&, std::shared_ptr<EC2Client> *ec2, std::shared_ptr<AutoScalingClient> *asg) {
+    clientsBuilt++;
+    *ec2 = std::make_shared<MockEC2Client>();
+    *asg = std::make_shared<MockAutoScalingClient>();
+  };
+
+  std::ofstream(path) << "{\"refresh_interval\": 5, \"instance_timeout\": 300, \"host_ttl_max\": 90,"
+                      << " \"zone_file_dir\": \"/var/named\", \"requestTimeoutMs\": 250}";
+  auto previous = m_state.client->GetConfig();
+  auto result = dlz_reload_config(&m_state);
+  Aws::Utils::Json::JsonValue json(result);
+  EXPECT_EQ(json.GetString("applied"), "refresh_interval, instance_timeout, host_ttl, requestTimeoutMs");
+  EXPECT_EQ(json.GetString("needs_restart"), "zone_file_dir");
+  EXPECT_EQ(m_state.client->GetConfig()->refresh_interval, 5);
+  EXPECT_EQ(m_state.client->GetConfig()->instance_timeout, 300);
+  // Whoever still holds the config they read keeps reading it.
+  EXPECT_EQ(previous->refresh_interval, 60);
+  EXPECT_EQ(m_state.client->GetConfig()->zone_file_dir, "");
+  EXPECT_EQ(clientsBuilt, 1);
+
+  // Cached answers keep coming, with the new TTLs.
+  ASSERT_EQ(this->Lookup("aws.test", "ip-10-1-7-8"), (isc_result_t)ISC_R_SUCCESS);
+  EXPECT_EQ(s_lastTtl, 90u);
+  ASSERT_EQ(this->Lookup("aws.test", "ue1a-tc-0123456789abcdef0"), (isc_result_t)ISC_R_SUCCESS);
+
+  // Timeouts unchanged, the AWS clients are kept.
+  std::ofstream(path) << "{\"refresh_interval\": 5, \"instance_timeout\": 300, \"host_ttl_max\": 90,"
+                      << " \"requestTimeoutMs\": 250}";
+  Aws::Utils::Json::JsonValue unchanged(dlz_reload_config(&m_state));
+  EXPECT_EQ(unchanged.GetString("applied"), "");
+  EXPECT_EQ(unchanged.GetString("needs_restart"), "");
+  EXPECT_EQ(clientsBuilt, 1);
+
+  std::ofstream(path) << "{not json";
+  Aws::Utils::Json::JsonValue failed(dlz_reload_config(&m_state));
+  EXPECT_TRUE(failed.ValueExists("error"));
+  EXPECT_EQ(m_state.client->GetConfig()->refresh_interval, 5);
+
+  dlz_hooks() = hooks;
+  unlink(path);
+}
+
+// Runs dlz_create for zone with config as the config file, the AWS clients
+// coming from factory.
+static isc_result_t _CreateZone(
+    const char *zone, const std::string &config, AwsClientFactory factory, void **dbdata) {
+  char path[] = "/tmp/ec2dns-create-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    return ISC_R_FAILURE;
+  }
+  close(fd);
+  std::ofstream(path) << config;
+  auto hooks = dlz_hooks();
+  dlz_hooks().config_path = path;
+  dlz_hooks().client_factory = factory;
+  const char *argv[] = {"ec2dns", zone, "10.1.0.0/16", "tc"};
+  auto result = dlz_create(
+      "ec2dns", 4, const_cast<char**>(argv), dbdata,
+      "log", &_dlzlog, "putrr", &_putrr, "putnamedrr", &_putnamedrr, (const char*)nullptr);
+  dlz_hooks() = hooks;
+  unlink(path);
+  return result;
+}
+
+TEST(TestDlzCreate, TestFailureFreesState) {
+  std::weak_ptr<EC2Client> ec2Client;
+  auto factory = [&ec2Client](
+      const Ec2DnsConfig&, std::shared_ptr<EC2Client> *ec2, std::shared_ptr<AutoScalingClient> *asg) {
+    *ec2 = std::make_shared<MockEC2Client>();
+    *asg = std::make_shared<MockAutoScalingClient>();
+    ec2Client = *ec2;
+  };
+  void *dbdata = nullptr;
+  ASSERT_EQ(_CreateZone("aws.test", "{\"xfr_allow\": \"not a cidr\", \"config_watch\": false}", factory, &dbdata),
+            (isc_result_t)ISC_R_FAILURE);
+  ASSERT_EQ(dbdata, nullptr);
+  ASSERT_TRUE(ec2Client.expired());
+}
+
+TEST(TestDlzCreate, TestSdkOutlivesFirstZone) {
+  auto factory = [](const Ec2DnsConfig&, std::shared_ptr<EC2Client> *ec2, std::shared_ptr<AutoScalingClient> *asg) {
+    auto mock = std::make_shared<NiceMock<MockEC2Client>>();
+    ON_CALL(*mock, DescribeInstances(_))
+        .WillByDefault(Return(DescribeInstancesOutcome(
+            DescribeInstancesResponse().AddReservations(Reservation().AddInstances(
+                Aws::EC2::Model::Instance()
+                    .WithPrivateIpAddress("10.1.2.4")
+                    .WithPlacement(Placement().WithAvailabilityZone("us-east-1c"))
+                    .WithInstanceId("i-1234567"))))));
+    *ec2 = mock;
+    *asg = std::make_shared<NiceMock<MockAutoScalingClient>>();
+  };
+  // A single stats thread, so anything the server throws as it's stopped
+  // right after starting is caught by StatsServer.
+  auto config = "{\"config_watch\": false, \"stats_address\": \"127.0.0.1\", \"stats_port\": 0, \"stats_threads\": 1}";
+  void *first = nullptr;
+  void *second = nullptr;
+  ASSERT_EQ(_CreateZone("aws.test", config, factory, &first), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(_CreateZone("aws.other", config, factory, &second), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(SdkLifetime::Get().GetNumUsers(), 2u);
+
+  dlz_destroy(first);
+  ASSERT_EQ(SdkLifetime::Get().GetNumUsers(), 1u);
+  s_numRecords = 0;
+  ASSERT_EQ(dlz_lookup("2.1.10.in-addr.arpa", "4", second, nullptr, nullptr, nullptr), (isc_result_t)ISC_R_SUCCESS);
+  ASSERT_EQ(s_numRecords, 1u);
+  ASSERT_STREQ(s_lastData, "ue1c-tc-1234567.aws.other.");
+
+  dlz_destroy(second);
+  ASSERT_EQ(SdkLifetime::Get().GetNumUsers(), 0u);
+}
@@ -1,6 +1,10 @@
 #include "gtest/gtest.h"
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "Ec2DnsClient.h"
+#include "KRandom.h"
 #include "mocks/mocks.h"
 
 using namespace testing;
@@ -12,12 +16,18 @@ void _logcb(int, const char*, ...) {
   return;
 }
 
-DescribeInstancesOutcome _GetExpectedResponse() {
+ClientAddress _LocalClient() {
+  ClientAddress addr;
+  ClientAddress::TryParse("127.0.0.1", &addr);
+  return addr;
+}
+
+DescribeInstancesOutcome _GetExpectedResponse(const char *ip = "10.1.2.3") {
   return DescribeInstancesOutcome(
       DescribeInstancesResponse().AddReservations(
           Reservation().AddInstances(
               Aws::EC2::Model::Instance()
-                  .WithPrivateIpAddress("10.1.2.3")
+                  .WithPrivateIpAddress(ip)
                   .WithPlacement(Placement().WithAvailabilityZone("us-east-1a"))
                   .WithInstanceId("i-1234567")
           ))
@@ -87,10 +97,164 @@ TEST(TestEc2DnsClient, TestEc2DnsClientResolveIp) {
       .WillOnce(Return(_GetExpectedResponse()));
 
   Ec2DnsClient dnsClient(&_logcb, ptr, asgClient, config, std::make_shared<StatsReceiver>());
-  std::string ip;
-  bool ret = dnsClient.TryResolveIp("i-1234567", "127.0.0.1", &ip);
+  char ip[DNS_NAME_BUFFER_SIZE];
+  bool ret = dnsClient.TryResolveIp("i-1234567", _LocalClient(), ip, sizeof(ip));
   ASSERT_TRUE(ret);
-  ASSERT_EQ(ip, "10.1.2.3");
+  ASSERT_STREQ(ip, "10.1.2.3");
+}
+
+TEST(TestEc2DnsClient, TestTracksMissKeys) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  // Off unless asked for.
+  ASSERT_EQ(config.top_k_capacity, 0u);
+  config.top_k_capacity = 8;
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(_GetExpectedResponse()));
+
+  Ec2DnsClient dnsClient(&_logcb, ptr, std::make_shared<AutoScalingClient>(), config, std::make_shared<StatsReceiver>());
+  char ip[DNS_NAME_BUFFER_SIZE];
+  ASSERT_TRUE(dnsClient.TryResolveIp("i-1234567", _LocalClient(), ip, sizeof(ip)));
+  ASSERT_TRUE(dnsClient.TryResolveIp("i-1234567", _LocalClient(), ip, sizeof(ip)));
+  auto misses = dnsClient.GetMissKeys()->GetCurrent().top;
+  ASSERT_EQ(misses.size(), 1u);
+  ASSERT_EQ(misses[0].key, "i-1234567");
+  ASSERT_EQ(misses[0].count, 1u);
+}
+
+TEST(TestEc2DnsClient, TestStopRefreshThread) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  config.refresh_interval = 3600;
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(_GetExpectedResponse()));
+
+  Ec2DnsClient dnsClient(&_logcb, ptr, std::make_shared<AutoScalingClient>(), config, std::make_shared<StatsReceiver>());
+  dnsClient.LaunchRefreshThread();
+  while (dnsClient.GetSnapshotSerial() == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto start = std::chrono::steady_clock::now();
+  dnsClient.StopRefreshThread();
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+}
+
+static uint64_t _GetStat(StatsReceiver &stats, const std::string &name) {
+  for (const auto &s : stats.GetAllStats()) {
+    if (s->GetName() == name) {
+      return s->GetValue();
+    }
+  }
+  return 0;
+}
+
+TEST(TestEc2DnsClient, TestApiTelemetryByCaller) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto asg = std::make_shared<MockAutoScalingClient>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  auto stats = std::make_shared<StatsReceiver>();
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(DescribeInstancesOutcome(
+          DescribeInstancesResponse()
+              .AddReservations(Reservation()
+                  .AddInstances(Aws::EC2::Model::Instance().WithInstanceId("i-1").WithPrivateIpAddress("10.0.0.1"))
+                  .AddInstances(Aws::EC2::Model::Instance().WithInstanceId("i-2").WithPrivateIpAddress("10.0.0.2")))
+              .WithNextToken("page2"))))
+      .WillOnce(Return(DescribeInstancesOutcome(
+          DescribeInstancesResponse().AddReservations(Reservation()
+              .AddInstances(Aws::EC2::Model::Instance().WithInstanceId("i-3").WithPrivateIpAddress("10.0.0.3"))))))
+      .WillOnce(Return(DescribeInstancesOutcome(Aws::Client::AWSError<EC2Errors>(
+          EC2Errors::INVALID_INSTANCE_I_D_NOT_FOUND, "InvalidInstanceID.NotFound", "not found", false))));
+  EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+      .WillOnce(Return(_GetExpectedAsgResponse()));
+
+  MockDnsClient dnsClient(&_logcb, ptr, asg, config, stats);
+  dnsClient.RefreshInstanceData();
+  char ip[DNS_NAME_BUFFER_SIZE];
+  ASSERT_FALSE(dnsClient.TryResolveIp("i-7654321", _LocalClient(), ip, sizeof(ip)));
+
+  ASSERT_EQ(_GetStat(*stats, "api_DescribeInstances_refresh_calls"), 1u);
+  ASSERT_EQ(_GetStat(*stats, "api_DescribeInstances_refresh_pages"), 2u);
+  ASSERT_EQ(_GetStat(*stats, "api_DescribeInstances_refresh_items"), 3u);
+  ASSERT_EQ(_GetStat(*stats, "api_DescribeAutoScalingGroups_refresh_items"), 2u);
+  ASSERT_EQ(_GetStat(*stats, "api_DescribeInstances_miss_calls"), 1u);
+  ASSERT_EQ(_GetStat(*stats, "api_DescribeInstances_miss_failed_calls"), 1u);
+  ASSERT_EQ(_GetStat(*stats, "api_DescribeInstances_miss_pages"), 0u);
+  ASSERT_EQ(_GetStat(*stats, "api_DescribeInstances_miss_error_InvalidInstanceID.NotFound"), 1u);
+  ASSERT_EQ(_GetStat(*stats, "api_requests"), 4u);
+}
+
+TEST(TestEc2DnsClient, TestCountsThrottledLookups) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  auto stats = std::make_shared<StatsReceiver>();
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(DescribeInstancesOutcome(DescribeInstancesResponse())));
+
+  Ec2DnsClient dnsClient(&_logcb, ptr, std::make_shared<AutoScalingClient>(), config, stats);
+  char ip[DNS_NAME_BUFFER_SIZE];
+  ResolveInfo info;
+  ASSERT_FALSE(dnsClient.TryResolveIp("i-7654321", _LocalClient(), ip, sizeof(ip), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Miss);
+  ASSERT_FALSE(dnsClient.TryResolveIp("i-7654321", _LocalClient(), ip, sizeof(ip), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Throttled);
+  ASSERT_EQ(_GetStat(*stats, "throttled_lookups"), 1u);
+}
+
+TEST(TestEc2DnsClient, TestTooLongValueSkipsApi) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto asg = std::make_shared<MockAutoScalingClient>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  // Only the refresh calls the API.
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(_GetExpectedResponse()));
+  EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+      .WillOnce(Return(DescribeAutoScalingGroupsOutcome(DescribeAutoScalingGroupsResult())));
+
+  MockDnsClient dnsClient(&_logcb, ptr, asg, config, std::make_shared<StatsReceiver>());
+  dnsClient.RefreshInstanceData();
+  char ip[4];
+  ResolveInfo info;
+  ASSERT_FALSE(dnsClient.TryResolveIp("i-1234567", _LocalClient(), ip, sizeof(ip), &info));
+  ASSERT_NE(info.outcome, LookupOutcome::Miss);
+}
+
+TEST(TestEc2DnsClient, TestRefreshServesFromSnapshot) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto asg = std::make_shared<MockAutoScalingClient>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  auto stats = std::make_shared<StatsReceiver>();
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(_GetExpectedResponse()))
+      .WillOnce(Return(_GetExpectedResponse()))
+      .WillOnce(Return(_GetExpectedResponse("10.1.2.4")));
+  EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+      .WillRepeatedly(Return(DescribeAutoScalingGroupsOutcome(DescribeAutoScalingGroupsResult())));
+  MockDnsClient dnsClient(&_logcb, ptr, asg, config, stats);
+  auto stableSince = [&dnsClient]() {
+    auto snapshot = dnsClient.GetSnapshot();
+    return snapshot->GetStableSince()[0];
+  };
+
+  dnsClient.RefreshInstanceData();
+  auto first = stableSince();
+  char value[DNS_NAME_BUFFER_SIZE];
+  ResolveInfo info;
+  ASSERT_TRUE(dnsClient.TryResolveIp("i-1234567", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_STREQ(value, "10.1.2.3");
+  ASSERT_EQ(info.outcome, LookupOutcome::Hit);
+  ASSERT_TRUE(dnsClient.TryResolveHostname("10.1.2.3", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Hit);
+  // Answered from the snapshot, nothing went into the host cache.
+  ASSERT_EQ(_GetStat(*stats, "host_hits"), 0u);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  dnsClient.RefreshInstanceData();
+  ASSERT_EQ(stableSince(), first);
+  dnsClient.RefreshInstanceData();
+  ASSERT_GT(stableSince(), first);
+  ASSERT_TRUE(dnsClient.TryResolveIp("i-1234567", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_STREQ(value, "10.1.2.4");
 }
 
 TEST(TestEc2DnsClient, TestEc2DnsClientResolveHostname) {
@@ -100,10 +264,10 @@ TEST(TestEc2DnsClient, TestEc2DnsClientResolveHostname) {
       .WillOnce(Return(_GetExpectedResponse()));
 
   Ec2DnsClient dnsClient(&_logcb, ptr, std::make_shared<AutoScalingClient>(), config, std::make_shared<StatsReceiver>());
-  std::string hostname;
-  bool ret = dnsClient.TryResolveHostname("10.1.2.3", "127.0.0.1", &hostname);
+  char hostname[DNS_NAME_BUFFER_SIZE];
+  bool ret = dnsClient.TryResolveHostname("10.1.2.3", _LocalClient(), hostname, sizeof(hostname));
   ASSERT_TRUE(ret);
-  ASSERT_EQ(hostname, "ue1a-tc-1234567.aws.test.");
+  ASSERT_STREQ(hostname, "ue1a-tc-1234567.aws.test.");
 }
 
 void _TestAsg(const std::string& dnsName, std::vector<std::string> expectedNodes, bool expectedSuccess) {
@@ -116,11 +280,14 @@ void _TestAsg(const std::string& dnsName, std::vector<std::string> expectedNodes
   MockDnsClient dnsClient(&_logcb, ptr, asg, config, std::make_shared<StatsReceiver>());
   dnsClient.RefreshAutoScalerData(_GetAsgInstances());
 
-  std::vector<std::string> nodes;
-  bool ret = dnsClient.TryResolveAutoscaler(dnsName, "127.0.0.1", &nodes);
+  AsgMembersPtr nodes;
+  bool ret = dnsClient.TryResolveAutoscaler(dnsName, _LocalClient(), &nodes);
   ASSERT_EQ(ret, expectedSuccess);
-  ASSERT_EQ(nodes.size(), expectedNodes.size());
-  ASSERT_EQ(nodes, expectedNodes);
+  if (!expectedSuccess) {
+    return;
+  }
+  ASSERT_EQ(nodes->size(), expectedNodes.size());
+  ASSERT_EQ(nodes->GetIps(), expectedNodes);
 }
 
 TEST(TestEc2DnsClient, TestEc2DnsClientResolveAsg) {
@@ -133,4 +300,278 @@ TEST(TestEc2DnsClient, TestEc2DnsClientResolveEmptyAsg) {
 
 TEST(TestEc2DnsClient, TestEc2DnsClientUnknownName) {
   _TestAsg("idontexist", {}, false);
-}
\ No newline at end of file
+}
+
+TEST(TestEc2DnsClient, TestEc2DnsClientPrefersClientZone) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto asg = std::make_shared<MockAutoScalingClient>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  config.num_asg_records = 1;
+  EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+      .WillOnce(Return(DescribeAutoScalingGroupsOutcome(
+          DescribeAutoScalingGroupsResult().AddAutoScalingGroups(
+              AutoScalingGroup()
+                  .AddInstances(Aws::AutoScaling::Model::Instance()
+                      .WithInstanceId("i-0000001")
+                      .WithHealthStatus("Healthy")
+                      .WithLifecycleState(LifecycleState::InService))
+                  .AddInstances(Aws::AutoScaling::Model::Instance()
+                      .WithInstanceId("i-0000002")
+                      .WithHealthStatus("Healthy")
+                      .WithLifecycleState(LifecycleState::InService))
+                  .AddTags(TagDescription().WithKey("twitter:aws:dns-alias").WithValue("web"))))));
+
+  Aws::Vector<Aws::EC2::Model::Instance> instances = {
+      Aws::EC2::Model::Instance()
+          .WithInstanceId("i-0000001")
+          .WithPrivateIpAddress("10.0.0.10")
+          .WithPlacement(Placement().WithAvailabilityZone("us-east-1a")),
+      Aws::EC2::Model::Instance()
+          .WithInstanceId("i-0000002")
+          .WithPrivateIpAddress("10.0.1.10")
+          .WithPlacement(Placement().WithAvailabilityZone("us-east-1c"))
+  };
+  MockDnsClient dnsClient(&_logcb, ptr, asg, config, std::make_shared<StatsReceiver>());
+  dnsClient.RefreshAutoScalerData(instances);
+  dnsClient.RefreshZoneMap(instances);
+
+  ClientAddress inA, inC;
+  ClientAddress::TryParse("10.0.0.99", &inA);
+  ClientAddress::TryParse("10.0.1.99", &inC);
+  AsgMembersPtr nodes;
+  ASSERT_TRUE(dnsClient.TryResolveAutoscaler("web", inA, &nodes));
+
+  size_t picks[K_RANDOM_MAX_K];
+  for (int a = 0; a < 20; a++) {
+    ASSERT_EQ(dnsClient.SelectAutoscalerMembers(*nodes, inA, picks), 1u);
+    ASSERT_EQ(nodes->GetIp(picks[0]), "10.0.0.10");
+    ASSERT_EQ(dnsClient.SelectAutoscalerMembers(*nodes, inC, picks), 1u);
+    ASSERT_EQ(nodes->GetIp(picks[0]), "10.0.1.10");
+  }
+}
+
+TEST(TestEc2DnsClient, TestAsgTtlFollowsChangeRate) {
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  MockDnsClient dnsClient(
+      &_logcb, std::make_shared<MockEC2Client>(), std::make_shared<MockAutoScalingClient>(),
+      config, std::make_shared<StatsReceiver>());
+  auto start = steady_clock::now();
+
+  // New groups start at the minimum and earn longer TTLs while stable.
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.1", "10.0.0.2"}, start), 10u);
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.2", "10.0.0.1"}, start + seconds(200)), 50u);
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.1", "10.0.0.2"}, start + seconds(2000)), 120u);
+
+  // Churn pulls it back down.
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.1"}, start + seconds(2000)), 120u);
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.3"}, start + seconds(2040)), 120u);
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.4"}, start + seconds(2060)), 120u);
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.5"}, start + seconds(2070)), 66u);
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.6"}, start + seconds(2072)), 33u);
+  ASSERT_EQ(dnsClient.UpdateAsgHistory("web", {"10.0.0.7"}, start + seconds(2074)), 16u);
+}
+
+TEST(TestEc2DnsClient, TestFollowsSharedSnapshot) {
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  config.shared_snapshot_name = "ec2dns-client-test-" + std::to_string(getpid());
+  config.shared_snapshot_lock_path = "/tmp/" + config.shared_snapshot_name + ".lock";
+  auto leaderEc2 = std::make_shared<MockEC2Client>();
+  auto leaderAsg = std::make_shared<MockAutoScalingClient>();
+  EXPECT_CALL(*leaderEc2, DescribeInstances(_))
+      .WillOnce(Return(_GetExpectedResponse()));
+  EXPECT_CALL(*leaderAsg, DescribeAutoScalingGroups(_))
+      .WillOnce(Return(_GetExpectedAsgResponse()));
+  // The follower never calls the API for instances the leader has seen.
+  auto followerEc2 = std::make_shared<MockEC2Client>();
+  auto followerAsg = std::make_shared<MockAutoScalingClient>();
+  EXPECT_CALL(*followerEc2, DescribeInstances(_)).Times(0);
+  EXPECT_CALL(*followerAsg, DescribeAutoScalingGroups(_)).Times(0);
+
+  {
+    MockDnsClient leader(&_logcb, leaderEc2, leaderAsg, config, std::make_shared<StatsReceiver>());
+    auto followerConfig = config;
+    followerConfig.account_name = "other";
+    MockDnsClient follower(&_logcb, followerEc2, followerAsg, followerConfig, std::make_shared<StatsReceiver>());
+    leader.RefreshOrFollow();
+    follower.RefreshOrFollow();
+    ASSERT_FALSE(leader.IsFollowing());
+    ASSERT_TRUE(follower.IsFollowing());
+    ASSERT_EQ(follower.GetSnapshotSerial(), leader.GetSnapshotSerial());
+
+    char ip[DNS_NAME_BUFFER_SIZE];
+    char hostname[DNS_NAME_BUFFER_SIZE];
+    ResolveInfo info;
+    ASSERT_TRUE(follower.TryResolveIp("i-1234567", _LocalClient(), ip, sizeof(ip), &info));
+    ASSERT_STREQ(ip, "10.1.2.3");
+    ASSERT_EQ(info.outcome, LookupOutcome::Hit);
+    ASSERT_TRUE(follower.TryResolveHostname("10.1.2.3", _LocalClient(), hostname, sizeof(hostname), &info));
+    ASSERT_STREQ(hostname, "ue1a-other-1234567.aws.test.");
+    AsgMembersPtr nodes;
+    ASSERT_TRUE(follower.TryResolveAutoscaler("testasg2", _LocalClient(), &nodes));
+  }
+
+  shm_unlink(("/" + config.shared_snapshot_name).c_str());
+  shm_unlink(("/" + config.shared_snapshot_name + ".1").c_str());
+  unlink(config.shared_snapshot_lock_path.c_str());
+}
+
+TEST(TestEc2DnsClient, TestConfigChanges) {
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  auto changed = config;
+  ASSERT_TRUE(config.GetChangedTunables(changed).empty());
+  ASSERT_TRUE(config.GetChangedFixedSettings(changed).empty());
+
+  changed.refresh_interval = 5;
+  changed.host_ttl.max_ttl = 99;
+  changed.client_config.requestTimeoutMs = config.client_config.requestTimeoutMs + 1;
+  changed.zone_file_dir = "/var/named/ec2dns";
+  ASSERT_EQ(config.GetChangedTunables(changed),
+            std::vector<std::string>({"refresh_interval", "host_ttl", "requestTimeoutMs"}));
+  ASSERT_EQ(config.GetChangedFixedSettings(changed), std::vector<std::string>({"zone_file_dir"}));
+}
+
+TEST(TestEc2DnsClient, TestApplyConfigKeepsCaches) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  auto asg = std::make_shared<MockAutoScalingClient>();
+  // Refreshed once, the caches survive the config changing.
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(_GetExpectedResponse()));
+  EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+      .WillOnce(Return(DescribeAutoScalingGroupsOutcome(DescribeAutoScalingGroupsResult())));
+  MockDnsClient dnsClient(&_logcb, ptr, asg, config, std::make_shared<StatsReceiver>());
+  dnsClient.RefreshInstanceData();
+  auto serial = dnsClient.GetSnapshotSerial();
+
+  auto reloaded = config;
+  reloaded.num_asg_records = 3;
+  reloaded.instance_timeout = 600;
+  reloaded.zone_name = "aws.other";
+  ASSERT_EQ(dnsClient.ApplyConfig(reloaded), std::vector<std::string>({"instance_timeout", "num_asg_records"}));
+  ASSERT_TRUE(dnsClient.ApplyConfig(reloaded).empty());
+  ASSERT_EQ(dnsClient.GetConfig()->num_asg_records, 3u);
+  ASSERT_EQ(dnsClient.GetConfig()->zone_name, "aws.test");
+
+  char ip[DNS_NAME_BUFFER_SIZE];
+  ResolveInfo info;
+  ASSERT_TRUE(dnsClient.TryResolveIp("i-1234567", _LocalClient(), ip, sizeof(ip), &info));
+  ASSERT_STREQ(ip, "10.1.2.3");
+  ASSERT_EQ(info.outcome, LookupOutcome::Hit);
+  ASSERT_EQ(dnsClient.GetSnapshotSerial(), serial);
+}
+
+TEST(TestEc2DnsClient, TestApplyConfigReschedulesRefresh) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  config.refresh_interval = 3600;
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillRepeatedly(Return(_GetExpectedResponse()));
+
+  Ec2DnsClient dnsClient(&_logcb, ptr, std::make_shared<AutoScalingClient>(), config, std::make_shared<StatsReceiver>());
+  dnsClient.LaunchRefreshThread();
+  while (dnsClient.GetSnapshotSerial() == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto first = dnsClient.GetSnapshotSerial();
+  auto reloaded = config;
+  reloaded.refresh_interval = 0;
+  dnsClient.ApplyConfig(reloaded);
+  auto start = std::chrono::steady_clock::now();
+  while (dnsClient.GetSnapshotSerial() == first) {
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  dnsClient.StopRefreshThread();
+}
+
+TEST(TestEc2DnsClient, TestAuthoritativeSnapshot) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto config = Ec2DnsConfig("tc", "10.1.0.0/16,10.0.0.0/8", "aws.test");
+  config.authoritative_snapshot = true;
+  auto asg = std::make_shared<MockAutoScalingClient>();
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(_GetExpectedResponse()));
+  EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+      .WillOnce(Return(_GetExpectedAsgResponse()));
+  MockDnsClient dnsClient(&_logcb, ptr, asg, config, std::make_shared<StatsReceiver>());
+  dnsClient.RefreshInstanceData();
+
+  char value[DNS_NAME_BUFFER_SIZE];
+  ResolveInfo info;
+  ASSERT_TRUE(dnsClient.TryResolveIp("i-1234567", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Hit);
+  ASSERT_TRUE(dnsClient.TryResolveHostname("10.1.2.3", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Hit);
+
+  // Not in the snapshot, so answered without the API.
+  ASSERT_FALSE(dnsClient.TryResolveIp("i-7654321", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Absent);
+  ASSERT_FALSE(dnsClient.TryResolveHostname("10.1.9.9", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Absent);
+  Mock::VerifyAndClearExpectations(ptr.get());
+
+  // Outside the mapped networks and /8 being too big, lookups go to the API.
+  // So do instance IDs once the grace period is over, they could be newer
+  // than the snapshot, while addresses are still answered from it.
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .Times(4)
+      .WillRepeatedly(Return(DescribeInstancesOutcome(DescribeInstancesResponse())));
+  ASSERT_FALSE(dnsClient.TryResolveHostname("192.168.0.1", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Miss);
+  ASSERT_FALSE(dnsClient.TryResolveHostname("10.3.0.1", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Miss);
+  auto reloaded = config;
+  reloaded.authoritative_grace_sec = 0;
+  ASSERT_EQ(dnsClient.ApplyConfig(reloaded), std::vector<std::string>({"authoritative_grace_sec"}));
+  ASSERT_FALSE(dnsClient.TryResolveIp("i-7654321", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Miss);
+  ASSERT_FALSE(dnsClient.TryResolveHostname("10.1.9.8", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Absent);
+
+  // A snapshot older than authoritative_max_intervals refreshes is stale.
+  reloaded.authoritative_max_intervals = 0;
+  ASSERT_EQ(dnsClient.ApplyConfig(reloaded), std::vector<std::string>({"authoritative_max_intervals"}));
+  ASSERT_FALSE(dnsClient.TryResolveHostname("10.1.9.7", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Miss);
+}
+
+TEST(TestEc2DnsClient, TestFailedRefreshEndsAuthoritativeAnswers) {
+  auto ptr = std::make_shared<MockEC2Client>();
+  auto asg = std::make_shared<MockAutoScalingClient>();
+  auto config = Ec2DnsConfig("tc", "10.1.0.0/16", "aws.test");
+  config.authoritative_snapshot = true;
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(_GetExpectedResponse()));
+  EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+      .WillOnce(Return(_GetExpectedAsgResponse()));
+  MockDnsClient dnsClient(&_logcb, ptr, asg, config, std::make_shared<StatsReceiver>());
+  dnsClient.RefreshInstanceData();
+
+  char value[DNS_NAME_BUFFER_SIZE];
+  ResolveInfo info;
+  ASSERT_FALSE(dnsClient.TryResolveIp("i-7654321", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Absent);
+  ASSERT_FALSE(dnsClient.TryResolveHostname("10.1.9.9", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Absent);
+  Mock::VerifyAndClearExpectations(ptr.get());
+  Mock::VerifyAndClearExpectations(asg.get());
+
+  // The snapshot may be missing instances once a refresh fails, so lookups
+  // go to the API until one succeeds.
+  EXPECT_CALL(*ptr, DescribeInstances(_))
+      .WillOnce(Return(DescribeInstancesOutcome(Aws::Client::AWSError<EC2Errors>(
+          EC2Errors::INVALID_INSTANCE_I_D_NOT_FOUND, "InvalidInstanceID.NotFound", "not found", false))))
+      .WillOnce(Return(DescribeInstancesOutcome(DescribeInstancesResponse())))
+      .WillOnce(Return(DescribeInstancesOutcome(DescribeInstancesResponse())))
+      .WillOnce(Return(_GetExpectedResponse()));
+  EXPECT_CALL(*asg, DescribeAutoScalingGroups(_))
+      .WillOnce(Return(_GetExpectedAsgResponse()));
+  dnsClient.RefreshInstanceData();
+  ASSERT_FALSE(dnsClient.TryResolveIp("i-7654322", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Miss);
+  ASSERT_FALSE(dnsClient.TryResolveHostname("10.1.9.8", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Miss);
+  dnsClient.RefreshInstanceData();
+  ASSERT_FALSE(dnsClient.TryResolveHostname("10.1.9.7", _LocalClient(), value, sizeof(value), &info));
+  ASSERT_EQ(info.outcome, LookupOutcome::Absent);
+}
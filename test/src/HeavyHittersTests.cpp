@@ -0,0 +1,76 @@
+#include <string>
+
+#include "gtest/gtest.h"
+#include "HeavyHitters.h"
+
+using namespace std::chrono;
+
+static steady_clock::time_point at(int seconds) {
+  return steady_clock::time_point(std::chrono::seconds(seconds));
+}
+
+TEST(TestHeavyHitters, TestCountsExactlyUnderCapacity) {
+  HeavyHitters hh("test", 4, 60);
+  for (int i = 0; i < 5; i++) {
+    hh.Offer("a", at(0));
+  }
+  hh.Offer("b", at(1));
+  hh.Offer("b", at(1));
+  hh.Offer("c", at(2));
+  auto window = hh.GetCurrent(at(3));
+  ASSERT_EQ(window.total, 8u);
+  ASSERT_EQ(window.top.size(), 3u);
+  ASSERT_EQ(window.top[0].key, "a");
+  ASSERT_EQ(window.top[0].count, 5u);
+  ASSERT_EQ(window.top[0].error, 0u);
+  ASSERT_EQ(window.top[1].key, "b");
+  ASSERT_EQ(window.top[1].count, 2u);
+}
+
+TEST(TestHeavyHitters, TestFindsHeavyHitterAmongNoise) {
+  HeavyHitters hh("test", 8, 60);
+  for (int i = 0; i < 1000; i++) {
+    hh.Offer("hot", at(0));
+    hh.Offer(std::to_string(i), at(0));
+    hh.Offer(std::to_string(i * 7), at(0));
+  }
+  auto window = hh.GetCurrent(at(0));
+  ASSERT_EQ(window.top.size(), 8u);
+  ASSERT_EQ(window.top[0].key, "hot");
+  ASSERT_GE(window.top[0].count, 1000u);
+  ASSERT_LE(window.top[0].count - window.top[0].error, 1000u);
+}
+
+TEST(TestHeavyHitters, TestRotatesWindows) {
+  HeavyHitters hh("test", 4, 10);
+  hh.Offer("old", at(5));
+  hh.Offer("new", at(15));
+  auto current = hh.GetCurrent(at(16));
+  ASSERT_EQ(current.top.size(), 1u);
+  ASSERT_EQ(current.top[0].key, "new");
+  auto previous = hh.GetPrevious(at(16));
+  ASSERT_EQ(previous.top.size(), 1u);
+  ASSERT_EQ(previous.top[0].key, "old");
+
+  // A quiet window in between leaves nothing previous.
+  ASSERT_TRUE(hh.GetPrevious(at(35)).top.empty());
+  ASSERT_TRUE(hh.GetCurrent(at(35)).top.empty());
+}
+
+TEST(TestHeavyHitters, TestTruncatesLongKeys) {
+  HeavyHitters hh("test", 4, 60);
+  std::string key(HEAVY_HITTER_KEY_SIZE * 2, 'x');
+  hh.Offer(key, at(0));
+  hh.Offer(key.substr(0, HEAVY_HITTER_KEY_SIZE), at(0));
+  auto window = hh.GetCurrent(at(0));
+  ASSERT_EQ(window.top.size(), 1u);
+  ASSERT_EQ(window.top[0].key.size(), (size_t)HEAVY_HITTER_KEY_SIZE);
+  ASSERT_EQ(window.top[0].count, 2u);
+}
+
+TEST(TestHeavyHitters, TestToJson) {
+  HeavyHitters hh("test", 4, 60);
+  hh.Offer("ue1a-tc-1234");
+  auto json = hh.ToJson().WriteCompact();
+  ASSERT_NE(json.find("ue1a-tc-1234"), std::string::npos);
+}
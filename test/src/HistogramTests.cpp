@@ -0,0 +1,69 @@
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "Histogram.h"
+
+TEST(TestHistogram, TestBucketsAreOrderedAndTight) {
+  size_t lastBucket = 0;
+  for (uint64_t v = 0; v < (1ull << 40); v = v < 64 ? v + 1 : v + v / 7) {
+    size_t bucket = Histogram::GetBucket(v);
+    ASSERT_GE(bucket, lastBucket);
+    ASSERT_LT(bucket, (size_t)HISTOGRAM_NUM_BUCKETS);
+    uint64_t upper = Histogram::GetBucketUpperBound(bucket);
+    ASSERT_GE(upper, v);
+    ASSERT_LE(upper - v, v / 32);
+    lastBucket = bucket;
+  }
+  ASSERT_EQ(Histogram::GetBucket(~0ull), (size_t)HISTOGRAM_NUM_BUCKETS - 1);
+}
+
+TEST(TestHistogram, TestPercentiles) {
+  Histogram histogram("test");
+  for (uint64_t v = 1; v <= 1000; v++) {
+    histogram.Record(v);
+  }
+  auto snapshot = histogram.GetSnapshot();
+  ASSERT_EQ(snapshot.GetCount(), 1000u);
+  ASSERT_EQ(snapshot.GetSum(), 500500u);
+  ASSERT_EQ(snapshot.GetMax(), 1000u);
+  ASSERT_NEAR(snapshot.GetPercentile(0.5), 500, 16);
+  ASSERT_NEAR(snapshot.GetPercentile(0.9), 900, 29);
+  ASSERT_NEAR(snapshot.GetPercentile(0.99), 990, 31);
+  ASSERT_EQ(snapshot.GetPercentile(1), 1000u);
+  ASSERT_EQ(HistogramSnapshot().GetPercentile(0.5), 0u);
+}
+
+TEST(TestHistogram, TestMerge) {
+  Histogram fast("fast"), slow("slow");
+  for (int a = 0; a < 90; a++) {
+    fast.Record(10);
+  }
+  for (int a = 0; a < 10; a++) {
+    slow.Record(5000);
+  }
+  auto merged = fast.GetSnapshot();
+  merged.Merge(slow.GetSnapshot());
+  ASSERT_EQ(merged.GetCount(), 100u);
+  ASSERT_EQ(merged.GetPercentile(0.9), 10u);
+  ASSERT_NEAR(merged.GetPercentile(0.95), 5000, 160);
+  ASSERT_EQ(merged.GetMax(), 5000u);
+}
+
+TEST(TestHistogram, TestConcurrentRecording) {
+  Histogram histogram("test");
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.push_back(std::thread([&histogram, t]() {
+      for (uint64_t v = 0; v < 10000; v++) {
+        histogram.Record(v + t);
+      }
+    }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  auto snapshot = histogram.GetSnapshot();
+  ASSERT_EQ(snapshot.GetCount(), 80000u);
+  ASSERT_EQ(snapshot.GetMax(), 10006u);
+}
@@ -7,11 +7,12 @@ TEST(TestHostMatcher, TestMatchesValidHostname) {
   auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
   auto hm = HostMatcher(config);
 
-  std::string instanceId, awsRegion;
-  bool success = hm.TryMatch("ue1a-tc-12345678", &instanceId, &awsRegion);
+  char instanceId[64];
+  boost::string_ref awsRegion;
+  bool success = hm.TryMatch("ue1a-tc-12345678", instanceId, sizeof(instanceId), &awsRegion);
 
   ASSERT_TRUE(success);
-  ASSERT_EQ(instanceId, "i-12345678");
+  ASSERT_STREQ(instanceId, "i-12345678");
   ASSERT_EQ(awsRegion, "ue1");
 }
 
@@ -19,8 +20,19 @@ TEST(TestHostMatcher, TestFailsInvalidHostname) {
   auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
   auto hm = HostMatcher(config);
 
-  std::string instanceId, awsRegion;
-  bool success = hm.TryMatch("invalid-data", &instanceId, &awsRegion);
+  char instanceId[64];
+  boost::string_ref awsRegion;
+  bool success = hm.TryMatch("invalid-data", instanceId, sizeof(instanceId), &awsRegion);
 
   ASSERT_FALSE(success);
-}
\ No newline at end of file
+}
+
+TEST(TestHostMatcher, TestFailsEmptyInstanceId) {
+  auto config = Ec2DnsConfig("tc", "10.0.0.0/23", "aws.test");
+  auto hm = HostMatcher(config);
+
+  char instanceId[64];
+  boost::string_ref awsRegion;
+  ASSERT_FALSE(hm.TryMatch("ue1a-tc-", instanceId, sizeof(instanceId), &awsRegion));
+  ASSERT_FALSE(hm.TryMatch("ue1a-tc-12345678", instanceId, 8, &awsRegion));
+}
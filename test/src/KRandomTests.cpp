@@ -1,30 +1,69 @@
+#include <set>
 #include <string>
 
 #include "gtest/gtest.h"
 #include "KRandom.h"
 
-void _Test(size_t numNodes, std::vector<std::string> expected){
-  tls_random::seed_thread(1);
+std::vector<std::string> _Pick(size_t numNodes, size_t k, std::default_random_engine::result_type seed) {
+  tls_random::seed_thread(seed);
   std::vector<std::string> nodes;
   for (size_t a = 0; a < numNodes; a++) {
     nodes.push_back(std::to_string(a));
   }
 
-  auto rndIter = k_random<std::string>(nodes, expected.size());
-  auto i1 = expected.begin(); auto i2 = rndIter.begin();
-  for (; i1 != expected.end() && i2 != rndIter.end(); ++i1, ++i2) {
-    ASSERT_EQ(*i1, *i2);
+  std::vector<std::string> picked;
+  for (const auto& node : k_random<std::string>(nodes, k)) {
+    picked.push_back(node);
   }
+  return picked;
+}
+
+void _Test(size_t numNodes, size_t k, size_t expectedSize) {
+  auto picked = _Pick(numNodes, k, 1);
+  ASSERT_EQ(picked.size(), expectedSize);
+
+  std::set<std::string> unique(picked.begin(), picked.end());
+  ASSERT_EQ(unique.size(), picked.size());
+  for (const auto& p : picked) {
+    ASSERT_LT(std::stoul(p), numNodes);
+  }
+  ASSERT_EQ(picked, _Pick(numNodes, k, 1));
 }
 
 TEST(KRandom, KRandomSeqPickOne) {
-  _Test(3, {"2"});
+  _Test(3, 1, 1);
 }
 
 TEST(KRandom, KRandomSeqPickAll) {
-  _Test(3, {"2", "1", "0"});
+  _Test(3, 3, 3);
+}
+
+TEST(KRandom, KRandomPickMoreThanAvailable) {
+  _Test(3, 10, 3);
+}
+
+TEST(KRandom, KRandomPickNone) {
+  _Test(0, 4, 0);
 }
 
 TEST(KRandom, KRandomHugeSeq) {
-  _Test(10000, {"6113"});
-}
\ No newline at end of file
+  _Test(10000, 4, 4);
+}
+
+TEST(KRandom, KRandomClampsK) {
+  _Test(10000, 1000, K_RANDOM_MAX_K);
+}
+
+TEST(KRandom, KRandomCoversAllItems) {
+  // Every item should come up first eventually, and in roughly even numbers.
+  tls_random::seed_thread(7);
+  std::vector<int> items = {0, 1, 2, 3, 4};
+  std::vector<size_t> counts(items.size());
+  for (int a = 0; a < 5000; a++) {
+    counts[*k_random<int>(items, 2).begin()]++;
+  }
+  for (auto c : counts) {
+    ASSERT_GT(c, 800u);
+    ASSERT_LT(c, 1200u);
+  }
+}
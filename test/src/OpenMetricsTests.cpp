@@ -0,0 +1,62 @@
+#include <string>
+
+#include "gtest/gtest.h"
+#include "OpenMetrics.h"
+
+static bool contains(const std::string& haystack, const std::string& needle) {
+  return haystack.find(needle) != std::string::npos;
+}
+
+TEST(TestOpenMetrics, TestCountersWithoutLabels) {
+  StatsReceiver stats;
+  stats.Create("api_requests")->Increment(3);
+  auto out = OpenMetricsWriter::Render(stats);
+  ASSERT_EQ(out, "# TYPE ec2dns_api_requests counter\nec2dns_api_requests_total 3\n# EOF\n");
+}
+
+TEST(TestOpenMetrics, TestLabelledStatsShareAFamily) {
+  StatsReceiver stats;
+  stats.Create("host_hits", MetricId("cache_hits", {{"cache", "host"}}))->Increment(2);
+  stats.Create("other")->Increment();
+  stats.Create("asg_hits", MetricId("cache_hits", {{"cache", "asg"}}))->Increment(5);
+  auto out = OpenMetricsWriter::Render(stats);
+  ASSERT_EQ(out,
+      "# TYPE ec2dns_cache_hits counter\n"
+      "ec2dns_cache_hits_total{cache=\"host\"} 2\n"
+      "ec2dns_cache_hits_total{cache=\"asg\"} 5\n"
+      "# TYPE ec2dns_other counter\n"
+      "ec2dns_other_total 1\n"
+      "# EOF\n");
+}
+
+TEST(TestOpenMetrics, TestHistogramBuckets) {
+  StatsReceiver stats;
+  auto h = stats.CreateHistogram("lookup_hit_us", MetricId("lookup_duration", {{"outcome", "hit"}}));
+  h->Record(50);
+  h->Record(200);
+  h->Record(2000000);
+  auto out = OpenMetricsWriter::Render(stats);
+  ASSERT_TRUE(contains(out, "# TYPE ec2dns_lookup_duration_seconds histogram\n"));
+  ASSERT_TRUE(contains(out, "ec2dns_lookup_duration_seconds_bucket{outcome=\"hit\",le=\"0.0001\"} 1\n"));
+  ASSERT_TRUE(contains(out, "ec2dns_lookup_duration_seconds_bucket{outcome=\"hit\",le=\"0.00025\"} 2\n"));
+  ASSERT_TRUE(contains(out, "ec2dns_lookup_duration_seconds_bucket{outcome=\"hit\",le=\"1.0\"} 2\n"));
+  ASSERT_TRUE(contains(out, "ec2dns_lookup_duration_seconds_bucket{outcome=\"hit\",le=\"2.5\"} 3\n"));
+  ASSERT_TRUE(contains(out, "ec2dns_lookup_duration_seconds_bucket{outcome=\"hit\",le=\"+Inf\"} 3\n"));
+  ASSERT_TRUE(contains(out, "ec2dns_lookup_duration_seconds_count{outcome=\"hit\"} 3\n"));
+  ASSERT_TRUE(contains(out, "ec2dns_lookup_duration_seconds_sum{outcome=\"hit\"} 2.00025\n"));
+  ASSERT_TRUE(contains(out, "# EOF\n"));
+}
+
+TEST(TestOpenMetrics, TestStreamsAFamilyPerChunk) {
+  StatsReceiver stats;
+  stats.Create("a");
+  stats.Create("b");
+  stats.CreateHistogram("c");
+  size_t chunks = 0;
+  OpenMetricsWriter::Render(stats, [&chunks](const std::string&) { chunks++; });
+  ASSERT_EQ(chunks, 4u);
+}
+
+TEST(TestOpenMetrics, TestEscapesLabelValues) {
+  ASSERT_EQ(OpenMetricsWriter::EscapeLabelValue("a\"b\\c\nd"), "a\\\"b\\\\c\\nd");
+}
@@ -0,0 +1,98 @@
+#include <string>
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "QueryLog.h"
+
+static std::string _TempPath(const char *name) {
+  return std::string("/tmp/ec2dns-") + name + "-" + std::to_string(getpid()) + ".qlog";
+}
+
+static ClientAddress _Addr(const char *str) {
+  ClientAddress addr;
+  ClientAddress::TryParse(str, &addr);
+  return addr;
+}
+
+TEST(TestQueryLog, TestRoundTrip) {
+  auto path = _TempPath("roundtrip");
+  {
+    QueryLogWriter writer(path, 1, 1 << 20, std::make_shared<StatsReceiver>());
+    ASSERT_TRUE(writer.IsOpen());
+    writer.Append(1000, "aws.test", "ue1a-tc-1234567", _Addr("10.1.2.3"));
+    writer.Append(2000, "aws.test", "@", _Addr("2001:db8::1"));
+    writer.Append(3000, "2.1.10.in-addr.arpa", "4", ClientAddress());
+    writer.Flush();
+    writer.Append(4000, "asg.aws.test", "web", _Addr("10.1.2.4"));
+  }
+
+  QueryLogReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  QueryLogEntry entry;
+  ASSERT_TRUE(reader.Next(&entry));
+  ASSERT_EQ(entry.timestamp_us, 1000u);
+  ASSERT_EQ(entry.zone, "aws.test");
+  ASSERT_EQ(entry.name, "ue1a-tc-1234567");
+  ASSERT_EQ(entry.client.ToString(), "10.1.2.3");
+  ASSERT_TRUE(reader.Next(&entry));
+  ASSERT_EQ(entry.zone, "aws.test");
+  ASSERT_EQ(entry.name, "@");
+  ASSERT_EQ(entry.client.ToString(), "2001:db8::1");
+  ASSERT_TRUE(reader.Next(&entry));
+  ASSERT_EQ(entry.zone, "2.1.10.in-addr.arpa");
+  ASSERT_FALSE(entry.client.IsValid());
+  ASSERT_TRUE(reader.Next(&entry));
+  ASSERT_EQ(entry.timestamp_us, 4000u);
+  ASSERT_EQ(entry.zone, "asg.aws.test");
+  ASSERT_EQ(entry.name, "web");
+  ASSERT_FALSE(reader.Next(&entry));
+  unlink(path.c_str());
+}
+
+TEST(TestQueryLog, TestStopsAtMaxBytes) {
+  auto path = _TempPath("max");
+  auto stats = std::make_shared<StatsReceiver>();
+  {
+    QueryLogWriter writer(path, 1, 100, stats, 64);
+    for (int i = 0; i < 10; i++) {
+      writer.Append(i, "aws.test", "ue1a-tc-1234567", _Addr("10.1.2.3"));
+    }
+  }
+
+  QueryLogReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  QueryLogEntry entry;
+  size_t count = 0;
+  while (reader.Next(&entry)) {
+    count++;
+  }
+  ASSERT_GT(count, 0u);
+  ASSERT_LT(count, 10u);
+  for (const auto &s : stats->GetAllStats()) {
+    if (s->GetName() == "query_log_dropped") {
+      ASSERT_EQ(s->GetValue(), 10u - count);
+    }
+  }
+  unlink(path.c_str());
+}
+
+TEST(TestQueryLog, TestSamples) {
+  QueryLogWriter writer("/dev/null", 4, 1 << 20, std::make_shared<StatsReceiver>());
+  size_t sampled = 0;
+  for (int i = 0; i < 100; i++) {
+    sampled += writer.ShouldSample() ? 1 : 0;
+  }
+  ASSERT_EQ(sampled, 25u);
+}
+
+TEST(TestQueryLog, TestRejectsOtherFiles) {
+  auto path = _TempPath("other");
+  FILE *f = fopen(path.c_str(), "wb");
+  fputs("not a capture", f);
+  fclose(f);
+  QueryLogReader reader;
+  ASSERT_FALSE(reader.Open(path));
+  unlink(path.c_str());
+}
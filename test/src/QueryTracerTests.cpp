@@ -0,0 +1,102 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "QueryTracer.h"
+
+static QueryTrace make_trace(const char *name, uint32_t totalUs) {
+  QueryTrace trace;
+  trace.start = std::chrono::steady_clock::now();
+  trace.Begin("aws.test", name, true);
+  trace.total_us = totalUs;
+  return trace;
+}
+
+TEST(TestQueryTracer, TestSamplingDisabled) {
+  QueryTracer tracer(0, 8, 2);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_FALSE(tracer.ShouldSample());
+  }
+}
+
+TEST(TestQueryTracer, TestSamplesOneInN) {
+  QueryTracer tracer(4, 8, 2);
+  int sampled = 0;
+  for (int i = 0; i < 100; i++) {
+    sampled += tracer.ShouldSample() ? 1 : 0;
+  }
+  ASSERT_EQ(sampled, 25);
+}
+
+TEST(TestQueryTracer, TestRingKeepsNewest) {
+  QueryTracer tracer(1, 4, 2);
+  for (int i = 0; i < 10; i++) {
+    tracer.Record(make_trace(std::to_string(i).c_str(), 1));
+  }
+  auto recent = tracer.GetRecent();
+  ASSERT_EQ(recent.size(), 4u);
+  ASSERT_STREQ(recent[0].name, "9");
+  ASSERT_STREQ(recent[3].name, "6");
+  ASSERT_EQ(tracer.GetDropped(), 0u);
+}
+
+TEST(TestQueryTracer, TestTruncatesLongNames) {
+  std::string name(QUERY_TRACE_NAME_SIZE * 2, 'a');
+  auto trace = make_trace(name.c_str(), 1);
+  ASSERT_EQ(strlen(trace.name), QUERY_TRACE_NAME_SIZE - 1u);
+}
+
+TEST(TestQueryTracer, TestKeepsSlowest) {
+  QueryTracer tracer(1, 4, 3);
+  uint32_t latencies[] = {5, 50, 1, 40, 2, 30, 10};
+  for (auto l : latencies) {
+    if (tracer.IsSlow(l)) {
+      tracer.OfferSlow(make_trace("x", l));
+    }
+  }
+  auto slowest = tracer.GetSlowest();
+  ASSERT_EQ(slowest.size(), 3u);
+  ASSERT_EQ(slowest[0].total_us, 50u);
+  ASSERT_EQ(slowest[1].total_us, 40u);
+  ASSERT_EQ(slowest[2].total_us, 30u);
+  ASSERT_FALSE(tracer.IsSlow(30));
+  ASSERT_TRUE(tracer.IsSlow(31));
+}
+
+TEST(TestQueryTracer, TestConcurrentRecord) {
+  QueryTracer tracer(1, 64, 8);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.push_back(std::thread([&tracer, t]() {
+      for (uint32_t i = 0; i < 1000; i++) {
+        auto trace = make_trace("x", i * 4 + t);
+        tracer.Record(trace);
+        if (tracer.IsSlow(trace.total_us)) {
+          tracer.OfferSlow(trace);
+        }
+      }
+    }));
+  }
+  for (int i = 0; i < 10; i++) {
+    tracer.GetRecent();
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(tracer.GetRecent().size(), 64u);
+  ASSERT_EQ(tracer.GetSlowest()[0].total_us, 3999u);
+}
+
+TEST(TestQueryTracer, TestRenderJson) {
+  QueryTracer tracer(1, 4, 2);
+  auto trace = make_trace("ue1a-tc-1234", 7);
+  trace.path = QueryPath::Forward;
+  trace.outcome = LookupOutcome::Miss;
+  tracer.Record(trace);
+  tracer.OfferSlow(trace);
+  auto json = tracer.RenderJson();
+  ASSERT_NE(json.find("ue1a-tc-1234"), std::string::npos);
+  ASSERT_NE(json.find("\"forward\""), std::string::npos);
+  ASSERT_NE(json.find("\"miss\""), std::string::npos);
+}
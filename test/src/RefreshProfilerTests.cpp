@@ -0,0 +1,60 @@
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "RefreshProfiler.h"
+
+TEST(TestRefreshProfiler, TestRecordsNestedPhases) {
+  RefreshProfiler profiler(4);
+  Histogram histogram("test");
+  std::unique_ptr<char[]> held;
+  profiler.BeginCycle();
+  {
+    RefreshProfiler::Phase outer(&profiler, "outer", &histogram);
+    {
+      RefreshProfiler::Phase inner(&profiler, "inner");
+      held.reset(new char[1 << 20]);
+      held[0] = 1;
+    }
+  }
+  profiler.EndCycle(true, 42);
+
+  auto history = profiler.GetHistory();
+  ASSERT_EQ(history.size(), 1u);
+  auto &cycle = history[0];
+  ASSERT_TRUE(cycle.success);
+  ASSERT_EQ(cycle.instances, 42u);
+  ASSERT_GT(cycle.rss_after_bytes, 0u);
+  ASSERT_GE(cycle.peak_rss_bytes, cycle.rss_after_bytes);
+  ASSERT_EQ(cycle.phases.size(), 2u);
+  ASSERT_EQ(cycle.phases[0].name, "outer");
+  ASSERT_EQ(cycle.phases[0].depth, 0);
+  ASSERT_EQ(cycle.phases[1].name, "inner");
+  ASSERT_EQ(cycle.phases[1].depth, 1);
+  ASSERT_GE(cycle.phases[0].duration_us, cycle.phases[1].duration_us);
+  ASSERT_GE(cycle.phases[1].heap_delta_bytes, 1 << 20);
+  ASSERT_EQ(histogram.GetSnapshot().GetCount(), 1u);
+}
+
+TEST(TestRefreshProfiler, TestPhasesOutsideCycleOnlyFeedHistogram) {
+  RefreshProfiler profiler(4);
+  Histogram histogram("test");
+  {
+    RefreshProfiler::Phase phase(&profiler, "phase", &histogram);
+  }
+  ASSERT_TRUE(profiler.GetHistory().empty());
+  ASSERT_EQ(histogram.GetSnapshot().GetCount(), 1u);
+}
+
+TEST(TestRefreshProfiler, TestKeepsLastCycles) {
+  RefreshProfiler profiler(3);
+  for (size_t i = 0; i < 5; i++) {
+    profiler.BeginCycle();
+    profiler.EndCycle(i % 2 == 0, i);
+  }
+  auto history = profiler.GetHistory();
+  ASSERT_EQ(history.size(), 3u);
+  ASSERT_EQ(history[0].instances, 2u);
+  ASSERT_EQ(history[2].instances, 4u);
+  ASSERT_NE(profiler.RenderJson().find("\"cycles\""), std::string::npos);
+}
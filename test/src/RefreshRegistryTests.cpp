@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <thread>
+
+#include "RefreshRegistry.h"
+#include "mocks/mocks.h"
+
+using namespace testing;
+using namespace Aws::EC2::Model;
+
+static void _registrylog(int, const char*, ...) { }
+
+static DescribeInstancesOutcome _GetInstances() {
+  return DescribeInstancesOutcome(
+      DescribeInstancesResponse().AddReservations(
+          Reservation().AddInstances(
+              Aws::EC2::Model::Instance()
+                  .WithPrivateIpAddress("10.1.2.3")
+                  .WithPlacement(Placement().WithAvailabilityZone("us-east-1a"))
+                  .WithInstanceId("i-1234567"))));
+}
+
+static bool _WaitForSerial(Ec2DnsClient &client, uint32_t after) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (client.GetSnapshotSerial() <= after) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+TEST(TestRefreshRegistry, TestKeys) {
+  auto config = Ec2DnsConfig("tc", "10.1.0.0/16", "aws.test");
+  auto key = RefreshRegistry::GetKey(config);
+
+  // Naming and presentation don't matter.
+  auto other = Ec2DnsConfig("other", "10.2.0.0/16", "aws.other");
+  other.host_ttl.max_ttl = 5;
+  ASSERT_EQ(RefreshRegistry::GetKey(other), key);
+
+  auto region = config;
+  region.client_config.region = "us-west-2";
+  ASSERT_NE(RefreshRegistry::GetKey(region), key);
+  auto creds = config;
+  creds.aws_access_key = "AKIA";
+  ASSERT_NE(RefreshRegistry::GetKey(creds), key);
+  auto endpoint = config;
+  endpoint.client_config.endpointOverride = "localhost:8000";
+  ASSERT_NE(RefreshRegistry::GetKey(endpoint), key);
+  auto tag = config;
+  tag.asg_dns_tag = "dns";
+  ASSERT_NE(RefreshRegistry::GetKey(tag), key);
+}
+
+TEST(TestRefreshRegistry, TestZonesShareRefresh) {
+  RefreshRegistry registry;
+  auto config = Ec2DnsConfig("tc", "10.1.0.0/16", "aws.test");
+  config.refresh_interval = 3600;
+  auto ownerEc2 = std::make_shared<MockEC2Client>();
+  EXPECT_CALL(*ownerEc2, DescribeInstances(_))
+      .WillRepeatedly(Return(_GetInstances()));
+  // The other zone never calls the API for instances the owner has seen.
+  auto followerEc2 = std::make_shared<MockEC2Client>();
+  EXPECT_CALL(*followerEc2, DescribeInstances(_)).Times(0);
+
+  auto owner = std::make_shared<Ec2DnsClient>(
+      &_registrylog, ownerEc2, std::make_shared<AutoScalingClient>(), config, std::make_shared<StatsReceiver>());
+  auto engine = registry.Join(owner);
+  ASSERT_EQ(engine->GetOwner(), owner);
+  ASSERT_TRUE(_WaitForSerial(*owner, 0));
+
+  auto followerConfig = Ec2DnsConfig("other", "10.1.0.0/16", "aws.other");
+  auto follower = std::make_shared<Ec2DnsClient>(
+      &_registrylog, followerEc2, std::make_shared<AutoScalingClient>(), followerConfig,
+      std::make_shared<StatsReceiver>());
+  ASSERT_EQ(registry.Join(follower), engine);
+  ASSERT_EQ(engine->GetNumZones(), 2u);
+  ASSERT_TRUE(follower->IsFollowing());
+  ASSERT_EQ(follower->GetSnapshotSerial(), owner->GetSnapshotSerial());
+
+  // Each zone names the instances its own way.
+  char ip[DNS_NAME_BUFFER_SIZE];
+  char hostname[DNS_NAME_BUFFER_SIZE];
+  ResolveInfo info;
+  ClientAddress client;
+  ClientAddress::TryParse("10.1.9.9", &client);
+  ASSERT_TRUE(follower->TryResolveIp("i-1234567", client, ip, sizeof(ip), &info));
+  ASSERT_STREQ(ip, "10.1.2.3");
+  ASSERT_TRUE(follower->TryResolveHostname("10.1.2.3", client, hostname, sizeof(hostname), &info));
+  ASSERT_STREQ(hostname, "ue1a-other-1234567.aws.other.");
+  ASSERT_TRUE(owner->TryResolveHostname("10.1.2.3", client, hostname, sizeof(hostname), &info));
+  ASSERT_STREQ(hostname, "ue1a-tc-1234567.aws.test.");
+
+  // Once the zone that started it goes, its client refreshes on for the
+  // others.
+  auto serial = owner->GetSnapshotSerial();
+  engine->Leave(owner.get());
+  ASSERT_EQ(engine->GetNumZones(), 1u);
+  auto reloaded = config;
+  reloaded.refresh_interval = 0;
+  owner->ApplyConfig(reloaded);
+  owner.reset();
+  ASSERT_TRUE(_WaitForSerial(*follower, serial));
+
+  engine->Leave(follower.get());
+  ASSERT_EQ(registry.GetEngines().size(), 1u);
+  engine.reset();
+  ASSERT_TRUE(registry.GetEngines().empty());
+}
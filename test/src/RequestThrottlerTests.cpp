@@ -0,0 +1,46 @@
+#include "gtest/gtest.h"
+
+#include "ClientAddress.h"
+#include "RequestThrottler.h"
+
+ClientAddress _Addr(const char *str) {
+  ClientAddress addr;
+  ClientAddress::TryParse(str, &addr);
+  return addr;
+}
+
+TEST(TestRequestThrottler, TestThrottlesRepeatedMiss) {
+  RequestThrottler throttler;
+  auto client = _Addr("10.0.0.5");
+
+  ASSERT_FALSE(throttler.IsRequestThrottled(client, "i-1234567"));
+  throttler.OnMiss("i-1234567");
+  ASSERT_TRUE(throttler.IsRequestThrottled(client, "i-1234567"));
+  ASSERT_TRUE(throttler.IsRequestThrottled(_Addr("10.0.0.6"), "i-1234567"));
+}
+
+TEST(TestRequestThrottler, TestNeverThrottlesOwnIp) {
+  RequestThrottler throttler;
+  auto client = _Addr("10.0.0.5");
+
+  throttler.OnMiss("10.0.0.5");
+  ASSERT_FALSE(throttler.IsRequestThrottled(client, "10.0.0.5"));
+  ASSERT_TRUE(throttler.IsRequestThrottled(_Addr("10.0.0.6"), "10.0.0.5"));
+  ASSERT_TRUE(throttler.IsRequestThrottled(ClientAddress(), "10.0.0.5"));
+
+  throttler.OnMiss("i-1234567");
+  ASSERT_TRUE(throttler.IsRequestThrottled(ClientAddress(), "i-1234567"));
+}
+
+TEST(TestClientAddress, TestParseAndFormat) {
+  ClientAddress v4, v6;
+  ASSERT_TRUE(ClientAddress::TryParse("10.1.2.3", &v4));
+  ASSERT_TRUE(ClientAddress::TryParse("fd00::1", &v6));
+  ASSERT_FALSE(ClientAddress::TryParse("i-1234567", &v4));
+
+  ASSERT_EQ(v4.ToString(), "10.1.2.3");
+  ASSERT_EQ(v4.GetV4(), 0x0A010203u);
+  ASSERT_EQ(v6.ToString(), "fd00::1");
+  ASSERT_NE(v4, v6);
+  ASSERT_EQ(ClientAddress().ToString(), "-");
+}
@@ -12,4 +12,51 @@ TEST(TestReverseLookupHelper, TestReverseLookupZones) {
   ASSERT_TRUE(rl.IsReverseLookupZone("2.1.10.in-addr.arpa"));
   ASSERT_TRUE(rl.IsReverseLookupZone("3.1.10.in-addr.arpa"));
   ASSERT_FALSE(rl.IsReverseLookupZone("4.1.10.in-addr.arpa"));
-}
\ No newline at end of file
+}
+TEST(TestReverseLookupHelper, TestSmallMaskReverseLookupZones) {
+  auto rl = ReverseLookupHelper(std::shared_ptr<Ec2DnsClient>());
+  // 10.1.2.64 - 10.1.2.127, plus a second VPC CIDR
+  ASSERT_TRUE(rl.InitializeReverseLookupZones("10.1.2.64/26,172.16.0.0/16"));
+
+  ASSERT_TRUE(rl.IsReverseLookupZone("2.1.10.in-addr.arpa"));
+  ASSERT_TRUE(rl.IsReverseLookupZone("2.1.10.IN-ADDR.ARPA."));
+  ASSERT_FALSE(rl.IsReverseLookupZone("3.1.10.in-addr.arpa"));
+  ASSERT_TRUE(rl.IsReverseLookupZone("255.16.172.in-addr.arpa"));
+  ASSERT_FALSE(rl.IsReverseLookupZone("0.17.172.in-addr.arpa"));
+
+  ASSERT_TRUE(rl.IsInVpc(0x0A010240));
+  ASSERT_FALSE(rl.IsInVpc(0x0A01023F));
+  ASSERT_FALSE(rl.IsInVpc(0x0A010280));
+  ASSERT_EQ(rl.GetReverseLookupZones().size(), 257u);
+}
+
+TEST(TestReverseLookupHelper, TestOverlappingCidrsShareZones) {
+  auto rl = ReverseLookupHelper(std::shared_ptr<Ec2DnsClient>());
+  ASSERT_TRUE(rl.InitializeReverseLookupZones("10.1.2.0/24,10.1.0.0/16,10.1.2.128/25"));
+  auto zones = rl.GetReverseLookupZones();
+  ASSERT_EQ(zones.size(), 256u);
+  ASSERT_EQ(zones[0], "2.1.10.in-addr.arpa");
+  ASSERT_EQ(zones[1], "0.1.10.in-addr.arpa");
+}
+
+TEST(TestReverseLookupHelper, TestParseReverseName) {
+  uint32_t addr;
+  size_t numOctets;
+  std::string name = "4.3.2.10.in-addr.arpa";
+  ASSERT_TRUE(ReverseLookupHelper::TryParseReverseName(name.c_str(), name.length(), &addr, &numOctets));
+  ASSERT_EQ(addr, 0x0A020304u);
+  ASSERT_EQ(numOctets, 4u);
+
+  for (auto bad : {"256.2.10.in-addr.arpa", "a.2.10.in-addr.arpa", ".2.10.in-addr.arpa",
+                   "1..10.in-addr.arpa", "5.4.3.2.1.in-addr.arpa", "in-addr.arpa", "2.10.ip6.arpa"}) {
+    std::string s(bad);
+    ASSERT_FALSE(ReverseLookupHelper::TryParseReverseName(s.c_str(), s.length(), &addr, &numOctets)) << bad;
+  }
+}
+
+TEST(TestReverseLookupHelper, TestRejectsInvalidCidr) {
+  auto rl = ReverseLookupHelper(std::shared_ptr<Ec2DnsClient>());
+  ASSERT_FALSE(rl.InitializeReverseLookupZones("10.1.0.0"));
+  ASSERT_FALSE(rl.InitializeReverseLookupZones("10.1.0.0/33"));
+  ASSERT_FALSE(rl.InitializeReverseLookupZones("10.1.0.0/16,bogus/8"));
+}
@@ -0,0 +1,134 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "SdkMemory.h"
+
+TEST(TestSdkMemory, TestRecyclesBlocks) {
+  SdkMemorySystem memory;
+  void *first = memory.AllocateMemory(100, 16);
+  ASSERT_NE(first, nullptr);
+  ASSERT_EQ((uintptr_t)first % 16, 0u);
+  memset(first, 0xAB, 100);
+  memory.FreeMemory(first);
+
+  void *second = memory.AllocateMemory(90, 16);
+  ASSERT_EQ(second, first);
+  void *third = memory.AllocateMemory(40, 16);
+  memory.FreeMemory(second);
+  memory.FreeMemory(third);
+
+  auto stats = memory.GetStats();
+  ASSERT_EQ(stats.allocations, 3u);
+  ASSERT_EQ(stats.allocated_bytes, 230u);
+  ASSERT_EQ(stats.live_bytes, 0u);
+  ASSERT_EQ(stats.pool_hits, 1u);
+}
+
+TEST(TestSdkMemory, TestSamplesPeak) {
+  SdkMemorySystem memory;
+  void *large = memory.AllocateMemory(SDK_MEMORY_FLUSH_BYTES * 2, 16);
+  memory.FreeMemory(large);
+  ASSERT_GE(memory.GetStats().peak_bytes, SDK_MEMORY_FLUSH_BYTES * 2u);
+  ASSERT_EQ(memory.GetStats().live_bytes, 0u);
+}
+
+TEST(TestSdkMemory, TestLargeAndOverAlignedBlocks) {
+  SdkMemorySystem memory;
+  void *large = memory.AllocateMemory(1 << 20, 16);
+  void *aligned = memory.AllocateMemory(24, 128);
+  ASSERT_NE(large, nullptr);
+  ASSERT_EQ((uintptr_t)aligned % 128, 0u);
+  memset(large, 0, 1 << 20);
+  memory.FreeMemory(large);
+  memory.FreeMemory(aligned);
+  memory.FreeMemory(nullptr);
+  ASSERT_EQ(memory.GetStats().live_bytes, 0u);
+  ASSERT_EQ(memory.GetStats().pool_hits, 0u);
+}
+
+TEST(TestSdkMemory, TestArenaIsReleasedAfterItsLastBlock) {
+  SdkMemorySystem memory;
+  void *survivor;
+  {
+    SdkMemorySystem::ArenaScope arena(&memory);
+    for (int i = 0; i < 1000; i++) {
+      memory.FreeMemory(memory.AllocateMemory(200, 16));
+    }
+    survivor = memory.AllocateMemory(64, 16);
+    ASSERT_EQ(memory.GetStats().arena_allocations, 1001u);
+    ASSERT_GT(memory.GetStats().arena_chunk_bytes, 0u);
+  }
+  // Outside the scope blocks come from the pools again.
+  memory.FreeMemory(memory.AllocateMemory(64, 16));
+  ASSERT_EQ(memory.GetStats().arena_allocations, 1001u);
+
+  // The chunk holding survivor goes back to the spares once it's freed.
+  auto chunkBytes = memory.GetStats().arena_chunk_bytes;
+  ASSERT_EQ(chunkBytes, (uint64_t)SDK_MEMORY_ARENA_CHUNK_SIZE);
+  std::thread([&memory, survivor] { memory.FreeMemory(survivor); }).join();
+  ASSERT_EQ(memory.GetStats().live_bytes, 0u);
+  {
+    SdkMemorySystem::ArenaScope arena(&memory);
+    memory.FreeMemory(memory.AllocateMemory(64, 16));
+  }
+  ASSERT_EQ(memory.GetStats().arena_chunk_bytes, chunkBytes);
+}
+
+TEST(TestSdkMemory, TestArenaOutlivedByBlocks) {
+  SdkMemorySystem memory;
+  std::vector<void*> blocks;
+  {
+    SdkMemorySystem::ArenaScope arena(&memory);
+    for (int i = 0; i < 20000; i++) {
+      blocks.push_back(memory.AllocateMemory(256, 16));
+    }
+  }
+  {
+    // Meanwhile the next arena can't reuse the chunks still in use.
+    SdkMemorySystem::ArenaScope arena(&memory);
+    memory.FreeMemory(memory.AllocateMemory(64, 16));
+  }
+  auto chunkBytes = memory.GetStats().arena_chunk_bytes;
+  ASSERT_GT(chunkBytes, (uint64_t)SDK_MEMORY_ARENA_CHUNK_SIZE * SDK_MEMORY_SPARE_CHUNKS);
+  for (auto block : blocks) {
+    memory.FreeMemory(block);
+  }
+  ASSERT_EQ(memory.GetStats().arena_chunk_bytes, (uint64_t)SDK_MEMORY_ARENA_CHUNK_SIZE * SDK_MEMORY_SPARE_CHUNKS);
+}
+
+TEST(TestSdkMemory, TestLongLivedBlockPinsOnlyItsChunk) {
+  SdkMemorySystem memory;
+  void *survivor;
+  {
+    SdkMemorySystem::ArenaScope arena(&memory);
+    survivor = memory.AllocateMemory(64, 16);
+    for (int i = 0; i < 10000; i++) {
+      memory.FreeMemory(memory.AllocateMemory(256, 16));
+    }
+  }
+  // Chunks the arena moved past were reused as it went, despite survivor.
+  auto chunkBytes = memory.GetStats().arena_chunk_bytes;
+  ASSERT_LE(chunkBytes, (uint64_t)SDK_MEMORY_ARENA_CHUNK_SIZE * 3);
+  {
+    SdkMemorySystem::ArenaScope arena(&memory);
+    for (int i = 0; i < 10000; i++) {
+      memory.FreeMemory(memory.AllocateMemory(256, 16));
+    }
+  }
+  ASSERT_EQ(memory.GetStats().arena_chunk_bytes, chunkBytes);
+  memory.FreeMemory(survivor);
+  ASSERT_EQ(memory.GetStats().live_bytes, 0u);
+}
+
+TEST(TestSdkMemory, TestArenaScopeWithoutSystem) {
+  SdkMemorySystem memory;
+  {
+    SdkMemorySystem::ArenaScope arena(nullptr);
+    memory.FreeMemory(memory.AllocateMemory(64, 16));
+  }
+  ASSERT_EQ(memory.GetStats().arena_allocations, 0u);
+}
@@ -0,0 +1,168 @@
+#include "gtest/gtest.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ClientAddress.h"
+#include "SharedSnapshot.h"
+
+class TestSharedSnapshot : public ::testing::Test {
+protected:
+  void SetUp() override {
+    this->name = "ec2dns-test-" + std::to_string(getpid());
+    this->lockPath = "/tmp/" + this->name + ".lock";
+  }
+
+  void TearDown() override {
+    SharedSnapshot shared(this->name, this->lockPath, std::make_shared<StatsReceiver>());
+    for (uint64_t generation = 1; generation <= 4; generation++) {
+      shm_unlink(shared.GetGenerationPath(generation).c_str());
+    }
+    shm_unlink(("/" + this->name).c_str());
+    unlink(this->lockPath.c_str());
+  }
+
+  std::unique_ptr<SharedSnapshot> Open() {
+    return std::unique_ptr<SharedSnapshot>(
+        new SharedSnapshot(this->name, this->lockPath, std::make_shared<StatsReceiver>()));
+  }
+
+  std::string name;
+  std::string lockPath;
+};
+
+static SnapshotInstance _Instance(const char *id, const char *ip, uint8_t zone) {
+  ClientAddress addr;
+  ClientAddress::TryParse(ip, &addr);
+  SnapshotInstance instance;
+  EXPECT_TRUE(instance.TrySetId(id));
+  instance.ipv4 = addr.GetV4();
+  instance.zone = zone;
+  instance.flags = SNAPSHOT_INSTANCE_HAS_IPV4;
+  return instance;
+}
+
+static ZoneSnapshot _Snapshot(uint32_t serial, std::vector<SnapshotInstance> instances) {
+  ZoneSnapshot::AutoscalingGroups groups;
+  groups["web"] = std::make_shared<const AsgMembers>(
+      std::vector<AsgMember> {{"10.0.0.2", 1}, {"10.0.0.1", 0}}, 25);
+  std::vector<uint32_t> stableSince;
+  for (size_t i = 0; i < instances.size(); i++) {
+    stableSince.push_back(1000 + i);
+  }
+  return ZoneSnapshot(
+      serial, std::move(instances), {"us-east-1a", "us-east-1c"},
+      HostnameFormat("ue1", "tc", "aws.test."), std::move(groups), std::move(stableSince));
+}
+
+TEST_F(TestSharedSnapshot, TestElectsOneLeader) {
+  auto first = this->Open();
+  auto second = this->Open();
+  ASSERT_TRUE(first->TryLead());
+  ASSERT_TRUE(first->TryLead());
+  ASSERT_FALSE(second->TryLead());
+  ASSERT_FALSE(second->IsLeader());
+  first.reset();
+  ASSERT_TRUE(second->TryLead());
+}
+
+TEST_F(TestSharedSnapshot, TestNothingPublishedYet) {
+  auto follower = this->Open();
+  SharedSnapshotGeneration loaded;
+  ASSERT_EQ(follower->GetGeneration(), 0u);
+  ASSERT_FALSE(follower->Load(HostnameFormat("ue1", "tc", "aws.test."), &loaded));
+  ASSERT_FALSE(follower->Publish(_Snapshot(1, {}), 0, 0));
+}
+
+TEST_F(TestSharedSnapshot, TestFollowsGenerations) {
+  auto leader = this->Open();
+  auto follower = this->Open();
+  ASSERT_TRUE(leader->TryLead());
+  ASSERT_TRUE(leader->Publish(_Snapshot(7, {
+      _Instance("i-0123456789abcdef0", "10.0.0.2", 1),
+      _Instance("i-1234", "10.0.0.1", 0)}), 1234, 12345));
+
+  SharedSnapshotGeneration first;
+  ASSERT_EQ(follower->GetGeneration(), 1u);
+  ASSERT_TRUE(follower->Load(HostnameFormat("ue1", "other", "aws.other."), &first));
+  ASSERT_EQ(first.generation, 1u);
+  ASSERT_EQ(first.taken, 1234);
+  ASSERT_EQ(first.next_refresh, 12345);
+  const auto &snapshot = *first.snapshot;
+  ASSERT_EQ(snapshot.GetSerial(), 7u);
+  ASSERT_EQ(snapshot.GetInstances().size(), 2u);
+  ASSERT_EQ(snapshot.GetZones(), std::vector<std::string>({"us-east-1a", "us-east-1c"}));
+
+  // Names are rendered with the follower's own format.
+  char hostname[SNAPSHOT_HOSTNAME_BUFFER_SIZE];
+  auto found = snapshot.FindById(_Instance("i-0123456789abcdef0", "0.0.0.0", 0));
+  ASSERT_NE(found, nullptr);
+  ASSERT_STREQ(snapshot.FormatHostname(*found, true, hostname, sizeof(hostname)),
+               "ue1c-other-0123456789abcdef0.aws.other.");
+  ASSERT_EQ(snapshot.GetStableSince()[found - snapshot.GetInstances().begin()], 1000u);
+  ASSERT_EQ(snapshot.FindByIp(0x0A000001), &snapshot.GetInstances()[0]);
+  ASSERT_EQ(snapshot.FindByIp(0x0A000003), nullptr);
+
+  auto web = snapshot.GetAutoscalingGroups().at("web");
+  ASSERT_EQ(web->GetTtl(), 25u);
+  ASSERT_EQ(web->GetIps(), std::vector<std::string>({"10.0.0.1", "10.0.0.2"}));
+  ASSERT_EQ(web->GetZone(1), 1);
+
+  // Later generations replace and eventually unlink it, the mapping the
+  // follower holds stays readable.
+  for (uint32_t serial = 8; serial <= 10; serial++) {
+    ASSERT_TRUE(leader->Publish(_Snapshot(serial, {_Instance("i-5678", "10.0.0.9", 0)}), 0, 0));
+  }
+  ASSERT_EQ(shm_open(leader->GetGenerationPath(1).c_str(), O_RDONLY, 0), -1);
+  SharedSnapshotGeneration latest;
+  ASSERT_TRUE(follower->Load(HostnameFormat("ue1", "tc", "aws.test."), &latest));
+  ASSERT_EQ(latest.generation, 4u);
+  ASSERT_EQ(latest.snapshot->GetSerial(), 10u);
+  ASSERT_EQ(latest.snapshot->GetInstances().size(), 1u);
+  ASSERT_STREQ(snapshot.FormatHostname(snapshot.GetInstances()[0], false, hostname, sizeof(hostname)),
+               "ue1a-other-1234");
+}
+
+TEST_F(TestSharedSnapshot, TestRejectsCorruptGenerations) {
+  auto leader = this->Open();
+  auto follower = this->Open();
+  ASSERT_TRUE(leader->TryLead());
+  ASSERT_TRUE(leader->Publish(_Snapshot(1, {_Instance("i-1234", "10.0.0.1", 0)}), 0, 0));
+
+  int fd = shm_open(leader->GetGenerationPath(1).c_str(), O_RDWR, 0);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, 64), 0);
+  close(fd);
+  SharedSnapshotGeneration loaded;
+  ASSERT_FALSE(follower->Load(HostnameFormat("ue1", "tc", "aws.test."), &loaded));
+}
+
+TEST_F(TestSharedSnapshot, TestRefusesSymlinkedLock) {
+  auto target = this->lockPath + ".target";
+  ASSERT_EQ(symlink(target.c_str(), this->lockPath.c_str()), 0);
+  auto leader = this->Open();
+  ASSERT_FALSE(leader->TryLead());
+  ASSERT_NE(access(target.c_str(), F_OK), 0);
+}
+
+TEST_F(TestSharedSnapshot, TestRefusesOtherUsersObjects) {
+  auto leader = this->Open();
+  auto follower = this->Open();
+  ASSERT_TRUE(leader->TryLead());
+  ASSERT_TRUE(leader->Publish(_Snapshot(1, {_Instance("i-1234", "10.0.0.1", 0)}), 0, 0));
+
+  int fd = shm_open(leader->GetGenerationPath(1).c_str(), O_RDWR, 0);
+  ASSERT_GE(fd, 0);
+  struct stat st;
+  ASSERT_EQ(fstat(fd, &st), 0);
+  ASSERT_EQ(st.st_mode & 0777, 0600u);
+  // Only root can hand the object to another user.
+  bool chowned = fchown(fd, geteuid() + 1, (gid_t)-1) == 0;
+  close(fd);
+  if (chowned) {
+    SharedSnapshotGeneration loaded;
+    ASSERT_FALSE(follower->Load(HostnameFormat("ue1", "tc", "aws.test."), &loaded));
+  }
+}
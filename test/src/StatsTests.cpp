@@ -0,0 +1,51 @@
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "Stats.h"
+
+TEST(TestStat, TestStartsAtZero) {
+  Stat stat("test");
+  ASSERT_EQ(stat.GetValue(), 0u);
+  stat.Increment();
+  stat.Increment(41);
+  ASSERT_EQ(stat.GetValue(), 42u);
+}
+
+TEST(TestStat, TestSumsAcrossThreads) {
+  StatsReceiver receiver;
+  auto stat = receiver.Create("test");
+  std::vector<std::thread> threads;
+  for (int t = 0; t < STAT_NUM_SLOTS + 8; t++) {
+    threads.push_back(std::thread([stat]() {
+      for (int a = 0; a < 1000; a++) {
+        stat->Increment();
+      }
+    }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(stat->GetValue(), (STAT_NUM_SLOTS + 8) * 1000u);
+  ASSERT_EQ(receiver.GetAllStats().size(), 1u);
+}
+
+TEST(TestStat, TestThreadsGetDistinctSlots) {
+  size_t slots[2];
+  std::thread a([&slots]() { slots[0] = Stat::GetThreadSlot(); });
+  a.join();
+  std::thread b([&slots]() { slots[1] = Stat::GetThreadSlot(); });
+  b.join();
+  ASSERT_NE(slots[0], slots[1]);
+  ASSERT_EQ(Stat::GetThreadSlot(), Stat::GetThreadSlot());
+}
+
+TEST(TestStatsServer, TestMountNamesAreUnique) {
+  StatsServer server(0, "127.0.0.1", 1);
+  auto stats = std::make_shared<StatsReceiver>();
+  ASSERT_EQ(server.Mount("aws.test", stats, nullptr), "aws.test");
+  ASSERT_EQ(server.Mount("aws.test", stats, nullptr), "aws.test-2");
+  ASSERT_EQ(server.Mount("aws.other", stats, nullptr), "aws.other");
+  server.Unmount("aws.test");
+  ASSERT_EQ(server.Mount("aws.test", stats, nullptr), "aws.test");
+}
@@ -0,0 +1,29 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <thread>
+
+#include "TimedMutex.h"
+
+TEST(TestTimedMutex, TestUncontendedLockIsNotCounted) {
+  TimedMutex mutex;
+  {
+    std::lock_guard<TimedMutex> lock(mutex);
+  }
+  ASSERT_EQ(mutex.GetContended(), 0u);
+  ASSERT_EQ(mutex.GetWaitNs(), 0u);
+}
+
+TEST(TestTimedMutex, TestCountsWaits) {
+  TimedMutex mutex;
+  std::unique_lock<TimedMutex> held(mutex);
+  std::thread waiter([&mutex] {
+    std::lock_guard<TimedMutex> lock(mutex);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  held.unlock();
+  waiter.join();
+
+  ASSERT_EQ(mutex.GetContended(), 1u);
+  ASSERT_GE(mutex.GetWaitNs(), 10u * 1000 * 1000);
+}
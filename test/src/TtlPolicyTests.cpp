@@ -0,0 +1,59 @@
+#include "gtest/gtest.h"
+
+#include "Cache.h"
+#include "TtlPolicy.h"
+
+TEST(TestTtlPolicy, TestScalesWithinBounds) {
+  TtlPolicy policy(60, 600, 10);
+  ASSERT_EQ(policy.GetTtl(0), 60u);
+  ASSERT_EQ(policy.GetTtl(1200), 120u);
+  ASSERT_EQ(policy.GetTtl(100000), 600u);
+}
+
+TEST(TestTtlPolicy, TestFloor) {
+  TtlPolicy policy(60, 600, 10);
+  ASSERT_EQ(policy.GetTtl(0, 90), 90u);
+  ASSERT_EQ(policy.GetTtl(1200, 90), 120u);
+  ASSERT_EQ(policy.GetTtl(0, 1000), 600u);
+}
+
+TEST(TestTtlPolicy, TestMinWinsOverMax) {
+  TtlPolicy policy(60, 30, 10);
+  ASSERT_EQ(policy.GetTtl(100000), 60u);
+}
+
+TEST(TestCache, TestStableSinceSurvivesSameValue) {
+  Cache<std::string> cache("test", std::make_shared<StatsReceiver>(), 60);
+  auto start = steady_clock::now();
+  auto expiresOn = start + seconds(60);
+  cache.Insert("i-1", "10.0.0.1", expiresOn);
+
+  char value[16];
+  time_point<steady_clock> first, second;
+  ASSERT_EQ(cache.TryGet("i-1", value, sizeof(value), &first), CacheLookup::Hit);
+  ASSERT_GE(first, start);
+
+  cache.Insert("i-1", "10.0.0.1", expiresOn);
+  ASSERT_EQ(cache.TryGet("i-1", value, sizeof(value), &second), CacheLookup::Hit);
+  ASSERT_EQ(first, second);
+
+  std::this_thread::sleep_for(milliseconds(2));
+  cache.Insert("i-1", "10.0.0.2", expiresOn);
+  ASSERT_EQ(cache.TryGet("i-1", value, sizeof(value), &second), CacheLookup::Hit);
+  ASSERT_GT(second, first);
+}
+
+TEST(TestCache, TestTooLongIsNotAMiss) {
+  auto stats = std::make_shared<StatsReceiver>();
+  Cache<std::string> cache("test", stats, 60);
+  cache.Insert("i-1", "10.0.0.1");
+
+  char value[4];
+  ASSERT_EQ(cache.TryGet("i-1", value, sizeof(value)), CacheLookup::TooLong);
+  ASSERT_EQ(cache.TryGet("i-2", value, sizeof(value)), CacheLookup::Missing);
+  for (const auto &stat : stats->GetAllStats()) {
+    if (stat->GetName() == "test_misses" || stat->GetName() == "test_hits") {
+      ASSERT_EQ(stat->GetValue(), stat->GetName() == "test_misses" ? 1u : 0u);
+    }
+  }
+}
@@ -0,0 +1,32 @@
+#include "gtest/gtest.h"
+
+#include "ZoneClassifier.h"
+
+std::shared_ptr<ReverseLookupHelper> _RlHelper(const std::string& cidr) {
+  auto rl = std::make_shared<ReverseLookupHelper>(std::shared_ptr<Ec2DnsClient>());
+  rl->InitializeReverseLookupZones(cidr);
+  return rl;
+}
+
+TEST(TestZoneClassifier, TestClassifiesZones) {
+  ZoneClassifier classifier("aws.test", _RlHelper("10.1.0.0/22"));
+
+  ASSERT_EQ(classifier.Classify("aws.test"), ZoneKind::Forward);
+  ASSERT_EQ(classifier.Classify("AWS.Test."), ZoneKind::Forward);
+  ASSERT_EQ(classifier.Classify("asg.aws.test"), ZoneKind::Autoscaler);
+  ASSERT_EQ(classifier.Classify("ASG.aws.test."), ZoneKind::Autoscaler);
+  ASSERT_EQ(classifier.Classify("3.1.10.in-addr.arpa"), ZoneKind::Reverse);
+  ASSERT_EQ(classifier.Classify("4.1.10.in-addr.arpa"), ZoneKind::Unknown);
+  ASSERT_EQ(classifier.Classify("foo.aws.test"), ZoneKind::Unknown);
+  ASSERT_EQ(classifier.Classify("ws.test"), ZoneKind::Unknown);
+  ASSERT_EQ(classifier.Classify("example.com"), ZoneKind::Unknown);
+  ASSERT_EQ(classifier.Classify(""), ZoneKind::Unknown);
+}
+
+TEST(TestZoneClassifier, TestNormalizesZoneName) {
+  ZoneClassifier classifier("AWS.Test.", _RlHelper("10.1.0.0/22"));
+
+  ASSERT_EQ(classifier.GetZoneName(), "aws.test");
+  ASSERT_EQ(classifier.GetAutoscalerZoneName(), "asg.aws.test");
+  ASSERT_EQ(classifier.Classify("aws.test"), ZoneKind::Forward);
+}
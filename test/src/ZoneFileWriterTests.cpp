@@ -0,0 +1,114 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "ZoneFileWriter.h"
+
+class ZoneFileWriterTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    char dir[] = "/tmp/ec2dns-zones-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    m_dir = dir;
+    m_stats = std::make_shared<StatsReceiver>();
+    auto rlHelper = std::make_shared<ReverseLookupHelper>(nullptr);
+    rlHelper->InitializeReverseLookupZones("10.1.2.0/23");
+    auto records = std::make_shared<ZoneRecords>(
+        "aws.test.", std::vector<std::string>({"ns1.aws.test."}), rlHelper);
+    m_writer = std::unique_ptr<ZoneFileWriter>(new ZoneFileWriter(
+        m_dir, "aws.test.", rlHelper->GetReverseLookupZones(), records, m_stats));
+  }
+
+  virtual void TearDown() {
+    system(("rm -rf " + m_dir).c_str());
+  }
+
+  ZoneSnapshotPtr Snapshot(uint32_t serial, const std::vector<std::pair<std::string, std::string>> &instances) {
+    std::vector<SnapshotInstance> result;
+    for (const auto &i : instances) {
+      ClientAddress addr;
+      ClientAddress::TryParse(i.second, &addr);
+      SnapshotInstance instance;
+      instance.TrySetId("i-" + i.first);
+      instance.ipv4 = addr.GetV4();
+      instance.zone = 0;
+      instance.flags = SNAPSHOT_INSTANCE_HAS_IPV4;
+      result.push_back(instance);
+    }
+    ZoneSnapshot::AutoscalingGroups groups;
+    groups["web"] = std::make_shared<const AsgMembers>(std::vector<AsgMember>({{instances[0].second, 0}}), 15);
+    return std::make_shared<const ZoneSnapshot>(
+        serial, result, std::vector<std::string>({"us-east-1a"}), HostnameFormat("ue1", "tc", "aws.test."), groups,
+        std::vector<uint32_t>(result.size(), 1000));
+  }
+
+  // Every instance stable for 1000s, 30s until the next refresh.
+  void Write(const ZoneSnapshotPtr &snapshot) {
+    m_writer->Write(*snapshot, RecordTtls(TtlPolicy(20, 600, 10), 2000, 2030));
+  }
+
+  std::string Read(const std::string &zone) {
+    std::ifstream f(m_writer->GetPath(zone));
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+  }
+
+  uint64_t GetStat(const std::string &name) {
+    for (const auto &s : m_stats->GetAllStats()) {
+      if (s->GetName() == name) {
+        return s->GetValue();
+      }
+    }
+    return 0;
+  }
+
+  std::string m_dir;
+  std::shared_ptr<StatsReceiver> m_stats;
+  std::unique_ptr<ZoneFileWriter> m_writer;
+};
+
+TEST_F(ZoneFileWriterTest, TestWritesEveryZone) {
+  this->Write(this->Snapshot(7, {{"a", "10.1.2.3"}, {"b", "10.1.3.4"}}));
+
+  ASSERT_EQ(this->Read("aws.test"),
+            "$ORIGIN aws.test.\n$TTL 30\n"
+            "@\t30\tIN\tSOA\taws.test. hostmaster.aws.test. 7 172800 900 1209600 180\n"
+            "@\t30\tIN\tNS\tns1.aws.test.\n"
+            "ue1a-tc-a\t100\tIN\tA\t10.1.2.3\n"
+            "ue1a-tc-b\t100\tIN\tA\t10.1.3.4\n");
+  ASSERT_EQ(this->Read("2.1.10.in-addr.arpa"),
+            "$ORIGIN 2.1.10.in-addr.arpa.\n$TTL 30\n"
+            "@\t30\tIN\tSOA\taws.test. hostmaster.aws.test. 7 172800 900 1209600 180\n"
+            "@\t30\tIN\tNS\tns1.aws.test.\n"
+            "3\t100\tIN\tPTR\tue1a-tc-a.aws.test.\n");
+  ASSERT_NE(this->Read("asg.aws.test").find("web\t15\tIN\tA\t10.1.2.3\n"), std::string::npos);
+  ASSERT_NE(this->Read("3.1.10.in-addr.arpa").find("4\t100\tIN\tPTR\tue1a-tc-b.aws.test.\n"), std::string::npos);
+  ASSERT_EQ(this->GetStat("zone_export_writes"), 4u);
+  ASSERT_GT(this->GetStat("zone_export_bytes"), 0u);
+}
+
+TEST_F(ZoneFileWriterTest, TestSkipsUnchangedZones) {
+  this->Write(this->Snapshot(7, {{"a", "10.1.2.3"}, {"b", "10.1.3.4"}}));
+  this->Write(this->Snapshot(8, {{"a", "10.1.2.3"}, {"b", "10.1.3.4"}}));
+  ASSERT_EQ(this->GetStat("zone_export_writes"), 4u);
+  ASSERT_EQ(this->GetStat("zone_export_skipped"), 4u);
+  ASSERT_NE(this->Read("aws.test").find(" 7 "), std::string::npos);
+
+  // Only the forward zone and b's reverse zone changed.
+  this->Write(this->Snapshot(9, {{"a", "10.1.2.3"}, {"b", "10.1.3.5"}}));
+  ASSERT_EQ(this->GetStat("zone_export_writes"), 6u);
+  ASSERT_NE(this->Read("aws.test").find(" 9 "), std::string::npos);
+  ASSERT_NE(this->Read("3.1.10.in-addr.arpa").find("5\t100\tIN\tPTR\tue1a-tc-b.aws.test.\n"), std::string::npos);
+  ASSERT_NE(this->Read("2.1.10.in-addr.arpa").find(" 7 "), std::string::npos);
+  ASSERT_NE(this->Read("asg.aws.test").find(" 7 "), std::string::npos);
+}
+
+TEST_F(ZoneFileWriterTest, TestCountsFailures) {
+  system(("rm -rf " + m_dir).c_str());
+  this->Write(this->Snapshot(7, {{"a", "10.1.2.3"}}));
+  ASSERT_EQ(this->GetStat("zone_export_writes"), 0u);
+  ASSERT_EQ(this->GetStat("zone_export_failures"), 4u);
+}
@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+
+#include "TransferAcl.h"
+#include "ZoneSnapshot.h"
+
+SnapshotInstance _Instance(const char *id, const char *ip, uint8_t zone = 0) {
+  ClientAddress addr;
+  ClientAddress::TryParse(ip, &addr);
+  SnapshotInstance instance;
+  EXPECT_TRUE(instance.TrySetId(id));
+  instance.ipv4 = addr.GetV4();
+  instance.zone = zone;
+  instance.flags = SNAPSHOT_INSTANCE_HAS_IPV4;
+  return instance;
+}
+
+ZoneSnapshot _Snapshot(std::vector<SnapshotInstance> instances) {
+  return ZoneSnapshot(
+      1, std::move(instances), {"us-east-1a", "us-east-1c"},
+      HostnameFormat("ue1", "tc", "aws.test."), ZoneSnapshot::AutoscalingGroups());
+}
+
+std::string _Id(const SnapshotInstance &instance) {
+  char id[SNAPSHOT_ID_BUFFER_SIZE];
+  return ZoneSnapshot::FormatInstanceId(instance, id, sizeof(id));
+}
+
+TEST(TestZoneSnapshot, TestInstancesInNetwork) {
+  auto snapshot = _Snapshot({
+      _Instance("i-4", "10.1.3.1"),
+      _Instance("i-1", "10.1.2.255"),
+      _Instance("i-2", "10.1.1.7"),
+      _Instance("i-3", "10.1.2.0")
+  });
+
+  auto range = snapshot.GetInstancesInNetwork(0x0A010200, 0xFFFFFF00u);
+  ASSERT_EQ(range.second - range.first, 2);
+  ASSERT_EQ(_Id(range.first[0]), "i-3");
+  ASSERT_EQ(_Id(range.first[1]), "i-1");
+
+  range = snapshot.GetInstancesInNetwork(0x0A020000, 0xFFFF0000u);
+  ASSERT_EQ(range.first, range.second);
+}
+
+TEST(TestZoneSnapshot, TestInstanceIds) {
+  ASSERT_EQ(sizeof(SnapshotInstance), 16u);
+  for (auto id : {"i-0123456789abcdef0", "i-f123456789abcdef0", "i-00001234", "i-0"}) {
+    ASSERT_EQ(_Id(_Instance(id, "10.1.2.3")), id);
+  }
+  ASSERT_EQ(_Id(_Instance("i-ABCDEF12", "10.1.2.3")), "i-abcdef12");
+
+  SnapshotInstance instance;
+  ASSERT_FALSE(instance.TrySetId("i-"));
+  ASSERT_FALSE(instance.TrySetId("x-1234"));
+  ASSERT_FALSE(instance.TrySetId("i-123g"));
+  ASSERT_FALSE(instance.TrySetId("i-0123456789abcdef01"));
+
+  char small[5];
+  ASSERT_EQ(ZoneSnapshot::FormatInstanceId(_Instance("i-1234", "10.1.2.3"), small, sizeof(small)), nullptr);
+}
+
+TEST(TestZoneSnapshot, TestFormatsNames) {
+  auto snapshot = _Snapshot({_Instance("i-0123456789abcdef0", "10.1.2.3", 1), _Instance("i-1234", "10.1.2.4", 7)});
+  const auto &instances = snapshot.GetInstances();
+  char buf[SNAPSHOT_HOSTNAME_BUFFER_SIZE];
+  ASSERT_STREQ(snapshot.FormatHostname(instances[0], true, buf, sizeof(buf)), "ue1c-tc-0123456789abcdef0.aws.test.");
+  ASSERT_STREQ(snapshot.FormatHostname(instances[0], false, buf, sizeof(buf)), "ue1c-tc-0123456789abcdef0");
+  // An unknown zone still gets a name.
+  ASSERT_STREQ(snapshot.FormatHostname(instances[1], true, buf, sizeof(buf)), "ue1?-tc-1234.aws.test.");
+  ASSERT_EQ(snapshot.FormatHostname(instances[0], true, buf, 20), nullptr);
+
+  ASSERT_STREQ(ZoneSnapshot::FormatIp(instances[0], buf, SNAPSHOT_IP_BUFFER_SIZE), "10.1.2.3");
+  auto broadcast = _Instance("i-1", "255.255.255.255");
+  ASSERT_STREQ(ZoneSnapshot::FormatIp(broadcast, buf, SNAPSHOT_IP_BUFFER_SIZE), "255.255.255.255");
+  ASSERT_EQ(ZoneSnapshot::FormatIp(broadcast, buf, 8), nullptr);
+}
+
+TEST(TestZoneSnapshot, TestNextSerialIncreases) {
+  uint32_t serial = ZoneSnapshot::NextSerial(0);
+  ASSERT_GT(serial, 1000000000u);
+  ASSERT_GT(ZoneSnapshot::NextSerial(serial), serial);
+  ASSERT_EQ(ZoneSnapshot::NextSerial(4000000000u), 4000000001u);
+}
+
+TEST(TestTransferAcl, TestEmptyDeniesEveryone) {
+  TransferAcl acl;
+  ASSERT_TRUE(acl.TryParse(""));
+  ASSERT_FALSE(acl.IsAllowed("10.0.0.1"));
+}
+
+TEST(TestTransferAcl, TestNetworksAndAddresses) {
+  TransferAcl acl;
+  ASSERT_TRUE(acl.TryParse("10.0.0.0/16, 192.168.1.5,fd00::53"));
+  ASSERT_TRUE(acl.IsAllowed("10.0.200.1"));
+  ASSERT_TRUE(acl.IsAllowed("192.168.1.5"));
+  ASSERT_TRUE(acl.IsAllowed("fd00::53"));
+  ASSERT_FALSE(acl.IsAllowed("10.1.0.1"));
+  ASSERT_FALSE(acl.IsAllowed("192.168.1.6"));
+  ASSERT_FALSE(acl.IsAllowed("fd00::54"));
+  ASSERT_FALSE(acl.IsAllowed("garbage"));
+  ASSERT_FALSE(acl.IsAllowed(nullptr));
+}
+
+TEST(TestTransferAcl, TestRejectsInvalidEntries) {
+  TransferAcl acl;
+  ASSERT_FALSE(acl.TryParse("10.0.0.0/33"));
+  ASSERT_FALSE(acl.TryParse("10.0.0.1,nope"));
+}